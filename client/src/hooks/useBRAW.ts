@@ -5,7 +5,7 @@
  * and frame extraction with caching and progress tracking
  */
 
-import { useState, useCallback } from 'react';
+import { useState, useCallback, useRef } from 'react';
 import { trpc } from '../lib/trpc';
 
 export interface BRAWMetadata {
@@ -39,10 +39,188 @@ export interface UseBRAWState {
   // Methods
   uploadFile: (file: File) => Promise<void>;
   extractFrame: (timestamp: number, quality?: 'low' | 'medium' | 'high') => Promise<void>;
-  extractFrames: (timestamps: number[], quality?: 'low' | 'medium' | 'high') => Promise<Array<{ timestamp: number; dataUrl: string }>>;
+  extractFrames: (
+    timestamps: number[],
+    quality?: 'low' | 'medium' | 'high',
+    onFrame?: (frame: StreamedFrame) => void
+  ) => Promise<Array<{ timestamp: number; dataUrl: string }>>;
   cleanup: () => Promise<void>;
 }
 
+export interface BRAWUploadResult {
+  success: boolean;
+  fileId: string;
+  info: BRAWMetadata;
+  fileName: string;
+  size: number;
+}
+
+// Each chunk is one PATCH; a dropped connection costs at most this much
+const UPLOAD_CHUNK_BYTES = 8 * 1024 * 1024;
+const UPLOAD_RETRIES = 5;
+
+// Same file, same upload: picking it again resumes where it stopped
+function uploadKey(file: File): string {
+  return `braw-upload:${file.name}:${file.size}:${file.lastModified}`;
+}
+
+async function queryUploadOffset(uploadId: string): Promise<number | null> {
+  const response = await fetch(`/api/braw/uploads/${uploadId}`, { method: 'HEAD', cache: 'no-store' });
+  return response.ok ? Number(response.headers.get('Upload-Offset')) : null;
+}
+
+// Resolves with the response status even for errors; rejects only when the
+// connection fails
+function sendUploadChunk(
+  uploadId: string,
+  offset: number,
+  chunk: Blob,
+  onProgress: (loaded: number) => void
+): Promise<{ status: number; offset: number; body: any }> {
+  return new Promise((resolve, reject) => {
+    const xhr = new XMLHttpRequest();
+    xhr.open('PATCH', `/api/braw/uploads/${uploadId}`, true);
+    xhr.setRequestHeader('Content-Type', 'application/offset+octet-stream');
+    xhr.setRequestHeader('Upload-Offset', String(offset));
+
+    xhr.upload.onprogress = (event) => onProgress(event.loaded);
+    xhr.onload = () => {
+      let body = null;
+      try {
+        body = xhr.responseText ? JSON.parse(xhr.responseText) : null;
+      } catch {}
+      resolve({ status: xhr.status, offset: Number(xhr.getResponseHeader('Upload-Offset')), body });
+    };
+    xhr.onerror = () => reject(new Error('Upload failed'));
+    xhr.send(chunk);
+  });
+}
+
+/**
+ * Upload a clip in chunks streamed straight to disk on the server. An
+ * interrupted upload resumes from the server's offset, whether the
+ * connection dropped mid-chunk or the page was reloaded.
+ */
+export async function uploadBRAWFile(
+  file: File,
+  onProgress: (percent: number) => void
+): Promise<BRAWUploadResult> {
+  const key = uploadKey(file);
+  let uploadId = localStorage.getItem(key);
+  let offset = uploadId ? await queryUploadOffset(uploadId).catch(() => null) : null;
+
+  if (!uploadId || offset === null) {
+    const response = await fetch('/api/braw/uploads', {
+      method: 'POST',
+      headers: { 'Content-Type': 'application/json' },
+      body: JSON.stringify({ fileName: file.name, size: file.size }),
+    });
+    const created = await response.json().catch(() => ({}));
+    if (!response.ok) {
+      throw new Error(created.error || response.statusText);
+    }
+    uploadId = created.uploadId as string;
+    offset = 0;
+    localStorage.setItem(key, uploadId);
+  }
+
+  let failures = 0;
+  for (;;) {
+    const start: number = offset;
+    const end = Math.min(start + UPLOAD_CHUNK_BYTES, file.size);
+    const result = await sendUploadChunk(uploadId, start, file.slice(start, end), (loaded) =>
+      onProgress(((start + loaded) / file.size) * 100)
+    ).catch(() => null);
+
+    if (result?.status === 200) {
+      localStorage.removeItem(key);
+      onProgress(100);
+      return result.body;
+    }
+    if (result?.status === 204) {
+      offset = result.offset;
+      failures = 0;
+      continue;
+    }
+    if (result && result.status !== 409 && result.status < 500) {
+      if (result.status === 404) {
+        localStorage.removeItem(key);
+      }
+      throw new Error(result.body?.error || `Upload failed (${result.status})`);
+    }
+
+    // Dropped, conflicting or failed on the server: back off, then resume
+    // from wherever the server's copy ends
+    if (++failures > UPLOAD_RETRIES) {
+      throw new Error('Upload failed');
+    }
+    await new Promise((resolve) => setTimeout(resolve, 500 * 2 ** failures));
+    const synced = await queryUploadOffset(uploadId).catch(() => null);
+    if (synced !== null) {
+      offset = synced;
+    }
+  }
+}
+
+export interface StreamedFrame {
+  position: number; // Index into the requested timestamps
+  frameIndex: number;
+  timestamp: number;
+  data: Uint8Array;
+  error?: string;
+}
+
+/**
+ * Read frames from /api/braw/frames/:fileId/stream as the server decodes
+ * them, in completion order. Each record is a u32 metadata length and u32
+ * data length (little-endian), JSON metadata, then the image bytes.
+ */
+export async function streamBRAWFrames(
+  fileId: string,
+  timestamps: number[],
+  options: { quality?: 'low' | 'medium' | 'high'; format?: 'jpeg' | 'webp' | 'raw'; signal?: AbortSignal },
+  onFrame: (frame: StreamedFrame) => void
+): Promise<void> {
+  const response = await fetch(`/api/braw/frames/${fileId}/stream`, {
+    method: 'POST',
+    headers: { 'Content-Type': 'application/json' },
+    body: JSON.stringify({ timestamps, quality: options.quality, format: options.format }),
+    signal: options.signal,
+  });
+  if (!response.ok || !response.body) {
+    const body = await response.json().catch(() => ({}));
+    throw new Error(body.error || `Frame stream failed (${response.status})`);
+  }
+
+  const reader = response.body.getReader();
+  let buffered = new Uint8Array(0);
+
+  for (;;) {
+    const { done, value } = await reader.read();
+    if (done) break;
+
+    const joined = new Uint8Array(buffered.length + value.length);
+    joined.set(buffered);
+    joined.set(value, buffered.length);
+    buffered = joined;
+
+    // Hand over every complete record; keep the partial tail for the next read
+    let offset = 0;
+    while (buffered.length - offset >= 8) {
+      const view = new DataView(buffered.buffer, buffered.byteOffset + offset, 8);
+      const metadataLength = view.getUint32(0, true);
+      const dataLength = view.getUint32(4, true);
+      const end = offset + 8 + metadataLength + dataLength;
+      if (buffered.length < end) break;
+
+      const metadata = JSON.parse(new TextDecoder().decode(buffered.subarray(offset + 8, offset + 8 + metadataLength)));
+      onFrame({ ...metadata, data: buffered.slice(offset + 8 + metadataLength, end) });
+      offset = end;
+    }
+    buffered = buffered.slice(offset);
+  }
+}
+
 /**
  * Hook for BRAW file processing
  */
@@ -61,6 +239,10 @@ export function useBRAW(): UseBRAWState {
   const getInfoQuery = trpc.braw.getInfo.useQuery;
   const extractFrameQuery = trpc.braw.extractFrame.useQuery;
   const cleanupMutation = trpc.braw.cleanup.useMutation();
+  const { mutate: cancelFrames } = trpc.braw.cancelFrames.useMutation();
+
+  // The frame request still in flight; a newer one (e.g. while scrubbing) supersedes it
+  const pendingFrame = useRef<{ requestId: string; controller: AbortController } | null>(null);
 
   /**
    * Upload BRAW file
@@ -72,51 +254,10 @@ export function useBRAW(): UseBRAWState {
         setUploadError(null);
         setUploadProgress(0);
 
-        // Read file as base64
-        const reader = new FileReader();
-        reader.onprogress = (event) => {
-          if (event.lengthComputable) {
-            setUploadProgress((event.loaded / event.total) * 100);
-          }
-        };
-
-
-
-        // Upload to server
-        const formData = new FormData();
-        formData.append("file", fileInput);
-
-        const xhr = new XMLHttpRequest();
-        xhr.open("POST", "/api/braw/upload", true);
-
-        xhr.upload.onprogress = (event) => {
-          if (event.lengthComputable) {
-            setUploadProgress((event.loaded / event.total) * 100);
-          }
-        };
-
-        const result = await new Promise<any>((resolve, reject) => {
-          xhr.onload = () => {
-            if (xhr.status >= 200 && xhr.status < 300) {
-              resolve(JSON.parse(xhr.responseText));
-            } else {
-              reject(new Error(xhr.statusText));
-            }
-          };
-          xhr.onerror = () => reject(new Error("Upload failed"));
-          xhr.send(formData);
-        });
-
-        // Get metadata using tRPC query
-        // Note: In a real app, you'd use useQuery hook in a component
-        // For now, we'll fetch it directly
-        const infoResult = await fetch('/api/trpc/braw.getInfo', {
-          method: 'POST',
-          headers: { 'Content-Type': 'application/json' },
-          body: JSON.stringify({ fileId: result.fileId }),
-        }).then(r => r.json());
-
-        const info = infoResult.result?.data || result.info;
+        // The final chunk answers with the clip info, read from the index
+        // the server builds as the upload completes
+        const result = await uploadBRAWFile(fileInput, setUploadProgress);
+        const info = result.info;
 
         setFile({
           fileId: result.fileId,
@@ -154,6 +295,17 @@ export function useBRAW(): UseBRAWState {
         return;
       }
 
+      // Drop the previous frame on the server too, so its decode doesn't
+      // delay this one
+      const previous = pendingFrame.current;
+      if (previous) {
+        previous.controller.abort();
+        cancelFrames({ fileId: file.fileId, requestIds: [previous.requestId] });
+      }
+
+      const request = { requestId: crypto.randomUUID(), controller: new AbortController() };
+      pendingFrame.current = request;
+
       try {
         setIsExtracting(true);
         setExtractError(null);
@@ -166,7 +318,10 @@ export function useBRAW(): UseBRAWState {
             fileId: file.fileId,
             timestamp,
             quality,
+            requestId: request.requestId,
+            priority: 'interactive',
           }),
+          signal: request.controller.signal,
         }).then(r => r.json());
 
         const frameData = result.result?.data || result;
@@ -174,21 +329,34 @@ export function useBRAW(): UseBRAWState {
         // Convert base64 to data URL
         setCurrentFrame(`data:image/jpeg;base64,${frameData.data}`);
       } catch (error) {
+        // Superseded by a newer frame, which reports its own outcome
+        if (request.controller.signal.aborted) {
+          return;
+        }
         const message = error instanceof Error ? error.message : 'Frame extraction failed';
         setExtractError(message);
         console.error('[BRAW Hook] Frame extraction failed:', error);
       } finally {
-        setIsExtracting(false);
+        if (pendingFrame.current === request) {
+          pendingFrame.current = null;
+          setIsExtracting(false);
+        }
       }
     },
-    [file]
+    [file, cancelFrames]
   );
 
   /**
-   * Extract multiple frames
+   * Extract multiple frames, streamed as each decode completes. onFrame sees
+   * every frame as it arrives; the result lists them in request order as
+   * object URLs, which the caller revokes once done with them.
    */
   const extractFrames = useCallback(
-    async (timestamps: number[], quality: 'low' | 'medium' | 'high' = 'medium') => {
+    async (
+      timestamps: number[],
+      quality: 'low' | 'medium' | 'high' = 'medium',
+      onFrame?: (frame: StreamedFrame) => void
+    ) => {
       if (!file) {
         setExtractError('No file loaded');
         return [];
@@ -198,29 +366,15 @@ export function useBRAW(): UseBRAWState {
         setIsExtracting(true);
         setExtractError(null);
 
-        // Extract frames one by one
-        const results = await Promise.all(
-          timestamps.map((timestamp) =>
-            fetch('/api/trpc/braw.extractFrame', {
-              method: 'POST',
-              headers: { 'Content-Type': 'application/json' },
-              body: JSON.stringify({
-                fileId: file.fileId,
-                timestamp,
-                quality,
-              }),
-            }).then(r => r.json())
-          )
-        );
-
-        // Return array of data URLs
-        return results.map((result: any, index: number) => {
-          const frameData = result.result?.data || result;
-          return {
-            timestamp: timestamps[index],
-            dataUrl: `data:image/jpeg;base64,${frameData.data}`,
-          };
+        const dataUrls: string[] = new Array(timestamps.length).fill('');
+        await streamBRAWFrames(file.fileId, timestamps, { quality }, (frame) => {
+          if (!frame.error) {
+            dataUrls[frame.position] = URL.createObjectURL(new Blob([frame.data], { type: 'image/jpeg' }));
+          }
+          onFrame?.(frame);
         });
+
+        return timestamps.map((timestamp, index) => ({ timestamp, dataUrl: dataUrls[index] }));
       } catch (error) {
         const message = error instanceof Error ? error.message : 'Frame extraction failed';
         setExtractError(message);
@@ -21,6 +21,17 @@ export interface ScopeConfig {
   showGrid: boolean;
 }
 
+/**
+ * Scopes computed by the server from the decoded frame (braw.getScopes),
+ * with the base64 payloads already decoded. Waveform and vectorscope cells
+ * are densities from 0 to 255.
+ */
+export interface ScopeData {
+  histogram: ArrayLike<number>; // 4 x 256 counts: R, G, B, then luma
+  waveform: { width: number; height: number; data: Uint8Array }; // Row 0 brightest
+  vectorscope: { size: number; data: Uint8Array }; // U right, V up; +-0.5 at the edges
+}
+
 export class ScopeRenderer {
   private canvas: HTMLCanvasElement;
   private ctx: CanvasRenderingContext2D;
@@ -71,6 +82,58 @@ export class ScopeRenderer {
     }
   }
   
+  /**
+   * Render scope from server-computed data, without touching frame pixels.
+   * Parade and CIE need the frame and are left blank.
+   */
+  renderScopeData(scopes: ScopeData): void {
+    switch (this.config.type) {
+      case ScopeType.WAVEFORM:
+        this.clear();
+        this.drawGrid();
+        this.drawDensity(scopes.waveform.data, scopes.waveform.width, scopes.waveform.height,
+          0, 0, this.canvas.width, this.canvas.height);
+        break;
+      case ScopeType.VECTORSCOPE: {
+        this.clear();
+        const { centerX, centerY, radius } = this.drawVectorscopeGraticule();
+        // +-0.5 in U/V maps to +-radius / 2 around the centre, as in renderVectorscope
+        const { size, data } = scopes.vectorscope;
+        this.drawDensity(data, size, size, centerX - radius / 2, centerY - radius / 2, radius, radius);
+        break;
+      }
+      case ScopeType.HISTOGRAM: {
+        this.clear();
+        this.drawGrid();
+        const histograms = [0, 1, 2, 3].map(channel =>
+          Array.prototype.slice.call(scopes.histogram, channel * 256, channel * 256 + 256) as number[]);
+        this.drawHistograms(histograms);
+        break;
+      }
+      default:
+        this.clear();
+        break;
+    }
+  }
+
+  /**
+   * Draw a 0-255 density map as green, scaled into the given rectangle
+   */
+  private drawDensity(data: Uint8Array, width: number, height: number,
+                      x: number, y: number, drawWidth: number, drawHeight: number): void {
+    const density = new ImageData(width, height);
+    for (let i = 0; i < data.length; i++) {
+      density.data[i * 4 + 1] = data[i];
+      density.data[i * 4 + 3] = data[i] > 0 ? 255 : 0;
+    }
+
+    const staging = document.createElement('canvas');
+    staging.width = width;
+    staging.height = height;
+    staging.getContext('2d')?.putImageData(density, 0, 0);
+    this.ctx.drawImage(staging, x, y, drawWidth, drawHeight);
+  }
+
   /**
    * Clear canvas
    */
@@ -165,12 +228,9 @@ export class ScopeRenderer {
   }
   
   /**
-   * Render Vectorscope
+   * Draw vectorscope circles and colour targets
    */
-  private renderVectorscope(imageData: ImageData): void {
-    this.clear();
-    
-    const { data, width, height } = imageData;
+  private drawVectorscopeGraticule(): { centerX: number; centerY: number; radius: number } {
     const centerX = this.canvas.width / 2;
     const centerY = this.canvas.height / 2;
     const radius = Math.min(centerX, centerY) * 0.9;
@@ -205,6 +265,18 @@ export class ScopeRenderer {
       this.ctx.fillRect(x - 3, y - 3, 6, 6);
     });
     
+    return { centerX, centerY, radius };
+  }
+  
+  /**
+   * Render Vectorscope
+   */
+  private renderVectorscope(imageData: ImageData): void {
+    this.clear();
+    
+    const { data, width, height } = imageData;
+    const { centerX, centerY, radius } = this.drawVectorscopeGraticule();
+    
     // Create accumulation buffer
     const buffer = new Uint32Array(this.canvas.width * this.canvas.height);
     
@@ -356,6 +428,13 @@ export class ScopeRenderer {
       histograms[3][lum]++;
     }
     
+    this.drawHistograms(histograms);
+  }
+  
+  /**
+   * Draw R, G, B and luma histograms of 256 bins each
+   */
+  private drawHistograms(histograms: ArrayLike<number>[]): void {
     // Find max value
     let maxValue = 0;
     for (let i = 0; i < 256; i++) {
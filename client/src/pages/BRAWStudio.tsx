@@ -4,7 +4,7 @@ import { Card } from '@/components/ui/card';
 import { Slider } from '@/components/ui/slider';
 import { Progress } from '@/components/ui/progress';
 import { Upload, Play, Pause, SkipBack, SkipForward, Loader2 } from 'lucide-react';
-import { BRAWFile, BRAWMetadata } from '@/hooks/useBRAW';
+import { BRAWFile, BRAWMetadata, uploadBRAWFile } from '@/hooks/useBRAW';
 import { toast } from 'sonner';
 
 /**
@@ -171,29 +171,8 @@ export default function BRAWStudio() {
       setUploadError(null);
       setUploadProgress(0);
 
-      const formData = new FormData();
-      formData.append('file', selectedFile);
-
-      const xhr = new XMLHttpRequest();
-      xhr.open('POST', '/api/braw/upload', true);
-
-      xhr.upload.onprogress = (event) => {
-        if (event.lengthComputable) {
-          setUploadProgress((event.loaded / event.total) * 100);
-        }
-      };
-
-      const result = await new Promise<any>((resolve, reject) => {
-        xhr.onload = () => {
-          if (xhr.status >= 200 && xhr.status < 300) {
-            resolve(JSON.parse(xhr.responseText));
-          } else {
-            reject(new Error(xhr.statusText));
-          }
-        };
-        xhr.onerror = () => reject(new Error('Upload failed'));
-        xhr.send(formData);
-      });
+      // Chunked and resumable: picking the same file after a failure continues it
+      const result = await uploadBRAWFile(selectedFile, setUploadProgress);
 
       setFile({
         fileId: result.fileId,
@@ -212,8 +191,8 @@ export default function BRAWStudio() {
       setUploadProgress(100);
       toast.success('BRAW file uploaded successfully!');
       
-      // Extract first frame for preview
-      await extractFrame(0, 'medium');
+      // Poster of frame 0, decoded by the server while the upload completed
+      setCurrentFrame(`/api/braw/poster/${result.fileId}`);
       
       // Start H.264 conversion
       await convertToH264(result.fileId);
@@ -0,0 +1,16 @@
+CREATE TABLE `renderJobs` (
+	`id` varchar(64) NOT NULL,
+	`fileId` varchar(64) NOT NULL,
+	`status` enum('queued','running','complete','failed','cancelled') NOT NULL DEFAULT 'queued',
+	`inFrame` int NOT NULL,
+	`outFrame` int NOT NULL,
+	`spec` json NOT NULL,
+	`outputPath` text,
+	`framesDone` int NOT NULL DEFAULT 0,
+	`fps` double NOT NULL DEFAULT 0,
+	`error` text,
+	`createdAt` timestamp DEFAULT (now()),
+	`startedAt` timestamp,
+	`finishedAt` timestamp,
+	CONSTRAINT `renderJobs_id` PRIMARY KEY(`id`)
+);
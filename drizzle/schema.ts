@@ -1,4 +1,4 @@
-import { mysqlEnum, mysqlTable, text, timestamp, varchar } from "drizzle-orm/mysql-core";
+import { double, int, json, mysqlEnum, mysqlTable, text, timestamp, varchar } from "drizzle-orm/mysql-core";
 
 /**
  * Core user table backing auth flow.
@@ -18,4 +18,29 @@ export const users = mysqlTable("users", {
 export type User = typeof users.$inferSelect;
 export type InsertUser = typeof users.$inferInsert;
 
+/**
+ * Server-side render jobs (server/brawRender.ts). framesDone counts frames
+ * written in order from inFrame, so an image-sequence render resumes there
+ * after a restart; fps is the throughput of the latest run.
+ */
+export const renderJobs = mysqlTable("renderJobs", {
+  id: varchar("id", { length: 64 }).primaryKey(),
+  fileId: varchar("fileId", { length: 64 }).notNull(),
+  status: mysqlEnum("status", ["queued", "running", "complete", "failed", "cancelled"]).default("queued").notNull(),
+  inFrame: int("inFrame").notNull(),
+  outFrame: int("outFrame").notNull(),
+  // Grade graph, SDK processing and output spec, as submitted
+  spec: json("spec").notNull(),
+  outputPath: text("outputPath"),
+  framesDone: int("framesDone").default(0).notNull(),
+  fps: double("fps").default(0).notNull(),
+  error: text("error"),
+  createdAt: timestamp("createdAt").defaultNow(),
+  startedAt: timestamp("startedAt"),
+  finishedAt: timestamp("finishedAt"),
+});
+
+export type RenderJob = typeof renderJobs.$inferSelect;
+export type InsertRenderJob = typeof renderJobs.$inferInsert;
+
 // TODO: Add your tables here
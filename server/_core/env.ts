@@ -7,4 +7,30 @@ export const ENV = {
   isProduction: process.env.NODE_ENV === "production",
   forgeApiUrl: process.env.BUILT_IN_FORGE_API_URL ?? "",
   forgeApiKey: process.env.BUILT_IN_FORGE_API_KEY ?? "",
+  // BRAW decode pipeline: cpu, cuda, opencl or auto (GPU falls back to CPU)
+  brawPipeline: process.env.BRAW_PIPELINE ?? "cpu",
+  // Native decoded-frame cache budget in MiB; 0 disables it
+  brawFrameCacheMB: Number(process.env.BRAW_FRAME_CACHE_MB ?? 512),
+  // Released native frame buffers kept for reuse, in MiB; 0 frees them at once
+  brawBufferPoolMB: Number(process.env.BRAW_BUFFER_POOL_MB ?? 256),
+  // Frames decoded ahead of the playhead per open clip; 0 disables prefetch
+  brawPrefetchDepth: Number(process.env.BRAW_PREFETCH_DEPTH ?? 8),
+  // Codecs a batch decode is spread over; 0 sizes the pool to the machine
+  brawDecodeCodecs: Number(process.env.BRAW_DECODE_CODECS ?? 0),
+  // Frames each open clip hands the SDK at once; the rest wait by priority
+  brawMaxJobs: Number(process.env.BRAW_MAX_JOBS ?? 8),
+  // Per-stage native decode timers, reported by braw.getStats
+  brawStats: process.env.BRAW_STATS === "1",
+  // Thumbnails in the strip prepared for each upload; 0 skips the strip
+  brawThumbnails: Number(process.env.BRAW_THUMBNAILS ?? 10),
+  brawThumbnailWidth: Number(process.env.BRAW_THUMBNAIL_WIDTH ?? 160),
+  // Scale of the memory-mapped proxies built for each opened clip: quarter,
+  // eighth, or off
+  brawProxyScale: process.env.BRAW_PROXY_SCALE ?? "quarter",
+  // Render jobs (brawRender.ts) run at once; the rest wait in order
+  brawRenderJobs: Number(process.env.BRAW_RENDER_JOBS ?? 1),
+  // Largest upload accepted, in MiB
+  brawMaxUploadMB: Number(process.env.BRAW_MAX_UPLOAD_MB ?? 2048),
+  // Directory .cube files named by grade LUT nodes are loaded from
+  brawLutDir: process.env.BRAW_LUT_DIR ?? "",
 };
@@ -7,6 +7,7 @@ import { registerOAuthRoutes } from "./oauth";
 import { appRouter } from "../routers";
 import { createContext } from "./context";
 import brawUploadRouter from "../brawUpload";
+import { getRenderQueue } from "../brawRender";
 import path from "path";
 
 // Using process.cwd() as a workaround for __dirname in esbuild context
@@ -71,6 +72,9 @@ async function startServer() {
   server.listen(port, () => {
     console.log(`Server running on http://localhost:${port}/`);
   });
+
+  // Pick up renders a previous run left unfinished
+  getRenderQueue().catch((error) => console.error("[BRAW Render] Failed to start render queue:", error));
 }
 
 startServer().catch(console.error);
@@ -0,0 +1,323 @@
+/*
+ * BRAW Decode Benchmark
+ *
+ * Usage:
+ *   braw-bench <input.braw> [frames] [format] [scale] [pipeline] [concurrency] [codecs] [encoding]
+ *
+ * Decodes the first frames frames of the clip (default 100, "all" for the
+ * whole clip) the way the addon does, through BrawClip, and prints a JSON
+ * report: wall time, throughput in fps and MB/s of decoded pixels, peak
+ * resident memory, and a log2 nanosecond histogram with mean and
+ * percentiles for each stage (factory, open, queue, read, decode, copy,
+ * encode, total). format is an SDK pixel format name (default rgba8),
+ * scale full, half, quarter or eighth, pipeline cpu, cuda, opencl or auto.
+ * concurrency is the frames kept in flight per codec (default 8) and codecs
+ * the number of independently opened codecs the frames are spread over
+ * (default 1, 0 sizes the pool to the machine). encoding jpeg or webp adds
+ * an encode at quality 90 on the decode thread. The frame cache is
+ * bypassed so every frame is decoded.
+ *
+ * Built by the braw-bench target in native/binding.gyp.
+ */
+
+#include "BlackmagicRawAPI.h"
+#include "native/BrawClip.h"
+#include "native/BrawDecodePool.h"
+#include "native/BrawEncoder.h"
+#include "native/BrawFormat.h"
+#include "native/BrawPipeline.h"
+#include "native/BrawStats.h"
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Bench;
+
+// One per codec; every job on that codec completes here
+class BenchCodec : public BrawFrameCompletion
+{
+public:
+    BenchCodec(Bench& bench, BrawClip& clip) : m_bench(bench), m_clip(clip) {}
+
+    virtual void FrameComplete(HRESULT result, BrawFrame& frame, const string& error);
+
+    // Submit the next unclaimed frame; false once there are none left
+    bool SubmitNext();
+
+private:
+    Bench& m_bench;
+    BrawClip& m_clip;
+};
+
+class Bench
+{
+public:
+    Bench(uint64_t frameCount, const BrawDecodeOptions& options)
+        : frame_count(frameCount), options(options), m_next(0), m_remaining(frameCount), m_failed(0) {}
+
+    // Next frame index to decode, shared by every codec
+    bool Claim(uint64_t& frameIndex)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (m_next >= frame_count)
+            return false;
+        frameIndex = m_next++;
+        return true;
+    }
+
+    void Done(HRESULT result, const string& error)
+    {
+        lock_guard<mutex> lock(m_mutex);
+
+        if (result != S_OK)
+        {
+            if (m_failed == 0)
+                m_error = error;
+            m_failed++;
+        }
+
+        m_remaining--;
+        if (m_remaining == 0)
+            m_condition.notify_all();
+    }
+
+    void Wait()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_remaining == 0; });
+    }
+
+    uint64_t Failed() const { return m_failed; }
+    const string& Error() const { return m_error; }
+
+    const uint64_t frame_count;
+    const BrawDecodeOptions options;
+
+private:
+    mutex m_mutex;
+    condition_variable m_condition;
+    uint64_t m_next;
+    uint64_t m_remaining;
+    uint64_t m_failed;
+    string m_error;
+};
+
+void BenchCodec::FrameComplete(HRESULT result, BrawFrame& frame, const string& error)
+{
+    frame.Reset();
+
+    // Keep the codec's queue topped up. Done last: the last one lets main
+    // tear everything down.
+    SubmitNext();
+    m_bench.Done(result, error);
+}
+
+bool BenchCodec::SubmitNext()
+{
+    uint64_t frameIndex = 0;
+    if (!m_bench.Claim(frameIndex))
+        return false;
+
+    string error;
+    HRESULT result = m_clip.SubmitFrame(frameIndex, m_bench.options, this, error);
+    if (result != S_OK)
+        m_bench.Done(result, error);
+
+    return true;
+}
+
+static double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void print_stage(const char* name, const BrawStageStats& stage, bool& first)
+{
+    if (stage.count == 0)
+        return;
+
+    printf("%s\n    \"%s\": {\"count\": %llu, \"mean_ns\": %llu, \"min_ns\": %llu, \"p50_ns\": %llu, "
+           "\"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu, \"histogram\": [",
+           first ? "" : ",", name, (unsigned long long)stage.count,
+           (unsigned long long)(stage.total_ns / stage.count), (unsigned long long)stage.min_ns,
+           (unsigned long long)StagePercentile(stage, 0.5), (unsigned long long)StagePercentile(stage, 0.9),
+           (unsigned long long)StagePercentile(stage, 0.99), (unsigned long long)stage.max_ns);
+    first = false;
+
+    bool firstBucket = true;
+    for (int bucket = 0; bucket < kBrawStatsBuckets; bucket++)
+    {
+        if (stage.buckets[bucket] == 0)
+            continue;
+        printf("%s[%llu, %llu]", firstBucket ? "" : ", ", (unsigned long long)StageBucketLimit(bucket),
+               (unsigned long long)stage.buckets[bucket]);
+        firstBucket = false;
+    }
+    printf("]}");
+}
+
+int run_bench(const char* inputFile, uint64_t frames, const BrawOpenOptions& openOptions,
+              const BrawDecodeOptions& options, uint32_t concurrency, uint32_t codecs)
+{
+    BrawStats& stats = BrawStats::Shared();
+    stats.SetEnabled(true);
+
+    chrono::steady_clock::time_point opening = chrono::steady_clock::now();
+
+    BrawDecodePool pool;
+    string error;
+    if (pool.Open(inputFile, openOptions, codecs, error) != S_OK)
+    {
+        cerr << "{\"error\": \"" << error << "\"}" << endl;
+        return 1;
+    }
+
+    double openSeconds = seconds_since(opening);
+    const BrawClipInfo& info = pool.Clip(0)->Info();
+
+    if (frames == 0 || frames > info.frame_count)
+        frames = info.frame_count;
+
+    Bench bench(frames, options);
+    vector<unique_ptr<BenchCodec> > benchCodecs;
+    for (size_t i = 0; i < pool.Size(); i++)
+        benchCodecs.push_back(unique_ptr<BenchCodec>(new BenchCodec(bench, *pool.Clip(i))));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // Prime every codec with concurrency frames; completions keep them full
+    for (uint32_t slot = 0; slot < concurrency; slot++)
+    {
+        for (size_t i = 0; i < benchCodecs.size(); i++)
+            benchCodecs[i]->SubmitNext();
+    }
+
+    bench.Wait();
+    double wallSeconds = seconds_since(start);
+
+    BrawStatsSnapshot snapshot;
+    stats.Snapshot(snapshot, false);
+
+    double fps = wallSeconds > 0 ? snapshot.frames / wallSeconds : 0.0;
+    double megabytes = wallSeconds > 0 ? snapshot.bytes / 1e6 / wallSeconds : 0.0;
+    double encodedMegabytes = wallSeconds > 0 ? snapshot.encoded_bytes / 1e6 / wallSeconds : 0.0;
+
+    printf("{\n");
+    printf("  \"clip\": \"%s\",\n", inputFile);
+    printf("  \"width\": %u,\n  \"height\": %u,\n", info.width, info.height);
+    printf("  \"pipeline\": \"%s\",\n", info.pipeline);
+    printf("  \"format\": \"%s\",\n  \"scale\": \"%s\",\n", options.format->name, options.scale->name);
+    printf("  \"encoding\": \"%s\",\n", EncodingName(options.encode.encoding));
+    printf("  \"codecs\": %u,\n  \"concurrency\": %u,\n", (unsigned)pool.Size(), concurrency);
+    printf("  \"frames\": %llu,\n  \"errors\": %llu,\n", (unsigned long long)snapshot.frames,
+           (unsigned long long)bench.Failed());
+    if (bench.Failed() > 0)
+        printf("  \"first_error\": \"%s\",\n", bench.Error().c_str());
+    printf("  \"open_s\": %.6f,\n  \"wall_s\": %.6f,\n", openSeconds, wallSeconds);
+    printf("  \"fps\": %.3f,\n  \"mb_per_s\": %.3f,\n  \"encoded_mb_per_s\": %.3f,\n", fps, megabytes, encodedMegabytes);
+    printf("  \"peak_rss_bytes\": %llu,\n", (unsigned long long)snapshot.peak_rss);
+    printf("  \"stages\": {");
+
+    bool first = true;
+    for (int i = 0; i < brawStageCount; i++)
+        print_stage(StageName(static_cast<BrawStage>(i)), snapshot.stages[i], first);
+    printf("\n  }\n}\n");
+
+    return bench.Failed() > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 9)
+    {
+        cerr << "Usage: " << argv[0]
+             << " <input.braw> [frames] [format] [scale] [pipeline] [concurrency] [codecs] [encoding]" << endl;
+        return 1;
+    }
+
+    uint64_t frames = 100;
+    uint32_t concurrency = 8;
+    uint32_t codecs = 1;
+    BrawOpenOptions openOptions;
+    BrawDecodeOptions options;
+
+    // Every frame must be decoded to be measured
+    options.cache = false;
+
+    if (argc >= 3)
+        frames = strcmp(argv[2], "all") == 0 ? 0 : strtoull(argv[2], nullptr, 10);
+
+    if (argc >= 4)
+    {
+        options.format = FindPixelFormat(argv[3]);
+        if (!options.format)
+        {
+            cerr << "{\"error\": \"Unknown pixel format: " << argv[3] << "\"}" << endl;
+            return 1;
+        }
+    }
+
+    if (argc >= 5)
+    {
+        options.scale = FindResolutionScale(argv[4]);
+        if (!options.scale)
+        {
+            cerr << "{\"error\": \"Unknown resolution scale: " << argv[4] << "\"}" << endl;
+            return 1;
+        }
+    }
+
+    if (argc >= 6 && !FindPipelineType(argv[5], openOptions.pipeline))
+    {
+        cerr << "{\"error\": \"Unknown pipeline: " << argv[5] << "\"}" << endl;
+        return 1;
+    }
+
+    if (argc >= 7)
+    {
+        concurrency = strtoul(argv[6], nullptr, 10);
+        if (concurrency == 0)
+        {
+            cerr << "{\"error\": \"Concurrency must be at least 1\"}" << endl;
+            return 1;
+        }
+    }
+
+    if (argc >= 8)
+    {
+        codecs = strtoul(argv[7], nullptr, 10);
+        if (codecs == 0)
+            codecs = BrawDecodePool::DefaultSize();
+    }
+
+    if (argc >= 9)
+    {
+        if (!FindEncoding(argv[8], options.encode.encoding))
+        {
+            cerr << "{\"error\": \"Unknown encoding: " << argv[8] << "\"}" << endl;
+            return 1;
+        }
+        if (options.encode.encoding != brawEncodingNone &&
+            (options.format->planar || options.format->bytes_per_sample != 1))
+        {
+            cerr << "{\"error\": \"Pixel format " << options.format->name << " cannot be encoded as "
+                 << EncodingName(options.encode.encoding) << "\"}" << endl;
+            return 1;
+        }
+    }
+
+    // Measure the requested depth, not the clip's admission limit
+    if (openOptions.max_jobs < concurrency)
+        openOptions.max_jobs = concurrency;
+
+    return run_bench(argv[1], frames, openOptions, options, concurrency, codecs);
+}
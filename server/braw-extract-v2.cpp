@@ -26,6 +26,7 @@
  */
 
 #include "BlackmagicRawAPI.h"
+#include "native/BrawImageWriter.h"
 
 #include <stdio.h>
 #include <iostream>
@@ -42,75 +43,10 @@ static const char* const s_outputFileName = "outputRGBU8.bmp";
 
 void OutputImage(unsigned int width, unsigned int height, void* imageData)
 {
-	FILE* file = fopen(s_outputFileName, "wb");
-	if (file == nullptr)
-		return;
-
-	typedef struct                       /**** BMP file header structure ****/
-    {
-		unsigned int   bfSize;           /* Size of file */
-		unsigned short bfReserved1;      /* Reserved */
-		unsigned short bfReserved2;      /* ... */
-		unsigned int   bfOffBits;        /* Offset to bitmap data */
-    } BITMAPFILEHEADER;
-
-	typedef struct                       /**** BMP file info structure ****/
-    {
-		unsigned int   biSize;           /* Size of info header */
-		int            biWidth;          /* Width of image */
-		int            biHeight;         /* Height of image */
-		unsigned short biPlanes;         /* Number of color planes */
-		unsigned short biBitCount;       /* Number of bits per pixel */
-		unsigned int   biCompression;    /* Type of compression to use */
-		unsigned int   biSizeImage;      /* Size of image data */
-		int            biXPelsPerMeter;  /* X pixels per meter */
-		int            biYPelsPerMeter;  /* Y pixels per meter */
-		unsigned int   biClrUsed;        /* Number of colors used */
-		unsigned int   biClrImportant;   /* Number of important colors */
-    } BITMAPINFOHEADER;
-
-	BITMAPFILEHEADER bfh;
-	BITMAPINFOHEADER bih;
-
-	unsigned short bfType = 0x4d42;
-	bfh.bfReserved1 = 0;
-	bfh.bfReserved2 = 0;
-	bfh.bfSize = 2 + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + width * height * 3;
-	bfh.bfOffBits = 0x36;
-
-	bih.biSize = sizeof(BITMAPINFOHEADER);
-	bih.biWidth = width;
-	bih.biHeight = -(long)height;
-	bih.biPlanes = 1;
-	bih.biBitCount = 24;
-	bih.biCompression = 0;
-	bih.biSizeImage = 0;
-	bih.biXPelsPerMeter = 5000;
-	bih.biYPelsPerMeter = 5000;
-	bih.biClrUsed = 0;
-	bih.biClrImportant = 0;
-
-	fwrite(&bfType,1,sizeof(bfType),file);
-	fwrite(&bfh, 1, sizeof(bfh), file);
-	fwrite(&bih, 1, sizeof(bih), file);
-
-	unsigned char* rgba = (unsigned char*)imageData;
-
-	for (int y = (int)height-1; y >= 0; y--) /*Scanline loop backwards*/
-    {
-		for (int x = 0; x < (int)width; x++) /*Column loop forwards*/
-		{
-			unsigned char red = rgba[0];
-			unsigned char green = rgba[1];
-			unsigned char blue = rgba[2];
-			rgba += 4; // Skip alpha
-
-			fwrite(&blue, 1, 1, file);
-			fwrite(&green, 1, 1, file);
-			fwrite(&red, 1, 1, file);
-		}
-	}
-	fclose(file);
+	BrawImageView image = { imageData, FindPixelFormat(s_resourceFormat), width, height, 0 };
+	image.stride = PixelFormatStride(*image.format, width);
+
+	WriteImage(s_outputFileName, brawImageFileBMP, image);
 }
 
 class CameraCodecCallback : public IBlackmagicRawCallback
@@ -6,14 +6,44 @@
  * 
  * Usage:
  *   braw-extract metadata <input.braw>
- *   braw-extract extract <input.braw> <frame_index> <output.jpg>
+ *   braw-extract extract <input.braw> <frame_index> <output> [format] [scale]
+ *   braw-extract export <input.braw> <start> <end> <outdir|-> [format] [scale] [type]
+ *
+ * The output type follows the extension: .ppm (the default), .bmp, .tif/.tiff
+ * (16-bit) or .raw/.rgba (decoded pixels as-is). format is an SDK pixel
+ * format name; image files need an interleaved integer one (rgba8, bgra8,
+ * rgb16, rgba16, bgra16), raw output takes any. 16-bit formats are written
+ * as 16-bit PPM. scale is full, half, quarter or eighth and picks a cheaper
+ * reduced-resolution decode.
+ *
+ * export decodes frames start..end (inclusive) with several jobs in flight
+ * and writes them in order, either as outdir/frame_NNNNNN.<ext> or, when
+ * outdir is -, back to back on stdout. type is ppm, bmp, tiff16 or raw and
+ * defaults to ppm for a directory and raw for stdout, so a stream can be
+ * piped straight into ffmpeg, e.g. for rgba8 at full scale:
+ *   braw-extract export clip.braw 0 99 - rgba8 |
+ *     ffmpeg -f rawvideo -pix_fmt rgba -s <width>x<height> -r <fps> -i - out.mov
+ * The summary JSON goes to stdout for a directory and to stderr for a
+ * stream.
+ *
+ * Built by the braw-extract target in native/binding.gyp.
  */
 
+#include <sys/stat.h>
+#include <errno.h>
+#include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <condition_variable>
 #include <cstring>
 #include <cstdlib>
-#include <BlackmagicRAW/BlackmagicRawAPI.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include "BlackmagicRawAPI.h"
+#include "native/BrawFactory.h"
+#include "native/BrawFormat.h"
+#include "native/BrawImageWriter.h"
 
 using namespace std;
 
@@ -21,7 +51,8 @@ using namespace std;
 class BRAWCallback : public IBlackmagicRawCallback
 {
 public:
-    BRAWCallback() : processed_image(nullptr), error_occurred(false) {}
+    BRAWCallback() : processed_image(nullptr), error_occurred(false),
+        format(DefaultPixelFormat()), scale(DefaultResolutionScale()) {}
     virtual ~BRAWCallback() {
         if (processed_image) {
             processed_image->Release();
@@ -30,6 +61,8 @@ public:
 
     IBlackmagicRawProcessedImage* processed_image;
     bool error_occurred;
+    const BrawPixelFormat* format;
+    const BrawResolutionScale* scale;
 
     virtual void ReadComplete(IBlackmagicRawJob* readJob, HRESULT result, IBlackmagicRawFrame* frame)
     {
@@ -40,8 +73,8 @@ public:
             return;
         }
 
-        // Set resource format to RGBA U8
-        result = frame->SetResourceFormat(blackmagicRawResourceFormatRGBAU8);
+        // Set the requested resource format
+        result = frame->SetResourceFormat(format->resource_format);
         if (result != S_OK) {
             cerr << "SetResourceFormat failed" << endl;
             error_occurred = true;
@@ -49,6 +82,17 @@ public:
             return;
         }
 
+        // Decode at a reduced resolution if asked to
+        if (scale->divisor != 1) {
+            result = frame->SetResolutionScale(scale->scale);
+            if (result != S_OK) {
+                cerr << "SetResolutionScale failed" << endl;
+                error_occurred = true;
+                readJob->Release();
+                return;
+            }
+        }
+
         // Create decode and process job
         IBlackmagicRawJob* decodeJob = nullptr;
         result = frame->CreateJobDecodeAndProcessFrame(nullptr, nullptr, &decodeJob);
@@ -101,28 +145,17 @@ public:
     virtual ULONG STDMETHODCALLTYPE Release(void) { return 0; }
 };
 
-// Write RGBA data as PPM (simple uncompressed format)
-bool write_ppm(const char* filename, unsigned int width, unsigned int height, const void* data)
+// Write the decoded frame in the file type picked from the output path
+bool write_image(const char* filename, const BrawImageFile& outputFile, unsigned int width,
+                 unsigned int height, const void* data, const BrawPixelFormat& format)
 {
-    ofstream file(filename, ios::binary);
-    if (!file.is_open()) {
-        cerr << "Failed to open output file: " << filename << endl;
-        return false;
-    }
+    BrawImageView image = { data, &format, width, height, PixelFormatStride(format, width) };
 
-    // Write PPM header
-    file << "P6\n" << width << " " << height << "\n255\n";
-
-    // Convert RGBA to RGB and write
-    const unsigned char* rgba = static_cast<const unsigned char*>(data);
-    for (unsigned int i = 0; i < width * height; i++) {
-        file.put(rgba[i * 4 + 0]); // R
-        file.put(rgba[i * 4 + 1]); // G
-        file.put(rgba[i * 4 + 2]); // B
-        // Skip alpha channel
+    if (!WriteImage(filename, outputFile.type, image)) {
+        cerr << "Failed to write output file: " << filename << endl;
+        return false;
     }
 
-    file.close();
     return true;
 }
 
@@ -134,7 +167,7 @@ int extract_metadata(const char* input_path)
     IBlackmagicRawClip* clip = nullptr;
 
     // Create factory
-    factory = CreateBlackmagicRawFactoryInstanceFromPath("/usr/local/lib");
+    factory = AcquireBrawFactory();
     if (!factory) {
         cerr << "{\"error\": \"Failed to create factory\"}" << endl;
         return 1;
@@ -189,7 +222,9 @@ int extract_metadata(const char* input_path)
 // Global callback instance
 static BRAWCallback* g_callback = nullptr;
 
-int extract_frame(const char* input_path, int frame_index, const char* output_path)
+int extract_frame(const char* input_path, int frame_index, const char* output_path,
+                  const BrawImageFile& outputFile, const BrawPixelFormat& format,
+                  const BrawResolutionScale& scale)
 {
     HRESULT result;
     IBlackmagicRawFactory* factory = nullptr;
@@ -202,9 +237,11 @@ int extract_frame(const char* input_path, int frame_index, const char* output_pa
     }
     g_callback = new BRAWCallback();
     BRAWCallback& callback = *g_callback;
+    callback.format = &format;
+    callback.scale = &scale;
 
     // Create factory
-    factory = CreateBlackmagicRawFactoryInstanceFromPath("/usr/local/lib");
+    factory = AcquireBrawFactory();
     if (!factory) {
         cerr << "{\"error\": \"Failed to create factory\"}" << endl;
         return 1;
@@ -329,8 +366,8 @@ int extract_frame(const char* input_path, int frame_index, const char* output_pa
         return 1;
     }
 
-    // Write to PPM file
-    if (!write_ppm(output_path, width, height, imageData)) {
+    // Write the output file
+    if (!write_image(output_path, outputFile, width, height, imageData, *callback.format)) {
         cerr << "{\"error\": \"Failed to write output file\"}" << endl;
         clip->Release();
         codec->Release();
@@ -343,7 +380,8 @@ int extract_frame(const char* input_path, int frame_index, const char* output_pa
     cout << "  \"success\": true," << endl;
     cout << "  \"path\": \"" << output_path << "\"," << endl;
     cout << "  \"width\": " << width << "," << endl;
-    cout << "  \"height\": " << height << endl;
+    cout << "  \"height\": " << height << "," << endl;
+    cout << "  \"format\": \"" << callback.format->name << "\"" << endl;
     cout << "}" << endl;
 
     // Cleanup
@@ -354,12 +392,289 @@ int extract_frame(const char* input_path, int frame_index, const char* output_pa
     return 0;
 }
 
+// Frames decoded or decoding ahead of the one being written
+static const uint64_t kExportMaxInFlight = 8;
+
+// Pipelined decode for export. Each job carries its frame index as user
+// data; finished images are held until the writer asks for them in order.
+class ExportCallback : public IBlackmagicRawCallback
+{
+public:
+    ExportCallback(const BrawPixelFormat& pixelFormat, const BrawResolutionScale& resolutionScale)
+        : format(pixelFormat), scale(resolutionScale) {}
+    virtual ~ExportCallback() {
+        for (map<uint64_t, IBlackmagicRawProcessedImage*>::iterator it = done.begin(); it != done.end(); ++it) {
+            if (it->second)
+                it->second->Release();
+        }
+    }
+
+    const BrawPixelFormat& format;
+    const BrawResolutionScale& scale;
+
+    // Block until frame_index has finished. Returns the image, now owned by
+    // the caller, or nullptr if it failed.
+    IBlackmagicRawProcessedImage* Wait(uint64_t frame_index)
+    {
+        unique_lock<mutex> lock(done_mutex);
+        done_changed.wait(lock, [&]() { return done.find(frame_index) != done.end(); });
+
+        IBlackmagicRawProcessedImage* image = done[frame_index];
+        done.erase(frame_index);
+        return image;
+    }
+
+    virtual void ReadComplete(IBlackmagicRawJob* readJob, HRESULT result, IBlackmagicRawFrame* frame)
+    {
+        uint64_t frame_index = FrameIndex(readJob);
+        IBlackmagicRawJob* decodeJob = nullptr;
+
+        if (result == S_OK)
+            result = frame->SetResourceFormat(format.resource_format);
+        if (result == S_OK && scale.divisor != 1)
+            result = frame->SetResolutionScale(scale.scale);
+        if (result == S_OK)
+            result = frame->CreateJobDecodeAndProcessFrame(nullptr, nullptr, &decodeJob);
+        if (result == S_OK)
+            result = decodeJob->SetUserData(reinterpret_cast<void*>(static_cast<uintptr_t>(frame_index)));
+        if (result == S_OK)
+            result = decodeJob->Submit();
+
+        if (result != S_OK) {
+            cerr << "Frame " << frame_index << " failed to decode: " << result << endl;
+            if (decodeJob)
+                decodeJob->Release();
+            Finish(frame_index, nullptr);
+        }
+
+        readJob->Release();
+    }
+
+    virtual void ProcessComplete(IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawProcessedImage* processedImage)
+    {
+        uint64_t frame_index = FrameIndex(job);
+
+        if (result != S_OK) {
+            cerr << "Frame " << frame_index << " failed to process: " << result << endl;
+            processedImage = nullptr;
+        }
+        else {
+            processedImage->AddRef();
+        }
+
+        Finish(frame_index, processedImage);
+        job->Release();
+    }
+
+    virtual void DecodeComplete(IBlackmagicRawJob*, HRESULT) {}
+    virtual void TrimProgress(IBlackmagicRawJob*, float) {}
+    virtual void TrimComplete(IBlackmagicRawJob*, HRESULT) {}
+    virtual void SidecarMetadataParseWarning(IBlackmagicRawClip*, const char*, uint32_t, const char*) {}
+    virtual void SidecarMetadataParseError(IBlackmagicRawClip*, const char*, uint32_t, const char*) {}
+    virtual void PreparePipelineComplete(void*, HRESULT) {}
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, LPVOID*) { return E_NOTIMPL; }
+    virtual ULONG STDMETHODCALLTYPE AddRef(void) { return 0; }
+    virtual ULONG STDMETHODCALLTYPE Release(void) { return 0; }
+
+private:
+    static uint64_t FrameIndex(IBlackmagicRawJob* job)
+    {
+        void* userData = nullptr;
+        job->GetUserData(&userData);
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(userData));
+    }
+
+    void Finish(uint64_t frame_index, IBlackmagicRawProcessedImage* image)
+    {
+        lock_guard<mutex> lock(done_mutex);
+        done[frame_index] = image;
+        done_changed.notify_all();
+    }
+
+    mutex done_mutex;
+    condition_variable done_changed;
+    map<uint64_t, IBlackmagicRawProcessedImage*> done;
+};
+
+// Submit a read of frame_index, tagged for ExportCallback
+static HRESULT submit_export_read(IBlackmagicRawClip* clip, uint64_t frame_index)
+{
+    IBlackmagicRawJob* readJob = nullptr;
+    HRESULT result = clip->CreateJobReadFrame(frame_index, &readJob);
+    if (result != S_OK)
+        return result;
+
+    result = readJob->SetUserData(reinterpret_cast<void*>(static_cast<uintptr_t>(frame_index)));
+    if (result == S_OK)
+        result = readJob->Submit();
+    if (result != S_OK)
+        readJob->Release();
+
+    return result;
+}
+
+int export_frames(const char* input_path, uint64_t start, uint64_t end, const char* output_dir,
+                  const BrawImageFile& outputFile, const BrawPixelFormat& format,
+                  const BrawResolutionScale& scale)
+{
+    HRESULT result = S_OK;
+    IBlackmagicRawFactory* factory = nullptr;
+    IBlackmagicRaw* codec = nullptr;
+    IBlackmagicRawClip* clip = nullptr;
+    ExportCallback callback(format, scale);
+    bool to_stdout = strcmp(output_dir, "-") == 0;
+    ostream& report = to_stdout ? cerr : cout;
+    string error;
+    uint64_t submitted = start;
+    uint64_t written = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    float frame_rate = 0.0f;
+
+    do {
+        if (!to_stdout && mkdir(output_dir, 0755) != 0 && errno != EEXIST) {
+            error = string("Failed to create output directory: ") + output_dir;
+            break;
+        }
+
+        factory = AcquireBrawFactory();
+        if (!factory) {
+            error = "Failed to create factory";
+            break;
+        }
+
+        result = factory->CreateCodec(&codec);
+        if (result != S_OK || !codec) {
+            error = "Failed to create codec";
+            break;
+        }
+
+        result = codec->OpenClip(input_path, &clip);
+        if (result != S_OK || !clip) {
+            error = "Failed to open clip";
+            break;
+        }
+
+        uint64_t frame_count = 0;
+        clip->GetFrameCount(&frame_count);
+        clip->GetFrameRate(&frame_rate);
+        if (start > end || end >= frame_count) {
+            error = "Frame range " + to_string(start) + "-" + to_string(end) +
+                    " out of range (0-" + to_string(frame_count - 1) + ")";
+            break;
+        }
+
+        result = codec->SetCallback(&callback);
+        if (result != S_OK) {
+            error = "Failed to set callback";
+            break;
+        }
+
+        // Keep the window full, then write each frame as its turn comes
+        for (uint64_t frame_index = start; frame_index <= end; frame_index++) {
+            while (submitted <= end && submitted - frame_index < kExportMaxInFlight) {
+                result = submit_export_read(clip, submitted);
+                if (result != S_OK)
+                    break;
+                submitted++;
+            }
+            if (submitted <= frame_index) {
+                error = "Failed to submit read job for frame " + to_string(frame_index);
+                break;
+            }
+
+            IBlackmagicRawProcessedImage* image = callback.Wait(frame_index);
+            if (!image) {
+                error = "Failed to decode frame " + to_string(frame_index);
+                break;
+            }
+
+            void* imageData = nullptr;
+            image->GetWidth(&width);
+            image->GetHeight(&height);
+            if (image->GetResource(&imageData) != S_OK || !imageData) {
+                image->Release();
+                error = "Failed to get image data for frame " + to_string(frame_index);
+                break;
+            }
+
+            BrawImageView view = { imageData, &format, width, height, PixelFormatStride(format, width) };
+            bool ok;
+            if (to_stdout) {
+                ok = WriteImage(stdout, outputFile.type, view);
+            }
+            else {
+                char name[32];
+                snprintf(name, sizeof(name), "/frame_%06llu", static_cast<unsigned long long>(frame_index));
+                string path = string(output_dir) + name + outputFile.extension;
+                ok = WriteImage(path.c_str(), outputFile.type, view);
+            }
+            image->Release();
+
+            if (!ok) {
+                error = "Failed to write frame " + to_string(frame_index);
+                break;
+            }
+            written++;
+        }
+
+        if (to_stdout && fflush(stdout) != 0 && error.empty())
+            error = "Failed to write output stream";
+    } while (0);
+
+    // Jobs still in flight reference the callback
+    if (codec != nullptr)
+        codec->FlushJobs();
+
+    if (clip != nullptr)
+        clip->Release();
+    if (codec != nullptr)
+        codec->Release();
+    if (factory != nullptr)
+        factory->Release();
+
+    if (!error.empty()) {
+        cerr << "{\"error\": \"" << error << "\", \"frames_written\": " << written << "}" << endl;
+        return 1;
+    }
+
+    report << "{" << endl;
+    report << "  \"success\": true," << endl;
+    report << "  \"output\": \"" << output_dir << "\"," << endl;
+    report << "  \"type\": \"" << outputFile.name << "\"," << endl;
+    report << "  \"start\": " << start << "," << endl;
+    report << "  \"end\": " << end << "," << endl;
+    report << "  \"frames\": " << written << "," << endl;
+    report << "  \"width\": " << width << "," << endl;
+    report << "  \"height\": " << height << "," << endl;
+    report << "  \"frame_rate\": " << frame_rate << "," << endl;
+    report << "  \"format\": \"" << format.name << "\"" << endl;
+    report << "}" << endl;
+
+    return 0;
+}
+
+// Parse a non-negative frame number
+static bool parse_frame(const char* text, uint64_t& frame_index)
+{
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || text[0] == '-')
+        return false;
+
+    frame_index = value;
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
     if (argc < 3) {
         cerr << "Usage:" << endl;
         cerr << "  " << argv[0] << " metadata <input.braw>" << endl;
-        cerr << "  " << argv[0] << " extract <input.braw> <frame_index> <output.ppm>" << endl;
+        cerr << "  " << argv[0] << " extract <input.braw> <frame_index> <output> [format] [scale]" << endl;
+        cerr << "  " << argv[0] << " export <input.braw> <start> <end> <outdir|-> [format] [scale] [type]" << endl;
         return 1;
     }
 
@@ -373,12 +688,78 @@ int main(int argc, char* argv[])
         return extract_metadata(argv[2]);
     }
     else if (command == "extract") {
-        if (argc != 5) {
-            cerr << "Usage: " << argv[0] << " extract <input.braw> <frame_index> <output.ppm>" << endl;
+        if (argc < 5 || argc > 7) {
+            cerr << "Usage: " << argv[0] << " extract <input.braw> <frame_index> <output> [format] [scale]" << endl;
+            return 1;
+        }
+        const BrawImageFile* outputFile = FindImageFileForPath(argv[4]);
+        if (!outputFile)
+            outputFile = FindImageFile("ppm");
+        const BrawPixelFormat* format = DefaultPixelFormat();
+        if (argc >= 6) {
+            format = FindPixelFormat(argv[5]);
+            if (!format) {
+                cerr << "{\"error\": \"Unknown pixel format: " << argv[5] << "\"}" << endl;
+                return 1;
+            }
+        }
+        if (!CanWriteImage(outputFile->type, *format)) {
+            cerr << "{\"error\": \"Pixel format " << format->name << " cannot be written as "
+                 << outputFile->name << "\"}" << endl;
             return 1;
         }
+        const BrawResolutionScale* scale = DefaultResolutionScale();
+        if (argc == 7) {
+            scale = FindResolutionScale(argv[6]);
+            if (!scale) {
+                cerr << "{\"error\": \"Unknown resolution scale: " << argv[6] << "\"}" << endl;
+                return 1;
+            }
+        }
         int frame_index = atoi(argv[3]);
-        return extract_frame(argv[2], frame_index, argv[4]);
+        return extract_frame(argv[2], frame_index, argv[4], *outputFile, *format, *scale);
+    }
+    else if (command == "export") {
+        if (argc < 6 || argc > 9) {
+            cerr << "Usage: " << argv[0] << " export <input.braw> <start> <end> <outdir|-> [format] [scale] [type]" << endl;
+            return 1;
+        }
+        uint64_t start = 0;
+        uint64_t end = 0;
+        if (!parse_frame(argv[3], start) || !parse_frame(argv[4], end)) {
+            cerr << "{\"error\": \"Invalid frame range: " << argv[3] << " " << argv[4] << "\"}" << endl;
+            return 1;
+        }
+        const BrawPixelFormat* format = DefaultPixelFormat();
+        if (argc >= 7) {
+            format = FindPixelFormat(argv[6]);
+            if (!format) {
+                cerr << "{\"error\": \"Unknown pixel format: " << argv[6] << "\"}" << endl;
+                return 1;
+            }
+        }
+        const BrawResolutionScale* scale = DefaultResolutionScale();
+        if (argc >= 8) {
+            scale = FindResolutionScale(argv[7]);
+            if (!scale) {
+                cerr << "{\"error\": \"Unknown resolution scale: " << argv[7] << "\"}" << endl;
+                return 1;
+            }
+        }
+        const BrawImageFile* outputFile = FindImageFile(strcmp(argv[5], "-") == 0 ? "raw" : "ppm");
+        if (argc == 9) {
+            outputFile = FindImageFile(argv[8]);
+            if (!outputFile) {
+                cerr << "{\"error\": \"Unknown output type: " << argv[8] << "\"}" << endl;
+                return 1;
+            }
+        }
+        if (!CanWriteImage(outputFile->type, *format)) {
+            cerr << "{\"error\": \"Pixel format " << format->name << " cannot be written as "
+                 << outputFile->name << "\"}" << endl;
+            return 1;
+        }
+        return export_frames(argv[2], start, end, argv[5], *outputFile, *format, *scale);
     }
     else {
         cerr << "Unknown command: " << command << endl;
@@ -3,19 +3,59 @@
  * 
  * Usage:
  *   braw-extractor metadata <input.braw>
- *   braw-extractor extract <input.braw> <frame_index> <output.ppm>
+ *   braw-extractor extract <input.braw> <frame_index> <output> [format] [scale]
+ *   braw-extractor serve [pipeline]
+ *
+ * The output type follows the extension: .ppm (the default), .bmp, .tif/.tiff
+ * (16-bit), .raw/.rgba (decoded pixels as-is) or .jpg/.jpeg/.webp (encoded
+ * in-process at quality 90, needs an 8-bit format). format is an SDK pixel
+ * format name; image files need an interleaved integer one (rgba8, bgra8,
+ * rgb16, rgba16, bgra16), raw output takes any. 16-bit formats are written
+ * as 16-bit PPM. scale is full, half, quarter or eighth and picks a cheaper
+ * reduced-resolution decode.
+ *
+ * serve stays resident and keeps one clip open, speaking a binary protocol
+ * on stdin/stdout. Recently decoded frames are served from the in-process
+ * frame cache. All integers are little-endian. Requests are
+ *   uint32 length, uint8 command, body[length - 1]
+ * and responses
+ *   uint32 length, uint8 status (0 ok, 1 error), body[length - 1]
+ * Commands:
+ *   1 open   body: path
+ *            -> metadata JSON
+ *   2 read   body: uint64 frame_index, uint8 n, format[n], uint8 m, scale[m]
+ *                  [, uint8 k, encoding[k], uint8 quality]
+ *            (empty names select rgba8 / full / none; any pixel format is
+ *            allowed unencoded; encoding is "jpeg" or "webp", quality 1-100)
+ *            -> uint32 width, uint32 height, uint32 stride, pixels
+ *            (stride is 0 and pixels the compressed image when encoded)
+ *   3 close  body: none
+ *            -> empty
+ * Error bodies are a message. The process exits on EOF or a malformed request.
+ *
+ * Built by the braw-extractor target in native/binding.gyp.
  */
 
 #include "BlackmagicRawAPI.h"
+#include "native/BrawClip.h"
+#include "native/BrawEncoder.h"
+#include "native/BrawFactory.h"
+#include "native/BrawFormat.h"
+#include "native/BrawImageWriter.h"
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <cstring>
+#include <vector>
 
 using namespace std;
 
 // Output format
-static const BlackmagicRawResourceFormat s_resourceFormat = blackmagicRawResourceFormatRGBAU8;
+static const BrawPixelFormat* s_pixelFormat = DefaultPixelFormat();
+static const BrawResolutionScale* s_resolutionScale = DefaultResolutionScale();
+static const BrawImageFile* s_outputFile = FindImageFile("ppm");
+static BrawEncodeOptions s_encode;
 
 // Global output path for extracted frame
 static string g_output_path;
@@ -23,28 +63,38 @@ static unsigned int g_output_width = 0;
 static unsigned int g_output_height = 0;
 static bool g_output_success = false;
 
-// Write RGBA data as PPM (simple uncompressed format)
-bool write_ppm(const char* filename, unsigned int width, unsigned int height, const void* data)
+// Write the decoded frame in the file type picked from the output path
+bool write_image(const char* filename, unsigned int width, unsigned int height, const void* data,
+                 const BrawPixelFormat& format)
 {
-    FILE* file = fopen(filename, "wb");
-    if (!file) {
-        cerr << "Failed to open output file: " << filename << endl;
-        return false;
-    }
+    BrawImageView image = { data, &format, width, height, PixelFormatStride(format, width) };
+
+    if (s_encode.encoding != brawEncodingNone) {
+        BrawEncodedImage encoded;
+        string error;
+
+        if (!EncodeImage(image, s_encode, encoded, error)) {
+            cerr << error << endl;
+            return false;
+        }
+
+        FILE* file = fopen(filename, "wb");
+        bool written = file && fwrite(encoded.data, 1, encoded.size, file) == encoded.size;
+        if (file && fclose(file) != 0)
+            written = false;
+        if (!written) {
+            cerr << "Failed to write output file: " << filename << endl;
+            return false;
+        }
 
-    // Write PPM header
-    fprintf(file, "P6\n%u %u\n255\n", width, height);
+        return true;
+    }
 
-    // Convert RGBA to RGB and write
-    const unsigned char* rgba = static_cast<const unsigned char*>(data);
-    for (unsigned int i = 0; i < width * height; i++) {
-        fputc(rgba[i * 4 + 0], file); // R
-        fputc(rgba[i * 4 + 1], file); // G
-        fputc(rgba[i * 4 + 2], file); // B
-        // Skip alpha channel
+    if (!WriteImage(filename, s_outputFile->type, image)) {
+        cerr << "Failed to write output file: " << filename << endl;
+        return false;
     }
 
-    fclose(file);
     return true;
 }
 
@@ -60,7 +110,10 @@ public:
         IBlackmagicRawJob* decodeAndProcessJob = nullptr;
 
         if (result == S_OK)
-            result = frame->SetResourceFormat(s_resourceFormat);
+            result = frame->SetResourceFormat(s_pixelFormat->resource_format);
+
+        if (result == S_OK && s_resolutionScale->divisor != 1)
+            result = frame->SetResolutionScale(s_resolutionScale->scale);
 
         if (result == S_OK)
             result = frame->CreateJobDecodeAndProcessFrame(nullptr, nullptr, &decodeAndProcessJob);
@@ -96,7 +149,7 @@ public:
         {
             g_output_width = width;
             g_output_height = height;
-            g_output_success = write_ppm(g_output_path.c_str(), width, height, imageData);
+            g_output_success = write_image(g_output_path.c_str(), width, height, imageData, *s_pixelFormat);
         }
 
         job->Release();
@@ -134,7 +187,7 @@ int extract_metadata(const char* input_path)
 
     do
     {
-        factory = CreateBlackmagicRawFactoryInstanceFromPath("/usr/local/lib");
+        factory = AcquireBrawFactory();
         if (!factory)
         {
             cerr << "{\"error\": \"Failed to create factory\"}" << endl;
@@ -203,7 +256,7 @@ int extract_frame(const char* input_path, long frame_index, const char* output_p
 
     do
     {
-        factory = CreateBlackmagicRawFactoryInstanceFromPath("/usr/local/lib");
+        factory = AcquireBrawFactory();
         if (!factory)
         {
             cerr << "{\"error\": \"Failed to create factory\"}" << endl;
@@ -265,7 +318,8 @@ int extract_frame(const char* input_path, long frame_index, const char* output_p
             cout << "  \"success\": true," << endl;
             cout << "  \"path\": \"" << output_path << "\"," << endl;
             cout << "  \"width\": " << g_output_width << "," << endl;
-            cout << "  \"height\": " << g_output_height << endl;
+            cout << "  \"height\": " << g_output_height << "," << endl;
+            cout << "  \"format\": \"" << s_pixelFormat->name << "\"" << endl;
             cout << "}" << endl;
         }
         else
@@ -286,13 +340,225 @@ int extract_frame(const char* input_path, long frame_index, const char* output_p
     return result == S_OK ? 0 : 1;
 }
 
+// serve protocol
+enum ServeCommand
+{
+    kServeOpen = 1,
+    kServeRead = 2,
+    kServeClose = 3,
+};
+
+enum ServeStatus
+{
+    kServeOk = 0,
+    kServeError = 1,
+};
+
+// Requests are small; anything bigger means the stream is out of sync
+static const uint32_t kServeMaxRequest = 64 * 1024;
+
+static void put_u32(vector<unsigned char>& out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+static bool read_exact(void* data, size_t size)
+{
+    return fread(data, 1, size, stdin) == size;
+}
+
+static bool read_u32(uint32_t& value)
+{
+    unsigned char bytes[4];
+    if (!read_exact(bytes, sizeof(bytes)))
+        return false;
+
+    value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    return true;
+}
+
+// Header and payload go out in two large writes; the pixel data is not copied
+static bool write_response(ServeStatus status, const vector<unsigned char>& header,
+                           const void* payload = nullptr, size_t payloadSize = 0)
+{
+    vector<unsigned char> prefix;
+    size_t length = 1 + header.size() + payloadSize;
+
+    if (length > 0xffffffffu)
+        return false;
+
+    put_u32(prefix, static_cast<uint32_t>(length));
+    prefix.push_back(static_cast<unsigned char>(status));
+    prefix.insert(prefix.end(), header.begin(), header.end());
+
+    if (fwrite(prefix.data(), 1, prefix.size(), stdout) != prefix.size())
+        return false;
+    if (payloadSize > 0 && fwrite(payload, 1, payloadSize, stdout) != payloadSize)
+        return false;
+
+    return fflush(stdout) == 0;
+}
+
+static bool write_error(const string& message)
+{
+    return write_response(kServeError, vector<unsigned char>(message.begin(), message.end()));
+}
+
+static string metadata_json(const BrawClipInfo& info)
+{
+    ostringstream json;
+
+    json << "{\"success\": true"
+         << ", \"frame_count\": " << info.frame_count
+         << ", \"width\": " << info.width
+         << ", \"height\": " << info.height
+         << ", \"frame_rate\": " << info.frame_rate
+         << ", \"duration\": " << (info.frame_count / info.frame_rate)
+         << ", \"pipeline\": \"" << info.pipeline << "\"}";
+
+    return json.str();
+}
+
+// Pull a uint8-length-prefixed name out of a request body
+static bool take_name(const vector<unsigned char>& body, size_t& offset, string& name)
+{
+    if (offset >= body.size())
+        return false;
+
+    size_t length = body[offset++];
+    if (offset + length > body.size())
+        return false;
+
+    name.assign(reinterpret_cast<const char*>(&body[offset]), length);
+    offset += length;
+    return true;
+}
+
+static bool serve_read(BrawClip& clip, const vector<unsigned char>& body)
+{
+    BrawDecodeOptions options;
+    BrawFrame frame;
+    string formatName;
+    string scaleName;
+    string encodingName;
+    string error;
+    uint64_t frame_index = 0;
+    size_t offset = 8;
+
+    if (body.size() < 8 || !take_name(body, offset, formatName) || !take_name(body, offset, scaleName))
+        return write_error("Malformed read request");
+
+    for (int i = 0; i < 8; i++)
+        frame_index |= static_cast<uint64_t>(body[i]) << (8 * i);
+
+    if (!formatName.empty() && !(options.format = FindPixelFormat(formatName.c_str())))
+        return write_error("Unknown pixel format: " + formatName);
+
+    if (!scaleName.empty() && !(options.scale = FindResolutionScale(scaleName.c_str())))
+        return write_error("Unknown resolution scale: " + scaleName);
+
+    // Optional trailer, absent from older clients
+    if (offset < body.size())
+    {
+        if (!take_name(body, offset, encodingName) || offset + 1 != body.size())
+            return write_error("Malformed read request");
+
+        if (!encodingName.empty() && !FindEncoding(encodingName.c_str(), options.encode.encoding))
+            return write_error("Unknown encoding: " + encodingName);
+
+        options.encode.quality = body[offset];
+        if (options.encode.encoding != brawEncodingNone &&
+            (options.format->planar || options.format->bytes_per_sample != 1))
+            return write_error(string("Cannot encode pixel format ") + options.format->name);
+    }
+
+    if (clip.ReadFrame(frame_index, options, frame, error) != S_OK)
+        return write_error(error);
+
+    vector<unsigned char> header;
+    put_u32(header, frame.width);
+    put_u32(header, frame.height);
+    put_u32(header, static_cast<uint32_t>(frame.stride));
+
+    if (frame.encoded.data)
+        return write_response(kServeOk, header, frame.encoded.data, frame.encoded.size);
+
+    return write_response(kServeOk, header, frame.data, frame.size);
+}
+
+int serve(const BrawOpenOptions& openOptions)
+{
+    BrawClip clip;
+
+    for (;;)
+    {
+        uint32_t length = 0;
+        if (!read_u32(length))
+            return 0; // EOF: the parent has gone away
+
+        if (length == 0 || length > kServeMaxRequest)
+        {
+            cerr << "{\"error\": \"Malformed request\"}" << endl;
+            return 1;
+        }
+
+        vector<unsigned char> request(length);
+        if (!read_exact(request.data(), length))
+            return 1;
+
+        unsigned char command = request[0];
+        vector<unsigned char> body(request.begin() + 1, request.end());
+        bool written = false;
+
+        switch (command)
+        {
+            case kServeOpen:
+            {
+                string path(body.begin(), body.end());
+                string error;
+
+                clip.Close();
+                if (clip.Open(path.c_str(), openOptions, error) != S_OK)
+                {
+                    written = write_error(error);
+                    break;
+                }
+
+                string json = metadata_json(clip.Info());
+                written = write_response(kServeOk, vector<unsigned char>(json.begin(), json.end()));
+                break;
+            }
+
+            case kServeRead:
+                written = serve_read(clip, body);
+                break;
+
+            case kServeClose:
+                clip.Close();
+                written = write_response(kServeOk, vector<unsigned char>());
+                break;
+
+            default:
+                written = write_error("Unknown command");
+                break;
+        }
+
+        if (!written)
+            return 1;
+    }
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc < 3)
+    if (argc < 2)
     {
         cerr << "Usage:" << endl;
         cerr << "  " << argv[0] << " metadata <input.braw>" << endl;
-        cerr << "  " << argv[0] << " extract <input.braw> <frame_index> <output.ppm>" << endl;
+        cerr << "  " << argv[0] << " extract <input.braw> <frame_index> <output> [format] [scale]" << endl;
+        cerr << "  " << argv[0] << " serve [pipeline]" << endl;
         return 1;
     }
 
@@ -309,14 +575,64 @@ int main(int argc, char* argv[])
     }
     else if (command == "extract")
     {
-        if (argc != 5)
+        if (argc < 5 || argc > 7)
         {
-            cerr << "Usage: " << argv[0] << " extract <input.braw> <frame_index> <output.ppm>" << endl;
+            cerr << "Usage: " << argv[0] << " extract <input.braw> <frame_index> <output> [format] [scale]" << endl;
             return 1;
         }
+        if (const BrawImageFile* outputFile = FindImageFileForPath(argv[4]))
+            s_outputFile = outputFile;
+        FindEncodingForPath(argv[4], s_encode.encoding);
+        if (argc >= 6)
+        {
+            s_pixelFormat = FindPixelFormat(argv[5]);
+            if (!s_pixelFormat)
+            {
+                cerr << "{\"error\": \"Unknown pixel format: " << argv[5] << "\"}" << endl;
+                return 1;
+            }
+        }
+        if (s_encode.encoding != brawEncodingNone &&
+            (s_pixelFormat->planar || s_pixelFormat->bytes_per_sample != 1))
+        {
+            cerr << "{\"error\": \"Pixel format " << s_pixelFormat->name << " cannot be encoded as "
+                 << EncodingName(s_encode.encoding) << "\"}" << endl;
+            return 1;
+        }
+        if (s_encode.encoding == brawEncodingNone && !CanWriteImage(s_outputFile->type, *s_pixelFormat))
+        {
+            cerr << "{\"error\": \"Pixel format " << s_pixelFormat->name << " cannot be written as "
+                 << s_outputFile->name << "\"}" << endl;
+            return 1;
+        }
+        if (argc == 7)
+        {
+            s_resolutionScale = FindResolutionScale(argv[6]);
+            if (!s_resolutionScale)
+            {
+                cerr << "{\"error\": \"Unknown resolution scale: " << argv[6] << "\"}" << endl;
+                return 1;
+            }
+        }
         long frame_index = atol(argv[3]);
         return extract_frame(argv[2], frame_index, argv[4]);
     }
+    else if (command == "serve")
+    {
+        BrawOpenOptions options;
+
+        if (argc > 3)
+        {
+            cerr << "Usage: " << argv[0] << " serve [pipeline]" << endl;
+            return 1;
+        }
+        if (argc == 3 && !FindPipelineType(argv[2], options.pipeline))
+        {
+            cerr << "{\"error\": \"Unknown pipeline: " << argv[2] << "\"}" << endl;
+            return 1;
+        }
+        return serve(options);
+    }
     else
     {
         cerr << "Unknown command: " << command << endl;
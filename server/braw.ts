@@ -10,36 +10,345 @@ const __dirname = dirname(__filename);
 // Create require function for loading native addon
 const require = createRequire(import.meta.url);
 
-// Load native addon using require
+// Load native addon using require. The addon is context-aware, so this
+// module may also be imported from worker_threads.
 const nativeAddon = require(join(__dirname, 'native/build/Release/braw.node'));
 
+// Decode pipelines; 'auto' tries CUDA then OpenCL. Any GPU pipeline that
+// can't be set up falls back to the CPU, so check metadata().pipeline.
+export type BRAWPipeline = 'cpu' | 'cuda' | 'opencl';
+
+export interface BRAWOpenOptions {
+  pipeline?: BRAWPipeline | 'auto'; // Default 'cpu'
+  // Frames handed to the SDK at once (default 8); later frames wait by
+  // priority, with a quarter of the slots kept for interactive reads
+  maxJobs?: number;
+}
+
+// Order frames wait in once a clip is at maxJobs
+export type BRAWPriority = 'interactive' | 'prefetch' | 'batch';
+
 export interface BRAWMetadata {
   success: boolean;
   frame_count: number;
   width: number;
   height: number;
   frame_rate: number;
+  // frame_rate as the exact rational rate, e.g. 24000/1001 for 23.976
+  frame_rate_num: number;
+  frame_rate_den: number;
   duration: number;
+  pipeline: BRAWPipeline; // Pipeline actually in use after any CPU fallback
   error?: string;
 }
 
+// SDK resource formats the native decode can produce. The SDK has no
+// 4-channel float layout in RGBA order, hence bgraf16/bgraf32.
+export type BRAWPixelFormat =
+  | 'rgba8' | 'bgra8'
+  | 'rgb16' | 'rgba16' | 'bgra16' | 'rgb16planar'
+  | 'rgbf16' | 'bgraf16' | 'rgbf16planar'
+  | 'rgbf32' | 'bgraf32' | 'rgbf32planar';
+
+// Decode resolution; reduced scales are far cheaper than decoding then resizing
+export type BRAWResolutionScale = 'full' | 'half' | 'quarter' | 'eighth';
+
+// Encoding done natively on the decode thread; WebP is always 4:2:0
+export type BRAWEncoding = 'none' | 'jpeg' | 'webp';
+export type BRAWChromaSubsampling = '444' | '422' | '420' | 'gray';
+
+// Scope sizes in cells, 16-1024 each
+export interface BRAWScopeOptions {
+  waveformWidth?: number; // default 256
+  waveformHeight?: number; // default 128
+  vectorscopeSize?: number; // default 128
+}
+
+// Computed natively from the decoded pixels. Waveform and vectorscope cells
+// are densities scaled so the busiest cell is 255.
+export interface BRAWScopes {
+  histogram: Uint32Array; // 4 x 256 pixel counts: R, G, B, then Rec. 709 luma
+  waveform: { width: number; height: number; data: Buffer }; // Luma per column, row 0 brightest
+  vectorscope: { size: number; data: Buffer }; // Rec. 601 U right, V up, centred
+}
+
+// RAW development settings applied inside the SDK decode; unset ones keep
+// the clip's own. Frames are cached per distinct set. Gamma, gamut and
+// post3DLUTMode take the SDK's names, e.g. 'Blackmagic Design Film', 'Rec.709'.
+export interface BRAWProcessingOptions {
+  colorScienceGen?: number;
+  gamma?: string;
+  gamut?: string;
+  toneCurveContrast?: number;
+  toneCurveSaturation?: number;
+  toneCurveMidpoint?: number;
+  toneCurveHighlights?: number;
+  toneCurveShadows?: number;
+  toneCurveVideoBlackLevel?: boolean;
+  toneCurveBlackLevel?: number;
+  toneCurveWhiteLevel?: number;
+  highlightRecovery?: boolean;
+  analogGainIsConstant?: boolean;
+  analogGain?: number;
+  post3DLUTMode?: string;
+  whiteBalanceKelvin?: number;
+  whiteBalanceTint?: number;
+  exposure?: number; // Stops
+  iso?: number;
+}
+
+// A node as NodeSystem.export() produces it. Only primary_wheels and lut
+// nodes are graded natively; a LUT's params are { path, intensity? }.
+export interface BRAWGradeNode {
+  type: string;
+  enabled?: boolean; // Disabled nodes are skipped
+  params: Record<string, any>;
+}
+
+// Nodes apply in array order, as the browser engine renders them
+export type BRAWGradeGraph = { nodes: BRAWGradeNode[] } | BRAWGradeNode[];
+
+// advancedChromaKeyShader's uniforms; colours are 0-255 levels as in
+// CHROMA_KEY_PRESETS. Unset values key like its GREEN_SCREEN preset.
+export interface BRAWKeyOptions {
+  keyColor?: [number, number, number] | { r: number; g: number; b: number };
+  hueRange?: number;
+  satRange?: number;
+  lumRange?: number;
+  threshold?: number;
+  tolerance?: number; // Softness either side of threshold
+  edgeThin?: number; // > 0 erodes, < 0 grows
+  edgeFeather?: number;
+  edgeRefine?: boolean;
+  edgeRadius?: number;
+  spillSuppress?: number;
+  despillBias?: number;
+  despillColor?: [number, number, number] | { r: number; g: number; b: number };
+  matteContrast?: number;
+  matteGamma?: number;
+  matteClipBlack?: number;
+  matteClipWhite?: number;
+  writeAlpha?: boolean; // Multiply the matte into 4-channel pixels' alpha (default true)
+  matte?: 'u8' | 'u16'; // Also return the matte on its own
+}
+
+export interface BRAWMatte {
+  width: number;
+  height: number;
+  format: 'u8' | 'u16';
+  data: Buffer; // One sample per pixel, rows packed
+}
+
 export interface BRAWFrameResult {
   success: boolean;
   width: number;
   height: number;
+  stride: number; // Bytes per row (per plane row when planar)
+  format: BRAWPixelFormat;
+  channels: number;
+  channel_order: 'RGB' | 'RGBA' | 'BGRA';
+  sample_type: 'uint8' | 'uint16' | 'float16' | 'float32';
+  planar: boolean;
+  encoding: BRAWEncoding; // When not 'none', buffer holds the encoded file and stride is 0
+  scopes?: BRAWScopes; // Present when requested
+  matte?: BRAWMatte; // Present when key.matte is set
   buffer: Buffer;
   error?: string;
+  cancelled?: boolean; // Set on failures caused by cancel() or timeoutMs
+}
+
+export interface BRAWBatchFrameResult extends BRAWFrameResult {
+  frame_index: number;
+}
+
+// pipeline only applies to the path-based exports; a session keeps the one it was opened with
+export interface BRAWNativeFrameOptions extends BRAWOpenOptions {
+  format?: BRAWPixelFormat; // Decoded pixel layout (default 'rgba8')
+  scale?: BRAWResolutionScale; // Decode resolution (default 'full')
+  // Wrap the SDK's decoded image instead of copying it; the image is
+  // released when the Buffer is garbage collected
+  zeroCopy?: boolean;
+  // Serve from and fill the shared decoded-frame cache (default true).
+  // Zero-copy buffers of cached frames are shared; treat them as read-only.
+  cache?: boolean;
+  // Compress on the decode thread; needs an 8-bit format (rgba8 or bgra8)
+  encoding?: BRAWEncoding;
+  quality?: number; // 1-100 (default 90)
+  subsampling?: BRAWChromaSubsampling; // JPEG only (default '420')
+  // Handed to the SDK decode; an invalid value fails the read
+  processing?: BRAWProcessingOptions;
+  // Grade on the decode thread; cached frames stay ungraded. Needs an
+  // interleaved integer format.
+  grade?: BRAWGradeGraph;
+  // Chroma key the graded pixels on the decode thread; needs an interleaved
+  // integer or float32 format
+  key?: BRAWKeyOptions;
+  // Measure the (graded) pixels before any encode; needs an interleaved integer format
+  scopes?: boolean | BRAWScopeOptions;
+  priority?: BRAWPriority; // Default 'interactive', or 'batch' for readFrames
+  requestId?: string; // Lets session.cancel() drop the request
+  // Frames not yet decoding this long after the call are skipped as cancelled
+  timeoutMs?: number;
+}
+
+export interface BRAWBatchOptions extends BRAWNativeFrameOptions {
+  maxInFlight?: number; // Read/decode jobs kept queued per codec (default 8)
+  // Codecs the frames are spread over (default 1; 0 sizes the pool to the
+  // machine). A session opens its pool once and keeps it.
+  codecs?: number;
+}
+
+export interface BRAWPrefetchStats {
+  depth: number;
+  direction: 1 | -1;
+  step: number; // Frames between consecutive reads
+  in_flight: number;
+  completed: number;
+  cancelled: number; // Dropped before decode after the playhead moved away
+}
+
+export interface BRAWProxyResult {
+  success: boolean;
+  frame_count: number;
+  stored: number; // Frames in the store, from any process
+  hits: number; // Reads this session served from it
+  width: number; // 0 until the first frame is stored
+  height: number;
+  format: BRAWPixelFormat;
+  scale: BRAWResolutionScale;
+  built?: number; // Frames buildProxies added
+  error?: string;
+}
+
+export interface BRAWClipSession {
+  readFrame(frameIndex: number, options?: BRAWNativeFrameOptions): BRAWFrameResult;
+  readFrameAsync(frameIndex: number, options?: BRAWNativeFrameOptions): Promise<BRAWFrameResult>;
+  readFrames(frameIndices: number[], options?: BRAWBatchOptions): Promise<BRAWBatchFrameResult[]>;
+  // Decode the next depth frames along the read direction into the frame cache; 0 turns it off
+  setPrefetch(options: { depth: number }): void;
+  prefetchStats(): BRAWPrefetchStats;
+  metadata(): BRAWMetadata;
+  // Frame index showing at each timestamp (seconds) on the clip's exact
+  // timebase, clamped to the clip; synchronous, with no SDK call
+  frameAt(timestamp: number): number;
+  frameAt(timestamps: number[]): number[];
+  // Clip attributes the SDK decodes with when processing leaves them unset;
+  // booleans come back as 0 or 1
+  clipProcessing(): { success: boolean; attributes?: Record<string, number | string>; error?: string };
+  // Cancel the request with requestId, or every one with an id; returns how many were cancelled
+  cancel(requestId?: string): number;
+  // Serve reads at the store's format and scale from a memory-mapped proxy
+  // pack file; buffers of stored frames are shared pages and read-only
+  attachProxies(
+    storePath: string,
+    options?: { scale?: 'quarter' | 'eighth'; format?: 'rgba8' | 'bgra8' }
+  ): BRAWProxyResult;
+  // Decode the frames missing from the attached store, at batch priority
+  buildProxies(options?: { maxInFlight?: number }): Promise<BRAWProxyResult>;
+  close(): void;
 }
 
 export interface BRAWFrameOptions {
-  format?: 'jpeg' | 'png' | 'webp' | 'bgr24'; // Changed 'raw' to 'bgr24'
+  format?: 'jpeg' | 'png' | 'webp' | 'raw'; // 'raw' returns the decoded pixels as-is
+  pixelFormat?: BRAWPixelFormat; // Decode format; sharp encodes need interleaved rgb(a) integers
+  scale?: BRAWResolutionScale; // Decode scale, applied before any resize
   quality?: number;
+  subsampling?: BRAWChromaSubsampling; // JPEG chroma subsampling (default '420')
   resizeWidth?: number;
   resizeHeight?: number;
+  processing?: BRAWProcessingOptions; // SDK decode settings
+  grade?: BRAWGradeGraph; // Applied natively before any encode
+  key?: BRAWKeyOptions; // Keyed natively after the grade; WebP and PNG keep the alpha
+  priority?: BRAWPriority;
+  requestId?: string;
+  timeoutMs?: number;
 }
 
-export function extractMetadata(filePath: string): BRAWMetadata {
-  return nativeAddon.extractMetadata(filePath);
+// Thrown for frames dropped by cancel() or a timeout
+export class BRAWCancelledError extends Error {
+  constructor() {
+    super('Frame request cancelled');
+    this.name = 'BRAWCancelledError';
+  }
+}
+
+export function extractMetadata(filePath: string, options: BRAWOpenOptions = {}): BRAWMetadata {
+  return nativeAddon.extractMetadata(filePath, options);
+}
+
+export type BRAWMetadataValue = number | string | number[];
+
+// Saved by indexClip next to the clip and read back without the SDK
+export interface BRAWClipIndex {
+  success: boolean;
+  frame_count: number;
+  width: number;
+  height: number;
+  frame_rate: number;
+  frame_rate_num: number;
+  frame_rate_den: number;
+  duration: number;
+  camera_type: string;
+  start_timecode: string;
+  clip: Record<string, BRAWMetadataValue>;
+  // Keys that changed at each frame, frame 0 holding them all; empty when not scanned
+  frames: { frame_index: number; metadata: Record<string, BRAWMetadataValue> }[];
+  error?: string;
+}
+
+// One pass of read jobs (no decode) over the clip's frames; frames: false
+// skips the per-frame metadata. An empty indexPath only returns the result.
+export function indexClip(
+  filePath: string,
+  indexPath: string,
+  options: BRAWOpenOptions & { frames?: boolean } = {}
+): Promise<BRAWClipIndex> {
+  return nativeAddon.indexClip(filePath, indexPath, options);
+}
+
+export interface BRAWPrepareOptions extends BRAWOpenOptions {
+  posterPath?: string; // JPEG of frame 0; omit to skip
+  stripPath?: string; // JPEG of thumbnails side by side; omit to skip
+  thumbnails?: number; // Default 10, evenly spaced over the clip
+  thumbnailWidth?: number; // Default 160
+  quality?: number; // JPEG quality, default 85
+  scale?: BRAWResolutionScale; // Decode scale, default 'quarter'
+}
+
+export interface BRAWPrepareResult extends BRAWClipIndex {
+  poster?: { width: number; height: number };
+  // width and height are those of one thumbnail
+  strip?: { count: number; width: number; height: number };
+  // Set when the index was saved but the preview failed
+  preview_error?: string;
+}
+
+// indexClip with per-frame metadata, then the poster and thumbnail strip,
+// decoded through the shared frame cache in one background job
+export function prepareClip(
+  filePath: string,
+  indexPath: string,
+  options: BRAWPrepareOptions = {}
+): Promise<BRAWPrepareResult> {
+  return nativeAddon.prepareClip(filePath, indexPath, options);
+}
+
+// Fails with 'Index is stale' once filePath changes size or mtime
+export function readClipIndex(
+  indexPath: string,
+  filePath: string,
+  options: { frames?: boolean } = {}
+): BRAWClipIndex {
+  return nativeAddon.readClipIndex(indexPath, filePath, options);
+}
+
+export interface BRAWFrameCacheStats {
+  entries: number;
+  bytes: number;
+  max_bytes: number;
+  hits: number;
+  misses: number;
+  evictions: number;
 }
 
 export function initBRAWNative(): void {
@@ -48,18 +357,390 @@ export function initBRAWNative(): void {
   }
 }
 
-export function extractFrameRaw(filePath: string, frameIndex: number): BRAWFrameResult {
-  return nativeAddon.extractFrame(filePath, frameIndex);
+/**
+ * Set the byte budget of the native decoded-frame cache, shared by every
+ * clip and session in the process. 0 disables it.
+ */
+export function configureFrameCache(maxBytes: number): BRAWFrameCacheStats {
+  return nativeAddon.configureFrameCache({ maxBytes });
 }
 
-export async function extractFrameBuffer(
+export function frameCacheStats(): BRAWFrameCacheStats {
+  return nativeAddon.frameCacheStats();
+}
+
+export interface BRAWBufferPoolStats {
+  idle_buffers: number;
+  idle_bytes: number;
+  max_idle_bytes: number;
+  used_buffers: number; // Held by frames, the cache and live JS Buffers
+  used_bytes: number;
+  hits: number;
+  misses: number;
+}
+
+/**
+ * Set how many bytes of released native frame buffers are kept for reuse.
+ * Pixel buffers handed to JS return to the pool when they are collected,
+ * so a steady export reuses the same memory instead of churning malloc.
+ */
+export function configureBufferPool(maxIdleBytes: number): BRAWBufferPoolStats {
+  return nativeAddon.configureBufferPool({ maxIdleBytes });
+}
+
+export function bufferPoolStats(): BRAWBufferPoolStats {
+  return nativeAddon.bufferPoolStats();
+}
+
+export function clearFrameCache(): void {
+  nativeAddon.clearFrameCache();
+}
+
+export interface BRAWTrimOptions extends BRAWOpenOptions {
+  onProgress?: (fraction: number) => void; // 0-1 as the new clip is written
+  requestId?: string; // Makes the trim cancellable through cancelTrim
+  timeoutMs?: number; // Abort trims still running this long after the call
+}
+
+export interface BRAWTrimResult {
+  success: boolean;
+  frame_count?: number;
+  bytes?: number; // Size of the new clip
+  error?: string;
+  cancelled?: boolean;
+}
+
+/**
+ * Copy frames inFrame to outFrame (inclusive) into a new clip at
+ * outputPath without decoding them: the SDK copies the compressed frames
+ * and metadata, so a select costs its own I/O only. The clip is written
+ * beside outputPath and renamed over it once complete, so a failed or
+ * cancelled trim leaves outputPath untouched.
+ */
+export function trimClip(
+  filePath: string,
+  inFrame: number,
+  outFrame: number,
+  outputPath: string,
+  options: BRAWTrimOptions = {}
+): Promise<BRAWTrimResult> {
+  return nativeAddon.trimClip(filePath, inFrame, outFrame, outputPath, options);
+}
+
+// Abort the trim with requestId, or every one started on this thread with an id
+export function cancelTrim(requestId?: string): number {
+  return nativeAddon.cancelTrim(requestId);
+}
+
+export type BRAWStage =
+  | 'factory' | 'open' | 'queue' | 'read' | 'decode' | 'copy' | 'grade' | 'key' | 'scopes' | 'encode' | 'total';
+
+export interface BRAWStageStats {
+  count: number;
+  total_ns: number;
+  mean_ns: number;
+  min_ns: number;
+  max_ns: number;
+  // Percentiles are bucket upper bounds, so within a factor of 2
+  p50_ns: number;
+  p90_ns: number;
+  p99_ns: number;
+  histogram: Array<[number, number]>; // [upper bound ns, count] of the non-empty log2 buckets
+}
+
+export interface BRAWStats {
+  enabled: boolean;
+  frames: number; // Decoded by the SDK; cache hits show in frameCacheStats
+  bytes: number; // Decoded pixel bytes
+  encoded_bytes: number;
+  errors: number;
+  cancelled: number;
+  peak_rss: number; // Bytes, whole process
+  stages: Record<BRAWStage, BRAWStageStats>;
+}
+
+// Per-stage timers are off by default; counters survive turning them off
+export function configureStats(enabled: boolean): BRAWStats {
+  return nativeAddon.configureStats({ enabled });
+}
+
+// reset zeroes the counters once read, for interval scraping
+export function getStats(reset = false): BRAWStats {
+  return nativeAddon.getStats({ reset });
+}
+
+export function extractFrameRaw(
+  filePath: string,
+  frameIndex: number,
+  options: BRAWNativeFrameOptions = {}
+): BRAWFrameResult {
+  return nativeAddon.extractFrame(filePath, frameIndex, options);
+}
+
+/**
+ * Decode off the event loop; the promise settles when the SDK finishes.
+ */
+export function extractFrameRawAsync(
   filePath: string,
   frameIndex: number,
+  options: BRAWNativeFrameOptions = {}
+): Promise<BRAWFrameResult> {
+  return nativeAddon.extractFrameAsync(filePath, frameIndex, options);
+}
+
+/**
+ * Decode many frames through one codec with the SDK pipeline kept full.
+ * Results come back in request order.
+ */
+export function extractFramesRaw(
+  filePath: string,
+  frameIndices: number[],
+  options: BRAWBatchOptions = {}
+): Promise<BRAWBatchFrameResult[]> {
+  return nativeAddon.extractFrames(filePath, frameIndices, options);
+}
+
+/**
+ * Open a clip once and keep the native factory/codec/clip alive.
+ * Throws if the clip cannot be opened. Call close() when done.
+ * Sessions opening the same file with the same options, on this thread or
+ * any worker, share one codec; it closes when the last of them does.
+ */
+export function openClip(filePath: string, options: BRAWOpenOptions = {}): BRAWClipSession {
+  return nativeAddon.openClip(filePath, options);
+}
+
+// JPEG/WebP at decoded size are encoded natively, skipping sharp entirely;
+// resizes, PNG and non-8-bit decodes still go through sharp
+function nativeEncodeOptions(options: BRAWFrameOptions): BRAWNativeFrameOptions {
+  const { format = 'jpeg', pixelFormat = 'rgba8' } = options;
+
+  if ((format !== 'jpeg' && format !== 'webp') || options.resizeWidth || options.resizeHeight ||
+      (pixelFormat !== 'rgba8' && pixelFormat !== 'bgra8')) {
+    return {};
+  }
+  return { encoding: format, quality: options.quality, subsampling: options.subsampling };
+}
+
+export async function extractFrameBuffer(
+  source: string | BRAWClipSession,
+  frameIndex: number,
   options: BRAWFrameOptions = {}
 ): Promise<Buffer> {
-  const { format = 'jpeg', quality = 90, resizeWidth, resizeHeight } = options;
-  const frameResult = extractFrameRaw(filePath, frameIndex);
+  // The buffer only feeds sharp or the caller, so skip the native copy
+  const nativeOptions: BRAWNativeFrameOptions = {
+    format: options.pixelFormat,
+    scale: options.scale,
+    zeroCopy: true,
+    processing: options.processing,
+    grade: options.grade,
+    key: options.key,
+    priority: options.priority,
+    requestId: options.requestId,
+    timeoutMs: options.timeoutMs,
+    ...nativeEncodeOptions(options),
+  };
+  const frameResult = typeof source === 'string'
+    ? await extractFrameRawAsync(source, frameIndex, nativeOptions)
+    : await source.readFrameAsync(frameIndex, nativeOptions);
+
+  return encodeFrame(frameResult, frameIndex, options);
+}
+
+// The key matte of one frame on its own, for clients to composite with
+// instead of running the key shader at full resolution on every repaint
+export async function extractFrameMatte(
+  source: string | BRAWClipSession,
+  frameIndex: number,
+  options: Pick<BRAWFrameOptions, 'scale' | 'processing' | 'grade' | 'priority' | 'requestId' | 'timeoutMs'> & {
+    key: BRAWKeyOptions;
+  }
+): Promise<BRAWMatte> {
+  // The pixels themselves are not wanted, so leave them untouched
+  const nativeOptions: BRAWNativeFrameOptions = {
+    scale: options.scale,
+    zeroCopy: true,
+    processing: options.processing,
+    grade: options.grade,
+    key: { spillSuppress: 0, writeAlpha: false, matte: 'u8', ...options.key },
+    priority: options.priority,
+    requestId: options.requestId,
+    timeoutMs: options.timeoutMs,
+  };
+  const frameResult = typeof source === 'string'
+    ? await extractFrameRawAsync(source, frameIndex, nativeOptions)
+    : await source.readFrameAsync(frameIndex, nativeOptions);
+
+  if (frameResult.cancelled) {
+    throw new BRAWCancelledError();
+  }
+  if (!frameResult.success || !frameResult.matte) {
+    throw new Error(frameResult.error || 'Failed to key frame');
+  }
+  return frameResult.matte;
+}
+
+// Scopes of one frame without keeping the pixels; cached frames skip the decode
+export async function extractFrameScopes(
+  source: string | BRAWClipSession,
+  frameIndex: number,
+  options: { pixelFormat?: BRAWPixelFormat; scale?: BRAWResolutionScale; scopes?: BRAWScopeOptions } = {}
+): Promise<BRAWScopes> {
+  const nativeOptions: BRAWNativeFrameOptions = {
+    format: options.pixelFormat,
+    scale: options.scale,
+    zeroCopy: true,
+    scopes: options.scopes ?? true,
+  };
+  const frameResult = typeof source === 'string'
+    ? await extractFrameRawAsync(source, frameIndex, nativeOptions)
+    : await source.readFrameAsync(frameIndex, nativeOptions);
+
+  if (!frameResult.success || !frameResult.scopes) {
+    throw new Error(frameResult.error || 'Failed to compute scopes');
+  }
+  return frameResult.scopes;
+}
+
+export async function extractFrameBuffers(
+  source: string | BRAWClipSession,
+  frameIndices: number[],
+  options: BRAWFrameOptions & BRAWBatchOptions = {}
+): Promise<Buffer[]> {
+  const nativeOptions: BRAWBatchOptions = {
+    format: options.pixelFormat,
+    scale: options.scale,
+    zeroCopy: true,
+    maxInFlight: options.maxInFlight,
+    codecs: options.codecs,
+    processing: options.processing,
+    grade: options.grade,
+    key: options.key,
+    priority: options.priority,
+    requestId: options.requestId,
+    timeoutMs: options.timeoutMs,
+    ...nativeEncodeOptions(options),
+  };
+  const frameResults = typeof source === 'string'
+    ? await extractFramesRaw(source, frameIndices, nativeOptions)
+    : await source.readFrames(frameIndices, nativeOptions);
+
+  return Promise.all(
+    frameResults.map((frameResult) => encodeFrame(frameResult, frameResult.frame_index, options))
+  );
+}
+
+export interface BRAWStreamedFrame {
+  position: number; // Index into the requested frameIndices
+  frameIndex: number;
+  buffer?: Buffer;
+  error?: string;
+}
+
+/**
+ * Decode frames and yield each one as its decode completes, rather than
+ * once the whole batch is done. At most maxInFlight (default 4) reads are
+ * queued natively; the next is only submitted when the consumer pulls, so a
+ * slow consumer holds back the decoder instead of buffering frames.
+ * Returning early (e.g. the client disconnected) cancels the reads still
+ * queued when requestId is set.
+ */
+export async function* streamFrameBuffers(
+  session: BRAWClipSession,
+  frameIndices: number[],
+  options: BRAWFrameOptions & { maxInFlight?: number } = {}
+): AsyncGenerator<BRAWStreamedFrame> {
+  const maxInFlight = Math.max(1, options.maxInFlight ?? 4);
+  const pending = new Map<number, Promise<BRAWStreamedFrame>>();
+  let next = 0;
+
+  const submit = () => {
+    const position = next++;
+    const frameIndex = frameIndices[position];
+    pending.set(
+      position,
+      extractFrameBuffer(session, frameIndex, options).then(
+        (buffer) => ({ position, frameIndex, buffer }),
+        (error) => ({ position, frameIndex, error: error instanceof Error ? error.message : String(error) })
+      )
+    );
+  };
+
+  try {
+    while (next < frameIndices.length && pending.size < maxInFlight) {
+      submit();
+    }
+    while (pending.size > 0) {
+      const frame = await Promise.race(pending.values());
+      pending.delete(frame.position);
+      yield frame;
+      if (next < frameIndices.length) {
+        submit();
+      }
+    }
+  } finally {
+    if (pending.size > 0 && options.requestId) {
+      session.cancel(options.requestId);
+    }
+  }
+}
+
+/**
+ * Like streamFrameBuffers, but frames are yielded in request order, for
+ * writers that must emit them in sequence (image sequences, an encoder's
+ * stdin). maxInFlight (default 4) bounds both the reads queued natively and
+ * the frames held waiting for an earlier one, and the next read is
+ * submitted before the current frame is handed over, so decoding overlaps
+ * the consumer's writes.
+ */
+export async function* orderedFrameBuffers(
+  session: BRAWClipSession,
+  frameIndices: number[],
+  options: BRAWFrameOptions & { maxInFlight?: number } = {}
+): AsyncGenerator<BRAWStreamedFrame> {
+  const maxInFlight = Math.max(1, options.maxInFlight ?? 4);
+  const window: Promise<BRAWStreamedFrame>[] = [];
+  let next = 0;
+
+  const submit = () => {
+    const position = next++;
+    const frameIndex = frameIndices[position];
+    window.push(
+      extractFrameBuffer(session, frameIndex, options).then(
+        (buffer) => ({ position, frameIndex, buffer }),
+        (error) => ({ position, frameIndex, error: error instanceof Error ? error.message : String(error) })
+      )
+    );
+  };
+
+  try {
+    while (next < frameIndices.length && window.length < maxInFlight) {
+      submit();
+    }
+    while (window.length > 0) {
+      const frame = await window.shift()!;
+      if (next < frameIndices.length) {
+        submit();
+      }
+      yield frame;
+    }
+  } finally {
+    if (window.length > 0 && options.requestId) {
+      session.cancel(options.requestId);
+    }
+  }
+}
+
+async function encodeFrame(
+  frameResult: BRAWFrameResult,
+  frameIndex: number,
+  options: BRAWFrameOptions
+): Promise<Buffer> {
+  const { format = 'jpeg', quality = 90, subsampling, resizeWidth, resizeHeight } = options;
 
+  if (frameResult.cancelled) {
+    throw new BRAWCancelledError();
+  }
   if (!frameResult.success) {
     console.error("Error from native addon:", frameResult.error);
     throw new Error(frameResult.error || 'Failed to extract frame');
@@ -68,21 +749,31 @@ export async function extractFrameBuffer(
     console.error("Native addon returned no buffer for frame", frameIndex);
     throw new Error('Native addon returned no buffer');
   }
-  const expectedBufferSize = frameResult.width * frameResult.height * 3;
-  console.log("Frame buffer received from native addon. Dimensions:", frameResult.width, "x", frameResult.height, ", Buffer Length:", frameResult.buffer.length, ", Expected BGR24 Size:", expectedBufferSize);
-
 
-  // If format is bgr24, return the raw buffer directly
-  if (format === 'bgr24') {
+  // Raw pixels and natively encoded images are returned directly
+  if (format === 'raw' || (frameResult.encoding && frameResult.encoding !== 'none')) {
     return frameResult.buffer;
   }
 
-  // Otherwise, process with sharp for image formats
+  // Otherwise, process with sharp for image formats. sharp reads packed
+  // RGB(A) integer rows only, so float, planar and BGRA decodes can't go here.
+  const { channels, sample_type: sampleType } = frameResult;
+  if (frameResult.planar || frameResult.channel_order === 'BGRA' ||
+      (sampleType !== 'uint8' && sampleType !== 'uint16')) {
+    throw new Error(`Pixel format ${frameResult.format} cannot be encoded as ${format}`);
+  }
+
+  const bytesPerSample = sampleType === 'uint16' ? 2 : 1;
+  if (frameResult.stride !== frameResult.width * channels * bytesPerSample) {
+    throw new Error(`Unexpected row padding in ${frameResult.format} frame`);
+  }
+
   let image = sharp(frameResult.buffer, {
     raw: {
       width: frameResult.width,
       height: frameResult.height,
-      channels: 3, // BGR24 has 3 channels
+      channels: channels as 3 | 4,
+      ...(sampleType === 'uint16' ? { depth: 'ushort' as const } : {}),
     },
   });
 
@@ -95,7 +786,10 @@ export async function extractFrameBuffer(
 
   switch (format) {
     case 'jpeg':
-      return image.jpeg({ quality }).toBuffer();
+      return image.jpeg({
+        quality,
+        ...(subsampling === '444' ? { chromaSubsampling: '4:4:4' } : {}),
+      }).toBuffer();
     case 'png':
       return image.png({ compressionLevel: 9 }).toBuffer();
     case 'webp':
@@ -4,11 +4,15 @@
  * TypeScript wrapper for the C++ BRAW frame extractor
  */
 
-import { spawn } from 'child_process';
+import { spawn, type ChildProcessWithoutNullStreams } from 'child_process';
+import { existsSync } from 'fs';
 import { join } from 'path';
-import { promises as fs } from 'fs';
+import type { BRAWPipeline, BRAWPixelFormat, BRAWResolutionScale } from './braw';
 
-const BRAW_EXTRACTOR_PATH = join(__dirname, 'braw-extractor');
+// The braw-extractor target's build output when present, which has serve;
+// the checked-in binary otherwise
+const BUILT_EXTRACTOR_PATH = join(__dirname, 'native', 'build', 'Release', 'braw-extractor');
+const BRAW_EXTRACTOR_PATH = existsSync(BUILT_EXTRACTOR_PATH) ? BUILT_EXTRACTOR_PATH : join(__dirname, 'braw-extractor');
 
 export interface BRAWMetadata {
   success: boolean;
@@ -25,6 +29,7 @@ export interface BRAWFrameResult {
   path: string;
   width: number;
   height: number;
+  format?: string;
   error?: string;
 }
 
@@ -72,19 +77,22 @@ export async function extractMetadata(brawPath: string): Promise<BRAWMetadata> {
 }
 
 /**
- * Extract a single frame from BRAW file
+ * Extract a single frame from BRAW file, optionally at a reduced decode scale
  */
 export async function extractFrame(
   brawPath: string,
   frameIndex: number,
-  outputPath: string
+  outputPath: string,
+  scale: BRAWResolutionScale = 'full'
 ): Promise<BRAWFrameResult> {
   return new Promise((resolve, reject) => {
     const process = spawn(BRAW_EXTRACTOR_PATH, [
       'extract',
       brawPath,
       frameIndex.toString(),
-      outputPath
+      outputPath,
+      'rgba8',
+      scale
     ]);
     
     let stdout = '';
@@ -156,38 +164,201 @@ export async function convertPPMToJPEG(ppmPath: string, jpegPath: string): Promi
 }
 
 /**
- * Extract frame and convert to JPEG in one step
+ * Extract a frame straight to JPEG; the extractor encodes it in-process
+ * from the .jpg/.jpeg extension, so no PPM or ffmpeg pass is involved
  */
 export async function extractFrameAsJPEG(
   brawPath: string,
   frameIndex: number,
-  outputJpegPath: string
+  outputJpegPath: string,
+  scale: BRAWResolutionScale = 'full'
 ): Promise<BRAWFrameResult> {
-  const tempPpmPath = outputJpegPath.replace(/\.jpe?g$/i, '.ppm');
-  
-  try {
-    // Extract frame as PPM
-    const result = await extractFrame(brawPath, frameIndex, tempPpmPath);
-    
-    if (!result.success) {
-      return result;
+  const result = await extractFrame(brawPath, frameIndex, outputJpegPath, scale);
+
+  if (!result.success) {
+    return result;
+  }
+
+  return {
+    ...result,
+    path: outputJpegPath
+  };
+}
+
+// `braw-extractor serve` protocol, see braw-extractor.cpp
+const SERVE_OPEN = 1;
+const SERVE_READ = 2;
+const SERVE_CLOSE = 3;
+const SERVE_OK = 0;
+
+export interface BRAWDaemonFrame {
+  width: number;
+  height: number;
+  stride: number;
+  buffer: Buffer;
+}
+
+export interface BRAWDaemonReadOptions {
+  format?: BRAWPixelFormat; // Default 'rgba8'
+  scale?: BRAWResolutionScale; // Default 'full'
+  encoding?: 'jpeg' | 'webp'; // Compressed in the daemon; buffer holds the file bytes
+  quality?: number; // 1-100, default 90
+}
+
+interface PendingResponse {
+  resolve: (body: Buffer) => void;
+  reject: (error: Error) => void;
+}
+
+/**
+ * Resident `braw-extractor serve` process holding one open clip.
+ *
+ * Avoids a process spawn, library load, CreateCodec/OpenClip and a temp
+ * file per frame while keeping SDK crashes out of the Node process. The
+ * daemon answers in request order, so requests are pipelined. If it dies,
+ * pending requests fail and the next request respawns it and reopens the clip.
+ */
+export class BRAWExtractorDaemon {
+  private child: ChildProcessWithoutNullStreams | null = null;
+  private pending: PendingResponse[] = [];
+  private chunks: Buffer[] = [];
+  private buffered = 0;
+  private openPath: string | null = null;
+
+  constructor(private pipeline: BRAWPipeline | 'auto' = 'cpu') {}
+
+  async open(brawPath: string): Promise<BRAWMetadata> {
+    const body = await this.request(SERVE_OPEN, Buffer.from(brawPath, 'utf8'));
+    this.openPath = brawPath;
+    return JSON.parse(body.toString('utf8'));
+  }
+
+  async readFrame(frameIndex: number, options: BRAWDaemonReadOptions = {}): Promise<BRAWDaemonFrame> {
+    const format = Buffer.from(options.format ?? '', 'ascii');
+    const scale = Buffer.from(options.scale ?? '', 'ascii');
+    const encoding = Buffer.from(options.encoding ?? '', 'ascii');
+    const trailer = options.encoding ? 1 + encoding.length + 1 : 0;
+    const body = Buffer.alloc(8 + 1 + format.length + 1 + scale.length + trailer);
+
+    let offset = body.writeBigUInt64LE(BigInt(frameIndex), 0);
+    offset = body.writeUInt8(format.length, offset);
+    offset += format.copy(body, offset);
+    offset = body.writeUInt8(scale.length, offset);
+    offset += scale.copy(body, offset);
+    if (options.encoding) {
+      offset = body.writeUInt8(encoding.length, offset);
+      offset += encoding.copy(body, offset);
+      body.writeUInt8(options.quality ?? 90, offset);
     }
-    
-    // Convert PPM to JPEG
-    await convertPPMToJPEG(tempPpmPath, outputJpegPath);
-    
-    // Clean up PPM file
-    await fs.unlink(tempPpmPath).catch(() => {});
-    
-    // Return result with JPEG path
+
+    const response = await this.request(SERVE_READ, body);
     return {
-      ...result,
-      path: outputJpegPath
+      width: response.readUInt32LE(0),
+      height: response.readUInt32LE(4),
+      stride: response.readUInt32LE(8),
+      buffer: response.subarray(12),
     };
-  } catch (error) {
-    // Clean up temp file on error
-    await fs.unlink(tempPpmPath).catch(() => {});
-    throw error;
   }
-}
 
+  async close(): Promise<void> {
+    this.openPath = null;
+    if (this.child) {
+      await this.request(SERVE_CLOSE, Buffer.alloc(0));
+    }
+  }
+
+  stop(): void {
+    this.openPath = null;
+    this.child?.stdin.end();
+    this.child = null;
+  }
+
+  private request(command: number, body: Buffer): Promise<Buffer> {
+    if (!this.child) {
+      this.start();
+      if (this.openPath && command !== SERVE_OPEN) {
+        // Restore the clip after a crash; if that fails this request reports it
+        this.send(SERVE_OPEN, Buffer.from(this.openPath, 'utf8')).catch(() => {});
+      }
+    }
+    return this.send(command, body);
+  }
+
+  private send(command: number, body: Buffer): Promise<Buffer> {
+    const header = Buffer.alloc(5);
+    header.writeUInt32LE(body.length + 1, 0);
+    header.writeUInt8(command, 4);
+
+    return new Promise((resolve, reject) => {
+      this.pending.push({ resolve, reject });
+      this.child!.stdin.write(Buffer.concat([header, body]));
+    });
+  }
+
+  private start(): void {
+    const child = spawn(BRAW_EXTRACTOR_PATH, ['serve', this.pipeline]);
+    let stderr = '';
+
+    child.stdout.on('data', (data: Buffer) => this.receive(data));
+    child.stderr.on('data', (data) => {
+      stderr += data.toString();
+    });
+    child.stdin.on('error', () => {}); // Reported through 'close'
+
+    const fail = (error: Error) => {
+      if (this.child === child) {
+        this.child = null;
+      }
+      this.chunks = [];
+      this.buffered = 0;
+      for (const pending of this.pending.splice(0)) {
+        pending.reject(error);
+      }
+    };
+
+    child.on('close', (code) => {
+      fail(new Error(`BRAW extractor exited with code ${code}: ${stderr}`));
+    });
+    child.on('error', (error) => {
+      fail(new Error(`Failed to spawn BRAW extractor: ${error.message}`));
+    });
+
+    this.child = child;
+  }
+
+  private receive(data: Buffer): void {
+    this.chunks.push(data);
+    this.buffered += data.length;
+
+    while (this.buffered >= 4) {
+      if (this.chunks[0].length < 4) {
+        this.chunks = [Buffer.concat(this.chunks, this.buffered)];
+      }
+
+      // Join chunks only once a whole response has arrived
+      const length = this.chunks[0].readUInt32LE(0);
+      if (this.buffered < 4 + length) {
+        return;
+      }
+
+      const head = this.chunks.length === 1 ? this.chunks[0] : Buffer.concat(this.chunks, this.buffered);
+
+      const status = head.readUInt8(4);
+      const body = head.subarray(5, 4 + length);
+      const rest = head.subarray(4 + length);
+
+      this.chunks = rest.length > 0 ? [rest] : [];
+      this.buffered = rest.length;
+
+      const pending = this.pending.shift();
+      if (!pending) {
+        continue;
+      }
+      if (status === SERVE_OK) {
+        pending.resolve(body);
+      } else {
+        pending.reject(new Error(body.toString('utf8')));
+      }
+    }
+  }
+}
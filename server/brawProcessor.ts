@@ -1,17 +1,133 @@
 import * as fs from 'fs/promises';
+import { createWriteStream } from 'fs';
 import path from 'path';
 import crypto from 'crypto';
+import { Transform, type Readable } from 'stream';
+import { pipeline } from 'stream/promises';
 import { fileURLToPath } from 'url';
 import { dirname } from 'path';
 
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = dirname(__filename);
-import { extractMetadata, extractFrameBuffer, initBRAWNative } from './braw';
+import {
+  extractFrameBuffer,
+  extractFrameBuffers,
+  streamFrameBuffers,
+  extractFrameScopes,
+  frameCacheStats,
+  getStats,
+  indexClip,
+  prepareClip,
+  trimClip,
+  cancelTrim,
+  readClipIndex,
+  configureFrameCache,
+  configureBufferPool,
+  bufferPoolStats,
+  configureStats,
+  initBRAWNative,
+  openClip,
+  type BRAWClipIndex,
+  type BRAWClipSession,
+  type BRAWGradeGraph,
+  type BRAWGradeNode,
+  type BRAWProcessingOptions,
+  type BRAWOpenOptions,
+  type BRAWPrepareResult,
+  type BRAWPriority,
+  type BRAWResolutionScale,
+  type BRAWScopeOptions,
+  type BRAWScopes,
+  type BRAWStats,
+  type BRAWStreamedFrame,
+  type BRAWKeyOptions,
+  type BRAWMatte,
+  orderedFrameBuffers,
+  extractFrameMatte,
+} from './braw';
+import { ENV } from './_core/env';
+
+// quality selects decode cost: reduced scales skip most of the wavelet decode
+const QUALITY_SCALES: Record<'low' | 'medium' | 'high', BRAWResolutionScale> = {
+  low: 'quarter',
+  medium: 'half',
+  high: 'full',
+};
 
 export interface BRAWFrameRequest {
   fileId: string;
   timestamp: number;
   quality?: 'low' | 'medium' | 'high';
+  processing?: BRAWProcessingOptions;
+  grade?: BRAWGradeGraph;
+  // Names the request for cancelFrames; a newer request from a scrub supersedes it
+  requestId?: string;
+  priority?: BRAWPriority;
+}
+
+export interface BRAWFramesRequest {
+  fileId: string;
+  timestamps: number[];
+  quality?: 'low' | 'medium' | 'high';
+  processing?: BRAWProcessingOptions;
+  grade?: BRAWGradeGraph;
+  requestId?: string;
+  priority?: BRAWPriority; // Default 'batch', behind interactive reads
+}
+
+export interface BRAWStreamRequest extends BRAWFramesRequest {
+  format?: 'jpeg' | 'webp' | 'raw'; // Default 'jpeg', encoded on the decode thread
+  jpegQuality?: number;
+  maxInFlight?: number; // Native reads queued ahead of the consumer
+}
+
+// A contiguous frame range for a render, decoded, graded and encoded natively
+export interface BRAWRenderRequest {
+  fileId: string;
+  inFrame: number;
+  outFrame: number; // Inclusive
+  format?: 'jpeg' | 'webp'; // Default 'jpeg'
+  jpegQuality?: number;
+  quality?: 'low' | 'medium' | 'high'; // Default 'high'
+  processing?: BRAWProcessingOptions;
+  grade?: BRAWGradeGraph;
+  key?: BRAWKeyOptions; // WebP frames carry the keyed alpha
+  requestId?: string;
+  maxInFlight?: number;
+}
+
+// The range is given in seconds, or as frames when inFrame/outFrame are set;
+// the frame showing at end (or outFrame) is the last one kept
+export interface BRAWTrimRequest {
+  fileId: string;
+  start?: number;
+  end?: number;
+  inFrame?: number;
+  outFrame?: number;
+  requestId?: string;
+  onProgress?: (fraction: number) => void;
+}
+
+export interface BRAWTrimmed {
+  fileId: string; // The new clip, prepared in the background like an upload
+  frameCount: number;
+  bytes: number;
+}
+
+export interface BRAWMatteRequest {
+  fileId: string;
+  timestamp: number;
+  quality?: 'low' | 'medium' | 'high';
+  processing?: BRAWProcessingOptions;
+  grade?: BRAWGradeGraph;
+  key: BRAWKeyOptions; // matte picks 'u8' (default) or 'u16'
+  requestId?: string;
+}
+
+export interface BRAWScopesRequest extends BRAWScopeOptions {
+  fileId: string;
+  timestamp: number;
+  quality?: 'low' | 'medium' | 'high';
 }
 
 export interface BRAWInfo {
@@ -21,26 +137,79 @@ export interface BRAWInfo {
   fps: number;
   codec: string;
   frameCount: number;
+  pipeline: string;
+}
+
+// Clip index written next to each upload; never mistaken for the upload itself
+const INDEX_EXT = '.brawidx';
+// Poster and thumbnail strip written next to each upload by prepareClip
+const POSTER_EXT = '.poster.jpg';
+const STRIP_EXT = '.strip.jpg';
+// Memory-mapped pack of decoded proxy frames, shared by every process on the host
+const PROXY_EXT = '.brawproxy';
+const SIDECAR_EXTS = [INDEX_EXT, POSTER_EXT, STRIP_EXT, PROXY_EXT];
+
+export const UPLOAD_EXTS = ['.braw', '.r3d', '.arriraw', '.dng', '.cr2', '.cr3', '.nef', '.arw'];
+
+// Chunked uploads stream into uploadDir/.partial until their last byte lands
+export interface BRAWUpload {
+  uploadId: string;
+  fileName: string;
+  size: number;
+  offset: number;
+  // Set once the upload has been moved into place; the fileId is the uploadId
+  complete: boolean;
+}
+
+// status is the HTTP status the upload routes answer with
+export class BRAWUploadError extends Error {
+  constructor(message: string, public status: number) {
+    super(message);
+    this.name = 'BRAWUploadError';
+  }
+}
+
+interface PartialUpload {
+  fileName: string;
+  ext: string;
+  size: number;
 }
 
 export class BRAWProcessor {
   private cacheDir: string;
   private uploadDir: string;
+  private partialDir: string;
+  private lutDir: string;
   // private frameCache: Map<string, Buffer> = new Map(); // Remove frame cache for raw buffers
   // private maxCacheSize = 100;
   private fileMetadataCache: Map<string, BRAWInfo> = new Map();
+  // One open native clip per fileId, so frame reads skip CreateCodec/OpenClip
+  private sessions: Map<string, BRAWClipSession> = new Map();
+  // Index builds in progress, so concurrent requests share one scan
+  private indexing: Map<string, Promise<BRAWClipIndex>> = new Map();
+  // Chunked uploads with a PATCH in flight; a second writer would interleave bytes
+  private appending: Set<string> = new Set();
 
   constructor() {
     this.cacheDir = path.resolve(__dirname, '..', 'temp', 'braw-cache');
     this.uploadDir = path.resolve(__dirname, '..', 'temp', 'braw-uploads');
+    this.partialDir = path.join(this.uploadDir, '.partial');
+    this.lutDir = ENV.brawLutDir
+      ? path.resolve(ENV.brawLutDir)
+      : path.resolve(__dirname, '..', 'temp', 'braw-luts');
   }
 
   async initialize(): Promise<void> {
     console.log("[BRAW] Initializing BRAWProcessor...");
     await fs.mkdir(this.cacheDir, { recursive: true });
     await fs.mkdir(this.uploadDir, { recursive: true });
+    await fs.mkdir(this.partialDir, { recursive: true });
+    await fs.mkdir(this.lutDir, { recursive: true });
     console.log("[BRAW] Initializing native BRAW module...");
     initBRAWNative(); // Explicitly initialize the native module
+    configureFrameCache(ENV.brawFrameCacheMB * 1024 * 1024);
+    configureBufferPool(ENV.brawBufferPoolMB * 1024 * 1024);
+    configureStats(ENV.brawStats);
     console.log("[BRAW] Processor initialized. Upload Dir: " + this.uploadDir + ", Cache Dir: " + this.cacheDir);
   }
 
@@ -56,45 +225,240 @@ export class BRAWProcessor {
     return fileId;
   }
 
+  // Start a chunked upload; bytes then arrive through appendUpload
+  async createUpload(fileName: string, size: number): Promise<BRAWUpload> {
+    const ext = path.extname(fileName).toLowerCase();
+    if (!UPLOAD_EXTS.includes(ext)) {
+      throw new BRAWUploadError(`Invalid file type: ${ext}`, 400);
+    }
+    if (!Number.isSafeInteger(size) || size <= 0) {
+      throw new BRAWUploadError('Upload size must be a positive integer', 400);
+    }
+    if (size > ENV.brawMaxUploadMB * 1024 * 1024) {
+      throw new BRAWUploadError(`Upload exceeds ${ENV.brawMaxUploadMB} MiB`, 413);
+    }
+
+    const uploadId = await this.generateFileId();
+    const partial: PartialUpload = { fileName, ext, size };
+    await fs.writeFile(this.partialPath(uploadId), '');
+    await fs.writeFile(this.partialPath(uploadId, '.json'), JSON.stringify(partial));
+    return { uploadId, fileName, size, offset: 0, complete: false };
+  }
+
+  // The offset to resume from; after completion, the whole size
+  async getUpload(uploadId: string): Promise<BRAWUpload> {
+    this.checkUploadId(uploadId);
+
+    const partial = await this.readPartial(uploadId);
+    if (!partial) {
+      const filePath = await this.getFilePath(uploadId).catch(() => undefined);
+      if (!filePath) {
+        throw new BRAWUploadError('Upload not found', 404);
+      }
+      const { size } = await fs.stat(filePath);
+      return { uploadId, fileName: path.basename(filePath), size, offset: size, complete: true };
+    }
+
+    const { size: offset } = await fs.stat(this.partialPath(uploadId));
+    return { uploadId, fileName: partial.fileName, size: partial.size, offset, complete: false };
+  }
+
+  // Stream body onto the end of the upload, which must currently hold offset
+  // bytes. The final chunk moves the file into place and starts prepareClip.
+  async appendUpload(uploadId: string, offset: number, body: Readable): Promise<BRAWUpload> {
+    this.checkUploadId(uploadId);
+    if (this.appending.has(uploadId)) {
+      throw new BRAWUploadError('Another chunk of this upload is in progress', 409);
+    }
+
+    this.appending.add(uploadId);
+    try {
+      const partial = await this.readPartial(uploadId);
+      if (!partial) {
+        // A client that missed the final response resumes at the full size
+        const upload = await this.getUpload(uploadId);
+        if (offset !== upload.size) {
+          throw new BRAWUploadError('Upload is already complete', 409);
+        }
+        return upload;
+      }
+
+      const partPath = this.partialPath(uploadId);
+      const { size: current } = await fs.stat(partPath);
+      if (offset !== current) {
+        throw new BRAWUploadError(`Upload is at offset ${current}, not ${offset}`, 409);
+      }
+
+      let received = current;
+      const limit = new Transform({
+        transform(chunk: Buffer, _encoding, callback) {
+          received += chunk.length;
+          if (received > partial.size) {
+            callback(new BRAWUploadError('Chunk runs past the declared upload size', 413));
+          } else {
+            callback(null, chunk);
+          }
+        },
+      });
+      await pipeline(body, limit, createWriteStream(partPath, { flags: 'a' }));
+
+      if (received < partial.size) {
+        return { uploadId, fileName: partial.fileName, size: partial.size, offset: received, complete: false };
+      }
+
+      const filePath = path.join(this.uploadDir, `${uploadId}${partial.ext}`);
+      await fs.rename(partPath, filePath);
+      await fs.rm(this.partialPath(uploadId, '.json'), { force: true });
+      console.log(`[BRAW Upload] Upload complete: ${uploadId} (${partial.size} bytes)`);
+
+      // Index, poster and thumbnails are built in the background, so the
+      // first open finds them ready
+      this.prepare(uploadId, filePath).catch((error) => {
+        console.error(`[BRAW Upload] Failed to prepare ${uploadId}:`, error);
+      });
+
+      return { uploadId, fileName: partial.fileName, size: partial.size, offset: received, complete: true };
+    } finally {
+      this.appending.delete(uploadId);
+    }
+  }
+
+  private checkUploadId(uploadId: string): void {
+    if (!/^[0-9a-f]{32}$/.test(uploadId)) {
+      throw new BRAWUploadError('Invalid upload id', 400);
+    }
+  }
+
+  private partialPath(uploadId: string, ext = '.part'): string {
+    return path.join(this.partialDir, `${uploadId}${ext}`);
+  }
+
+  private async readPartial(uploadId: string): Promise<PartialUpload | undefined> {
+    try {
+      return JSON.parse(await fs.readFile(this.partialPath(uploadId, '.json'), 'utf8'));
+    } catch {
+      return undefined;
+    }
+  }
+
   async getInfo(fileId: string): Promise<BRAWInfo> {
     if (this.fileMetadataCache.has(fileId)) {
       return this.fileMetadataCache.get(fileId)!;
     }
 
-    const filePath = await this.getFilePath(fileId);
-    const metadata = extractMetadata(filePath);
-
-    if (!metadata.success) {
-      throw new Error(metadata.error || 'Failed to extract metadata');
-    }
+    // Served from the clip index, so listing clips opens none of them
+    const index = await this.getIndex(fileId, false);
+    const session = this.sessions.get(fileId);
 
     const info: BRAWInfo = {
-      duration: metadata.duration,
-      width: metadata.width,
-      height: metadata.height,
-      fps: metadata.frame_rate,
+      duration: index.duration,
+      width: index.width,
+      height: index.height,
+      fps: index.frame_rate,
       codec: 'BRAW',
-      frameCount: metadata.frame_count,
+      frameCount: index.frame_count,
+      pipeline: session ? session.metadata().pipeline : ENV.brawPipeline,
     };
 
     this.fileMetadataCache.set(fileId, info);
     return info;
   }
 
-  private async timestampToFrameIndex(fileId: string, timestamp: number): Promise<number> {
+  // Clip and per-frame metadata; the first call scans the clip and saves the index
+  async getMetadata(fileId: string): Promise<BRAWClipIndex> {
+    return this.getIndex(fileId, true);
+  }
+
+  private async getIndex(fileId: string, frames: boolean): Promise<BRAWClipIndex> {
+    const filePath = await this.getFilePath(fileId);
+    const indexPath = filePath + INDEX_EXT;
+
+    const saved = readClipIndex(indexPath, filePath, { frames });
+    if (saved.success) {
+      return saved;
+    }
+
+    let pending = this.indexing.get(fileId);
+    if (!pending) {
+      pending = indexClip(filePath, indexPath).finally(() => this.indexing.delete(fileId));
+      this.indexing.set(fileId, pending);
+    }
+
+    const index = await pending;
+    if (!index.success) {
+      throw new Error(index.error || 'Failed to index clip');
+    }
+    return frames ? index : { ...index, frames: [] };
+  }
+
+  // Shares the indexing slot, so a getInfo during prepare waits for it
+  // rather than scanning the clip a second time
+  private prepare(fileId: string, filePath: string): Promise<BRAWPrepareResult> {
+    const pending = prepareClip(filePath, filePath + INDEX_EXT, {
+      pipeline: ENV.brawPipeline as BRAWOpenOptions['pipeline'],
+      posterPath: filePath + POSTER_EXT,
+      stripPath: ENV.brawThumbnails > 0 ? filePath + STRIP_EXT : '',
+      thumbnails: ENV.brawThumbnails,
+      thumbnailWidth: ENV.brawThumbnailWidth,
+    })
+      .then((result) => {
+        if (result.preview_error) {
+          console.warn(`[BRAW] Preview failed for ${fileId}: ${result.preview_error}`);
+        }
+        return result;
+      })
+      .finally(() => this.indexing.delete(fileId));
+    this.indexing.set(fileId, pending);
+    return pending;
+  }
+
+  // Path of the poster (frame 0) or thumbnail strip JPEG, built on demand
+  // for clips uploaded before previews existed
+  async getPreview(fileId: string, kind: 'poster' | 'strip'): Promise<string> {
+    const filePath = await this.getFilePath(fileId);
+    const previewPath = filePath + (kind === 'poster' ? POSTER_EXT : STRIP_EXT);
+
+    await this.indexing.get(fileId)?.catch(() => undefined);
+    if (await fs.access(previewPath).then(() => true, () => false)) {
+      return previewPath;
+    }
+
+    const result = await this.prepare(fileId, filePath);
+    if (!result.success) {
+      throw new Error(result.error || 'Failed to prepare clip');
+    }
+    if (result.preview_error) {
+      throw new Error(result.preview_error);
+    }
+    if (kind === 'strip' && !result.strip) {
+      throw new Error('Thumbnail strip disabled');
+    }
+    return previewPath;
+  }
+
+  // Layout of the strip served by getPreview, for slicing it client-side
+  async getStripLayout(fileId: string): Promise<{ count: number; width: number }> {
     const info = await this.getInfo(fileId);
-    const frameIndex = Math.floor(timestamp * info.fps);
-    return Math.min(frameIndex, info.frameCount - 1);
+    return { count: Math.min(ENV.brawThumbnails, info.frameCount), width: ENV.brawThumbnailWidth };
+  }
+
+  // LUT nodes name a file in the LUT directory; never let a client pick a path
+  private resolveGrade(grade?: BRAWGradeGraph): BRAWGradeNode[] | undefined {
+    if (!grade) return undefined;
+    const nodes = Array.isArray(grade) ? grade : grade.nodes;
+    return nodes.map((node) => {
+      if (node.type !== 'lut') return node;
+      const file = typeof node.params?.path === 'string' ? path.basename(node.params.path) : '';
+      return { ...node, params: { ...node.params, path: path.join(this.lutDir, file) } };
+    });
   }
 
   async extractFrame(request: BRAWFrameRequest): Promise<Buffer> {
-    const { fileId, timestamp, quality = 'medium' } = request;
+    const { fileId, timestamp, quality = 'medium', processing, grade, requestId, priority } = request;
     const cacheKey = `${fileId}_${timestamp}_${quality}`;
 
-    // Removed frame cache for raw buffers, as they are large and not easily cacheable as JPEGs
-    // if (this.frameCache.has(cacheKey)) {
-    //   return this.frameCache.get(cacheKey)!;
-    // }
+    // Decoded frames are cached off-heap by the native addon (configureFrameCache),
+    // so scrubbing back over a frame at the same quality skips the decode
 
     // Removed disk cache for raw buffers
     // const diskCachePath = path.join(this.cacheDir, `${cacheKey}.jpg`);
@@ -104,24 +468,183 @@ export class BRAWProcessor {
     //   return cached;
     // } catch {}
 
-    const filePath = await this.getFilePath(fileId);
-    const frameIndex = await this.timestampToFrameIndex(fileId, timestamp);
-    
-    // The `quality` parameter for extractFrameBuffer is not directly used for raw formats,
-    // but we can still pass it if the native module expects it.
-    // For now, we'll just pass the quality string.
-    const frameBuffer = await extractFrameBuffer(filePath, frameIndex, {
-      format: 'bgr24', // Request raw BGR24 pixel format
+    const session = await this.getSession(fileId);
+    // Mapped natively on the clip's rational timebase, so 29.97 fps frame
+    // times land on the frame (and its cache entry) they name
+    const frameIndex = session.frameAt(timestamp);
+
+    const frameBuffer = await extractFrameBuffer(session, frameIndex, {
+      format: 'raw', // Return the decoded RGBA8 pixels unencoded
+      scale: QUALITY_SCALES[quality],
+      processing,
+      grade: this.resolveGrade(grade),
+      requestId,
+      priority,
       // quality: jpegQuality, // Not applicable for raw format
       // resizeWidth: resizeWidth, // Not applicable for raw format, unless native module handles it
     });
 
-    // Do not cache raw frame buffers, as they are large and not easily cacheable.
+    // The native cache already holds this frame; these buffers are shared, so don't mutate them
     // await fs.writeFile(diskCachePath, frameBuffer);
     // this.addToCache(cacheKey, frameBuffer);
     return frameBuffer;
   }
 
+  async extractFrames(request: BRAWFramesRequest): Promise<Buffer[]> {
+    const { fileId, timestamps, quality = 'medium', processing, grade, requestId, priority } = request;
+
+    const session = await this.getSession(fileId);
+    const frameIndices = session.frameAt(timestamps);
+
+    // One pipelined native batch instead of a decode round trip per frame
+    return extractFrameBuffers(session, frameIndices, {
+      format: 'raw', // Return the decoded RGBA8 pixels unencoded
+      scale: QUALITY_SCALES[quality],
+      codecs: ENV.brawDecodeCodecs,
+      processing,
+      grade: this.resolveGrade(grade),
+      requestId,
+      priority,
+    });
+  }
+
+  // Frames in decode-completion order, each carrying its position in timestamps
+  async streamFrames(request: BRAWStreamRequest): Promise<AsyncGenerator<BRAWStreamedFrame>> {
+    const { fileId, timestamps, quality = 'medium', processing, grade, requestId, priority } = request;
+
+    const session = await this.getSession(fileId);
+    const frameIndices = session.frameAt(timestamps);
+
+    return streamFrameBuffers(session, frameIndices, {
+      format: request.format ?? 'jpeg',
+      quality: request.jpegQuality,
+      scale: QUALITY_SCALES[quality],
+      processing,
+      grade: this.resolveGrade(grade),
+      requestId,
+      priority: priority ?? 'batch',
+      maxInFlight: request.maxInFlight,
+    });
+  }
+
+  // Frames of a render in frame order, at batch priority so interactive
+  // reads of the same clip still go first
+  async renderFrames(request: BRAWRenderRequest): Promise<AsyncGenerator<BRAWStreamedFrame>> {
+    const { fileId, inFrame, outFrame, quality = 'high', processing, grade, key, requestId } = request;
+
+    const session = await this.getSession(fileId);
+    const frameIndices = Array.from({ length: Math.max(0, outFrame - inFrame + 1) }, (_, i) => inFrame + i);
+
+    return orderedFrameBuffers(session, frameIndices, {
+      format: request.format ?? 'jpeg',
+      quality: request.jpegQuality,
+      scale: QUALITY_SCALES[quality],
+      processing,
+      grade: this.resolveGrade(grade),
+      key,
+      requestId,
+      priority: 'batch',
+      maxInFlight: request.maxInFlight ?? ENV.brawMaxJobs,
+    });
+  }
+
+  // Frame count and exact rational rate, for sizing and timing renders
+  async getTimebase(fileId: string): Promise<{ frameCount: number; num: number; den: number }> {
+    const metadata = (await this.getSession(fileId)).metadata();
+    if (!metadata.success) {
+      throw new Error(metadata.error || 'Failed to read clip metadata');
+    }
+    return { frameCount: metadata.frame_count, num: metadata.frame_rate_num, den: metadata.frame_rate_den };
+  }
+
+  // Deliver a range as a new clip without decoding it. The clip is written
+  // beside partial uploads and moved into place once complete.
+  async trimClip(request: BRAWTrimRequest): Promise<BRAWTrimmed> {
+    const { fileId, requestId, onProgress } = request;
+    const sourcePath = await this.getFilePath(fileId);
+    const session = await this.getSession(fileId);
+    const inFrame = request.inFrame ?? session.frameAt(request.start ?? 0);
+    const outFrame = request.outFrame ?? session.frameAt(request.end ?? Number.MAX_VALUE);
+
+    const trimmedId = await this.generateFileId();
+    const partPath = path.join(this.partialDir, `${trimmedId}.braw`);
+    const result = await trimClip(sourcePath, inFrame, outFrame, partPath, {
+      pipeline: ENV.brawPipeline as BRAWOpenOptions['pipeline'],
+      maxJobs: ENV.brawMaxJobs,
+      requestId,
+      onProgress,
+    });
+    if (!result.success) {
+      throw new Error(result.error || 'Failed to trim clip');
+    }
+
+    const filePath = path.join(this.uploadDir, `${trimmedId}.braw`);
+    await fs.rename(partPath, filePath);
+    this.prepare(trimmedId, filePath).catch((error) => {
+      console.error(`[BRAW] Failed to prepare trim ${trimmedId}:`, error);
+    });
+
+    return { fileId: trimmedId, frameCount: result.frame_count ?? 0, bytes: result.bytes ?? 0 };
+  }
+
+  cancelTrim(requestId: string): boolean {
+    return cancelTrim(requestId) > 0;
+  }
+
+  // Drop frame requests the client no longer wants; queued frames are never
+  // decoded and frames mid-decode are discarded. No ids cancels them all.
+  cancelFrames(fileId: string, requestIds?: string[]): number {
+    const session = this.sessions.get(fileId);
+    if (!session) {
+      return 0;
+    }
+    if (!requestIds) {
+      return session.cancel();
+    }
+    return requestIds.reduce((cancelled, requestId) => cancelled + session.cancel(requestId), 0);
+  }
+
+  // The SDK settings frames decode with by default, for seeding RAW controls
+  async getClipProcessing(fileId: string): Promise<Record<string, number | string>> {
+    const session = await this.getSession(fileId);
+    const result = session.clipProcessing();
+    if (!result.success || !result.attributes) {
+      throw new Error(result.error || 'Failed to read clip processing attributes');
+    }
+    return result.attributes;
+  }
+
+  // Scopes are computed natively from the decoded frame, so clients can draw
+  // them without downloading the frame itself
+  async getScopes(request: BRAWScopesRequest): Promise<BRAWScopes> {
+    const { fileId, timestamp, quality = 'medium', ...scopes } = request;
+
+    const session = await this.getSession(fileId);
+    const frameIndex = session.frameAt(timestamp);
+
+    return extractFrameScopes(session, frameIndex, {
+      scale: QUALITY_SCALES[quality],
+      scopes,
+    });
+  }
+
+  // Keyed natively from the graded frame, so clients can composite a
+  // precomputed matte rather than keying every repaint
+  async getMatte(request: BRAWMatteRequest): Promise<BRAWMatte> {
+    const { fileId, timestamp, quality = 'medium', processing, grade, key, requestId } = request;
+
+    const session = await this.getSession(fileId);
+    const frameIndex = session.frameAt(timestamp);
+
+    return extractFrameMatte(session, frameIndex, {
+      scale: QUALITY_SCALES[quality],
+      processing,
+      grade: this.resolveGrade(grade),
+      key,
+      requestId,
+    });
+  }
+
   // private addToCache(key: string, buffer: Buffer): void {
   //   if (this.frameCache.size >= this.maxCacheSize) {
   //     const firstKey = this.frameCache.keys().next().value;
@@ -132,9 +655,68 @@ export class BRAWProcessor {
   //   this.frameCache.set(key, buffer);
   // }
 
+  private async getSession(fileId: string): Promise<BRAWClipSession> {
+    const existing = this.sessions.get(fileId);
+    if (existing) {
+      return existing;
+    }
+
+    const filePath = await this.getFilePath(fileId);
+    // Another request may have opened it while we were resolving the path
+    const raced = this.sessions.get(fileId);
+    if (raced) {
+      return raced;
+    }
+
+    const session = openClip(filePath, {
+      pipeline: ENV.brawPipeline as BRAWOpenOptions['pipeline'],
+      maxJobs: ENV.brawMaxJobs,
+    });
+    // Sequential reads for playback or scrubbing then hit the frame cache
+    session.setPrefetch({ depth: ENV.brawPrefetchDepth });
+    this.sessions.set(fileId, session);
+    this.attachProxies(fileId, filePath, session);
+    return session;
+  }
+
+  // Reads at the proxy scale ('low' quality for quarter) stop decoding once
+  // the store is filled, which happens in the background behind other work
+  private attachProxies(fileId: string, filePath: string, session: BRAWClipSession): void {
+    const scale = ENV.brawProxyScale;
+    if (scale !== 'quarter' && scale !== 'eighth') {
+      return;
+    }
+
+    const attached = session.attachProxies(filePath + PROXY_EXT, { scale });
+    if (!attached.success) {
+      console.warn(`[BRAW] Proxies unavailable for ${fileId}: ${attached.error}`);
+      return;
+    }
+    if (attached.stored >= attached.frame_count) {
+      return;
+    }
+
+    session.buildProxies().then(
+      (built) => {
+        if (!built.success && this.sessions.get(fileId) === session) {
+          console.warn(`[BRAW] Proxy build failed for ${fileId}: ${built.error}`);
+        }
+      },
+      (error) => console.warn(`[BRAW] Proxy build failed for ${fileId}:`, error)
+    );
+  }
+
+  private closeSession(fileId: string): void {
+    const session = this.sessions.get(fileId);
+    if (session) {
+      session.close();
+      this.sessions.delete(fileId);
+    }
+  }
+
   private async getFilePath(fileId: string): Promise<string> {
     const files = await fs.readdir(this.uploadDir);
-    const file = files.find((f) => f.startsWith(fileId));
+    const file = files.find((f) => f.startsWith(fileId) && !SIDECAR_EXTS.some((ext) => f.includes(ext)));
     if (!file) {
       throw new Error(`File not found: ${fileId}`);
     }
@@ -143,18 +725,35 @@ export class BRAWProcessor {
 
   async cleanup(fileId: string): Promise<void> {
     const filePath = await this.getFilePath(fileId);
+    this.closeSession(fileId);
     await fs.unlink(filePath);
+    await Promise.all(SIDECAR_EXTS.map((ext) => fs.rm(filePath + ext, { force: true })));
     this.fileMetadataCache.delete(fileId);
     // Implement more cleanup logic if needed (e.g., clearing frame cache)
   }
 
   getCacheStats() {
+    const frameCache = frameCacheStats();
+    const bufferPool = bufferPoolStats();
     return {
-      memoryFrames: 0, // this.frameCache.size,
-      maxMemoryFrames: 0, // this.maxCacheSize,
+      memoryFrames: frameCache.entries,
+      memoryBytes: frameCache.bytes,
+      maxMemoryBytes: frameCache.max_bytes,
+      frameCacheHits: frameCache.hits,
+      frameCacheMisses: frameCache.misses,
+      bufferPoolIdleBytes: bufferPool.idle_bytes,
+      bufferPoolUsedBytes: bufferPool.used_bytes,
+      bufferPoolHits: bufferPool.hits,
+      bufferPoolMisses: bufferPool.misses,
       cachedFiles: new Set(this.fileMetadataCache.keys()),
+      openSessions: this.sessions.size,
     };
   }
+
+  // Native per-stage decode timings, for scraping; zeroed on read when reset
+  getStats(reset = false): BRAWStats {
+    return getStats(reset);
+  }
 }
 
 let processorInstance: BRAWProcessor | null = null;
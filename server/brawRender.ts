@@ -0,0 +1,340 @@
+import path from 'path';
+import fs from 'fs/promises';
+import crypto from 'crypto';
+import { once } from 'events';
+import { spawn } from 'child_process';
+import { getBRAWProcessor, type BRAWProcessor } from './brawProcessor';
+import type { BRAWGradeGraph, BRAWKeyOptions, BRAWProcessingOptions } from './braw';
+import { ENV } from './_core/env';
+import { getRenderJob, insertRenderJob, listRenderJobs, updateRenderJob } from './db';
+import type { RenderJob } from '../drizzle/schema';
+
+// Headless renders: a clip range decoded, graded and encoded natively in a
+// bounded in-order window, then written out as an image sequence or piped
+// through ffmpeg. Jobs are kept in the renderJobs table, so unfinished ones
+// are picked up again when the server restarts; without a database the
+// queue still runs, it just forgets on restart.
+
+export interface RenderOutput {
+  container: 'frames' | 'mp4';
+  encoding?: 'jpeg' | 'webp'; // Image sequences only; ffmpeg is fed JPEG
+  quality?: number; // Default 90
+  resolution?: 'low' | 'medium' | 'high'; // Decode scale, default 'high'
+}
+
+export interface RenderSpec {
+  grade?: BRAWGradeGraph;
+  processing?: BRAWProcessingOptions;
+  key?: BRAWKeyOptions; // Keyed after the grade; WebP sequences keep the alpha
+  output: RenderOutput;
+}
+
+// Without a range the whole clip is rendered; outFrame is inclusive
+export interface RenderSubmission extends RenderSpec {
+  fileId: string;
+  inFrame?: number;
+  outFrame?: number;
+}
+
+export class RenderError extends Error {
+  constructor(message: string, public status: number) {
+    super(message);
+    this.name = 'RenderError';
+  }
+}
+
+// Progress is written back at most this often
+const PERSIST_INTERVAL_MS = 1000;
+
+class RenderCancelled extends Error {}
+
+export class RenderQueue {
+  private renderDir = path.join(process.cwd(), 'temp', 'braw-renders');
+  // Jobs submitted or resumed by this process and not yet finished,
+  // mirroring their rows; finished ones are read back from the table
+  private jobs: Map<string, RenderJob> = new Map();
+  private waiting: string[] = [];
+  // Running jobs and whether they have been asked to stop
+  private running: Map<string, { cancelled: boolean }> = new Map();
+
+  constructor(private processor: BRAWProcessor) {}
+
+  // Re-queue what a previous process left unfinished. Image sequences carry
+  // on from the last frame recorded; movies start over.
+  async initialize(): Promise<void> {
+    await fs.mkdir(this.renderDir, { recursive: true });
+
+    const unfinished = await listRenderJobs(['queued', 'running']);
+    unfinished.sort((a, b) => (a.createdAt?.getTime() ?? 0) - (b.createdAt?.getTime() ?? 0));
+    for (const job of unfinished) {
+      const spec = job.spec as RenderSpec;
+      const resumed = { ...job, status: 'queued' as const, framesDone: spec.output.container === 'frames' ? job.framesDone : 0 };
+      this.jobs.set(job.id, resumed);
+      this.waiting.push(job.id);
+      await this.persist(resumed, { status: 'queued', framesDone: resumed.framesDone });
+    }
+    if (unfinished.length > 0) {
+      console.log(`[BRAW Render] Resuming ${unfinished.length} render job(s)`);
+    }
+    this.pump();
+  }
+
+  async submit(submission: RenderSubmission): Promise<RenderJob> {
+    const { fileId, grade, processing, key, output } = submission;
+    const { frameCount } = await this.processor.getTimebase(fileId);
+    const inFrame = submission.inFrame ?? 0;
+    const outFrame = submission.outFrame ?? frameCount - 1;
+    if (!Number.isInteger(inFrame) || !Number.isInteger(outFrame) || inFrame < 0 || outFrame < inFrame ||
+        outFrame >= frameCount) {
+      throw new RenderError(`Render range must lie within the clip's ${frameCount} frames`, 400);
+    }
+
+    const id = crypto.randomUUID();
+    const extension = output.container === 'mp4' ? '.mp4' : '';
+    const job: RenderJob = {
+      id,
+      fileId,
+      status: 'queued',
+      inFrame,
+      outFrame,
+      spec: { grade, processing, key, output } satisfies RenderSpec,
+      outputPath: path.join(this.renderDir, id + extension),
+      framesDone: 0,
+      fps: 0,
+      error: null,
+      createdAt: new Date(),
+      startedAt: null,
+      finishedAt: null,
+    };
+
+    await insertRenderJob(job);
+    this.jobs.set(id, job);
+    this.waiting.push(id);
+    this.pump();
+    return job;
+  }
+
+  async get(id: string): Promise<RenderJob | undefined> {
+    return this.jobs.get(id) ?? (await getRenderJob(id));
+  }
+
+  // Newest first; jobs this process holds are more current than their rows
+  async list(): Promise<RenderJob[]> {
+    const byId = new Map((await listRenderJobs()).map((job) => [job.id, job]));
+    for (const job of this.jobs.values()) {
+      byId.set(job.id, job);
+    }
+    return [...byId.values()].sort((a, b) => (b.createdAt?.getTime() ?? 0) - (a.createdAt?.getTime() ?? 0));
+  }
+
+  // Queued jobs are dropped; running ones stop after the frame in hand and
+  // have their in-flight reads cancelled
+  async cancel(id: string): Promise<boolean> {
+    const job = this.jobs.get(id);
+    if (!job) {
+      return false;
+    }
+
+    const position = this.waiting.indexOf(id);
+    if (position >= 0) {
+      this.waiting.splice(position, 1);
+      await this.finish(job, 'cancelled');
+      return true;
+    }
+
+    const control = this.running.get(id);
+    if (!control) {
+      return false;
+    }
+    control.cancelled = true;
+    this.processor.cancelFrames(job.fileId, [id]);
+    return true;
+  }
+
+  private pump(): void {
+    while (this.running.size < Math.max(1, ENV.brawRenderJobs) && this.waiting.length > 0) {
+      const id = this.waiting.shift()!;
+      const job = this.jobs.get(id);
+      if (job) {
+        this.run(job).catch((error) => console.error(`[BRAW Render] Job ${id} failed:`, error));
+      }
+    }
+  }
+
+  private async run(job: RenderJob): Promise<void> {
+    const control = { cancelled: false };
+    this.running.set(job.id, control);
+
+    job.status = 'running';
+    job.startedAt = new Date();
+    await this.persist(job, { status: 'running', startedAt: job.startedAt });
+
+    try {
+      const spec = job.spec as RenderSpec;
+      if (spec.output.container === 'mp4') {
+        await this.renderMovie(job, spec, control);
+      } else {
+        await this.renderSequence(job, spec, control);
+      }
+      await this.finish(job, 'complete');
+    } catch (error) {
+      if (control.cancelled || error instanceof RenderCancelled) {
+        await this.finish(job, 'cancelled');
+      } else {
+        console.error(`[BRAW Render] Job ${job.id} failed:`, error);
+        await this.finish(job, 'failed', error instanceof Error ? error.message : String(error));
+      }
+    } finally {
+      this.running.delete(job.id);
+      this.pump();
+    }
+  }
+
+  // Yield the job's remaining frames in order, counting and timing them
+  private async *frames(job: RenderJob, spec: RenderSpec, encoding: 'jpeg' | 'webp', control: { cancelled: boolean }) {
+    const frames = await this.processor.renderFrames({
+      fileId: job.fileId,
+      inFrame: job.inFrame + job.framesDone,
+      outFrame: job.outFrame,
+      format: encoding,
+      jpegQuality: spec.output.quality,
+      quality: spec.output.resolution,
+      processing: spec.processing,
+      grade: spec.grade,
+      key: spec.key,
+      requestId: job.id,
+    });
+
+    const started = Date.now();
+    const startFrames = job.framesDone;
+    let persisted = started;
+
+    for await (const frame of frames) {
+      if (control.cancelled) {
+        throw new RenderCancelled();
+      }
+      if (frame.error || !frame.buffer) {
+        throw new Error(`Frame ${frame.frameIndex}: ${frame.error ?? 'no data'}`);
+      }
+
+      yield frame;
+
+      job.framesDone++;
+      const now = Date.now();
+      if (now - persisted >= PERSIST_INTERVAL_MS) {
+        persisted = now;
+        job.fps = ((job.framesDone - startFrames) * 1000) / (now - started);
+        await this.persist(job, { framesDone: job.framesDone, fps: job.fps });
+      }
+    }
+
+    const elapsed = Date.now() - started;
+    if (elapsed > 0) {
+      job.fps = ((job.framesDone - startFrames) * 1000) / elapsed;
+    }
+  }
+
+  // One file per frame, named by frame index, so a resumed job only
+  // rewrites the frames after the last one recorded
+  private async renderSequence(job: RenderJob, spec: RenderSpec, control: { cancelled: boolean }): Promise<void> {
+    const encoding = spec.output.encoding ?? 'jpeg';
+    const extension = encoding === 'webp' ? '.webp' : '.jpg';
+    const directory = job.outputPath!;
+    await fs.mkdir(directory, { recursive: true });
+
+    for await (const frame of this.frames(job, spec, encoding, control)) {
+      await fs.writeFile(path.join(directory, String(frame.frameIndex).padStart(6, '0') + extension), frame.buffer!);
+    }
+  }
+
+  // JPEG frames piped to ffmpeg at the clip's exact rational rate; written
+  // beside the output and renamed once ffmpeg exits cleanly
+  private async renderMovie(job: RenderJob, spec: RenderSpec, control: { cancelled: boolean }): Promise<void> {
+    const { num, den } = await this.processor.getTimebase(job.fileId);
+    const outputPath = job.outputPath!;
+    const partPath = outputPath + '.part';
+
+    const ffmpeg = spawn('ffmpeg', [
+      '-y',
+      '-f', 'image2pipe',
+      '-framerate', `${num}/${den}`,
+      '-c:v', 'mjpeg',
+      '-i', 'pipe:0',
+      '-c:v', 'libx264',
+      '-preset', 'fast',
+      '-pix_fmt', 'yuv420p',
+      '-movflags', 'faststart',
+      '-f', 'mp4',
+      partPath,
+    ], { stdio: ['pipe', 'ignore', 'pipe'] });
+
+    let stderr = '';
+    ffmpeg.stderr.on('data', (data) => {
+      stderr = (stderr + data.toString()).slice(-4096);
+    });
+    // A dead ffmpeg surfaces through its exit code, not EPIPE on stdin
+    ffmpeg.stdin.on('error', () => {});
+    const exited = new Promise<number | null>((resolve, reject) => {
+      ffmpeg.on('error', reject);
+      ffmpeg.on('close', resolve);
+    });
+
+    try {
+      for await (const frame of this.frames(job, spec, 'jpeg', control)) {
+        if (ffmpeg.exitCode !== null) {
+          break;
+        }
+        if (!ffmpeg.stdin.write(frame.buffer!)) {
+          await Promise.race([once(ffmpeg.stdin, 'drain'), exited]);
+        }
+      }
+      ffmpeg.stdin.end();
+
+      const code = await exited;
+      if (code !== 0) {
+        throw new Error(`ffmpeg exited with code ${code}: ${stderr.trim()}`);
+      }
+      await fs.rename(partPath, outputPath);
+    } catch (error) {
+      ffmpeg.kill('SIGKILL');
+      await exited.catch(() => null);
+      await fs.rm(partPath, { force: true });
+      throw error;
+    }
+  }
+
+  private async finish(job: RenderJob, status: 'complete' | 'failed' | 'cancelled', error?: string): Promise<void> {
+    job.status = status;
+    job.error = error ?? null;
+    job.finishedAt = new Date();
+    const update = { status, error: job.error, framesDone: job.framesDone, fps: job.fps, finishedAt: job.finishedAt };
+    // Kept in memory only while its row is missing or out of date
+    if (await this.persist(job, update)) {
+      this.jobs.delete(job.id);
+    }
+  }
+
+  // A database hiccup must not fail the render itself; false when the row
+  // was not written
+  private async persist(job: RenderJob, update: Partial<RenderJob>): Promise<boolean> {
+    try {
+      return await updateRenderJob(job.id, update);
+    } catch (error) {
+      console.warn(`[BRAW Render] Failed to record job ${job.id}:`, error);
+      return false;
+    }
+  }
+}
+
+let queueInstance: Promise<RenderQueue> | null = null;
+
+export function getRenderQueue(): Promise<RenderQueue> {
+  if (!queueInstance) {
+    queueInstance = (async () => {
+      const queue = new RenderQueue(await getBRAWProcessor());
+      await queue.initialize();
+      return queue;
+    })();
+  }
+  return queueInstance;
+}
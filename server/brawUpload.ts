@@ -1,10 +1,14 @@
-import { Router } from 'express';
+import { Router, type Response } from 'express';
 import multer from 'multer';
 import path from 'path';
-import { getBRAWProcessor } from './brawProcessor';
+import { BRAWUploadError, getBRAWProcessor, UPLOAD_EXTS, type BRAWUpload } from './brawProcessor';
+import { getRenderQueue } from './brawRender';
+import type { BRAWStreamedFrame } from './braw';
+import { ENV } from './_core/env';
 import { spawn } from 'child_process';
 import fs from 'fs/promises';
-import { EventEmitter } from 'events';
+import { EventEmitter, once } from 'events';
+import crypto from 'crypto';
 
 const conversionEvents = new EventEmitter();
 
@@ -29,9 +33,8 @@ const upload = multer({
   },
   fileFilter: (req, file, cb) => {
     const ext = path.extname(file.originalname).toLowerCase();
-    const allowedExts = ['.braw', '.r3d', '.arriraw', '.dng', '.cr2', '.cr3', '.nef', '.arw'];
     
-    if (allowedExts.includes(ext)) {
+    if (UPLOAD_EXTS.includes(ext)) {
       cb(null, true);
     } else {
       cb(new Error(`Invalid file type: ${ext}`));
@@ -69,6 +72,308 @@ router.post('/upload', upload.single('file'), async (req, res) => {
   }
 });
 
+// Resumable uploads: POST /uploads declares the file, HEAD reports how many
+// bytes have landed (Upload-Offset), and each PATCH streams the next chunk
+// straight onto the file at that offset. Nothing is buffered in memory.
+const UPLOAD_CONTENT_TYPE = 'application/offset+octet-stream';
+
+function setUploadHeaders(res: Response, upload: BRAWUpload) {
+  res.setHeader('Upload-Offset', String(upload.offset));
+  res.setHeader('Upload-Length', String(upload.size));
+  res.setHeader('Cache-Control', 'no-store');
+}
+
+function sendUploadError(res: Response, error: unknown) {
+  if (error instanceof BRAWUploadError) {
+    return res.status(error.status).json({ error: error.message });
+  }
+  console.error('[BRAW Upload] Error:', error);
+  res.status(500).json({
+    error: 'Failed to process BRAW upload',
+    message: error instanceof Error ? error.message : 'Unknown error',
+  });
+}
+
+router.post('/uploads', async (req, res) => {
+  try {
+    const { fileName, size } = req.body ?? {};
+    if (typeof fileName !== 'string' || typeof size !== 'number') {
+      return res.status(400).json({ error: 'Expected { fileName, size }' });
+    }
+
+    const processor = await getBRAWProcessor();
+    const upload = await processor.createUpload(fileName, size);
+    setUploadHeaders(res, upload);
+    res.status(201).json(upload);
+  } catch (error) {
+    sendUploadError(res, error);
+  }
+});
+
+router.head('/uploads/:uploadId', async (req, res) => {
+  try {
+    const processor = await getBRAWProcessor();
+    setUploadHeaders(res, await processor.getUpload(req.params.uploadId));
+    res.status(200).end();
+  } catch (error) {
+    res.status(error instanceof BRAWUploadError ? error.status : 500).end();
+  }
+});
+
+router.patch('/uploads/:uploadId', async (req, res) => {
+  const { uploadId } = req.params;
+  try {
+    if (req.headers['content-type'] !== UPLOAD_CONTENT_TYPE) {
+      return res.status(415).json({ error: `Expected Content-Type ${UPLOAD_CONTENT_TYPE}` });
+    }
+    const offset = Number(req.headers['upload-offset']);
+    if (!Number.isSafeInteger(offset) || offset < 0) {
+      return res.status(400).json({ error: 'Missing or invalid Upload-Offset header' });
+    }
+
+    const processor = await getBRAWProcessor();
+    const upload = await processor.appendUpload(uploadId, offset, req);
+    setUploadHeaders(res, upload);
+
+    if (!upload.complete) {
+      return res.status(204).end();
+    }
+
+    // Waits for the index that prepareClip is building, which then warms the first open
+    const info = await processor.getInfo(uploadId);
+    res.json({
+      success: true,
+      fileId: uploadId,
+      info,
+      fileName: upload.fileName,
+      size: upload.size,
+    });
+  } catch (error) {
+    // Tell the client where to resume; the request body may be unread
+    const processor = await getBRAWProcessor();
+    const upload = await processor.getUpload(uploadId).catch(() => undefined);
+    if (upload) {
+      setUploadHeaders(res, upload);
+    }
+    req.resume();
+    sendUploadError(res, error);
+  }
+});
+
+router.get('/poster/:fileId', async (req, res) => {
+  try {
+    const processor = await getBRAWProcessor();
+    const posterPath = await processor.getPreview(req.params.fileId, 'poster');
+    res.sendFile(posterPath, { headers: { 'Cache-Control': 'private, max-age=3600' } });
+  } catch (error) {
+    console.error('[BRAW Poster] Error:', error);
+    res.status(404).json({
+      error: 'Poster not available',
+      message: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+});
+
+// One JPEG of thumbnails side by side, X-Thumbnail-Width pixels each
+router.get('/thumbnails/:fileId', async (req, res) => {
+  try {
+    const { fileId } = req.params;
+    const processor = await getBRAWProcessor();
+    const stripPath = await processor.getPreview(fileId, 'strip');
+    const layout = await processor.getStripLayout(fileId);
+    res.sendFile(stripPath, {
+      headers: {
+        'Cache-Control': 'private, max-age=3600',
+        'X-Thumbnail-Count': String(layout.count),
+        'X-Thumbnail-Width': String(layout.width),
+      },
+    });
+  } catch (error) {
+    console.error('[BRAW Thumbnails] Error:', error);
+    res.status(404).json({
+      error: 'Thumbnails not available',
+      message: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+});
+
+// Frames are streamed as each decode completes: per frame, a little-endian
+// u32 metadata length and u32 data length, the metadata as JSON
+// ({ position, frameIndex, timestamp, error? }), then the image bytes.
+// The socket drives the pace; a client that stops reading stops the decodes.
+const FRAME_STREAM_CONTENT_TYPE = 'application/x-braw-frame-stream';
+const MAX_STREAM_FRAMES = 10000;
+
+router.post('/frames/:fileId/stream', async (req, res) => {
+  const { fileId } = req.params;
+  const { timestamps, quality, format, jpegQuality, maxInFlight } = req.body ?? {};
+  if (!Array.isArray(timestamps) || timestamps.length === 0 || timestamps.length > MAX_STREAM_FRAMES ||
+      !timestamps.every((timestamp) => typeof timestamp === 'number' && timestamp >= 0)) {
+    return res.status(400).json({ error: `Expected 1-${MAX_STREAM_FRAMES} non-negative timestamps` });
+  }
+  if (format !== undefined && !['jpeg', 'webp', 'raw'].includes(format)) {
+    return res.status(400).json({ error: `Unsupported format: ${format}` });
+  }
+  if (quality !== undefined && !['low', 'medium', 'high'].includes(quality)) {
+    return res.status(400).json({ error: `Unsupported quality: ${quality}` });
+  }
+  if (jpegQuality !== undefined && (!Number.isInteger(jpegQuality) || jpegQuality < 1 || jpegQuality > 100)) {
+    return res.status(400).json({ error: 'jpegQuality must be an integer from 1 to 100' });
+  }
+  if (maxInFlight !== undefined && !Number.isInteger(maxInFlight)) {
+    return res.status(400).json({ error: 'maxInFlight must be an integer' });
+  }
+
+  let frames: AsyncGenerator<BRAWStreamedFrame>;
+  try {
+    const processor = await getBRAWProcessor();
+    frames = await processor.streamFrames({
+      fileId,
+      timestamps,
+      quality,
+      format,
+      jpegQuality,
+      // More than the codec's job limit would only queue frames ahead of the socket
+      maxInFlight: maxInFlight === undefined ? undefined : Math.min(Math.max(1, maxInFlight), ENV.brawMaxJobs),
+      requestId: crypto.randomUUID(),
+    });
+  } catch (error) {
+    console.error('[BRAW Stream] Error:', error);
+    return res.status(404).json({
+      error: 'Failed to open clip',
+      message: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+
+  let closed = false;
+  res.on('close', () => {
+    closed = true;
+  });
+
+  res.writeHead(200, {
+    'Content-Type': FRAME_STREAM_CONTENT_TYPE,
+    'Cache-Control': 'no-store',
+    'X-Frame-Count': String(timestamps.length),
+  });
+
+  try {
+    for await (const frame of frames) {
+      if (closed) {
+        break; // Leaving the loop cancels the reads still queued
+      }
+
+      const metadata = Buffer.from(JSON.stringify({
+        position: frame.position,
+        frameIndex: frame.frameIndex,
+        timestamp: timestamps[frame.position],
+        ...(frame.error ? { error: frame.error } : {}),
+      }));
+      const data = frame.buffer ?? Buffer.alloc(0);
+      const header = Buffer.alloc(8);
+      header.writeUInt32LE(metadata.length, 0);
+      header.writeUInt32LE(data.length, 4);
+
+      // The frame itself is written as-is, never copied into the record
+      res.write(Buffer.concat([header, metadata]));
+      if (!res.write(data) && !closed) {
+        await Promise.race([once(res, 'drain'), once(res, 'close')]);
+      }
+    }
+  } catch (error) {
+    console.error('[BRAW Stream] Error:', error);
+  } finally {
+    res.end();
+  }
+});
+
+// Cut a select out of a clip without decoding it. The response is NDJSON:
+// { progress } lines as the new clip is written, then { complete, fileId,
+// frameCount, bytes } or { error }. Closing the request aborts the trim.
+router.post('/trim/:fileId', async (req, res) => {
+  const { fileId } = req.params;
+  const { start, end, inFrame, outFrame } = req.body ?? {};
+  const numbers = [start, end, inFrame, outFrame].filter((value) => value !== undefined);
+  if (!numbers.every((value) => typeof value === 'number' && value >= 0) ||
+      (inFrame === undefined) !== (outFrame === undefined)) {
+    return res.status(400).json({ error: 'Expected non-negative start/end seconds or inFrame/outFrame' });
+  }
+
+  const requestId = crypto.randomUUID();
+  const processor = await getBRAWProcessor();
+  let closed = false;
+  res.on('close', () => {
+    if (!res.writableFinished) {
+      closed = true;
+      processor.cancelTrim(requestId);
+    }
+  });
+
+  res.writeHead(200, { 'Content-Type': 'application/x-ndjson', 'Cache-Control': 'no-store' });
+
+  let reported = -1;
+  try {
+    const trimmed = await processor.trimClip({
+      fileId,
+      start,
+      end,
+      inFrame,
+      outFrame,
+      requestId,
+      onProgress: (fraction) => {
+        // Whole percents are plenty for a progress bar
+        const percent = Math.floor(fraction * 100);
+        if (!closed && percent > reported) {
+          reported = percent;
+          res.write(JSON.stringify({ progress: fraction }) + '\n');
+        }
+      },
+    });
+    res.end(JSON.stringify({ complete: true, ...trimmed }) + '\n');
+  } catch (error) {
+    console.error('[BRAW Trim] Error:', error);
+    res.end(JSON.stringify({ error: error instanceof Error ? error.message : 'Unknown error' }) + '\n');
+  }
+});
+
+// A finished mp4 render; image sequences stay on the server
+router.get('/render/:jobId', async (req, res) => {
+  const queue = await getRenderQueue();
+  const job = await queue.get(req.params.jobId);
+  if (!job || job.status !== 'complete' || !job.outputPath?.endsWith('.mp4')) {
+    return res.status(404).json({ error: 'No finished movie render with that id' });
+  }
+  res.sendFile(job.outputPath);
+});
+
+// The chroma key matte of one frame as raw samples, one per pixel, described
+// by X-Matte-Width/Height/Format. Body: { timestamp, quality?, grade?, key }.
+router.post('/matte/:fileId', async (req, res) => {
+  const { fileId } = req.params;
+  const { timestamp, quality, processing, grade, key } = req.body ?? {};
+  if (typeof timestamp !== 'number' || timestamp < 0 || typeof key !== 'object' || key === null) {
+    return res.status(400).json({ error: 'Expected a non-negative timestamp and key options' });
+  }
+
+  try {
+    const processor = await getBRAWProcessor();
+    const matte = await processor.getMatte({ fileId, timestamp, quality, processing, grade, key });
+    res.writeHead(200, {
+      'Content-Type': 'application/octet-stream',
+      'Content-Length': matte.data.length,
+      'X-Matte-Width': String(matte.width),
+      'X-Matte-Height': String(matte.height),
+      'X-Matte-Format': matte.format,
+    });
+    res.end(matte.data);
+  } catch (error) {
+    console.error('[BRAW Matte] Error:', error);
+    res.status(500).json({
+      error: 'Failed to key frame',
+      message: error instanceof Error ? error.message : 'Unknown error',
+    });
+  }
+});
+
 router.get('/frame/:fileId/:timestamp', async (req, res) => {
   try {
     const { fileId, timestamp } = req.params;
@@ -1,6 +1,6 @@
-import { eq } from "drizzle-orm";
+import { eq, inArray } from "drizzle-orm";
 import { drizzle } from "drizzle-orm/mysql2";
-import { InsertUser, users } from "../drizzle/schema";
+import { InsertRenderJob, InsertUser, RenderJob, renderJobs, users } from "../drizzle/schema";
 import { ENV } from './_core/env';
 
 let _db: ReturnType<typeof drizzle> | null = null;
@@ -85,4 +85,46 @@ export async function getUser(id: string) {
   return result.length > 0 ? result[0] : undefined;
 }
 
+export async function insertRenderJob(job: InsertRenderJob): Promise<void> {
+  const db = await getDb();
+  if (!db) {
+    console.warn("[Database] Cannot save render job: database not available");
+    return;
+  }
+
+  await db.insert(renderJobs).values(job);
+}
+
+// False when there is no database to write to
+export async function updateRenderJob(id: string, update: Partial<InsertRenderJob>): Promise<boolean> {
+  const db = await getDb();
+  if (!db) {
+    return false;
+  }
+
+  await db.update(renderJobs).set(update).where(eq(renderJobs.id, id));
+  return true;
+}
+
+export async function getRenderJob(id: string): Promise<RenderJob | undefined> {
+  const db = await getDb();
+  if (!db) {
+    return undefined;
+  }
+
+  const result = await db.select().from(renderJobs).where(eq(renderJobs.id, id)).limit(1);
+
+  return result.length > 0 ? result[0] : undefined;
+}
+
+export async function listRenderJobs(statuses?: RenderJob["status"][]): Promise<RenderJob[]> {
+  const db = await getDb();
+  if (!db) {
+    return [];
+  }
+
+  const query = db.select().from(renderJobs);
+  return statuses ? query.where(inArray(renderJobs.status, statuses)) : query;
+}
+
 // TODO: add feature queries here as your schema grows.
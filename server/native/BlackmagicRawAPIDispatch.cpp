@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <atomic>
 #include <dirent.h>
 #include <dlfcn.h>
 #include <libgen.h>
@@ -73,7 +74,11 @@ typedef HRESULT (*SafeArrayAccessDataFunc)(SafeArray*, void**);
 typedef HRESULT (*SafeArrayUnaccessDataFunc)(SafeArray*);
 typedef HRESULT (*SafeArrayDestroyFunc)(SafeArray*);
 
-static CreateRawFactoryFunc					gCreateBlackmagicRawFactoryInstance		= NULL;
+// Published with release semantics only once every other pointer is set, so
+// a non-null acquire load means the library is fully loaded. From then on no
+// call takes gBlackmagicRawMutex.
+static std::atomic<CreateRawFactoryFunc>	gCreateBlackmagicRawFactoryInstance(NULL);
+static void*								gLibraryHandle							= NULL;
 static VariantInitFunc						gVariantInit							= NULL;
 static VariantClearFunc						gVariantClear							= NULL;
 static SafeArrayCreateFunc					gSafeArrayCreate						= NULL;
@@ -86,9 +91,12 @@ static SafeArrayDestroyFunc					gSafeArrayDestroy						= NULL;
 
 static BmdMutex								gBlackmagicRawMutex;
 
+// Called with gBlackmagicRawMutex held. The handle is kept for the life of the
+// process; factories and codecs may outlive any one caller.
 static void	InitBlackmagicRawAPI (const char* libraryFilePath)
 {
 	void* libraryHandle;
+	CreateRawFactoryFunc createFactory;
 
 	libraryHandle = dlopen(libraryFilePath, RTLD_NOW|RTLD_GLOBAL);
 	if (!libraryHandle)
@@ -97,8 +105,8 @@ static void	InitBlackmagicRawAPI (const char* libraryFilePath)
 		return;
 	}
 
-	gCreateBlackmagicRawFactoryInstance = (CreateRawFactoryFunc)dlsym(libraryHandle, "CreateBlackmagicRawFactoryInstance");
-	if (!gCreateBlackmagicRawFactoryInstance)
+	createFactory = (CreateRawFactoryFunc)dlsym(libraryHandle, "CreateBlackmagicRawFactoryInstance");
+	if (!createFactory)
 		fprintf(stderr, "%s\n", dlerror());
 	gVariantInit = (VariantInitFunc)dlsym(libraryHandle, "VariantInit");
 	if (!gVariantInit)
@@ -127,43 +135,67 @@ static void	InitBlackmagicRawAPI (const char* libraryFilePath)
 	gSafeArrayDestroy = (SafeArrayDestroyFunc)dlsym(libraryHandle, "SafeArrayDestroy");
 	if (!gSafeArrayDestroy)
 		fprintf(stderr, "%s\n", dlerror());
+
+	if (!createFactory)
+	{
+		dlclose(libraryHandle);
+		return;
+	}
+
+	gLibraryHandle = libraryHandle;
+	gCreateBlackmagicRawFactoryInstance.store(createFactory, std::memory_order_release);
+}
+
+// Lock-free once the library is loaded
+static inline CreateRawFactoryFunc LoadedFactoryFunc (void)
+{
+	return gCreateBlackmagicRawFactoryInstance.load(std::memory_order_acquire);
 }
 
 IBlackmagicRawFactory* CreateBlackmagicRawFactoryInstance (void)
 {
 	IBlackmagicRawFactory* factory = NULL;
+	CreateRawFactoryFunc createFactory = LoadedFactoryFunc();
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
-	{
-		factory = CreateBlackmagicRawFactoryInstanceFromExeRelativePath(kBlackmagicRawAPI_LibraryFolder);
-		if (factory != NULL)
-			return factory;
-	}
+	if (createFactory != NULL)
+		return createFactory();
+
+	factory = CreateBlackmagicRawFactoryInstanceFromExeRelativePath(kBlackmagicRawAPI_LibraryFolder);
+	if (factory != NULL)
+		return factory;
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 	{
 		factory = CreateBlackmagicRawFactoryInstanceFromExeRelativePath(NULL);
 		if (factory != NULL)
 			return factory;
 	}
 
-	BmdScopedLock lock(gBlackmagicRawMutex);
+	{
+		BmdScopedLock lock(gBlackmagicRawMutex);
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
-		InitBlackmagicRawAPI(kBlackmagicRawAPI_Name);
+		if (LoadedFactoryFunc() == NULL)
+			InitBlackmagicRawAPI(kBlackmagicRawAPI_Name);
+	}
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	createFactory = LoadedFactoryFunc();
+	if (createFactory == NULL)
 		return NULL;
 
-	return gCreateBlackmagicRawFactoryInstance();
+	return createFactory();
 }
 
 IBlackmagicRawFactory* CreateBlackmagicRawFactoryInstanceFromPath (const char* loadPath)
 {
+	CreateRawFactoryFunc createFactory = LoadedFactoryFunc();
+
+	if (createFactory != NULL)
+		return createFactory();
+
 	BmdScopedLock lock(gBlackmagicRawMutex);
 
 	// Load from desired folder
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 	{
 		std::string libraryFilePath(loadPath);
 		if ((! libraryFilePath.empty()) && (libraryFilePath.back() != '/'))
@@ -173,17 +205,23 @@ IBlackmagicRawFactory* CreateBlackmagicRawFactoryInstanceFromPath (const char* l
 		InitBlackmagicRawAPI(libraryFilePath.c_str());
 	}
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	createFactory = LoadedFactoryFunc();
+	if (createFactory == NULL)
 		return NULL;
 
-	return gCreateBlackmagicRawFactoryInstance();
+	return createFactory();
 }
 
 IBlackmagicRawFactory* CreateBlackmagicRawFactoryInstanceFromExeRelativePath (const char* loadPath)
 {
+	CreateRawFactoryFunc createFactory = LoadedFactoryFunc();
+
+	if (createFactory != NULL)
+		return createFactory();
+
 	BmdScopedLock lock(gBlackmagicRawMutex);
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 	{
 		char path[PATH_MAX + 1];
 		ssize_t count = readlink("/proc/self/exe", path, PATH_MAX);
@@ -218,15 +256,16 @@ IBlackmagicRawFactory* CreateBlackmagicRawFactoryInstanceFromExeRelativePath (co
 		InitBlackmagicRawAPI(libraryFilePath.c_str());
 	}
 
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	createFactory = LoadedFactoryFunc();
+	if (createFactory == NULL)
 		return NULL;
 
-	return gCreateBlackmagicRawFactoryInstance();
+	return createFactory();
 }
 
 HRESULT VariantInit (Variant* variant)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gVariantInit(variant);
@@ -234,7 +273,7 @@ HRESULT VariantInit (Variant* variant)
 
 HRESULT VariantClear (Variant* variant)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gVariantClear(variant);
@@ -242,7 +281,7 @@ HRESULT VariantClear (Variant* variant)
 
 SafeArray* SafeArrayCreate (BlackmagicRawVariantType variantType, uint32_t dimensions, SafeArrayBound* safeArrayBound)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return NULL;
 
 	return gSafeArrayCreate(variantType, dimensions, safeArrayBound);
@@ -250,7 +289,7 @@ SafeArray* SafeArrayCreate (BlackmagicRawVariantType variantType, uint32_t dimen
 
 HRESULT SafeArrayGetVartype (SafeArray* safeArray, BlackmagicRawVariantType* variantType)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gSafeArrayGetVartype(safeArray, variantType);
@@ -258,7 +297,7 @@ HRESULT SafeArrayGetVartype (SafeArray* safeArray, BlackmagicRawVariantType* var
 
 HRESULT SafeArrayGetLBound (SafeArray* safeArray, uint32_t dimensions, long* lBound)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gSafeArrayGetLBound(safeArray, dimensions, lBound);
@@ -266,7 +305,7 @@ HRESULT SafeArrayGetLBound (SafeArray* safeArray, uint32_t dimensions, long* lBo
 
 HRESULT SafeArrayGetUBound (SafeArray* safeArray, uint32_t dimensions, long* uBound)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gSafeArrayGetUBound(safeArray, dimensions, uBound);
@@ -274,7 +313,7 @@ HRESULT SafeArrayGetUBound (SafeArray* safeArray, uint32_t dimensions, long* uBo
 
 HRESULT SafeArrayAccessData (SafeArray* safeArray, void** outData)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gSafeArrayAccessData(safeArray, outData);
@@ -282,7 +321,7 @@ HRESULT SafeArrayAccessData (SafeArray* safeArray, void** outData)
 
 HRESULT SafeArrayUnaccessData (SafeArray* safeArray)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gSafeArrayUnaccessData(safeArray);
@@ -290,7 +329,7 @@ HRESULT SafeArrayUnaccessData (SafeArray* safeArray)
 
 HRESULT SafeArrayDestroy (SafeArray* safeArray)
 {
-	if (gCreateBlackmagicRawFactoryInstance == NULL)
+	if (LoadedFactoryFunc() == NULL)
 		return E_FAIL;
 
 	return gSafeArrayDestroy(safeArray);
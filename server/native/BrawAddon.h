@@ -0,0 +1,35 @@
+/*
+ * BrawAddon - per-environment instance data of the addon
+ *
+ * The addon is context-aware: the main thread and every worker_thread that
+ * loads it gets its own BrawAddon holding that environment's JS handles,
+ * such as the ClipSession constructor. Native state (the SDK library, the
+ * factory, the frame cache, stats and open clips) stays process-wide and
+ * thread-safe, since the SDK is loaded once per process.
+ */
+
+#ifndef BRAW_ADDON_H
+#define BRAW_ADDON_H
+
+#include <napi.h>
+#include <map>
+#include <memory>
+#include <string>
+
+class FrameCancel;
+
+class BrawAddon : public Napi::Addon<BrawAddon>
+{
+public:
+    BrawAddon(Napi::Env env, Napi::Object exports);
+
+    // The instance of the environment calling in
+    static BrawAddon& Get(Napi::Env env) { return *env.GetInstanceData<BrawAddon>(); }
+
+    Napi::FunctionReference clip_session;
+
+    // Trims started here with a requestId, for cancelTrim
+    std::map<std::string, std::shared_ptr<FrameCancel> > trims;
+};
+
+#endif // BRAW_ADDON_H
@@ -0,0 +1,197 @@
+/*
+ * BrawBufferPool - process-wide pool of frame-sized pixel buffers
+ */
+
+#include "BrawBufferPool.h"
+#include <sys/mman.h>
+#include <cstdlib>
+
+static const size_t kMinClass = 4096;
+static const size_t kHugePage = 2 * 1024 * 1024;
+
+// Sits in the alignment gap in front of every buffer
+struct PoolHeader
+{
+    uint64_t capacity;
+    uint64_t mapped; // Bytes mapped from base, 0 when from posix_memalign
+    uint8_t padding[48];
+};
+
+static_assert(sizeof(PoolHeader) == BrawBufferPool::kAlignment, "Pool header must keep buffers aligned");
+
+static PoolHeader* HeaderOf(const void* data)
+{
+    return reinterpret_cast<PoolHeader*>(const_cast<uint8_t*>(static_cast<const uint8_t*>(data))) - 1;
+}
+
+// Four classes per power of two: p, 5p/4, 3p/2, 7p/4
+static size_t SizeClass(size_t size)
+{
+    if (size <= kMinClass)
+        return kMinClass;
+
+    size_t power = kMinClass;
+    while (power * 2 < size)
+        power *= 2;
+
+    size_t step = power / 4;
+    return power + (size - power + step - 1) / step * step;
+}
+
+static void* AllocateBuffer(size_t capacity)
+{
+    size_t total = capacity + sizeof(PoolHeader);
+    void* base = nullptr;
+    size_t mapped = 0;
+
+    if (total >= kHugePage)
+    {
+        mapped = (total + kHugePage - 1) / kHugePage * kHugePage;
+        base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            return nullptr;
+#ifdef MADV_HUGEPAGE
+        madvise(base, mapped, MADV_HUGEPAGE);
+#endif
+    }
+    else if (posix_memalign(&base, BrawBufferPool::kAlignment, total) != 0)
+    {
+        return nullptr;
+    }
+
+    PoolHeader* header = static_cast<PoolHeader*>(base);
+    header->capacity = capacity;
+    header->mapped = mapped;
+    return header + 1;
+}
+
+static void FreeBuffer(void* data)
+{
+    PoolHeader* header = HeaderOf(data);
+    if (header->mapped)
+        munmap(header, header->mapped);
+    else
+        free(header);
+}
+
+BrawBufferPool& BrawBufferPool::Shared()
+{
+    static BrawBufferPool s_pool;
+    return s_pool;
+}
+
+BrawBufferPool::BrawBufferPool()
+    : m_idleBuffers(0), m_idleBytes(0), m_maxIdleBytes(kDefaultMaxIdleBytes), m_usedBuffers(0), m_usedBytes(0),
+      m_hits(0), m_misses(0)
+{
+}
+
+void* BrawBufferPool::Acquire(size_t size)
+{
+    size_t capacity = SizeClass(size);
+    void* data = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::map<size_t, std::vector<void*> >::iterator idle = m_idle.find(capacity);
+        if (idle != m_idle.end() && !idle->second.empty())
+        {
+            data = idle->second.back();
+            idle->second.pop_back();
+            m_idleBuffers--;
+            m_idleBytes -= capacity;
+            m_hits++;
+        }
+        else
+        {
+            m_misses++;
+        }
+
+        m_usedBuffers++;
+        m_usedBytes += capacity;
+    }
+
+    // Fresh memory is allocated outside the lock; mapping 100 MB takes a while
+    if (!data)
+    {
+        data = AllocateBuffer(capacity);
+        if (!data)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_usedBuffers--;
+            m_usedBytes -= capacity;
+        }
+    }
+
+    return data;
+}
+
+void BrawBufferPool::Release(void* data)
+{
+    if (!data)
+        return;
+
+    size_t capacity = Capacity(data);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_usedBuffers--;
+        m_usedBytes -= capacity;
+
+        if (m_idleBytes + capacity <= m_maxIdleBytes)
+        {
+            m_idle[capacity].push_back(data);
+            m_idleBuffers++;
+            m_idleBytes += capacity;
+            return;
+        }
+    }
+
+    FreeBuffer(data);
+}
+
+size_t BrawBufferPool::Capacity(const void* data)
+{
+    return data ? static_cast<size_t>(HeaderOf(data)->capacity) : 0;
+}
+
+void BrawBufferPool::SetMaxIdleBytes(size_t maxIdleBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxIdleBytes = maxIdleBytes;
+    TrimLocked(maxIdleBytes);
+}
+
+// Largest classes first: they hold the most memory per buffer
+void BrawBufferPool::TrimLocked(size_t maxIdleBytes)
+{
+    std::map<size_t, std::vector<void*> >::reverse_iterator idle = m_idle.rbegin();
+    while (m_idleBytes > maxIdleBytes && idle != m_idle.rend())
+    {
+        while (m_idleBytes > maxIdleBytes && !idle->second.empty())
+        {
+            FreeBuffer(idle->second.back());
+            idle->second.pop_back();
+            m_idleBuffers--;
+            m_idleBytes -= idle->first;
+        }
+        ++idle;
+    }
+}
+
+BrawBufferPoolStats BrawBufferPool::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    BrawBufferPoolStats stats;
+    stats.idle_buffers = m_idleBuffers;
+    stats.idle_bytes = m_idleBytes;
+    stats.max_idle_bytes = m_maxIdleBytes;
+    stats.used_buffers = m_usedBuffers;
+    stats.used_bytes = m_usedBytes;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    return stats;
+}
@@ -0,0 +1,73 @@
+/*
+ * BrawBufferPool - process-wide pool of frame-sized pixel buffers
+ *
+ * Host copies of GPU frames, graded frames, cached frames and the pixel
+ * buffers handed to JS are all full-size and short-lived, so a long export
+ * churns hundreds of MB a second through malloc. The pool keeps released
+ * buffers in size classes (four per power of two, so at most a fifth is
+ * wasted) and hands them out again, up to an idle byte budget. Buffers are
+ * 64-byte aligned; those of 2 MB and up are mapped directly and advised for
+ * transparent huge pages.
+ */
+
+#ifndef BRAW_BUFFER_POOL_H
+#define BRAW_BUFFER_POOL_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct BrawBufferPoolStats
+{
+    size_t idle_buffers;
+    size_t idle_bytes;
+    size_t max_idle_bytes;
+    size_t used_buffers; // Acquired and not yet released
+    size_t used_bytes;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+class BrawBufferPool
+{
+public:
+    static const size_t kDefaultMaxIdleBytes = 256 * 1024 * 1024;
+    static const size_t kAlignment = 64;
+
+    static BrawBufferPool& Shared();
+
+    // A buffer of at least size bytes, or null when out of memory. Contents
+    // are undefined.
+    void* Acquire(size_t size);
+    // Give back a buffer from Acquire; null is ignored
+    void Release(void* data);
+
+    // Usable bytes of a buffer from Acquire, its size class
+    static size_t Capacity(const void* data);
+
+    // A budget of 0 stops pooling and frees every idle buffer
+    void SetMaxIdleBytes(size_t maxIdleBytes);
+
+    BrawBufferPoolStats Stats();
+
+private:
+    BrawBufferPool();
+    BrawBufferPool(const BrawBufferPool&);
+    BrawBufferPool& operator=(const BrawBufferPool&);
+
+    void TrimLocked(size_t maxIdleBytes);
+
+    std::mutex m_mutex;
+    std::map<size_t, std::vector<void*> > m_idle; // By size class
+    size_t m_idleBuffers;
+    size_t m_idleBytes;
+    size_t m_maxIdleBytes;
+    size_t m_usedBuffers;
+    size_t m_usedBytes;
+    uint64_t m_hits;
+    uint64_t m_misses;
+};
+
+#endif // BRAW_BUFFER_POOL_H
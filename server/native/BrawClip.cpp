@@ -0,0 +1,1155 @@
+/*
+ * BrawClip - long-lived Blackmagic RAW clip handle
+ */
+
+#include "BrawClip.h"
+#include "BrawBufferPool.h"
+#include "BrawFactory.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+bool FindPriority(const char* name, BrawPriority& priority)
+{
+    static const char* const s_names[brawPriorityCount] = { "interactive", "prefetch", "batch" };
+
+    for (int i = 0; i < brawPriorityCount; i++)
+    {
+        if (strcmp(s_names[i], name) == 0)
+        {
+            priority = static_cast<BrawPriority>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Carried through the SDK as job user data, from submit to ProcessComplete
+struct BrawJob
+{
+    BrawJob(BrawFrameCompletion* jobCompletion, const BrawDecodeOptions& decodeOptions, uint64_t submitTime)
+        : completion(jobCompletion), options(decodeOptions), clip_attributes(nullptr),
+          submitted(submitTime), started(0), decoding(0) {}
+
+    ~BrawJob()
+    {
+        if (clip_attributes)
+            clip_attributes->Release();
+    }
+
+    BrawFrameCompletion* completion;
+    BrawDecodeOptions options;
+    BrawFrameKey key; // Empty clip when the result is not to be cached
+
+    // Built at submit from options.processing, while the clip is known
+    IBlackmagicRawClipProcessingAttributes* clip_attributes;
+
+    // Why the job failed before the SDK decoded it, when it did
+    std::string error;
+
+    // BrawStats clock at SubmitFrame, at the SDK submit and at ReadComplete;
+    // 0 while stats are off
+    uint64_t submitted;
+    uint64_t started;
+    uint64_t decoding;
+};
+
+// User data of a trim job
+struct BrawTrimJob
+{
+    explicit BrawTrimJob(BrawTrimCompletion* trimCompletion) : completion(trimCompletion), aborted(false) {}
+
+    BrawTrimCompletion* completion;
+    bool aborted; // Only touched by the SDK's callbacks for the job
+};
+
+// Completion used by the blocking ReadFrame path. Waits for its own job
+// only, so other jobs queued on the codec do not hold it up.
+class SyncFrameCompletion : public BrawFrameCompletion
+{
+public:
+    SyncFrameCompletion() : result(S_OK), m_done(false) {}
+    virtual ~SyncFrameCompletion() = default;
+
+    virtual void FrameComplete(HRESULT frameResult, BrawFrame& decodedFrame, const std::string& frameError)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        result = frameResult;
+        error = frameError;
+        frame.Swap(decodedFrame);
+
+        m_done = true;
+        m_condition.notify_one();
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_done; });
+    }
+
+    HRESULT result;
+    BrawFrame frame;
+    std::string error;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_done;
+};
+
+// Callback shared by every job on the codec; results are routed by user data
+class BrawClipCallback : public IBlackmagicRawCallback
+{
+public:
+    BrawClipCallback(BrawClip& clip, BrawPipeline& pipeline) : m_clip(clip), m_pipeline(pipeline) {}
+    virtual ~BrawClipCallback() = default;
+
+    virtual void ReadComplete(IBlackmagicRawJob* readJob, HRESULT result, IBlackmagicRawFrame* frame)
+    {
+        IBlackmagicRawJob* decodeAndProcessJob = nullptr;
+        IBlackmagicRawFrameProcessingAttributes* frameAttributes = nullptr;
+        BrawJob* job = UserData(readJob);
+        BrawStats& stats = BrawStats::Shared();
+
+        stats.Record(brawStageRead, job->started);
+        job->decoding = stats.Now();
+
+        // Reading is cheap next to decoding, so this is the last point to back out
+        if (result == S_OK && job->completion->Cancelled())
+            result = E_ABORT;
+
+        if (result == S_OK && job->completion->FrameRead(frame))
+        {
+            BrawFrameCompletion* completion = job->completion;
+            BrawFrame empty;
+
+            delete job;
+            m_clip.JobDone();
+            completion->FrameComplete(S_OK, empty, std::string());
+            readJob->Release();
+            return;
+        }
+
+        if (result == S_OK)
+            result = frame->SetResourceFormat(job->options.format->resource_format);
+
+        if (result == S_OK && job->options.scale->divisor != 1)
+            result = frame->SetResolutionScale(job->options.scale->scale);
+
+        if (result == S_OK && job->options.processing)
+            result = job->options.processing->ApplyFrame(frame, &frameAttributes, job->error);
+
+        // The job takes its own references on the attributes
+        if (result == S_OK)
+            result = frame->CreateJobDecodeAndProcessFrame(job->clip_attributes, frameAttributes, &decodeAndProcessJob);
+
+        if (frameAttributes)
+            frameAttributes->Release();
+
+        if (result == S_OK)
+            result = decodeAndProcessJob->SetUserData(job);
+
+        if (result == S_OK)
+            result = decodeAndProcessJob->Submit();
+
+        if (result != S_OK)
+        {
+            if (decodeAndProcessJob)
+                decodeAndProcessJob->Release();
+            Complete(job, result, nullptr);
+        }
+
+        readJob->Release();
+    }
+
+    virtual void ProcessComplete(IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawProcessedImage* processedImage)
+    {
+        Complete(UserData(job), result, result == S_OK ? processedImage : nullptr);
+
+        job->Release();
+    }
+
+    virtual void DecodeComplete(IBlackmagicRawJob*, HRESULT) {}
+
+    virtual void TrimProgress(IBlackmagicRawJob* job, float progress)
+    {
+        BrawTrimJob* trim = TrimUserData(job);
+
+        if (trim->aborted)
+            return;
+
+        if (trim->completion->Cancelled())
+        {
+            trim->aborted = true;
+            job->Abort();
+            return;
+        }
+
+        trim->completion->TrimProgress(progress);
+    }
+
+    virtual void TrimComplete(IBlackmagicRawJob* job, HRESULT result)
+    {
+        BrawTrimJob* trim = TrimUserData(job);
+        BrawTrimCompletion* completion = trim->completion;
+
+        if (trim->aborted)
+            result = E_ABORT;
+        delete trim;
+        job->Release();
+
+        completion->TrimComplete(result, result == S_OK ? std::string() :
+                                 result == E_ABORT ? std::string("Cancelled") : std::string("Trim failed"));
+    }
+
+    virtual void SidecarMetadataParseWarning(IBlackmagicRawClip*, const char*, uint32_t, const char*) {}
+    virtual void SidecarMetadataParseError(IBlackmagicRawClip*, const char*, uint32_t, const char*) {}
+    virtual void PreparePipelineComplete(void* userData, HRESULT result)
+    {
+        static_cast<BrawPipelinePrepare*>(userData)->Complete(result);
+    }
+
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, LPVOID*)
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef(void)
+    {
+        return 0;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE Release(void)
+    {
+        return 0;
+    }
+
+private:
+    static BrawJob* UserData(IBlackmagicRawJob* job)
+    {
+        void* userData = nullptr;
+        job->GetUserData(&userData);
+        return static_cast<BrawJob*>(userData);
+    }
+
+    static BrawTrimJob* TrimUserData(IBlackmagicRawJob* job)
+    {
+        void* userData = nullptr;
+        job->GetUserData(&userData);
+        return static_cast<BrawTrimJob*>(userData);
+    }
+
+    // Map (or read back) the image here, on the SDK thread, so completions
+    // only ever see host memory
+    void Complete(BrawJob* job, HRESULT result, IBlackmagicRawProcessedImage* processedImage)
+    {
+        BrawFrameCompletion* completion = job->completion;
+        BrawEncodeOptions encode = job->options.encode;
+        std::shared_ptr<const BrawGrade> grade = job->options.grade;
+        BrawKeyOptions keyOptions = job->options.key;
+        BrawScopeOptions scopes = job->options.scopes;
+        BrawStats& stats = BrawStats::Shared();
+        uint64_t submitted = job->submitted;
+        uint64_t start = 0;
+        size_t decodedBytes = 0;
+        BrawFrameKey key;
+        BrawFrame frame;
+        std::string error;
+
+        // Jobs that failed before decoding have nothing to time
+        if (job->decoding != 0 && processedImage != nullptr)
+            stats.Record(brawStageDecode, job->decoding);
+
+        std::swap(key, job->key);
+        std::swap(error, job->error);
+        delete job;
+
+        if (result == S_OK)
+        {
+            start = stats.Now();
+            result = frame.Attach(processedImage, m_pipeline, error);
+            stats.Record(brawStageCopy, start);
+            decodedBytes = frame.size;
+        }
+        else if (result == E_ABORT)
+            error = "Cancelled";
+        else if (error.empty())
+            error = "Processing error occurred";
+
+        // Cache the decoded pixels before any encode drops them
+        if (result == S_OK && !key.clip.empty())
+            frame.Cache(key);
+
+        if (result == S_OK && grade)
+        {
+            start = stats.Now();
+            result = frame.Grade(*grade, error);
+            stats.Record(brawStageGrade, start);
+        }
+
+        if (result == S_OK && keyOptions.enabled)
+        {
+            start = stats.Now();
+            result = frame.Key(keyOptions, error);
+            stats.Record(brawStageKey, start);
+        }
+
+        if (result == S_OK && scopes.enabled)
+        {
+            start = stats.Now();
+            result = frame.ComputeScopes(scopes, error);
+            stats.Record(brawStageScopes, start);
+        }
+
+        if (result == S_OK && encode.encoding != brawEncodingNone)
+        {
+            start = stats.Now();
+            result = frame.Encode(encode, error);
+            stats.Record(brawStageEncode, start);
+        }
+
+        if (result == S_OK)
+            stats.CountFrame(decodedBytes, frame.encoded.size);
+        else if (result == E_ABORT)
+            stats.CountCancelled();
+        else
+            stats.CountError();
+        stats.Record(brawStageTotal, submitted);
+
+        // Free the slot first, so the next frame decodes while this one is delivered
+        m_clip.JobDone();
+        completion->FrameComplete(result, frame, error);
+    }
+
+    BrawClip& m_clip;
+    BrawPipeline& m_pipeline;
+};
+
+BrawFrame::BrawFrame()
+    : image(nullptr), format(nullptr), width(0), height(0), stride(0), data(nullptr), size(0),
+      m_hostCopy(nullptr)
+{
+}
+
+BrawFrame::~BrawFrame()
+{
+    Reset();
+}
+
+HRESULT BrawFrame::Attach(IBlackmagicRawProcessedImage* processedImage, BrawPipeline& pipeline, std::string& error)
+{
+    Reset();
+
+    if (!processedImage)
+    {
+        error = "No processed image received";
+        return E_FAIL;
+    }
+
+    image = processedImage;
+    image->AddRef();
+
+    image->GetWidth(&width);
+    image->GetHeight(&height);
+
+    // Get resource type
+    BlackmagicRawResourceType resourceType;
+    image->GetResourceType(&resourceType);
+
+    const BrawPipelineType* active = pipeline.Active();
+    bool onDevice = resourceType != blackmagicRawResourceTypeBufferCPU;
+
+    if (onDevice && !(active && resourceType == active->resource_type))
+    {
+        error = "Unexpected resource type";
+        Reset();
+        return E_FAIL;
+    }
+
+    BlackmagicRawResourceFormat resourceFormat;
+    image->GetResourceFormat(&resourceFormat);
+
+    format = FindPixelFormat(resourceFormat);
+    if (!format)
+    {
+        error = "Unsupported resource format";
+        Reset();
+        return E_FAIL;
+    }
+
+    stride = PixelFormatStride(*format, width);
+
+    uint32_t sizeBytes = 0;
+    if (image->GetResourceSizeBytes(&sizeBytes) == S_OK && sizeBytes > 0)
+        size = sizeBytes;
+    else
+        size = PixelFormatImageSize(*format, width, height);
+
+    if (onDevice)
+    {
+        // Copy the GPU buffer to host memory; the image itself is then unneeded
+        m_hostCopy = BrawBufferPool::Shared().Acquire(size);
+        if (!m_hostCopy || pipeline.ReadBack(image, m_hostCopy, static_cast<uint32_t>(size)) != S_OK)
+        {
+            error = "Failed to read back image data";
+            Reset();
+            return E_FAIL;
+        }
+
+        data = m_hostCopy;
+        image->Release();
+        image = nullptr;
+        return S_OK;
+    }
+
+    // Get image data
+    HRESULT result = image->GetResource(&data);
+    if (result != S_OK || !data)
+    {
+        error = "Failed to get image data";
+        Reset();
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+void BrawFrame::Reset()
+{
+    ReleasePixels();
+    encoded.Reset();
+    scopes.Reset();
+    matte.Reset();
+
+    format = nullptr;
+    width = 0;
+    height = 0;
+}
+
+void BrawFrame::ReleasePixels()
+{
+    if (image != nullptr)
+        image->Release();
+    BrawBufferPool::Shared().Release(m_hostCopy);
+
+    image = nullptr;
+    m_hostCopy = nullptr;
+    m_cached.reset();
+    stride = 0;
+    data = nullptr;
+    size = 0;
+}
+
+HRESULT BrawFrame::Encode(const BrawEncodeOptions& options, std::string& error)
+{
+    BrawImageView view = { data, format, width, height, stride };
+
+    if (!EncodeImage(view, options, encoded, error))
+        return E_FAIL;
+
+    ReleasePixels();
+    return S_OK;
+}
+
+HRESULT BrawFrame::Grade(const BrawGrade& grade, std::string& error)
+{
+    if (!CanGrade(*format))
+    {
+        error = std::string("Cannot grade pixel format ") + format->name;
+        return E_FAIL;
+    }
+
+    // Never in place: the pixels may belong to the cache or the SDK
+    void* graded = BrawBufferPool::Shared().Acquire(size);
+    if (!graded)
+    {
+        error = "Out of memory for graded frame";
+        return E_OUTOFMEMORY;
+    }
+
+    BrawImageView view = { data, format, width, height, stride };
+    grade.Apply(view, graded);
+
+    size_t gradedStride = stride;
+    size_t gradedSize = size;
+    ReleasePixels();
+
+    m_hostCopy = graded;
+    stride = gradedStride;
+    data = graded;
+    size = gradedSize;
+    return S_OK;
+}
+
+HRESULT BrawFrame::Key(const BrawKeyOptions& options, std::string& error)
+{
+    BrawImageView view = { data, format, width, height, stride };
+
+    // A host copy is ours to key in place; cache and SDK memory is not
+    if (m_hostCopy || !options.ModifiesPixels(format->channels))
+        return KeyImage(view, data, options, matte, error) ? S_OK : E_FAIL;
+
+    void* keyed = BrawBufferPool::Shared().Acquire(size);
+    if (!keyed)
+    {
+        error = "Out of memory for keyed frame";
+        return E_OUTOFMEMORY;
+    }
+
+    if (!KeyImage(view, keyed, options, matte, error))
+    {
+        BrawBufferPool::Shared().Release(keyed);
+        return E_FAIL;
+    }
+
+    size_t keyedStride = stride;
+    size_t keyedSize = size;
+    ReleasePixels();
+
+    m_hostCopy = keyed;
+    stride = keyedStride;
+    data = keyed;
+    size = keyedSize;
+    return S_OK;
+}
+
+HRESULT BrawFrame::ComputeScopes(const BrawScopeOptions& options, std::string& error)
+{
+    BrawImageView view = { data, format, width, height, stride };
+
+    if (!ComputeImageScopes(view, options, scopes, error))
+        return E_FAIL;
+
+    return S_OK;
+}
+
+bool BrawFrame::Cache(const BrawFrameKey& key)
+{
+    if (!data || IsCached() || !BrawFrameCache::Shared().Enabled())
+        return false;
+
+    // GPU host copies are adopted as they are; SDK memory has to be copied
+    void* pixels = m_hostCopy;
+    if (!pixels)
+    {
+        pixels = BrawBufferPool::Shared().Acquire(size);
+        if (!pixels)
+            return false;
+        memcpy(pixels, data, size);
+    }
+
+    std::shared_ptr<BrawCachedFrame> cached(new BrawCachedFrame(pixels, size, format, width, height, stride));
+    m_hostCopy = nullptr;
+    ReleasePixels();
+
+    BrawFrameCache::Shared().Insert(key, cached);
+
+    m_cached = cached;
+    stride = cached->stride;
+    data = cached->data;
+    size = cached->size;
+    return true;
+}
+
+bool BrawFrame::LoadCached(const BrawFrameKey& key)
+{
+    std::shared_ptr<BrawCachedFrame> cached = BrawFrameCache::Shared().Lookup(key);
+    if (!cached)
+        return false;
+
+    LoadCached(cached);
+    return true;
+}
+
+void BrawFrame::LoadCached(const std::shared_ptr<BrawCachedFrame>& cached)
+{
+    Reset();
+
+    m_cached = cached;
+    format = cached->format;
+    width = cached->width;
+    height = cached->height;
+    stride = cached->stride;
+    data = cached->data;
+    size = cached->size;
+}
+
+std::shared_ptr<BrawCachedFrame>* BrawFrame::DetachCached()
+{
+    std::shared_ptr<BrawCachedFrame>* cached = new std::shared_ptr<BrawCachedFrame>();
+    cached->swap(m_cached);
+    Reset();
+    return cached;
+}
+
+void BrawFrame::Swap(BrawFrame& other)
+{
+    std::swap(image, other.image);
+    std::swap(format, other.format);
+    std::swap(width, other.width);
+    std::swap(height, other.height);
+    std::swap(stride, other.stride);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    std::swap(m_hostCopy, other.m_hostCopy);
+    m_cached.swap(other.m_cached);
+    encoded.Swap(other.encoded);
+    scopes.Swap(other.scopes);
+    matte.Swap(other.matte);
+}
+
+IBlackmagicRawProcessedImage* BrawFrame::Detach()
+{
+    IBlackmagicRawProcessedImage* processedImage = image;
+    image = nullptr;
+    Reset();
+    return processedImage;
+}
+
+void* BrawFrame::DetachHostCopy()
+{
+    void* hostCopy = m_hostCopy;
+    m_hostCopy = nullptr;
+    Reset();
+    return hostCopy;
+}
+
+BrawClip::BrawClip()
+    : m_factory(nullptr), m_codec(nullptr), m_clip(nullptr),
+      m_callback(new BrawClipCallback(*this, m_pipeline)), m_info(),
+      m_maxJobs(kBrawDefaultMaxJobs), m_activeJobs(0)
+{
+}
+
+BrawClip::~BrawClip()
+{
+    Close();
+    delete m_callback;
+}
+
+HRESULT BrawClip::Open(const char* filePath, const BrawOpenOptions& options, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    HRESULT result = S_OK;
+    BrawStats& stats = BrawStats::Shared();
+    uint64_t opening = stats.Now();
+
+    if (m_clip != nullptr)
+    {
+        error = "Clip already open";
+        return E_FAIL;
+    }
+
+    do
+    {
+        uint64_t start = stats.Now();
+        m_factory = AcquireBrawFactory();
+        stats.Record(brawStageFactory, start);
+        if (!m_factory)
+        {
+            error = "Failed to create factory";
+            result = E_FAIL;
+            break;
+        }
+
+        result = m_factory->CreateCodec(&m_codec);
+        if (result != S_OK)
+        {
+            error = "Failed to create codec";
+            break;
+        }
+
+        // The callback must be in place for PreparePipeline to report back
+        result = m_codec->SetCallback(m_callback);
+        if (result != S_OK)
+        {
+            error = "Failed to set callback";
+            break;
+        }
+
+        result = m_pipeline.Configure(m_factory, m_codec, options.pipeline, error);
+        if (result != S_OK)
+            break;
+
+        if (options.cpu_threads > 0 && m_pipeline.Active()->pipeline == blackmagicRawPipelineCPU)
+        {
+            IBlackmagicRawConfiguration* configuration = nullptr;
+
+            result = m_codec->QueryInterface(IID_IBlackmagicRawConfiguration, (LPVOID*)&configuration);
+            if (result == S_OK)
+            {
+                result = configuration->SetCPUThreads(options.cpu_threads);
+                configuration->Release();
+            }
+
+            if (result != S_OK)
+            {
+                error = "Failed to set CPU thread count";
+                break;
+            }
+        }
+
+        result = m_codec->OpenClip(filePath, &m_clip);
+        if (result != S_OK)
+        {
+            error = "Failed to open clip";
+            break;
+        }
+
+        m_clip->GetFrameCount(&m_info.frame_count);
+        m_clip->GetWidth(&m_info.width);
+        m_clip->GetHeight(&m_info.height);
+        m_clip->GetFrameRate(&m_info.frame_rate);
+        m_info.timebase = TimebaseForRate(m_info.frame_rate);
+        m_info.pipeline = m_pipeline.Active()->name;
+        m_maxJobs = options.max_jobs > 0 ? options.max_jobs : 1;
+
+        // A file replaced under the same path must not hit old frames
+        struct stat fileStat;
+        if (stat(filePath, &fileStat) == 0)
+        {
+            std::ostringstream cacheId;
+            cacheId << filePath << '|' << fileStat.st_size << '|' << fileStat.st_mtime;
+            m_cacheId = cacheId.str();
+        }
+
+    } while(0);
+
+    if (result != S_OK)
+    {
+        IBlackmagicRawFactory* factory = m_factory;
+        IBlackmagicRaw* codec = m_codec;
+        IBlackmagicRawClip* clip = m_clip;
+
+        m_factory = nullptr;
+        m_codec = nullptr;
+        m_clip = nullptr;
+
+        Release(factory, codec, clip);
+        m_pipeline.Release();
+    }
+    else
+    {
+        stats.Record(brawStageOpen, opening);
+    }
+
+    return result;
+}
+
+void BrawClip::Close()
+{
+    IBlackmagicRawFactory* factory = nullptr;
+    IBlackmagicRaw* codec = nullptr;
+    IBlackmagicRawClip* clip = nullptr;
+    BrawPipeline pipeline; // Released after the codec that uses its device
+
+    // Detach under the lock so new submissions fail, then flush without it:
+    // SDK callbacks may themselves submit follow-up jobs.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        factory = m_factory;
+        codec = m_codec;
+        clip = m_clip;
+
+        m_factory = nullptr;
+        m_codec = nullptr;
+        m_clip = nullptr;
+        m_info = BrawClipInfo();
+        m_cacheId.clear();
+    }
+
+    Release(factory, codec, clip);
+
+    // Every job has completed; fail the frames still waiting for a slot.
+    // The callback reads the pipeline without the lock until the flush, so
+    // it is only taken now.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_activeJobs = 0;
+        m_pipeline.Swap(pipeline);
+    }
+    StartPending();
+}
+
+void BrawClip::Release(IBlackmagicRawFactory* factory, IBlackmagicRaw* codec, IBlackmagicRawClip* clip)
+{
+    if (codec != nullptr)
+        codec->FlushJobs();
+
+    if (clip != nullptr)
+        clip->Release();
+    if (codec != nullptr)
+        codec->Release();
+    if (factory != nullptr)
+        factory->Release();
+}
+
+HRESULT BrawClip::ReadFrame(uint64_t frameIndex, const BrawDecodeOptions& options, BrawFrame& frame, std::string& error)
+{
+    SyncFrameCompletion completion;
+
+    if (LookupFrame(frameIndex, options, frame))
+        return S_OK;
+
+    frame.Reset();
+
+    HRESULT result = SubmitFrame(frameIndex, options, &completion, error);
+    if (result != S_OK)
+        return result;
+
+    completion.Wait();
+
+    // Check for errors
+    if (completion.result != S_OK)
+    {
+        error = completion.error;
+        return completion.result;
+    }
+
+    frame.Swap(completion.frame);
+    return S_OK;
+}
+
+HRESULT BrawClip::SubmitFrame(uint64_t frameIndex, const BrawDecodeOptions& options,
+                              BrawFrameCompletion* completion, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_clip == nullptr)
+    {
+        error = "Clip is not open";
+        return E_FAIL;
+    }
+
+    // Verify frame index
+    if (frameIndex >= m_info.frame_count)
+    {
+        error = "Frame index out of range";
+        return E_FAIL;
+    }
+
+    // Queue behind frames of the same or higher priority already waiting
+    bool waiting = false;
+    for (int i = 0; i <= options.priority; i++)
+        waiting = waiting || !m_pending[i].empty();
+
+    if (waiting || !CanStartLocked(options.priority))
+    {
+        PendingFrame pending;
+        pending.frame_index = frameIndex;
+        pending.options = options;
+        pending.completion = completion;
+        pending.submitted = BrawStats::Shared().Now();
+        m_pending[options.priority].push_back(pending);
+        return S_OK;
+    }
+
+    HRESULT result = StartFrameLocked(frameIndex, options, completion, BrawStats::Shared().Now(), error);
+    if (result == S_OK)
+        m_activeJobs++;
+
+    return result;
+}
+
+HRESULT BrawClip::SubmitTrim(const char* outputPath, uint64_t firstFrame, uint64_t frameCount,
+                             BrawTrimCompletion* completion, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_clip == nullptr)
+    {
+        error = "Clip is not open";
+        return E_FAIL;
+    }
+
+    if (frameCount == 0 || firstFrame >= m_info.frame_count || frameCount > m_info.frame_count - firstFrame)
+    {
+        error = "Trim range outside the clip";
+        return E_FAIL;
+    }
+
+    // No processing attributes: the new clip keeps the source's own
+    IBlackmagicRawJob* job = nullptr;
+    HRESULT result = m_clip->CreateJobTrim(outputPath, firstFrame, frameCount, nullptr, nullptr, &job);
+    if (result != S_OK)
+    {
+        error = "Failed to create trim job";
+        return result;
+    }
+
+    BrawTrimJob* trim = new BrawTrimJob(completion);
+    result = job->SetUserData(trim);
+    if (result == S_OK)
+        result = job->Submit();
+
+    if (result != S_OK)
+    {
+        delete trim;
+        job->Release();
+        error = "Failed to submit trim job";
+    }
+
+    return result;
+}
+
+bool BrawClip::CanStartLocked(BrawPriority priority) const
+{
+    if (priority == brawPriorityInteractive)
+        return m_activeJobs < m_maxJobs;
+
+    // Keep slots back so a scrub does not wait behind a full queue of export work
+    uint32_t reserved = m_maxJobs > 1 ? std::max<uint32_t>(1, m_maxJobs / 4) : 0;
+    return m_activeJobs + reserved < m_maxJobs;
+}
+
+void BrawClip::JobDone()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_activeJobs > 0)
+            m_activeJobs--;
+    }
+
+    StartPending();
+}
+
+void BrawClip::StartPending()
+{
+    for (;;)
+    {
+        PendingFrame pending;
+        bool open = false;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Lower classes only start once every higher one is empty
+            int priority = 0;
+            while (priority < brawPriorityCount && m_pending[priority].empty())
+                priority++;
+
+            if (priority == brawPriorityCount)
+                return;
+
+            open = m_clip != nullptr;
+            if (open && !CanStartLocked(static_cast<BrawPriority>(priority)))
+                return;
+
+            pending = m_pending[priority].front();
+            m_pending[priority].pop_front();
+
+            // Hold the slot while the completion is asked outside the lock
+            if (open)
+                m_activeJobs++;
+        }
+
+        BrawFrame empty;
+
+        if (!open)
+        {
+            pending.completion->FrameComplete(E_FAIL, empty, "Clip closed");
+            continue;
+        }
+
+        // Frames that waited may no longer be wanted
+        bool cancelled = pending.completion->Cancelled();
+        HRESULT result = E_ABORT;
+        std::string error = "Cancelled";
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (!cancelled && m_clip != nullptr)
+            {
+                error.clear();
+                BrawStats::Shared().Record(brawStageQueue, pending.submitted);
+                result = StartFrameLocked(pending.frame_index, pending.options, pending.completion,
+                                          pending.submitted, error);
+            }
+            else if (!cancelled)
+            {
+                result = E_FAIL;
+                error = "Clip closed";
+            }
+
+            if (result != S_OK && m_activeJobs > 0)
+                m_activeJobs--;
+        }
+
+        if (result != S_OK)
+            pending.completion->FrameComplete(result, empty, error);
+    }
+}
+
+HRESULT BrawClip::StartFrameLocked(uint64_t frameIndex, const BrawDecodeOptions& options,
+                                   BrawFrameCompletion* completion, uint64_t submitted, std::string& error)
+{
+    HRESULT result = S_OK;
+    IBlackmagicRawJob* readJob = nullptr;
+
+    result = m_clip->CreateJobReadFrame(frameIndex, &readJob);
+    if (result != S_OK)
+    {
+        error = "Failed to create read job";
+        return result;
+    }
+
+    BrawJob* job = new BrawJob(completion, options, submitted);
+    job->key = FrameKeyLocked(frameIndex, options);
+
+    if (options.processing)
+    {
+        result = options.processing->ApplyClip(m_clip, &job->clip_attributes, error);
+        if (result != S_OK)
+        {
+            delete job;
+            readJob->Release();
+            return result;
+        }
+    }
+
+    job->started = BrawStats::Shared().Now();
+    result = readJob->SetUserData(job);
+    if (result == S_OK)
+        result = readJob->Submit();
+    if (result != S_OK)
+    {
+        // submit has failed, the ReadComplete callback won't be called
+        delete job;
+        readJob->Release();
+        error = "Failed to submit job";
+        return result;
+    }
+
+    return S_OK;
+}
+
+// Proxies are decoded with the clip's own processing settings
+static std::shared_ptr<BrawProxyStore> MatchingProxies(const BrawDecodeOptions& options)
+{
+    if (!options.proxies || options.processing || !options.proxies->Matches(options.format, options.scale))
+        return std::shared_ptr<BrawProxyStore>();
+    return options.proxies;
+}
+
+bool BrawClip::LookupFrame(uint64_t frameIndex, const BrawDecodeOptions& options, BrawFrame& frame)
+{
+    BrawFrameKey key;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_clip == nullptr || frameIndex >= m_info.frame_count)
+            return false;
+        key = FrameKeyLocked(frameIndex, options);
+    }
+    std::shared_ptr<BrawProxyStore> proxies = MatchingProxies(options);
+
+    if (key.clip.empty() || !frame.LoadCached(key))
+    {
+        std::shared_ptr<BrawCachedFrame> proxy = proxies ? proxies->Lookup(frameIndex) : std::shared_ptr<BrawCachedFrame>();
+        if (!proxy)
+            return false;
+        frame.LoadCached(proxy);
+    }
+
+    // Fall back to a decode, which reports the grade, key, scope or encode error itself
+    std::string error;
+    if ((options.grade && frame.Grade(*options.grade, error) != S_OK) ||
+        (options.key.enabled && frame.Key(options.key, error) != S_OK) ||
+        (options.scopes.enabled && frame.ComputeScopes(options.scopes, error) != S_OK) ||
+        (options.encode.encoding != brawEncodingNone && frame.Encode(options.encode, error) != S_OK))
+    {
+        frame.Reset();
+        return false;
+    }
+
+    return true;
+}
+
+bool BrawClip::IsFrameCached(uint64_t frameIndex, const BrawDecodeOptions& options)
+{
+    BrawFrameKey key;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        key = FrameKeyLocked(frameIndex, options);
+    }
+    std::shared_ptr<BrawProxyStore> proxies = MatchingProxies(options);
+
+    return (!key.clip.empty() && BrawFrameCache::Shared().Contains(key)) ||
+           (proxies && proxies->Contains(frameIndex));
+}
+
+BrawFrameKey BrawClip::FrameKeyLocked(uint64_t frameIndex, const BrawDecodeOptions& options) const
+{
+    BrawFrameKey key;
+
+    if (options.cache && BrawFrameCache::Shared().Enabled())
+    {
+        key.clip = m_cacheId;
+        key.frame_index = frameIndex;
+        key.format = options.format;
+        key.scale = options.scale;
+        if (options.processing)
+            key.processing = options.processing->Key();
+    }
+
+    return key;
+}
+
+HRESULT BrawClip::ReadClipMetadata(BrawClipIndex& index, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_clip == nullptr)
+    {
+        error = "Clip is not open";
+        return E_FAIL;
+    }
+
+    index.frame_count = m_info.frame_count;
+    index.width = m_info.width;
+    index.height = m_info.height;
+    index.frame_rate = m_info.frame_rate;
+
+    const char* cameraType = nullptr;
+    if (m_clip->GetCameraType(&cameraType) == S_OK && cameraType)
+        index.camera_type = cameraType;
+
+    const char* timecode = nullptr;
+    if (m_info.frame_count > 0 && m_clip->GetTimecodeForFrame(0, &timecode) == S_OK && timecode)
+        index.start_timecode = timecode;
+
+    IBlackmagicRawMetadataIterator* iterator = nullptr;
+    HRESULT result = m_clip->GetMetadataIterator(&iterator);
+    if (result != S_OK)
+    {
+        error = "Failed to get clip metadata";
+        return result;
+    }
+
+    ReadMetadataIterator(iterator, index.clip);
+    iterator->Release();
+    return S_OK;
+}
+
+HRESULT BrawClip::GetClipProcessing(BrawProcessing& processing, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_clip == nullptr)
+    {
+        error = "Clip is not open";
+        return E_FAIL;
+    }
+
+    return ReadClipProcessing(m_clip, processing, error);
+}
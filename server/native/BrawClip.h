@@ -0,0 +1,315 @@
+/*
+ * BrawClip - long-lived Blackmagic RAW clip handle
+ *
+ * Owns the factory, codec and clip for one BRAW file so frames and metadata
+ * can be read repeatedly without paying for CreateCodec/OpenClip per call.
+ * Independent of N-API so the addon and the CLI tools can share it.
+ */
+
+#ifndef BRAW_CLIP_H
+#define BRAW_CLIP_H
+
+#include "BlackmagicRawAPI.h"
+#include "BrawEncoder.h"
+#include "BrawFormat.h"
+#include "BrawFrameCache.h"
+#include "BrawGrade.h"
+#include "BrawKey.h"
+#include "BrawMetadata.h"
+#include "BrawPipeline.h"
+#include "BrawProcessing.h"
+#include "BrawProxyStore.h"
+#include "BrawScopes.h"
+#include "BrawStats.h"
+#include "BrawTimebase.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct BrawClipInfo
+{
+    uint64_t frame_count;
+    unsigned int width;
+    unsigned int height;
+    float frame_rate;
+    BrawTimebase timebase; // frame_rate as the exact rational rate
+    const char* pipeline; // Name of the active decode pipeline
+};
+
+// Scheduling class of a decode. Once the clip's job limit is reached,
+// waiting frames start interactive first, then prefetch, then batch.
+enum BrawPriority
+{
+    brawPriorityInteractive,
+    brawPriorityPrefetch,
+    brawPriorityBatch,
+    brawPriorityCount
+};
+
+// Priority for name ("interactive", "prefetch" or "batch"); false if unknown
+bool FindPriority(const char* name, BrawPriority& priority);
+
+const uint32_t kBrawDefaultMaxJobs = 8;
+
+// Codec-wide settings, fixed when the clip is opened
+struct BrawOpenOptions
+{
+    BrawOpenOptions() : pipeline(DefaultPipelineType()), cpu_threads(0), max_jobs(kBrawDefaultMaxJobs) {}
+
+    // Null tries each GPU pipeline before falling back to the CPU
+    const BrawPipelineType* pipeline;
+
+    // Decoder threads on the CPU pipeline; 0 keeps the SDK default
+    uint32_t cpu_threads;
+
+    // Frames handed to the SDK at once. The SDK runs its queue in order, so
+    // later frames wait in the clip's priority queues instead; a quarter of
+    // the slots are kept free of prefetch and batch work.
+    uint32_t max_jobs;
+};
+
+// Per-job decode settings, applied in ReadComplete before decoding
+struct BrawDecodeOptions
+{
+    BrawDecodeOptions()
+        : format(DefaultPixelFormat()), scale(DefaultResolutionScale()), cache(true),
+          priority(brawPriorityInteractive) {}
+
+    const BrawPixelFormat* format;
+    const BrawResolutionScale* scale;
+
+    // Serve from and populate the shared decoded-frame cache
+    bool cache;
+
+    // Queue position while the clip is at its job limit
+    BrawPriority priority;
+
+    // RAW development settings handed to the SDK decode; null keeps the
+    // clip's own. Cached frames are keyed by them.
+    std::shared_ptr<const BrawProcessing> processing;
+
+    // Compress on the SDK thread once processed; the pixels are then dropped
+    BrawEncodeOptions encode;
+
+    // Grade on the SDK thread once cached, so the cache keeps the ungraded frame
+    std::shared_ptr<const BrawGrade> grade;
+
+    // Chroma key the graded pixels on the SDK thread, into their alpha
+    // and/or a separate matte
+    BrawKeyOptions key;
+
+    // Measure the (graded) pixels on the SDK thread, before any encode
+    BrawScopeOptions scopes;
+
+    // Serve matching frames from this store, after the shared cache. Set per
+    // session rather than on the clip, which sessions share.
+    std::shared_ptr<BrawProxyStore> proxies;
+};
+
+// A decoded frame. Holds a reference on the SDK processed image until
+// Reset() or destruction; data points into that image's CPU buffer. Frames
+// from a GPU pipeline are copied to a pooled host buffer instead, and
+// cached frames point into a BrawCachedFrame they share with the cache.
+class BrawFrame
+{
+public:
+    BrawFrame();
+    ~BrawFrame();
+
+    // Take a reference on a processed image and map its CPU buffer, reading
+    // GPU buffers back through pipeline
+    HRESULT Attach(IBlackmagicRawProcessedImage* processedImage, BrawPipeline& pipeline, std::string& error);
+    void Reset();
+    void Swap(BrawFrame& other);
+
+    // Compress the attached pixels into encoded and release them. format,
+    // width and height still describe the decoded image afterwards.
+    HRESULT Encode(const BrawEncodeOptions& options, std::string& error);
+
+    // Replace the pixels with a graded host copy in the same layout
+    HRESULT Grade(const BrawGrade& grade, std::string& error);
+
+    // Key the pixels, despilling and writing alpha in a host copy where
+    // the options change them, and fill matte if requested
+    HRESULT Key(const BrawKeyOptions& options, std::string& error);
+
+    // Fill scopes from the attached pixels, which are left in place
+    HRESULT ComputeScopes(const BrawScopeOptions& options, std::string& error);
+
+    // Move the pixels into the shared cache under key, leaving the frame
+    // pointing at the cached copy. Returns false (frame untouched) when the
+    // cache is disabled or out of memory.
+    bool Cache(const BrawFrameKey& key);
+
+    // Point the frame at a cached copy; returns false on a miss
+    bool LoadCached(const BrawFrameKey& key);
+    void LoadCached(const std::shared_ptr<BrawCachedFrame>& cached);
+
+    // True when data belongs to a cache entry, which must not be modified
+    bool IsCached() const { return m_cached.get() != nullptr; }
+
+    // Give up the frame's cache reference; the caller owns the returned pointer
+    std::shared_ptr<BrawCachedFrame>* DetachCached();
+
+    // True when data is a host copy rather than SDK memory
+    bool HasHostCopy() const { return m_hostCopy != nullptr; }
+
+    // Give up ownership of the image reference; the caller must Release() it
+    IBlackmagicRawProcessedImage* Detach();
+
+    // Give up ownership of the host copy; the caller must release it to
+    // BrawBufferPool
+    void* DetachHostCopy();
+
+    IBlackmagicRawProcessedImage* image;
+    const BrawPixelFormat* format;
+    unsigned int width;
+    unsigned int height;
+    size_t stride; // Bytes per row (per plane row for planar formats)
+    void* data;
+    size_t size;
+    BrawEncodedImage encoded;
+    BrawScopes scopes;
+    BrawMatte matte;
+
+private:
+    void ReleasePixels();
+
+    void* m_hostCopy;
+    std::shared_ptr<BrawCachedFrame> m_cached;
+
+    BrawFrame(const BrawFrame&);
+    BrawFrame& operator=(const BrawFrame&);
+};
+
+// Receives the outcome of a frame submitted with BrawClip::SubmitFrame.
+// Called once, on an SDK thread. On S_OK frame holds the decoded image and
+// the receiver takes it with Swap(); otherwise error says what went wrong.
+class BrawFrameCompletion
+{
+public:
+    virtual ~BrawFrameCompletion() = default;
+    virtual void FrameComplete(HRESULT result, BrawFrame& frame, const std::string& error) = 0;
+
+    // Asked before a queued frame is handed to the SDK, and on an SDK
+    // thread once it has been read. Returning true skips the rest and
+    // completes the job with E_ABORT.
+    virtual bool Cancelled() { return false; }
+
+    // Handed the read frame on an SDK thread, before any decode. Returning
+    // true ends the job there, completing with S_OK and an empty frame, for
+    // callers that only want what the read frame carries.
+    virtual bool FrameRead(IBlackmagicRawFrame*) { return false; }
+};
+
+// Receives the progress and outcome of a trim started with
+// BrawClip::SubmitTrim, on SDK threads. TrimComplete is called once.
+class BrawTrimCompletion
+{
+public:
+    virtual ~BrawTrimCompletion() = default;
+    virtual void TrimComplete(HRESULT result, const std::string& error) = 0;
+
+    // Fraction of the trim written so far, 0 to 1
+    virtual void TrimProgress(float) {}
+
+    // Asked with every progress report; returning true aborts the trim,
+    // which then completes with E_ABORT
+    virtual bool Cancelled() { return false; }
+};
+
+class BrawClipCallback;
+
+class BrawClip
+{
+public:
+    BrawClip();
+    ~BrawClip();
+
+    HRESULT Open(const char* filePath, const BrawOpenOptions& options, std::string& error);
+    HRESULT Open(const char* filePath, std::string& error) { return Open(filePath, BrawOpenOptions(), error); }
+    // Waits for outstanding jobs, then releases the SDK objects.
+    // Must not be called from an SDK callback thread.
+    void Close();
+
+    bool IsOpen() const { return m_clip != nullptr; }
+    const BrawClipInfo& Info() const { return m_info; }
+
+    // Decode one frame, blocking until the SDK has processed it.
+    // Must not be called from an SDK callback thread.
+    HRESULT ReadFrame(uint64_t frameIndex, const BrawDecodeOptions& options, BrawFrame& frame, std::string& error);
+
+    // Queue a read/decode without waiting. On S_OK the completion will be
+    // called exactly once, never before SubmitFrame returns; on failure it is
+    // never called. Safe to call from inside a completion to chain further
+    // jobs. Past the job limit the frame waits for a slot by priority.
+    HRESULT SubmitFrame(uint64_t frameIndex, const BrawDecodeOptions& options,
+                        BrawFrameCompletion* completion, std::string& error);
+
+    // Fill frame from the shared cache without touching the codec, encoding
+    // it if options ask for that. Returns false on a miss; SubmitFrame then
+    // decodes the frame and caches it.
+    bool LookupFrame(uint64_t frameIndex, const BrawDecodeOptions& options, BrawFrame& frame);
+
+    // True when a frame decoded with options is in the shared cache or the
+    // proxy store
+    bool IsFrameCached(uint64_t frameIndex, const BrawDecodeOptions& options);
+
+    // Write frameCount frames from firstFrame to a new clip at outputPath
+    // without decoding them: the SDK copies the compressed frames and the
+    // metadata. On S_OK the completion will be called exactly once; on
+    // failure it is never called. Trims do not take decode job slots.
+    HRESULT SubmitTrim(const char* outputPath, uint64_t firstFrame, uint64_t frameCount,
+                       BrawTrimCompletion* completion, std::string& error);
+
+    // Clip-level part of an index: info, camera type, start timecode and metadata
+    HRESULT ReadClipMetadata(BrawClipIndex& index, std::string& error);
+
+    // The clip processing attributes the SDK decodes with by default, from
+    // the clip's metadata and any sidecar
+    HRESULT GetClipProcessing(BrawProcessing& processing, std::string& error);
+
+private:
+    BrawClip(const BrawClip&);
+    BrawClip& operator=(const BrawClip&);
+
+    static void Release(IBlackmagicRawFactory* factory, IBlackmagicRaw* codec, IBlackmagicRawClip* clip);
+
+    friend class BrawClipCallback;
+
+    struct PendingFrame
+    {
+        uint64_t frame_index;
+        BrawDecodeOptions options;
+        BrawFrameCompletion* completion;
+        uint64_t submitted; // BrawStats clock
+    };
+
+    BrawFrameKey FrameKeyLocked(uint64_t frameIndex, const BrawDecodeOptions& options) const;
+
+    // Whether a frame of priority may take an SDK slot now
+    bool CanStartLocked(BrawPriority priority) const;
+    HRESULT StartFrameLocked(uint64_t frameIndex, const BrawDecodeOptions& options,
+                             BrawFrameCompletion* completion, uint64_t submitted, std::string& error);
+
+    // A job has left the SDK; hand its slot to the next waiting frame
+    void JobDone();
+    // Start waiting frames while slots are free. Must be called without
+    // m_mutex, as it completes cancelled frames.
+    void StartPending();
+
+    IBlackmagicRawFactory* m_factory;
+    IBlackmagicRaw* m_codec;
+    IBlackmagicRawClip* m_clip;
+    BrawClipCallback* m_callback;
+    BrawPipeline m_pipeline;
+    BrawClipInfo m_info;
+    std::string m_cacheId; // Path plus size and mtime, so a replaced file misses
+    uint32_t m_maxJobs;
+    uint32_t m_activeJobs; // Submitted and not yet completed
+    std::deque<PendingFrame> m_pending[brawPriorityCount];
+    std::mutex m_mutex;
+};
+
+#endif // BRAW_CLIP_H
@@ -0,0 +1,96 @@
+/*
+ * BrawClipRegistry - open clips shared across the process
+ */
+
+#include "BrawClipRegistry.h"
+#include <sstream>
+
+BrawClipRegistry& BrawClipRegistry::Shared()
+{
+    static BrawClipRegistry s_registry;
+    return s_registry;
+}
+
+static std::string RegistryKey(const std::string& filePath, const BrawOpenOptions& options)
+{
+    std::ostringstream key;
+    key << filePath << '|' << (options.pipeline ? options.pipeline->name : "auto") << '|'
+        << options.cpu_threads << '|' << options.max_jobs;
+    return key.str();
+}
+
+// The first thread to ask for a key opens it with the lock released, so
+// opens of other files never wait behind it; threads asking for the same
+// key wait for that open and share its result
+std::shared_ptr<BrawClip> BrawClipRegistry::Open(const std::string& filePath, const BrawOpenOptions& options,
+                                                 std::string& error)
+{
+    std::string key = RegistryKey(filePath, options);
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (std::map<std::string, Entry>::iterator it = m_clips.begin(); it != m_clips.end();)
+    {
+        if (!it->second.pending && it->second.clip.expired())
+            it = m_clips.erase(it);
+        else
+            ++it;
+    }
+
+    Entry& entry = m_clips[key];
+    if (entry.pending)
+    {
+        std::shared_ptr<Pending> pending = entry.pending;
+        while (!pending->done)
+            m_opened.wait(lock);
+
+        if (!pending->clip)
+            error = pending->error;
+        return pending->clip;
+    }
+
+    std::shared_ptr<BrawClip> clip = entry.clip.lock();
+    if (clip && clip->IsOpen())
+        return clip;
+
+    std::shared_ptr<Pending> pending = std::make_shared<Pending>();
+    entry.pending = pending;
+    lock.unlock();
+
+    clip = std::make_shared<BrawClip>();
+    if (clip->Open(filePath.c_str(), options, error) != S_OK)
+    {
+        clip.reset();
+        pending->error = error;
+    }
+
+    lock.lock();
+    pending->clip = clip;
+    pending->done = true;
+
+    // A failed open leaves no entry, so the next caller tries again
+    if (clip)
+    {
+        Entry& opened = m_clips[key];
+        opened.clip = clip;
+        opened.pending.reset();
+    }
+    else
+    {
+        m_clips.erase(key);
+    }
+    m_opened.notify_all();
+    return clip;
+}
+
+size_t BrawClipRegistry::Size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t open = 0;
+    for (std::map<std::string, Entry>::iterator it = m_clips.begin(); it != m_clips.end(); ++it)
+    {
+        if (!it->second.clip.expired())
+            open++;
+    }
+    return open;
+}
@@ -0,0 +1,60 @@
+/*
+ * BrawClipRegistry - open clips shared across the process
+ *
+ * Sessions that open the same file with the same codec settings, from the
+ * main thread or any worker_thread, share one BrawClip: one codec, one set
+ * of SDK decode threads and one job limit, instead of a codec per session.
+ * Entries are weak; a clip closes once the last session and request using
+ * it let go.
+ */
+
+#ifndef BRAW_CLIP_REGISTRY_H
+#define BRAW_CLIP_REGISTRY_H
+
+#include "BrawClip.h"
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class BrawClipRegistry
+{
+public:
+    static BrawClipRegistry& Shared();
+
+    // The open clip for filePath and options, opening it if no one has.
+    // Null on failure, with error set.
+    std::shared_ptr<BrawClip> Open(const std::string& filePath, const BrawOpenOptions& options,
+                                   std::string& error);
+
+    // Clips currently open through the registry
+    size_t Size();
+
+private:
+    BrawClipRegistry() {}
+    BrawClipRegistry(const BrawClipRegistry&);
+    BrawClipRegistry& operator=(const BrawClipRegistry&);
+
+    // An open in progress; threads opening the same key wait on it
+    struct Pending
+    {
+        Pending() : done(false) {}
+
+        bool done;
+        std::shared_ptr<BrawClip> clip;
+        std::string error;
+    };
+
+    struct Entry
+    {
+        std::weak_ptr<BrawClip> clip;
+        std::shared_ptr<Pending> pending;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_opened;
+    std::map<std::string, Entry> m_clips;
+};
+
+#endif // BRAW_CLIP_REGISTRY_H
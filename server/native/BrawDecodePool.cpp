@@ -0,0 +1,72 @@
+/*
+ * BrawDecodePool - several codecs on one clip for wide batch decodes
+ */
+
+#include "BrawDecodePool.h"
+#include <thread>
+
+uint32_t BrawDecodePool::DefaultSize()
+{
+    uint32_t threads = std::thread::hardware_concurrency();
+    uint32_t size = threads / kThreadsPerCodec;
+
+    return size > 0 ? size : 1;
+}
+
+BrawDecodePool::BrawDecodePool(std::shared_ptr<BrawClip> clip)
+{
+    m_clips.push_back(clip);
+}
+
+HRESULT BrawDecodePool::Open(const char* filePath, const BrawOpenOptions& options, uint32_t size, std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_clips.empty())
+        return S_OK;
+
+    if (size == 0)
+        size = 1;
+
+    // A lone codec keeps the SDK's own thread count
+    BrawOpenOptions clipOptions = options;
+    if (size > 1 && clipOptions.cpu_threads == 0)
+    {
+        uint32_t threads = std::thread::hardware_concurrency();
+        clipOptions.cpu_threads = threads > size ? threads / size : 1;
+    }
+
+    std::vector<std::shared_ptr<BrawClip> > clips(size);
+    std::vector<HRESULT> results(size, S_OK);
+    std::vector<std::string> errors(size);
+    std::vector<std::thread> openers;
+
+    // Loading the library and opening the clip dominate; overlap them
+    for (uint32_t i = 0; i < size; i++)
+    {
+        clips[i] = std::make_shared<BrawClip>();
+        if (i == 0)
+            continue;
+
+        openers.push_back(std::thread([&, i]() {
+            results[i] = clips[i]->Open(filePath, clipOptions, errors[i]);
+        }));
+    }
+
+    results[0] = clips[0]->Open(filePath, clipOptions, errors[0]);
+
+    for (size_t i = 0; i < openers.size(); i++)
+        openers[i].join();
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (results[i] != S_OK)
+        {
+            error = errors[i];
+            return results[i];
+        }
+    }
+
+    m_clips.swap(clips);
+    return S_OK;
+}
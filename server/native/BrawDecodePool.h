@@ -0,0 +1,51 @@
+/*
+ * BrawDecodePool - several codecs on one clip for wide batch decodes
+ *
+ * One SDK codec stops scaling well long before a large render node runs
+ * out of cores, so batches can be spread over a pool of independently
+ * opened BrawClips. Each pooled codec gets an even share of the CPU
+ * threads. Every clip routes its own results by job user data, so jobs on
+ * different codecs never share state.
+ */
+
+#ifndef BRAW_DECODE_POOL_H
+#define BRAW_DECODE_POOL_H
+
+#include "BrawClip.h"
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class BrawDecodePool
+{
+public:
+    // CPU threads one codec is expected to keep busy
+    static const uint32_t kThreadsPerCodec = 8;
+
+    // Codecs for a pool sized to the machine, at least 1
+    static uint32_t DefaultSize();
+
+    // An empty pool, filled by Open
+    BrawDecodePool() {}
+    // Single-codec pool over an already open clip
+    explicit BrawDecodePool(std::shared_ptr<BrawClip> clip);
+
+    // Open size codecs on filePath in parallel. A no-op once open. On
+    // failure nothing stays open.
+    HRESULT Open(const char* filePath, const BrawOpenOptions& options, uint32_t size, std::string& error);
+
+    // Fixed once Open has returned, so readers need no lock afterwards
+    size_t Size() const { return m_clips.size(); }
+    const std::shared_ptr<BrawClip>& Clip(size_t index) const { return m_clips[index]; }
+
+private:
+    BrawDecodePool(const BrawDecodePool&);
+    BrawDecodePool& operator=(const BrawDecodePool&);
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<BrawClip> > m_clips;
+};
+
+#endif // BRAW_DECODE_POOL_H
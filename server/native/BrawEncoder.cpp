@@ -0,0 +1,208 @@
+/*
+ * BrawEncoder - in-process JPEG/WebP encoding of decoded frames
+ */
+
+#include "BrawEncoder.h"
+#include <turbojpeg.h>
+#include <webp/encode.h>
+#include <cstring>
+#include <utility>
+
+bool FindEncoding(const char* name, BrawEncoding& encoding)
+{
+    if (strcmp(name, "none") == 0)
+        encoding = brawEncodingNone;
+    else if (strcmp(name, "jpeg") == 0)
+        encoding = brawEncodingJPEG;
+    else if (strcmp(name, "webp") == 0)
+        encoding = brawEncodingWebP;
+    else
+        return false;
+
+    return true;
+}
+
+bool FindChromaSubsampling(const char* name, BrawChromaSubsampling& subsampling)
+{
+    if (strcmp(name, "444") == 0)
+        subsampling = brawChroma444;
+    else if (strcmp(name, "422") == 0)
+        subsampling = brawChroma422;
+    else if (strcmp(name, "420") == 0)
+        subsampling = brawChroma420;
+    else if (strcmp(name, "gray") == 0)
+        subsampling = brawChromaGray;
+    else
+        return false;
+
+    return true;
+}
+
+const char* EncodingName(BrawEncoding encoding)
+{
+    switch (encoding)
+    {
+        case brawEncodingJPEG:
+            return "jpeg";
+        case brawEncodingWebP:
+            return "webp";
+        default:
+            return "none";
+    }
+}
+
+bool FindEncodingForPath(const char* path, BrawEncoding& encoding)
+{
+    static const struct { const char* extension; BrawEncoding encoding; } s_extensions[] = {
+        { ".jpg",  brawEncodingJPEG },
+        { ".jpeg", brawEncodingJPEG },
+        { ".webp", brawEncodingWebP },
+    };
+
+    size_t pathLength = strlen(path);
+
+    for (size_t i = 0; i < sizeof(s_extensions) / sizeof(s_extensions[0]); i++)
+    {
+        size_t extensionLength = strlen(s_extensions[i].extension);
+        if (pathLength >= extensionLength &&
+            strcmp(path + pathLength - extensionLength, s_extensions[i].extension) == 0)
+        {
+            encoding = s_extensions[i].encoding;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+BrawEncodedImage::BrawEncodedImage()
+    : encoding(brawEncodingNone), data(nullptr), size(0)
+{
+}
+
+BrawEncodedImage::~BrawEncodedImage()
+{
+    Reset();
+}
+
+void BrawEncodedImage::Reset()
+{
+    if (data != nullptr)
+    {
+        if (encoding == brawEncodingJPEG)
+            tjFree(data);
+        else if (encoding == brawEncodingWebP)
+            WebPFree(data);
+    }
+
+    encoding = brawEncodingNone;
+    data = nullptr;
+    size = 0;
+}
+
+void BrawEncodedImage::Swap(BrawEncodedImage& other)
+{
+    std::swap(encoding, other.encoding);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+}
+
+static bool EncodeJPEG(const BrawImageView& image, const BrawEncodeOptions& options,
+                       BrawEncodedImage& encoded, std::string& error)
+{
+    static const int s_subsampling[] = { TJSAMP_444, TJSAMP_422, TJSAMP_420, TJSAMP_GRAY };
+
+    int pixelFormat = image.format->channels == 3 ? TJPF_RGB :
+                      PixelFormatRedIndex(*image.format) == 0 ? TJPF_RGBX : TJPF_BGRX;
+
+    tjhandle compressor = tjInitCompress();
+    if (!compressor)
+    {
+        error = "Failed to create JPEG compressor";
+        return false;
+    }
+
+    unsigned char* jpeg = nullptr;
+    unsigned long jpegSize = 0;
+
+    int result = tjCompress2(compressor, static_cast<const unsigned char*>(image.data),
+                             static_cast<int>(image.width), static_cast<int>(image.stride),
+                             static_cast<int>(image.height), pixelFormat, &jpeg, &jpegSize,
+                             s_subsampling[options.subsampling], options.quality, TJFLAG_FASTDCT);
+
+    if (result != 0)
+    {
+        error = std::string("JPEG encoding failed: ") + tjGetErrorStr2(compressor);
+        tjFree(jpeg);
+        tjDestroy(compressor);
+        return false;
+    }
+
+    tjDestroy(compressor);
+
+    encoded.Reset();
+    encoded.encoding = brawEncodingJPEG;
+    encoded.data = jpeg;
+    encoded.size = jpegSize;
+    return true;
+}
+
+static bool EncodeWebP(const BrawImageView& image, const BrawEncodeOptions& options,
+                       BrawEncodedImage& encoded, std::string& error)
+{
+    const uint8_t* pixels = static_cast<const uint8_t*>(image.data);
+    int stride = static_cast<int>(image.stride);
+    bool bgra = PixelFormatRedIndex(*image.format) != 0;
+    uint8_t* webp = nullptr;
+    size_t webpSize = 0;
+
+    // libwebp drops the alpha plane by itself when every pixel is opaque
+    if (image.format->channels == 3)
+        webpSize = WebPEncodeRGB(pixels, image.width, image.height, stride, options.quality, &webp);
+    else if (bgra)
+        webpSize = WebPEncodeBGRA(pixels, image.width, image.height, stride, options.quality, &webp);
+    else
+        webpSize = WebPEncodeRGBA(pixels, image.width, image.height, stride, options.quality, &webp);
+
+    if (webpSize == 0)
+    {
+        error = "WebP encoding failed";
+        WebPFree(webp);
+        return false;
+    }
+
+    encoded.Reset();
+    encoded.encoding = brawEncodingWebP;
+    encoded.data = webp;
+    encoded.size = webpSize;
+    return true;
+}
+
+bool EncodeImage(const BrawImageView& image, const BrawEncodeOptions& options,
+                 BrawEncodedImage& encoded, std::string& error)
+{
+    const BrawPixelFormat& format = *image.format;
+
+    if (format.planar || format.bytes_per_sample != 1 || format.channels < 3)
+    {
+        error = std::string("Cannot encode pixel format ") + format.name + "; use rgba8 or bgra8";
+        return false;
+    }
+
+    if (options.quality < 1 || options.quality > 100)
+    {
+        error = "Quality must be between 1 and 100";
+        return false;
+    }
+
+    switch (options.encoding)
+    {
+        case brawEncodingJPEG:
+            return EncodeJPEG(image, options, encoded, error);
+        case brawEncodingWebP:
+            return EncodeWebP(image, options, encoded, error);
+        default:
+            error = "No encoding requested";
+            return false;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * BrawEncoder - in-process JPEG/WebP encoding of decoded frames
+ *
+ * Compresses straight from the SDK's processed image buffer with
+ * libjpeg-turbo or libwebp, so a preview needs no intermediate full-size
+ * copy, sharp pass or ffmpeg process. Needs -lturbojpeg -lwebp.
+ */
+
+#ifndef BRAW_ENCODER_H
+#define BRAW_ENCODER_H
+
+#include "BrawImageWriter.h"
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+enum BrawEncoding
+{
+    brawEncodingNone,
+    brawEncodingJPEG,
+    brawEncodingWebP,
+};
+
+// JPEG chroma subsampling; WebP lossy is always 4:2:0
+enum BrawChromaSubsampling
+{
+    brawChroma444,
+    brawChroma422,
+    brawChroma420,
+    brawChromaGray,
+};
+
+struct BrawEncodeOptions
+{
+    BrawEncodeOptions() : encoding(brawEncodingNone), quality(90), subsampling(brawChroma420) {}
+
+    BrawEncoding encoding;
+    int quality; // 1-100
+    BrawChromaSubsampling subsampling;
+};
+
+// Name lookups shared by the addon and CLI; return false for unknown names
+bool FindEncoding(const char* name, BrawEncoding& encoding);
+bool FindChromaSubsampling(const char* name, BrawChromaSubsampling& subsampling);
+const char* EncodingName(BrawEncoding encoding);
+
+// Pick the encoding from a .jpg/.jpeg/.webp output path
+bool FindEncodingForPath(const char* path, BrawEncoding& encoding);
+
+// Compressed output, in memory owned by the encoding library
+class BrawEncodedImage
+{
+public:
+    BrawEncodedImage();
+    ~BrawEncodedImage();
+
+    void Reset();
+    void Swap(BrawEncodedImage& other);
+
+    BrawEncoding encoding;
+    uint8_t* data;
+    size_t size;
+
+private:
+    BrawEncodedImage(const BrawEncodedImage&);
+    BrawEncodedImage& operator=(const BrawEncodedImage&);
+};
+
+// Encode an 8-bit interleaved image. Safe to call from any thread.
+bool EncodeImage(const BrawImageView& image, const BrawEncodeOptions& options,
+                 BrawEncodedImage& encoded, std::string& error);
+
+#endif // BRAW_ENCODER_H
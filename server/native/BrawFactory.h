@@ -0,0 +1,49 @@
+/*
+ * BrawFactory - one SDK factory per process
+ *
+ * Creating a factory per clip repeats the library lookup on every open, so
+ * the addon, the codec pool and the CLI tools all take references to a
+ * single factory created on first use. It is never destroyed; codecs made
+ * from it may be released on SDK threads at any time up to exit. Header-only
+ * so the standalone extractors can use it without extra sources.
+ */
+
+#ifndef BRAW_FACTORY_H
+#define BRAW_FACTORY_H
+
+#include "BlackmagicRawAPI.h"
+#include <atomic>
+#include <mutex>
+
+// Where the SDK library is installed
+#define kBrawLibraryPath "/usr/local/lib"
+
+// A new reference to the shared factory, or nullptr when the SDK cannot be
+// loaded. Callers Release it as usual. Lock-free after the first success; a
+// failed load is retried by the next caller.
+inline IBlackmagicRawFactory* AcquireBrawFactory()
+{
+    static std::atomic<IBlackmagicRawFactory*> s_factory(nullptr);
+    static std::mutex s_mutex;
+
+    IBlackmagicRawFactory* factory = s_factory.load(std::memory_order_acquire);
+    if (factory == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        factory = s_factory.load(std::memory_order_relaxed);
+        if (factory == nullptr)
+        {
+            factory = CreateBlackmagicRawFactoryInstanceFromPath(kBrawLibraryPath);
+            if (factory == nullptr)
+                return nullptr;
+
+            s_factory.store(factory, std::memory_order_release);
+        }
+    }
+
+    factory->AddRef();
+    return factory;
+}
+
+#endif // BRAW_FACTORY_H
@@ -0,0 +1,149 @@
+/*
+ * BrawFormat - SDK resource formats and decode scales exposed to callers
+ *
+ * Maps the names used by the addon and CLI tools to SDK resource formats
+ * and resolution scales, and describes their memory layout. Header-only so the standalone
+ * extractors can use it without extra sources.
+ */
+
+#ifndef BRAW_FORMAT_H
+#define BRAW_FORMAT_H
+
+#include "BlackmagicRawAPI.h"
+#include <cstddef>
+#include <cstring>
+
+struct BrawPixelFormat
+{
+    const char* name;
+    BlackmagicRawResourceFormat resource_format;
+    unsigned int channels;
+    unsigned int bytes_per_sample;
+    bool planar;
+    const char* sample_type; // "uint8", "uint16", "float16" or "float32"
+    const char* channel_order;
+};
+
+// The SDK offers 4-channel float output in BGRA order only
+inline const BrawPixelFormat* BrawPixelFormats(size_t& count)
+{
+    static const BrawPixelFormat s_formats[] = {
+        { "rgba8",        blackmagicRawResourceFormatRGBAU8,        4, 1, false, "uint8",   "RGBA" },
+        { "bgra8",        blackmagicRawResourceFormatBGRAU8,        4, 1, false, "uint8",   "BGRA" },
+        { "rgb16",        blackmagicRawResourceFormatRGBU16,        3, 2, false, "uint16",  "RGB"  },
+        { "rgba16",       blackmagicRawResourceFormatRGBAU16,       4, 2, false, "uint16",  "RGBA" },
+        { "bgra16",       blackmagicRawResourceFormatBGRAU16,       4, 2, false, "uint16",  "BGRA" },
+        { "rgb16planar",  blackmagicRawResourceFormatRGBU16Planar,  3, 2, true,  "uint16",  "RGB"  },
+        { "rgbf16",       blackmagicRawResourceFormatRGBF16,        3, 2, false, "float16", "RGB"  },
+        { "bgraf16",      blackmagicRawResourceFormatBGRAF16,       4, 2, false, "float16", "BGRA" },
+        { "rgbf16planar", blackmagicRawResourceFormatRGBF16Planar,  3, 2, true,  "float16", "RGB"  },
+        { "rgbf32",       blackmagicRawResourceFormatRGBF32,        3, 4, false, "float32", "RGB"  },
+        { "bgraf32",      blackmagicRawResourceFormatBGRAF32,       4, 4, false, "float32", "BGRA" },
+        { "rgbf32planar", blackmagicRawResourceFormatRGBF32Planar,  3, 4, true,  "float32", "RGB"  },
+    };
+
+    count = sizeof(s_formats) / sizeof(s_formats[0]);
+    return s_formats;
+}
+
+inline const BrawPixelFormat* FindPixelFormat(const char* name)
+{
+    size_t count = 0;
+    const BrawPixelFormat* formats = BrawPixelFormats(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(formats[i].name, name) == 0)
+            return &formats[i];
+    }
+
+    return nullptr;
+}
+
+inline const BrawPixelFormat* FindPixelFormat(BlackmagicRawResourceFormat resourceFormat)
+{
+    size_t count = 0;
+    const BrawPixelFormat* formats = BrawPixelFormats(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (formats[i].resource_format == resourceFormat)
+            return &formats[i];
+    }
+
+    return nullptr;
+}
+
+// Interleaved 8/16-bit RGB(A) layouts, the ones PPM/BMP style writers accept
+inline bool IsIntegerInterleaved(const BrawPixelFormat& format)
+{
+    return !format.planar && format.channels >= 3 &&
+           (strcmp(format.sample_type, "uint8") == 0 || strcmp(format.sample_type, "uint16") == 0);
+}
+
+// Offset of red within a pixel, in samples
+inline unsigned int PixelFormatRedIndex(const BrawPixelFormat& format)
+{
+    return format.channel_order[0] == 'B' ? 2 : 0;
+}
+
+inline const BrawPixelFormat* DefaultPixelFormat()
+{
+    return FindPixelFormat(blackmagicRawResourceFormatRGBAU8);
+}
+
+// Bytes per row; for planar formats, bytes per row of a single plane
+inline size_t PixelFormatStride(const BrawPixelFormat& format, unsigned int width)
+{
+    size_t samplesPerRow = format.planar ? width : static_cast<size_t>(width) * format.channels;
+    return samplesPerRow * format.bytes_per_sample;
+}
+
+inline size_t PixelFormatImageSize(const BrawPixelFormat& format, unsigned int width, unsigned int height)
+{
+    size_t planes = format.planar ? format.channels : 1;
+    return PixelFormatStride(format, width) * height * planes;
+}
+
+struct BrawResolutionScale
+{
+    const char* name;
+    BlackmagicRawResolutionScale scale;
+    unsigned int divisor; // Output is width / divisor by height / divisor
+};
+
+// Reduced scales decode only part of the wavelet data, so they are much
+// cheaper than a full decode followed by a downscale
+inline const BrawResolutionScale* BrawResolutionScales(size_t& count)
+{
+    static const BrawResolutionScale s_scales[] = {
+        { "full",    blackmagicRawResolutionScaleFull,    1 },
+        { "half",    blackmagicRawResolutionScaleHalf,    2 },
+        { "quarter", blackmagicRawResolutionScaleQuarter, 4 },
+        { "eighth",  blackmagicRawResolutionScaleEighth,  8 },
+    };
+
+    count = sizeof(s_scales) / sizeof(s_scales[0]);
+    return s_scales;
+}
+
+inline const BrawResolutionScale* FindResolutionScale(const char* name)
+{
+    size_t count = 0;
+    const BrawResolutionScale* scales = BrawResolutionScales(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(scales[i].name, name) == 0)
+            return &scales[i];
+    }
+
+    return nullptr;
+}
+
+inline const BrawResolutionScale* DefaultResolutionScale()
+{
+    return FindResolutionScale("full");
+}
+
+#endif // BRAW_FORMAT_H
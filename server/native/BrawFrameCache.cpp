@@ -0,0 +1,139 @@
+/*
+ * BrawFrameCache - process-wide cache of decoded frames
+ */
+
+#include "BrawFrameCache.h"
+#include "BrawBufferPool.h"
+#include <cstdlib>
+#include <functional>
+
+size_t BrawFrameKeyHash::operator()(const BrawFrameKey& key) const
+{
+    size_t hash = std::hash<std::string>()(key.clip);
+
+    hash ^= std::hash<uint64_t>()(key.frame_index) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<const void*>()(key.format) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<const void*>()(key.scale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<std::string>()(key.processing) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+BrawCachedFrame::BrawCachedFrame(void* pixels, size_t pixelsSize, const BrawPixelFormat* pixelFormat,
+                                 uint32_t frameWidth, uint32_t frameHeight, size_t frameStride)
+    : format(pixelFormat), width(frameWidth), height(frameHeight), stride(frameStride),
+      data(pixels), size(pixelsSize)
+{
+}
+
+BrawCachedFrame::BrawCachedFrame(const std::shared_ptr<const void>& owner, const void* pixels, size_t pixelsSize,
+                                 const BrawPixelFormat* pixelFormat, uint32_t frameWidth, uint32_t frameHeight,
+                                 size_t frameStride)
+    : format(pixelFormat), width(frameWidth), height(frameHeight), stride(frameStride),
+      data(const_cast<void*>(pixels)), size(pixelsSize), m_owner(owner)
+{
+}
+
+BrawCachedFrame::~BrawCachedFrame()
+{
+    if (!m_owner)
+        BrawBufferPool::Shared().Release(data);
+}
+
+BrawFrameCache& BrawFrameCache::Shared()
+{
+    static BrawFrameCache s_cache;
+    return s_cache;
+}
+
+BrawFrameCache::BrawFrameCache()
+    : m_bytes(0), m_maxBytes(kDefaultMaxBytes), m_hits(0), m_misses(0), m_evictions(0)
+{
+}
+
+void BrawFrameCache::SetMaxBytes(size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_maxBytes = maxBytes;
+    EvictLocked(m_maxBytes);
+}
+
+bool BrawFrameCache::Enabled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_maxBytes > 0;
+}
+
+std::shared_ptr<BrawCachedFrame> BrawFrameCache::Lookup(const BrawFrameKey& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto found = m_index.find(key);
+    if (found == m_index.end())
+    {
+        m_misses++;
+        return std::shared_ptr<BrawCachedFrame>();
+    }
+
+    m_hits++;
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    return found->second->second;
+}
+
+bool BrawFrameCache::Contains(const BrawFrameKey& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_index.find(key) != m_index.end();
+}
+
+void BrawFrameCache::Insert(const BrawFrameKey& key, const std::shared_ptr<BrawCachedFrame>& frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (key.clip.empty() || frame->size > m_maxBytes)
+        return;
+
+    // Two jobs may decode the same frame concurrently; keep the first
+    if (m_index.find(key) != m_index.end())
+        return;
+
+    EvictLocked(m_maxBytes - frame->size);
+
+    m_entries.push_front(Entry(key, frame));
+    m_index[key] = m_entries.begin();
+    m_bytes += frame->size;
+}
+
+void BrawFrameCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EvictLocked(0);
+}
+
+BrawFrameCacheStats BrawFrameCache::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    BrawFrameCacheStats stats;
+    stats.entries = m_entries.size();
+    stats.bytes = m_bytes;
+    stats.max_bytes = m_maxBytes;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    return stats;
+}
+
+// Drop least recently used entries until at most maxBytes remain
+void BrawFrameCache::EvictLocked(size_t maxBytes)
+{
+    while (m_bytes > maxBytes && !m_entries.empty())
+    {
+        Entry& entry = m_entries.back();
+
+        m_bytes -= entry.second->size;
+        m_index.erase(entry.first);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
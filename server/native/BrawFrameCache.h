@@ -0,0 +1,121 @@
+/*
+ * BrawFrameCache - process-wide cache of decoded frames
+ *
+ * Decoded pixels are kept off the V8 heap, keyed by clip file, frame index,
+ * pixel format and decode scale, under a byte budget with LRU eviction.
+ * Entries are shared: a hit hands out a reference rather than a copy, and an
+ * evicted entry is freed once the last reference (e.g. a JS Buffer) is gone.
+ */
+
+#ifndef BRAW_FRAME_CACHE_H
+#define BRAW_FRAME_CACHE_H
+
+#include "BrawFormat.h"
+#include <stdint.h>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct BrawFrameKey
+{
+    BrawFrameKey() : frame_index(0), format(nullptr), scale(nullptr) {}
+
+    std::string clip; // File identity from BrawClip, empty when uncacheable
+    uint64_t frame_index;
+    const BrawPixelFormat* format;
+    const BrawResolutionScale* scale;
+    std::string processing; // BrawProcessing::Key(), empty for the clip's own settings
+
+    bool operator==(const BrawFrameKey& other) const
+    {
+        return frame_index == other.frame_index && format == other.format &&
+               scale == other.scale && clip == other.clip && processing == other.processing;
+    }
+};
+
+struct BrawFrameKeyHash
+{
+    size_t operator()(const BrawFrameKey& key) const;
+};
+
+// Decoded pixels owned by the cache. Read-only once inserted.
+class BrawCachedFrame
+{
+public:
+    // Takes ownership of data from BrawBufferPool
+    BrawCachedFrame(void* pixels, size_t pixelsSize, const BrawPixelFormat* pixelFormat,
+                    uint32_t frameWidth, uint32_t frameHeight, size_t frameStride);
+    // Borrows data, which owner keeps alive (a mapped proxy store)
+    BrawCachedFrame(const std::shared_ptr<const void>& owner, const void* pixels, size_t pixelsSize,
+                    const BrawPixelFormat* pixelFormat, uint32_t frameWidth, uint32_t frameHeight,
+                    size_t frameStride);
+    ~BrawCachedFrame();
+
+    const BrawPixelFormat* format;
+    uint32_t width;
+    uint32_t height;
+    size_t stride;
+    void* data;
+    size_t size;
+
+private:
+    std::shared_ptr<const void> m_owner;
+
+    BrawCachedFrame(const BrawCachedFrame&);
+    BrawCachedFrame& operator=(const BrawCachedFrame&);
+};
+
+struct BrawFrameCacheStats
+{
+    size_t entries;
+    size_t bytes;
+    size_t max_bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+class BrawFrameCache
+{
+public:
+    static const size_t kDefaultMaxBytes = 512 * 1024 * 1024;
+
+    static BrawFrameCache& Shared();
+
+    // A budget of 0 disables the cache and drops every entry
+    void SetMaxBytes(size_t maxBytes);
+    bool Enabled();
+
+    std::shared_ptr<BrawCachedFrame> Lookup(const BrawFrameKey& key);
+    // Membership test that leaves the LRU order and hit counters alone
+    bool Contains(const BrawFrameKey& key);
+    // Frames larger than the whole budget are not kept
+    void Insert(const BrawFrameKey& key, const std::shared_ptr<BrawCachedFrame>& frame);
+    void Clear();
+
+    BrawFrameCacheStats Stats();
+
+private:
+    BrawFrameCache();
+    BrawFrameCache(const BrawFrameCache&);
+    BrawFrameCache& operator=(const BrawFrameCache&);
+
+    typedef std::pair<BrawFrameKey, std::shared_ptr<BrawCachedFrame> > Entry;
+    typedef std::list<Entry> EntryList;
+
+    void EvictLocked(size_t maxBytes);
+
+    std::mutex m_mutex;
+    EntryList m_entries; // Most recently used first
+    std::unordered_map<BrawFrameKey, EntryList::iterator, BrawFrameKeyHash> m_index;
+    size_t m_bytes;
+    size_t m_maxBytes;
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_evictions;
+};
+
+#endif // BRAW_FRAME_CACHE_H
@@ -0,0 +1,556 @@
+/*
+ * BrawGrade - native colour grading of decoded frames
+ */
+
+#include "BrawGrade.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Distinct LUT files kept loaded; the whole cache is dropped past this
+static const size_t kMaxCachedLuts = 32;
+
+namespace
+{
+
+// Four floats, one lattice entry or one working pixel
+#if defined(__SSE2__)
+typedef __m128 Vec4;
+inline Vec4 Load(const float* p) { return _mm_loadu_ps(p); }
+inline Vec4 LoadAligned(const float* p) { return _mm_load_ps(p); }
+inline void Store(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+inline Vec4 Splat(float value) { return _mm_set1_ps(value); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+#elif defined(__ARM_NEON)
+typedef float32x4_t Vec4;
+inline Vec4 Load(const float* p) { return vld1q_f32(p); }
+inline Vec4 LoadAligned(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, Vec4 v) { vst1q_f32(p, v); }
+inline Vec4 Splat(float value) { return vdupq_n_f32(value); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+#else
+struct Vec4
+{
+    float v[4];
+};
+inline Vec4 Load(const float* p) { Vec4 r = { { p[0], p[1], p[2], p[3] } }; return r; }
+inline Vec4 LoadAligned(const float* p) { return Load(p); }
+inline void Store(float* p, Vec4 v) { for (int i = 0; i < 4; i++) p[i] = v.v[i]; }
+inline Vec4 Splat(float value) { Vec4 r = { { value, value, value, value } }; return r; }
+inline Vec4 Add(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline Vec4 Sub(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline Vec4 Mul(Vec4 a, Vec4 b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+#endif
+
+// a + t * (b - a)
+inline Vec4 Step(Vec4 a, Vec4 from, Vec4 to, float t)
+{
+    return Add(a, Mul(Splat(t), Sub(to, from)));
+}
+
+inline float Clamp01(float value)
+{
+    return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+inline float SmoothStep(float edge0, float edge1, float x)
+{
+    float t = Clamp01((x - edge0) / (edge1 - edge0));
+    return t * t * (3.0f - 2.0f * t);
+}
+
+inline float Fract(float x)
+{
+    return x - std::floor(x);
+}
+
+// rgb2hsv/hsv2rgb exactly as the shader writes them, so results match
+void RgbToHsv(const float* c, float* hsv)
+{
+    float p[4];
+    if (c[1] >= c[2]) {
+        p[0] = c[1]; p[1] = c[2]; p[2] = 0.0f; p[3] = -1.0f / 3.0f;
+    } else {
+        p[0] = c[2]; p[1] = c[1]; p[2] = -1.0f; p[3] = 2.0f / 3.0f;
+    }
+
+    float q[4];
+    if (c[0] >= p[0]) {
+        q[0] = c[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[0];
+    } else {
+        q[0] = p[0]; q[1] = p[1]; q[2] = p[3]; q[3] = c[0];
+    }
+
+    float d = q[0] - std::min(q[3], q[1]);
+    float e = 1.0e-10f;
+    hsv[0] = std::fabs(q[2] + (q[3] - q[1]) / (6.0f * d + e));
+    hsv[1] = d / (q[0] + e);
+    hsv[2] = q[0];
+}
+
+void HsvToRgb(const float* hsv, float* c)
+{
+    static const float K[3] = { 1.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    for (int i = 0; i < 3; i++)
+    {
+        float p = std::fabs(Fract(hsv[0] + K[i]) * 6.0f - 3.0f);
+        c[i] = hsv[2] * (1.0f + hsv[1] * (Clamp01(p - 1.0f) - 1.0f));
+    }
+}
+
+// primaryColorShader's main(), minus the texture fetch. exposure is
+// pow(2, node.exposure), worked out once per row.
+void ApplyPrimary(const BrawGradeNode& node, float exposure, float* c)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        float value = c[i] * exposure;
+        value = value + node.lift[i] * (1.0f - value);
+        // The shader's exponent blows up at gamma -1; stop just short of it
+        value = std::pow(std::max(value, 0.0f), 1.0f / std::max(node.gamma[i] + 1.0f, 1.0e-3f));
+        value = value * (1.0f + node.gain[i]) + node.offset[i];
+        c[i] = (value - 0.5f) * (1.0f + node.contrast) + 0.5f;
+    }
+
+    c[0] += node.temperature * 0.1f;
+    c[2] -= node.temperature * 0.1f;
+    c[1] += node.tint * 0.1f;
+
+    float luminance = 0.299f * c[0] + 0.587f * c[1] + 0.114f * c[2];
+    float shadowMask = 1.0f - SmoothStep(0.0f, 0.5f, luminance);
+    float highlightMask = SmoothStep(0.5f, 1.0f, luminance);
+    for (int i = 0; i < 3; i++)
+    {
+        c[i] += shadowMask * node.shadows * 0.1f + highlightMask * node.highlights * 0.1f;
+        c[i] = (c[i] - node.blacks * 0.1f) / (1.0f - node.blacks * 0.1f);
+        c[i] = c[i] / (1.0f + node.whites * 0.1f);
+    }
+
+    float hsv[3];
+    RgbToHsv(c, hsv);
+    hsv[1] *= 1.0f + node.saturation;
+    hsv[0] = Fract(hsv[0] + node.hue / 360.0f);
+    HsvToRgb(hsv, c);
+
+    for (int i = 0; i < 3; i++)
+        c[i] = Clamp01(c[i]);
+}
+
+// Read one row into RGBx floats in [0, 1]
+void LoadRow(const void* srcRow, const BrawPixelFormat& format, unsigned int width, float* row)
+{
+    unsigned int channels = format.channels;
+    unsigned int red = PixelFormatRedIndex(format);
+    unsigned int blue = 2 - red;
+
+    if (format.bytes_per_sample == 2)
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(srcRow);
+        const float scale = 1.0f / 65535.0f;
+        for (unsigned int x = 0; x < width; x++, src += channels, row += 4)
+        {
+            row[0] = src[red] * scale;
+            row[1] = src[1] * scale;
+            row[2] = src[blue] * scale;
+        }
+    }
+    else
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(srcRow);
+        const float scale = 1.0f / 255.0f;
+        for (unsigned int x = 0; x < width; x++, src += channels, row += 4)
+        {
+            row[0] = src[red] * scale;
+            row[1] = src[1] * scale;
+            row[2] = src[blue] * scale;
+        }
+    }
+}
+
+// Write RGBx floats back, copying alpha from the source row
+void StoreRow(const float* row, const BrawPixelFormat& format, unsigned int width, const void* srcRow, void* dstRow)
+{
+    unsigned int channels = format.channels;
+    unsigned int red = PixelFormatRedIndex(format);
+    unsigned int blue = 2 - red;
+
+    if (format.bytes_per_sample == 2)
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(srcRow);
+        uint16_t* dst = static_cast<uint16_t*>(dstRow);
+        for (unsigned int x = 0; x < width; x++, src += channels, dst += channels, row += 4)
+        {
+            dst[red] = static_cast<uint16_t>(Clamp01(row[0]) * 65535.0f + 0.5f);
+            dst[1] = static_cast<uint16_t>(Clamp01(row[1]) * 65535.0f + 0.5f);
+            dst[blue] = static_cast<uint16_t>(Clamp01(row[2]) * 65535.0f + 0.5f);
+            if (channels == 4)
+                dst[3] = src[3];
+        }
+    }
+    else
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(srcRow);
+        uint8_t* dst = static_cast<uint8_t*>(dstRow);
+        for (unsigned int x = 0; x < width; x++, src += channels, dst += channels, row += 4)
+        {
+            dst[red] = static_cast<uint8_t>(Clamp01(row[0]) * 255.0f + 0.5f);
+            dst[1] = static_cast<uint8_t>(Clamp01(row[1]) * 255.0f + 0.5f);
+            dst[blue] = static_cast<uint8_t>(Clamp01(row[2]) * 255.0f + 0.5f);
+            if (channels == 4)
+                dst[3] = src[3];
+        }
+    }
+}
+
+// Skip whitespace and read the next float, advancing text
+bool ReadFloat(const char*& text, const char* end, float& value)
+{
+    while (text < end && (*text == ' ' || *text == '\t'))
+        text++;
+
+    char* parsed = nullptr;
+    value = strtof(text, &parsed);
+    if (parsed == text || parsed > end)
+        return false;
+
+    text = parsed;
+    return true;
+}
+
+} // namespace
+
+BrawLut3D::BrawLut3D()
+    : m_size(0), m_entries(nullptr)
+{
+}
+
+BrawLut3D::~BrawLut3D()
+{
+    free(m_entries);
+}
+
+std::shared_ptr<const BrawLut3D> BrawLut3D::Parse(const char* text, size_t length, std::string& error)
+{
+    std::shared_ptr<BrawLut3D> lut(new BrawLut3D());
+    float domainMin[3] = { 0.0f, 0.0f, 0.0f };
+    float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+    size_t count = 0;
+    size_t expected = 0;
+    const char* end = text + length;
+
+    for (const char* line = text; line < end; )
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+
+        const char* p = line;
+        while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+
+        std::string keyword;
+        if (p < lineEnd && (isalpha(static_cast<unsigned char>(*p)) || *p == '_'))
+        {
+            const char* word = p;
+            while (p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r')
+                p++;
+            keyword.assign(word, p);
+        }
+
+        if (p >= lineEnd || *p == '#' || keyword == "TITLE")
+        {
+            // Blank, comment or title
+        }
+        else if (keyword == "LUT_3D_SIZE")
+        {
+            float size = 0.0f;
+            if (lut->m_entries || !ReadFloat(p, lineEnd, size) || size < kMinSize || size > kMaxSize) {
+                error = "Invalid LUT_3D_SIZE";
+                return std::shared_ptr<const BrawLut3D>();
+            }
+
+            lut->m_size = static_cast<uint32_t>(size);
+            expected = static_cast<size_t>(lut->m_size) * lut->m_size * lut->m_size;
+
+            // Cache-line aligned, so no entry straddles two lines
+            void* entries = nullptr;
+            if (posix_memalign(&entries, 64, expected * sizeof(Entry)) != 0) {
+                error = "Out of memory for LUT";
+                return std::shared_ptr<const BrawLut3D>();
+            }
+            lut->m_entries = static_cast<Entry*>(entries);
+        }
+        else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX")
+        {
+            float* domain = keyword == "DOMAIN_MIN" ? domainMin : domainMax;
+            for (int i = 0; i < 3; i++)
+            {
+                if (!ReadFloat(p, lineEnd, domain[i])) {
+                    error = "Invalid " + keyword;
+                    return std::shared_ptr<const BrawLut3D>();
+                }
+            }
+        }
+        else if (keyword == "LUT_1D_SIZE")
+        {
+            error = "1D LUTs are not supported";
+            return std::shared_ptr<const BrawLut3D>();
+        }
+        else if (!keyword.empty())
+        {
+            // Other keywords (e.g. LUT_IN_VIDEO_RANGE) don't change the table
+        }
+        else
+        {
+            float rgb[3];
+            for (int i = 0; i < 3; i++)
+            {
+                if (!ReadFloat(p, lineEnd, rgb[i])) {
+                    error = "Invalid LUT entry";
+                    return std::shared_ptr<const BrawLut3D>();
+                }
+            }
+            if (!lut->m_entries || count >= expected) {
+                error = lut->m_entries ? "Too many LUT entries" : "LUT entries before LUT_3D_SIZE";
+                return std::shared_ptr<const BrawLut3D>();
+            }
+
+            Entry& entry = lut->m_entries[count++];
+            entry.r = rgb[0];
+            entry.g = rgb[1];
+            entry.b = rgb[2];
+            entry.pad = 0.0f;
+        }
+
+        line = lineEnd + 1;
+    }
+
+    if (!lut->m_entries || count != expected)
+    {
+        error = lut->m_entries ? "Too few LUT entries" : "Missing LUT_3D_SIZE";
+        return std::shared_ptr<const BrawLut3D>();
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!(domainMax[i] > domainMin[i])) {
+            error = "Invalid LUT domain";
+            return std::shared_ptr<const BrawLut3D>();
+        }
+        lut->m_domainMin[i] = domainMin[i];
+        lut->m_scale[i] = (lut->m_size - 1) / (domainMax[i] - domainMin[i]);
+    }
+
+    return lut;
+}
+
+void BrawLut3D::Apply(const float* rgb, float* out) const
+{
+    const float last = static_cast<float>(m_size - 1);
+    uint32_t index[3];
+    float fraction[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        float x = (rgb[i] - m_domainMin[i]) * m_scale[i];
+        x = x < 0.0f ? 0.0f : (x > last ? last : x);
+
+        uint32_t cell = std::min(static_cast<uint32_t>(x), m_size - 2);
+        index[i] = cell;
+        fraction[i] = x - cell;
+    }
+
+    const uint32_t r = index[0], g = index[1], b = index[2];
+    const float fr = fraction[0], fg = fraction[1], fb = fraction[2];
+
+    // Split the cube into six tetrahedra along its main diagonal and blend
+    // the four corners of the one holding the point
+    Vec4 c000 = LoadAligned(&At(r, g, b).r);
+    Vec4 c111 = LoadAligned(&At(r + 1, g + 1, b + 1).r);
+    Vec4 result;
+
+    if (fr > fg)
+    {
+        if (fg > fb)
+        {
+            Vec4 c100 = LoadAligned(&At(r + 1, g, b).r);
+            Vec4 c110 = LoadAligned(&At(r + 1, g + 1, b).r);
+            result = Step(Step(Step(c000, c000, c100, fr), c100, c110, fg), c110, c111, fb);
+        }
+        else if (fr > fb)
+        {
+            Vec4 c100 = LoadAligned(&At(r + 1, g, b).r);
+            Vec4 c101 = LoadAligned(&At(r + 1, g, b + 1).r);
+            result = Step(Step(Step(c000, c000, c100, fr), c100, c101, fb), c101, c111, fg);
+        }
+        else
+        {
+            Vec4 c001 = LoadAligned(&At(r, g, b + 1).r);
+            Vec4 c101 = LoadAligned(&At(r + 1, g, b + 1).r);
+            result = Step(Step(Step(c000, c000, c001, fb), c001, c101, fr), c101, c111, fg);
+        }
+    }
+    else
+    {
+        if (fb > fg)
+        {
+            Vec4 c001 = LoadAligned(&At(r, g, b + 1).r);
+            Vec4 c011 = LoadAligned(&At(r, g + 1, b + 1).r);
+            result = Step(Step(Step(c000, c000, c001, fb), c001, c011, fg), c011, c111, fr);
+        }
+        else if (fb > fr)
+        {
+            Vec4 c010 = LoadAligned(&At(r, g + 1, b).r);
+            Vec4 c011 = LoadAligned(&At(r, g + 1, b + 1).r);
+            result = Step(Step(Step(c000, c000, c010, fg), c010, c011, fb), c011, c111, fr);
+        }
+        else
+        {
+            Vec4 c010 = LoadAligned(&At(r, g + 1, b).r);
+            Vec4 c110 = LoadAligned(&At(r + 1, g + 1, b).r);
+            result = Step(Step(Step(c000, c000, c010, fg), c010, c110, fr), c110, c111, fb);
+        }
+    }
+
+    float blended[4];
+    Store(blended, result);
+    out[0] = blended[0];
+    out[1] = blended[1];
+    out[2] = blended[2];
+}
+
+std::shared_ptr<const BrawLut3D> LoadCubeLut(const std::string& path, std::string& error)
+{
+    struct CachedLut
+    {
+        time_t mtime;
+        off_t size;
+        std::shared_ptr<const BrawLut3D> lut;
+    };
+    static std::mutex s_mutex;
+    static std::map<std::string, CachedLut> s_luts;
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        error = "LUT not found: " + path;
+        return std::shared_ptr<const BrawLut3D>();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        std::map<std::string, CachedLut>::iterator found = s_luts.find(path);
+        if (found != s_luts.end() && found->second.mtime == info.st_mtime && found->second.size == info.st_size)
+            return found->second.lut;
+    }
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        error = "Failed to open LUT: " + path;
+        return std::shared_ptr<const BrawLut3D>();
+    }
+
+    // One spare byte for the terminator Parse needs
+    size_t length = static_cast<size_t>(info.st_size);
+    std::vector<char> text(length + 1, '\0');
+    size_t read = fread(&text[0], 1, length, file);
+    fclose(file);
+    if (read != length)
+    {
+        error = "Failed to read LUT: " + path;
+        return std::shared_ptr<const BrawLut3D>();
+    }
+
+    std::shared_ptr<const BrawLut3D> lut = BrawLut3D::Parse(&text[0], length, error);
+    if (!lut)
+    {
+        error += " in " + path;
+        return lut;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_luts.size() >= kMaxCachedLuts)
+        s_luts.clear();
+
+    CachedLut& cached = s_luts[path];
+    cached.mtime = info.st_mtime;
+    cached.size = info.st_size;
+    cached.lut = lut;
+    return lut;
+}
+
+BrawGradeNode::BrawGradeNode()
+    : type(kPrimary), contrast(0.0f), saturation(0.0f), hue(0.0f), temperature(0.0f), tint(0.0f),
+      exposure(0.0f), highlights(0.0f), shadows(0.0f), whites(0.0f), blacks(0.0f), intensity(1.0f)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        lift[i] = 0.0f;
+        gamma[i] = 0.0f;
+        gain[i] = 0.0f;
+        offset[i] = 0.0f;
+    }
+}
+
+void BrawGrade::Apply(const BrawImageView& source, void* destination) const
+{
+    const BrawPixelFormat& format = *source.format;
+    std::vector<float> row(static_cast<size_t>(source.width) * 4);
+    float* pixels = &row[0];
+
+    const uint8_t* srcRow = static_cast<const uint8_t*>(source.data);
+    uint8_t* dstRow = static_cast<uint8_t*>(destination);
+
+    for (unsigned int y = 0; y < source.height; y++, srcRow += source.stride, dstRow += source.stride)
+    {
+        LoadRow(srcRow, format, source.width, pixels);
+
+        // Node by node over the whole row keeps each LUT's table hot
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            const BrawGradeNode& node = nodes[n];
+            float* pixel = pixels;
+
+            if (node.type == BrawGradeNode::kPrimary)
+            {
+                float exposure = std::pow(2.0f, node.exposure);
+                for (unsigned int x = 0; x < source.width; x++, pixel += 4)
+                    ApplyPrimary(node, exposure, pixel);
+            }
+            else if (node.intensity >= 1.0f)
+            {
+                for (unsigned int x = 0; x < source.width; x++, pixel += 4)
+                    node.lut->Apply(pixel, pixel);
+            }
+            else
+            {
+                for (unsigned int x = 0; x < source.width; x++, pixel += 4)
+                {
+                    float graded[4];
+                    node.lut->Apply(pixel, graded);
+                    graded[3] = pixel[3];
+                    Store(pixel, Step(Load(pixel), Load(pixel), Load(graded), node.intensity));
+                }
+            }
+        }
+
+        StoreRow(pixels, format, source.width, srcRow, dstRow);
+    }
+}
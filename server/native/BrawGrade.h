@@ -0,0 +1,113 @@
+/*
+ * BrawGrade - native colour grading of decoded frames
+ *
+ * Applies the browser node graph's primary wheels and LUT nodes on the SDK
+ * thread that decoded the frame, so graded renders need no WebGL client.
+ * Primary nodes follow primaryColorShader in client/src/lib/webgl/shaders.ts.
+ * .cube LUTs are held in a shared cache as 64-byte aligned tables of padded
+ * RGB entries, so each lattice corner is one 4-float vector load and the
+ * tetrahedral blend runs on SSE2 or NEON vectors.
+ */
+
+#ifndef BRAW_GRADE_H
+#define BRAW_GRADE_H
+
+#include "BrawImageWriter.h"
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A 3D LUT from a .cube file. Entries are red-fastest, as in the file.
+class BrawLut3D
+{
+public:
+    struct Entry
+    {
+        float r, g, b, pad;
+    };
+
+    // Smallest and largest LUT_3D_SIZE accepted
+    static const uint32_t kMinSize = 2;
+    static const uint32_t kMaxSize = 256;
+
+    // Parse .cube text; text[length] must be a NUL
+    static std::shared_ptr<const BrawLut3D> Parse(const char* text, size_t length, std::string& error);
+
+    ~BrawLut3D();
+
+    uint32_t Size() const { return m_size; }
+
+    // Look up rgb[0..2] with tetrahedral interpolation into out[0..2]
+    void Apply(const float* rgb, float* out) const;
+
+private:
+    BrawLut3D();
+    BrawLut3D(const BrawLut3D&);
+    BrawLut3D& operator=(const BrawLut3D&);
+
+    const Entry& At(uint32_t r, uint32_t g, uint32_t b) const { return m_entries[(b * m_size + g) * m_size + r]; }
+
+    uint32_t m_size;
+    float m_domainMin[3];
+    float m_scale[3]; // (size - 1) / (max - min) per channel
+    Entry* m_entries;
+};
+
+// Load a .cube file, sharing one copy per path until the file changes
+std::shared_ptr<const BrawLut3D> LoadCubeLut(const std::string& path, std::string& error);
+
+// One node of the graph. Master amounts are folded into the colour wheels.
+struct BrawGradeNode
+{
+    enum Type
+    {
+        kPrimary,
+        kLut,
+    };
+
+    BrawGradeNode();
+
+    Type type;
+
+    // Primary wheels
+    float lift[3];
+    float gamma[3];
+    float gain[3];
+    float offset[3];
+    float contrast;
+    float saturation;
+    float hue; // Degrees
+    float temperature;
+    float tint;
+    float exposure; // Stops
+    float highlights;
+    float shadows;
+    float whites;
+    float blacks;
+
+    // LUT, blended with the input by intensity
+    std::shared_ptr<const BrawLut3D> lut;
+    float intensity;
+};
+
+// Enabled nodes in the order they apply
+class BrawGrade
+{
+public:
+    std::vector<BrawGradeNode> nodes;
+
+    bool Empty() const { return nodes.empty(); }
+
+    // Grade source into destination, which has the same layout. Alpha is
+    // copied through; colour is clamped to the format's range.
+    void Apply(const BrawImageView& source, void* destination) const;
+};
+
+// Grading reads and writes interleaved 8/16-bit RGB(A) layouts
+inline bool CanGrade(const BrawPixelFormat& format)
+{
+    return IsIntegerInterleaved(format);
+}
+
+#endif // BRAW_GRADE_H
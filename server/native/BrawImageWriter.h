@@ -0,0 +1,480 @@
+/*
+ * BrawImageWriter - still image output for decoded frames
+ *
+ * Converts a frame a whole row at a time into a staging buffer and writes
+ * it in large blocks, rather than making a libc call per byte or pixel.
+ * Header-only, like BrawFormat.h, so the standalone extractors can use it
+ * without extra sources. The 8-bit swizzle uses NEON when the compiler
+ * targets it, and SSSE3 on any x86 CPU that has it, checked at run time so
+ * the default -march still gets it.
+ */
+
+#ifndef BRAW_IMAGE_WRITER_H
+#define BRAW_IMAGE_WRITER_H
+
+#include "BrawFormat.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define BRAW_SSSE3 1
+#define BRAW_TARGET_SSSE3
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define BRAW_SSSE3 1
+#define BRAW_TARGET_SSSE3 __attribute__((target("ssse3")))
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(BRAW_SSSE3)
+// Whether BRAW_TARGET_SSSE3 kernels may run: always when the whole build
+// targets SSSE3, otherwise asked of the CPU once
+inline bool HaveSSSE3()
+{
+#if defined(__SSSE3__)
+    return true;
+#else
+    static const bool s_supported = __builtin_cpu_supports("ssse3") != 0;
+    return s_supported;
+#endif
+}
+#endif
+
+enum BrawImageFileType
+{
+    brawImageFilePPM,    // 8-bit or 16-bit RGB, following the source depth
+    brawImageFileBMP,    // 24-bit BGR
+    brawImageFileTIFF16, // 16-bit RGB, uncompressed
+    brawImageFileRaw,    // Decoded pixels unchanged, rows packed without padding
+};
+
+struct BrawImageFile
+{
+    const char* name;
+    const char* extension;
+    BrawImageFileType type;
+};
+
+inline const BrawImageFile* BrawImageFiles(size_t& count)
+{
+    static const BrawImageFile s_files[] = {
+        { "ppm",    ".ppm",  brawImageFilePPM    },
+        { "bmp",    ".bmp",  brawImageFileBMP    },
+        { "tiff16", ".tif",  brawImageFileTIFF16 },
+        { "tiff16", ".tiff", brawImageFileTIFF16 },
+        { "raw",    ".raw",  brawImageFileRaw    },
+        { "raw",    ".rgba", brawImageFileRaw    },
+    };
+
+    count = sizeof(s_files) / sizeof(s_files[0]);
+    return s_files;
+}
+
+inline const BrawImageFile* FindImageFile(const char* name)
+{
+    size_t count = 0;
+    const BrawImageFile* files = BrawImageFiles(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(files[i].name, name) == 0)
+            return &files[i];
+    }
+
+    return nullptr;
+}
+
+// Match a file name's extension, case-sensitively
+inline const BrawImageFile* FindImageFileForPath(const char* path)
+{
+    size_t count = 0;
+    const BrawImageFile* files = BrawImageFiles(count);
+    size_t pathLength = strlen(path);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t extensionLength = strlen(files[i].extension);
+        if (pathLength >= extensionLength &&
+            strcmp(path + pathLength - extensionLength, files[i].extension) == 0)
+            return &files[i];
+    }
+
+    return nullptr;
+}
+
+// Raw output takes any layout; the image formats need interleaved integers
+inline bool CanWriteImage(BrawImageFileType type, const BrawPixelFormat& format)
+{
+    return type == brawImageFileRaw || IsIntegerInterleaved(format);
+}
+
+// A decoded frame as laid out in memory
+struct BrawImageView
+{
+    const void* data;
+    const BrawPixelFormat* format;
+    unsigned int width;
+    unsigned int height;
+    size_t stride; // Bytes per row (per plane row for planar formats)
+};
+
+namespace braw_image_writer
+{
+
+enum RowLayout
+{
+    kRowRGB8,
+    kRowBGR8,
+    kRowRGB16BE,
+    kRowRGB16LE,
+};
+
+// Output bytes for one row of width pixels
+inline size_t RowBytes(RowLayout layout, unsigned int width)
+{
+    return static_cast<size_t>(width) * ((layout == kRowRGB8 || layout == kRowBGR8) ? 3 : 6);
+}
+
+#if defined(BRAW_SSSE3)
+// The 4-channel part of SwizzleRow8; returns the pixels done
+BRAW_TARGET_SSSE3 inline unsigned int SwizzleRow8SSSE3(const uint8_t* src, const unsigned int order[3],
+                                                       uint8_t* dst, unsigned int width)
+{
+    // 4 pixels in, 12 bytes out; the 16-byte store overlaps the next
+    // group, so stop while 16 bytes still fit in the row
+    uint8_t shuffle[16];
+    for (unsigned int p = 0; p < 4; p++)
+        for (unsigned int k = 0; k < 3; k++)
+            shuffle[p * 3 + k] = static_cast<uint8_t>(p * 4 + order[k]);
+    memset(shuffle + 12, 0x80, 4);
+
+    __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle));
+    unsigned int x = 0;
+    for (; x + 6 <= width; x += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm_shuffle_epi8(pixels, mask));
+    }
+    return x;
+}
+#endif
+
+// 8-bit RGB(A)/BGRA to 3-byte pixels, taking source bytes order[0..2]
+inline void SwizzleRow8(const uint8_t* src, unsigned int channels, const unsigned int order[3],
+                        uint8_t* dst, unsigned int width)
+{
+    unsigned int x = 0;
+
+#if defined(BRAW_SSSE3)
+    if (channels == 4 && HaveSSSE3())
+        x = SwizzleRow8SSSE3(src, order, dst, width);
+#elif defined(__ARM_NEON)
+    if (channels == 4)
+    {
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t pixels = vld4q_u8(src + x * 4);
+            uint8x16x3_t out;
+            out.val[0] = pixels.val[order[0]];
+            out.val[1] = pixels.val[1];
+            out.val[2] = pixels.val[order[2]];
+            vst3q_u8(dst + x * 3, out);
+        }
+    }
+    else
+    {
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x3_t pixels = vld3q_u8(src + x * 3);
+            uint8x16x3_t out;
+            out.val[0] = pixels.val[order[0]];
+            out.val[1] = pixels.val[1];
+            out.val[2] = pixels.val[order[2]];
+            vst3q_u8(dst + x * 3, out);
+        }
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        const uint8_t* pixel = src + x * channels;
+        dst[x * 3 + 0] = pixel[order[0]];
+        dst[x * 3 + 1] = pixel[order[1]];
+        dst[x * 3 + 2] = pixel[order[2]];
+    }
+}
+
+// Convert one source row into layout
+inline void ConvertRow(const void* srcRow, const BrawPixelFormat& format, RowLayout layout,
+                       uint8_t* dst, unsigned int width)
+{
+    unsigned int red = PixelFormatRedIndex(format);
+    unsigned int blue = 2 - red;
+    unsigned int channels = format.channels;
+
+    const unsigned int rgb[3] = { red, 1, blue };
+    const unsigned int bgr[3] = { blue, 1, red };
+    const unsigned int* order = layout == kRowBGR8 ? bgr : rgb;
+
+    if (format.bytes_per_sample == 1)
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(srcRow);
+
+        if (layout == kRowRGB8 || layout == kRowBGR8)
+        {
+            SwizzleRow8(src, channels, order, dst, width);
+            return;
+        }
+
+        // Widen to 16 bits as v * 257, whose two bytes are both v in either order
+        for (unsigned int x = 0; x < width; x++, src += channels)
+        {
+            for (unsigned int k = 0; k < 3; k++, dst += 2)
+            {
+                dst[0] = src[order[k]];
+                dst[1] = src[order[k]];
+            }
+        }
+        return;
+    }
+
+    const uint16_t* src = static_cast<const uint16_t*>(srcRow);
+
+    if (layout == kRowRGB8 || layout == kRowBGR8)
+    {
+        for (unsigned int x = 0; x < width; x++, src += channels, dst += 3)
+        {
+            dst[0] = static_cast<uint8_t>(src[order[0]] >> 8);
+            dst[1] = static_cast<uint8_t>(src[order[1]] >> 8);
+            dst[2] = static_cast<uint8_t>(src[order[2]] >> 8);
+        }
+        return;
+    }
+
+    bool bigEndian = layout == kRowRGB16BE;
+    for (unsigned int x = 0; x < width; x++, src += channels)
+    {
+        for (unsigned int k = 0; k < 3; k++, dst += 2)
+        {
+            uint16_t sample = src[order[k]];
+            dst[bigEndian ? 0 : 1] = static_cast<uint8_t>(sample >> 8);
+            dst[bigEndian ? 1 : 0] = static_cast<uint8_t>(sample & 0xff);
+        }
+    }
+}
+
+inline void PutU16(std::vector<uint8_t>& out, uint16_t value)
+{
+    out.push_back(static_cast<uint8_t>(value & 0xff));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+inline void PutU32(std::vector<uint8_t>& out, uint32_t value)
+{
+    PutU16(out, static_cast<uint16_t>(value & 0xffff));
+    PutU16(out, static_cast<uint16_t>(value >> 16));
+}
+
+// Stages converted rows and writes them out about a megabyte at a time
+class BlockWriter
+{
+public:
+    BlockWriter(FILE* file, size_t rowBytes, size_t rowPadding = 0)
+        : m_file(file), m_rowBytes(rowBytes + rowPadding), m_used(0), m_ok(true)
+    {
+        size_t rows = (1 << 20) / m_rowBytes;
+        m_buffer.assign((rows > 0 ? rows : 1) * m_rowBytes, 0);
+    }
+
+    // Space for the next row; padding bytes stay zero
+    uint8_t* NextRow()
+    {
+        if (m_used + m_rowBytes > m_buffer.size())
+            Flush();
+
+        uint8_t* row = &m_buffer[m_used];
+        m_used += m_rowBytes;
+        return row;
+    }
+
+    bool Flush()
+    {
+        if (m_used > 0 && fwrite(&m_buffer[0], 1, m_used, m_file) != m_used)
+            m_ok = false;
+
+        m_used = 0;
+        return m_ok;
+    }
+
+private:
+    FILE* m_file;
+    size_t m_rowBytes;
+    std::vector<uint8_t> m_buffer;
+    size_t m_used;
+    bool m_ok;
+};
+
+inline bool WriteRows(FILE* file, const BrawImageView& image, RowLayout layout, size_t rowPadding = 0)
+{
+    BlockWriter writer(file, RowBytes(layout, image.width), rowPadding);
+    const uint8_t* src = static_cast<const uint8_t*>(image.data);
+
+    for (unsigned int y = 0; y < image.height; y++, src += image.stride)
+        ConvertRow(src, *image.format, layout, writer.NextRow(), image.width);
+
+    return writer.Flush();
+}
+
+inline bool WriteHeader(FILE* file, const std::vector<uint8_t>& header)
+{
+    return fwrite(&header[0], 1, header.size(), file) == header.size();
+}
+
+inline bool WritePPM(FILE* file, const BrawImageView& image)
+{
+    bool wide = image.format->bytes_per_sample == 2;
+
+    if (fprintf(file, "P6\n%u %u\n%u\n", image.width, image.height, wide ? 65535u : 255u) < 0)
+        return false;
+
+    // PPM stores 16-bit samples big-endian
+    return WriteRows(file, image, wide ? kRowRGB16BE : kRowRGB8);
+}
+
+inline bool WriteBMP(FILE* file, const BrawImageView& image)
+{
+    size_t rowBytes = RowBytes(kRowBGR8, image.width);
+    size_t rowPadding = (4 - rowBytes % 4) % 4;
+    uint32_t imageSize = static_cast<uint32_t>((rowBytes + rowPadding) * image.height);
+    std::vector<uint8_t> header;
+
+    // BITMAPFILEHEADER
+    PutU16(header, 0x4d42);
+    PutU32(header, 14 + 40 + imageSize);
+    PutU32(header, 0);
+    PutU32(header, 14 + 40);
+
+    // BITMAPINFOHEADER; a negative height stores rows top-down
+    PutU32(header, 40);
+    PutU32(header, image.width);
+    PutU32(header, static_cast<uint32_t>(-static_cast<int32_t>(image.height)));
+    PutU16(header, 1);
+    PutU16(header, 24);
+    PutU32(header, 0);
+    PutU32(header, imageSize);
+    PutU32(header, 5000);
+    PutU32(header, 5000);
+    PutU32(header, 0);
+    PutU32(header, 0);
+
+    return WriteHeader(file, header) && WriteRows(file, image, kRowBGR8, rowPadding);
+}
+
+inline void PutTIFFEntry(std::vector<uint8_t>& out, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+{
+    PutU16(out, tag);
+    PutU16(out, type);
+    PutU32(out, count);
+
+    // SHORT values are left-justified in the value field
+    if (type == 3 && count == 1)
+    {
+        PutU16(out, static_cast<uint16_t>(value));
+        PutU16(out, 0);
+    }
+    else
+        PutU32(out, value);
+}
+
+// Baseline little-endian TIFF: one IFD, one strip
+inline bool WriteTIFF16(FILE* file, const BrawImageView& image)
+{
+    const uint16_t kShort = 3;
+    const uint16_t kLong = 4;
+    const uint16_t entries = 10;
+    const uint32_t ifdOffset = 8;
+    const uint32_t bitsOffset = ifdOffset + 2 + entries * 12 + 4;
+    const uint32_t dataOffset = bitsOffset + 3 * 2;
+    uint32_t dataSize = static_cast<uint32_t>(RowBytes(kRowRGB16LE, image.width) * image.height);
+    std::vector<uint8_t> header;
+
+    header.push_back('I');
+    header.push_back('I');
+    PutU16(header, 42);
+    PutU32(header, ifdOffset);
+
+    PutU16(header, entries);
+    PutTIFFEntry(header, 256, kLong, 1, image.width);      // ImageWidth
+    PutTIFFEntry(header, 257, kLong, 1, image.height);     // ImageLength
+    PutTIFFEntry(header, 258, kShort, 3, bitsOffset);      // BitsPerSample
+    PutTIFFEntry(header, 259, kShort, 1, 1);               // Compression: none
+    PutTIFFEntry(header, 262, kShort, 1, 2);               // PhotometricInterpretation: RGB
+    PutTIFFEntry(header, 273, kLong, 1, dataOffset);       // StripOffsets
+    PutTIFFEntry(header, 277, kShort, 1, 3);               // SamplesPerPixel
+    PutTIFFEntry(header, 278, kLong, 1, image.height);     // RowsPerStrip
+    PutTIFFEntry(header, 279, kLong, 1, dataSize);         // StripByteCounts
+    PutTIFFEntry(header, 284, kShort, 1, 1);               // PlanarConfiguration: chunky
+    PutU32(header, 0);
+
+    PutU16(header, 16);
+    PutU16(header, 16);
+    PutU16(header, 16);
+
+    return WriteHeader(file, header) && WriteRows(file, image, kRowRGB16LE);
+}
+
+inline bool WriteRaw(FILE* file, const BrawImageView& image)
+{
+    size_t rowBytes = PixelFormatStride(*image.format, image.width);
+    size_t rows = static_cast<size_t>(image.height) * (image.format->planar ? image.format->channels : 1);
+    const uint8_t* src = static_cast<const uint8_t*>(image.data);
+
+    // Unpadded rows are already one contiguous block
+    if (image.stride == rowBytes)
+        return fwrite(src, 1, rowBytes * rows, file) == rowBytes * rows;
+
+    BlockWriter writer(file, rowBytes);
+    for (size_t y = 0; y < rows; y++, src += image.stride)
+        memcpy(writer.NextRow(), src, rowBytes);
+
+    return writer.Flush();
+}
+
+} // namespace braw_image_writer
+
+// Write image to an open stream. The caller checks CanWriteImage first.
+inline bool WriteImage(FILE* file, BrawImageFileType type, const BrawImageView& image)
+{
+    if (!CanWriteImage(type, *image.format))
+        return false;
+
+    switch (type)
+    {
+        case brawImageFilePPM:
+            return braw_image_writer::WritePPM(file, image);
+        case brawImageFileBMP:
+            return braw_image_writer::WriteBMP(file, image);
+        case brawImageFileTIFF16:
+            return braw_image_writer::WriteTIFF16(file, image);
+        case brawImageFileRaw:
+            return braw_image_writer::WriteRaw(file, image);
+    }
+
+    return false;
+}
+
+inline bool WriteImage(const char* filename, BrawImageFileType type, const BrawImageView& image)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+        return false;
+
+    bool written = WriteImage(file, type, image);
+    return fclose(file) == 0 && written;
+}
+
+#endif // BRAW_IMAGE_WRITER_H
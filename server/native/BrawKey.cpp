@@ -0,0 +1,589 @@
+/*
+ * BrawKey - chroma key matte generation for decoded frames
+ */
+
+#include "BrawKey.h"
+#include "BrawBufferPool.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BRAW_KEY_SIMD 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BRAW_KEY_SIMD 1
+#endif
+
+// Rows worth a thread of their own, and the most threads one frame gets
+static const unsigned int kMinRowsPerThread = 64;
+static const unsigned int kMaxKeyThreads = 16;
+
+bool FindMatteFormat(const char* name, BrawMatteFormat& format)
+{
+    if (strcmp(name, "u8") == 0)
+        format = brawMatteU8;
+    else if (strcmp(name, "u16") == 0)
+        format = brawMatteU16;
+    else
+        return false;
+    return true;
+}
+
+const char* MatteFormatName(BrawMatteFormat format)
+{
+    switch (format)
+    {
+    case brawMatteU8:
+        return "u8";
+    case brawMatteU16:
+        return "u16";
+    default:
+        return "none";
+    }
+}
+
+// GREEN_SCREEN from CHROMA_KEY_PRESETS, with the refinements left neutral
+BrawKeyOptions::BrawKeyOptions()
+    : enabled(false), hue_range(1.0f), sat_range(1.0f), lum_range(1.0f), threshold(0.3f), tolerance(0.1f),
+      edge_thin(0.0f), edge_feather(0.0f), spill_suppress(0.5f), despill_bias(0.0f), matte_contrast(0.0f),
+      matte_gamma(1.0f), matte_clip_black(0.0f), matte_clip_white(1.0f), edge_refine(false), edge_radius(1.0f),
+      write_alpha(true), matte(brawMatteNone)
+{
+    key_color[0] = 0.0f;
+    key_color[1] = 177.0f / 255.0f;
+    key_color[2] = 64.0f / 255.0f;
+    for (int i = 0; i < 3; i++)
+        despill_color[i] = 0.5f;
+}
+
+void BrawMatte::Reset()
+{
+    BrawBufferPool::Shared().Release(data);
+
+    format = brawMatteNone;
+    width = 0;
+    height = 0;
+    data = nullptr;
+    size = 0;
+}
+
+void BrawMatte::Swap(BrawMatte& other)
+{
+    std::swap(format, other.format);
+    std::swap(width, other.width);
+    std::swap(height, other.height);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+}
+
+void* BrawMatte::Detach()
+{
+    void* detached = data;
+    data = nullptr;
+    Reset();
+    return detached;
+}
+
+namespace
+{
+
+inline float Clamp01(float value)
+{
+    return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+inline float SmoothStep(float edge0, float edge1, float x)
+{
+    float t = Clamp01((x - edge0) / (edge1 - edge0));
+    return t * t * (3.0f - 2.0f * t);
+}
+
+inline float Fract(float x)
+{
+    return x - std::floor(x);
+}
+
+// rgb2hsv/hsv2rgb as the shader writes them, like BrawGrade's
+void RgbToHsv(const float* c, float* hsv)
+{
+    float p[4];
+    if (c[1] >= c[2]) {
+        p[0] = c[1]; p[1] = c[2]; p[2] = 0.0f; p[3] = -1.0f / 3.0f;
+    } else {
+        p[0] = c[2]; p[1] = c[1]; p[2] = -1.0f; p[3] = 2.0f / 3.0f;
+    }
+
+    float q[4];
+    if (c[0] >= p[0]) {
+        q[0] = c[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[0];
+    } else {
+        q[0] = p[0]; q[1] = p[1]; q[2] = p[3]; q[3] = c[0];
+    }
+
+    float d = q[0] - std::min(q[3], q[1]);
+    float e = 1.0e-10f;
+    hsv[0] = std::fabs(q[2] + (q[3] - q[1]) / (6.0f * d + e));
+    hsv[1] = d / (q[0] + e);
+    hsv[2] = q[0];
+}
+
+void HsvToRgb(const float* hsv, float* c)
+{
+    static const float K[3] = { 1.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    for (int i = 0; i < 3; i++)
+    {
+        float p = std::fabs(Fract(hsv[0] + K[i]) * 6.0f - 3.0f);
+        c[i] = hsv[2] * (1.0f + hsv[1] * (Clamp01(p - 1.0f) - 1.0f));
+    }
+}
+
+// Everything a worker needs, worked out once per frame
+struct KeyContext
+{
+    const BrawImageView* source;
+    uint8_t* destination; // Null when only the matte is wanted
+    const BrawKeyOptions* options;
+    BrawMatte* matte;
+
+    float key_hsv[3];
+    float inv_hue_range;
+    float inv_sat_range;
+    float inv_lum_range;
+
+    // smoothstep(threshold - tolerance, threshold + tolerance, distance)
+    float edge0;
+    float inv_width;
+
+    // Whole-frame base matte, for edge refinement's neighbours; else empty
+    std::vector<float> base;
+    int offset_x;
+    int offset_y;
+};
+
+// Read one row into RGBA floats; 3-channel pixels are opaque
+void LoadRow(const void* srcRow, const BrawPixelFormat& format, unsigned int width, float* row)
+{
+    unsigned int channels = format.channels;
+    unsigned int red = PixelFormatRedIndex(format);
+    unsigned int blue = 2 - red;
+
+    if (format.bytes_per_sample == 4)
+    {
+        const float* src = static_cast<const float*>(srcRow);
+        for (unsigned int x = 0; x < width; x++, src += channels, row += 4)
+        {
+            row[0] = src[red];
+            row[1] = src[1];
+            row[2] = src[blue];
+            row[3] = channels == 4 ? src[3] : 1.0f;
+        }
+    }
+    else if (format.bytes_per_sample == 2)
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(srcRow);
+        const float scale = 1.0f / 65535.0f;
+        for (unsigned int x = 0; x < width; x++, src += channels, row += 4)
+        {
+            row[0] = src[red] * scale;
+            row[1] = src[1] * scale;
+            row[2] = src[blue] * scale;
+            row[3] = channels == 4 ? src[3] * scale : 1.0f;
+        }
+    }
+    else
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(srcRow);
+        const float scale = 1.0f / 255.0f;
+        for (unsigned int x = 0; x < width; x++, src += channels, row += 4)
+        {
+            row[0] = src[red] * scale;
+            row[1] = src[1] * scale;
+            row[2] = src[blue] * scale;
+            row[3] = channels == 4 ? src[3] * scale : 1.0f;
+        }
+    }
+}
+
+// Write RGBA floats back; integer layouts are clamped to their range
+void StoreRow(const float* row, const BrawPixelFormat& format, unsigned int width, void* dstRow)
+{
+    unsigned int channels = format.channels;
+    unsigned int red = PixelFormatRedIndex(format);
+    unsigned int blue = 2 - red;
+
+    if (format.bytes_per_sample == 4)
+    {
+        float* dst = static_cast<float*>(dstRow);
+        for (unsigned int x = 0; x < width; x++, dst += channels, row += 4)
+        {
+            dst[red] = row[0];
+            dst[1] = row[1];
+            dst[blue] = row[2];
+            if (channels == 4)
+                dst[3] = row[3];
+        }
+    }
+    else if (format.bytes_per_sample == 2)
+    {
+        uint16_t* dst = static_cast<uint16_t*>(dstRow);
+        for (unsigned int x = 0; x < width; x++, dst += channels, row += 4)
+        {
+            dst[red] = static_cast<uint16_t>(Clamp01(row[0]) * 65535.0f + 0.5f);
+            dst[1] = static_cast<uint16_t>(Clamp01(row[1]) * 65535.0f + 0.5f);
+            dst[blue] = static_cast<uint16_t>(Clamp01(row[2]) * 65535.0f + 0.5f);
+            if (channels == 4)
+                dst[3] = static_cast<uint16_t>(Clamp01(row[3]) * 65535.0f + 0.5f);
+        }
+    }
+    else
+    {
+        uint8_t* dst = static_cast<uint8_t*>(dstRow);
+        for (unsigned int x = 0; x < width; x++, dst += channels, row += 4)
+        {
+            dst[red] = static_cast<uint8_t>(Clamp01(row[0]) * 255.0f + 0.5f);
+            dst[1] = static_cast<uint8_t>(Clamp01(row[1]) * 255.0f + 0.5f);
+            dst[blue] = static_cast<uint8_t>(Clamp01(row[2]) * 255.0f + 0.5f);
+            if (channels == 4)
+                dst[3] = static_cast<uint8_t>(Clamp01(row[3]) * 255.0f + 0.5f);
+        }
+    }
+}
+
+// generateAlpha(): smoothstep of the scaled HSV distance from the key
+float BaseAlpha(const KeyContext& ctx, const float* pixel)
+{
+    float hsv[3];
+    RgbToHsv(pixel, hsv);
+
+    float hue = std::fabs(hsv[0] - ctx.key_hsv[0]);
+    hue = std::min(hue, 1.0f - hue) * ctx.inv_hue_range;
+    float sat = std::fabs(hsv[1] - ctx.key_hsv[1]) * ctx.inv_sat_range;
+    float lum = std::fabs(hsv[2] - ctx.key_hsv[2]) * ctx.inv_lum_range;
+    float distance = std::sqrt(hue * hue + sat * sat + lum * lum);
+
+    float t = Clamp01((distance - ctx.edge0) * ctx.inv_width);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+#if defined(BRAW_KEY_SIMD)
+
+// Four pixels a lane each
+#if defined(__SSE2__)
+typedef __m128 F4;
+typedef __m128 M4;
+inline F4 Splat(float value) { return _mm_set1_ps(value); }
+inline F4 Add(F4 a, F4 b) { return _mm_add_ps(a, b); }
+inline F4 Sub(F4 a, F4 b) { return _mm_sub_ps(a, b); }
+inline F4 Mul(F4 a, F4 b) { return _mm_mul_ps(a, b); }
+inline F4 Div(F4 a, F4 b) { return _mm_div_ps(a, b); }
+inline F4 Min(F4 a, F4 b) { return _mm_min_ps(a, b); }
+inline F4 Max(F4 a, F4 b) { return _mm_max_ps(a, b); }
+inline F4 Abs(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline F4 Sqrt(F4 a) { return _mm_sqrt_ps(a); }
+inline M4 GreaterEqual(F4 a, F4 b) { return _mm_cmpge_ps(a, b); }
+inline F4 Select(M4 mask, F4 a, F4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline void Store(float* p, F4 v) { _mm_storeu_ps(p, v); }
+
+inline void LoadPixels(const float* rgba, F4& r, F4& g, F4& b)
+{
+    F4 p0 = _mm_loadu_ps(rgba);
+    F4 p1 = _mm_loadu_ps(rgba + 4);
+    F4 p2 = _mm_loadu_ps(rgba + 8);
+    F4 p3 = _mm_loadu_ps(rgba + 12);
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    r = p0;
+    g = p1;
+    b = p2;
+}
+#else
+typedef float32x4_t F4;
+typedef uint32x4_t M4;
+inline F4 Splat(float value) { return vdupq_n_f32(value); }
+inline F4 Add(F4 a, F4 b) { return vaddq_f32(a, b); }
+inline F4 Sub(F4 a, F4 b) { return vsubq_f32(a, b); }
+inline F4 Mul(F4 a, F4 b) { return vmulq_f32(a, b); }
+inline F4 Div(F4 a, F4 b) { return vdivq_f32(a, b); }
+inline F4 Min(F4 a, F4 b) { return vminq_f32(a, b); }
+inline F4 Max(F4 a, F4 b) { return vmaxq_f32(a, b); }
+inline F4 Abs(F4 a) { return vabsq_f32(a); }
+inline F4 Sqrt(F4 a) { return vsqrtq_f32(a); }
+inline M4 GreaterEqual(F4 a, F4 b) { return vcgeq_f32(a, b); }
+inline F4 Select(M4 mask, F4 a, F4 b) { return vbslq_f32(mask, a, b); }
+inline void Store(float* p, F4 v) { vst1q_f32(p, v); }
+
+inline void LoadPixels(const float* rgba, F4& r, F4& g, F4& b)
+{
+    float32x4x4_t pixels = vld4q_f32(rgba);
+    r = pixels.val[0];
+    g = pixels.val[1];
+    b = pixels.val[2];
+}
+#endif
+
+// BaseAlpha for four pixels, with the shader's branches as selects
+void BaseAlpha4(const KeyContext& ctx, const float* rgba, float* alpha)
+{
+    F4 r, g, b;
+    LoadPixels(rgba, r, g, b);
+
+    // p = g >= b ? (g, b, 0, -1/3) : (b, g, -1, 2/3)
+    M4 greenFirst = GreaterEqual(g, b);
+    F4 p0 = Select(greenFirst, g, b);
+    F4 p1 = Select(greenFirst, b, g);
+    F4 p2 = Select(greenFirst, Splat(0.0f), Splat(-1.0f));
+    F4 p3 = Select(greenFirst, Splat(-1.0f / 3.0f), Splat(2.0f / 3.0f));
+
+    // q = r >= p.x ? (r, p.y, p.z, p.x) : (p.x, p.y, p.w, r)
+    M4 redFirst = GreaterEqual(r, p0);
+    F4 q0 = Select(redFirst, r, p0);
+    F4 q2 = Select(redFirst, p2, p3);
+    F4 q3 = Select(redFirst, p0, r);
+
+    F4 e = Splat(1.0e-10f);
+    F4 d = Sub(q0, Min(q3, p1));
+    F4 h = Abs(Add(q2, Div(Sub(q3, p1), Add(Mul(Splat(6.0f), d), e))));
+    F4 s = Div(d, Add(q0, e));
+
+    F4 hue = Abs(Sub(h, Splat(ctx.key_hsv[0])));
+    hue = Mul(Min(hue, Sub(Splat(1.0f), hue)), Splat(ctx.inv_hue_range));
+    F4 sat = Mul(Abs(Sub(s, Splat(ctx.key_hsv[1]))), Splat(ctx.inv_sat_range));
+    F4 lum = Mul(Abs(Sub(q0, Splat(ctx.key_hsv[2]))), Splat(ctx.inv_lum_range));
+    F4 distance = Sqrt(Add(Add(Mul(hue, hue), Mul(sat, sat)), Mul(lum, lum)));
+
+    F4 t = Mul(Sub(distance, Splat(ctx.edge0)), Splat(ctx.inv_width));
+    t = Min(Max(t, Splat(0.0f)), Splat(1.0f));
+    Store(alpha, Mul(Mul(t, t), Sub(Splat(3.0f), Mul(Splat(2.0f), t))));
+}
+
+#endif
+
+void BaseAlphaRow(const KeyContext& ctx, const float* rgba, unsigned int width, float* alpha)
+{
+    unsigned int x = 0;
+#if defined(BRAW_KEY_SIMD)
+    for (; x + 4 <= width; x += 4)
+        BaseAlpha4(ctx, rgba + x * 4, alpha + x);
+#endif
+    for (; x < width; x++)
+        alpha[x] = BaseAlpha(ctx, rgba + x * 4);
+}
+
+// detectEdge(): mean difference from the 3x3 samples around the pixel
+float Edge(const KeyContext& ctx, unsigned int x, unsigned int y, float alpha)
+{
+    const BrawImageView& image = *ctx.source;
+    float edge = 0.0f;
+
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        int sy = std::min(std::max(static_cast<int>(y) + dy * ctx.offset_y, 0), static_cast<int>(image.height) - 1);
+        const float* row = &ctx.base[static_cast<size_t>(sy) * image.width];
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            int sx = std::min(std::max(static_cast<int>(x) + dx * ctx.offset_x, 0), static_cast<int>(image.width) - 1);
+            edge += std::fabs(row[sx] - alpha);
+        }
+    }
+
+    return edge / 9.0f;
+}
+
+// adjustEdge() then refineMatte()
+float RefineAlpha(const BrawKeyOptions& options, float alpha)
+{
+    if (options.edge_thin > 0.0f)
+        alpha = std::pow(alpha, 1.0f + options.edge_thin);
+    else if (options.edge_thin < 0.0f)
+        alpha = 1.0f - std::pow(1.0f - alpha, 1.0f - options.edge_thin);
+
+    alpha = (alpha - 0.5f) * (1.0f + options.matte_contrast) + 0.5f;
+    // The shader clamps before its pow() whatever the gamma; only the pow
+    // itself is skipped at 1
+    alpha = std::max(alpha, 0.0f);
+    if (options.matte_gamma != 1.0f)
+        alpha = std::pow(alpha, options.matte_gamma);
+    alpha = (alpha - options.matte_clip_black) / (options.matte_clip_white - options.matte_clip_black);
+
+    return Clamp01(alpha);
+}
+
+// suppressSpill()
+void SuppressSpill(const KeyContext& ctx, float alpha, float* c)
+{
+    const BrawKeyOptions& options = *ctx.options;
+
+    float hsv[3];
+    RgbToHsv(c, hsv);
+
+    float hueDiff = std::fabs(hsv[0] - ctx.key_hsv[0]);
+    if (hueDiff > 0.5f)
+        hueDiff = 1.0f - hueDiff;
+
+    float spillMask = (1.0f - SmoothStep(0.0f, 0.2f, hueDiff)) * (1.0f - alpha);
+    hsv[1] *= 1.0f - spillMask * options.spill_suppress;
+    if (options.despill_bias > 0.0f)
+        hsv[0] = Fract(hsv[0] + spillMask * options.despill_bias * 0.1f);
+
+    HsvToRgb(hsv, c);
+    float mix = spillMask * options.despill_bias;
+    for (int i = 0; i < 3; i++)
+        c[i] += mix * (options.despill_color[i] - c[i]);
+}
+
+enum KeyPass
+{
+    kBasePass,   // Base matte only, into ctx.base
+    kFinishPass, // Refine, despill, write pixels and matte
+};
+
+void KeyRows(KeyContext& ctx, KeyPass pass, unsigned int firstRow, unsigned int endRow)
+{
+    const BrawImageView& image = *ctx.source;
+    const BrawKeyOptions& options = *ctx.options;
+    const BrawPixelFormat& format = *image.format;
+    bool refine = !ctx.base.empty();
+
+    std::vector<float> pixels(static_cast<size_t>(image.width) * 4);
+    std::vector<float> rowAlpha(refine ? 0 : image.width);
+
+    for (unsigned int y = firstRow; y < endRow; y++)
+    {
+        const uint8_t* srcRow = static_cast<const uint8_t*>(image.data) + y * image.stride;
+        LoadRow(srcRow, format, image.width, &pixels[0]);
+
+        if (pass == kBasePass)
+        {
+            BaseAlphaRow(ctx, &pixels[0], image.width, &ctx.base[static_cast<size_t>(y) * image.width]);
+            continue;
+        }
+
+        const float* alphas = refine ? &ctx.base[static_cast<size_t>(y) * image.width] : &rowAlpha[0];
+        if (!refine)
+            BaseAlphaRow(ctx, &pixels[0], image.width, &rowAlpha[0]);
+
+        uint8_t* matteRow = ctx.matte->data
+            ? static_cast<uint8_t*>(ctx.matte->data) + static_cast<size_t>(y) * image.width *
+                  (ctx.matte->format == brawMatteU16 ? 2 : 1)
+            : nullptr;
+
+        float* pixel = &pixels[0];
+        for (unsigned int x = 0; x < image.width; x++, pixel += 4)
+        {
+            float alpha = alphas[x];
+            if (refine)
+                alpha += (SmoothStep(0.3f, 0.7f, alpha) - alpha) * Edge(ctx, x, y, alpha) * options.edge_feather;
+            alpha = RefineAlpha(options, alpha);
+
+            if (options.spill_suppress > 0.0f)
+                SuppressSpill(ctx, alpha, pixel);
+
+            float keyed = alpha * pixel[3];
+            if (options.write_alpha)
+                pixel[3] = keyed;
+
+            if (ctx.matte->format == brawMatteU16)
+                reinterpret_cast<uint16_t*>(matteRow)[x] = static_cast<uint16_t>(Clamp01(keyed) * 65535.0f + 0.5f);
+            else if (matteRow)
+                matteRow[x] = static_cast<uint8_t>(Clamp01(keyed) * 255.0f + 0.5f);
+        }
+
+        if (ctx.destination)
+            StoreRow(&pixels[0], format, image.width, ctx.destination + y * image.stride);
+    }
+}
+
+// Split the rows into bands, one per worker, the calling thread taking the first
+void RunPass(KeyContext& ctx, KeyPass pass)
+{
+    unsigned int height = ctx.source->height;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, kMaxKeyThreads);
+    threads = std::max(1u, std::min(threads, height / kMinRowsPerThread));
+
+    std::vector<std::thread> workers;
+    unsigned int rowsPerThread = (height + threads - 1) / threads;
+
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        unsigned int firstRow = std::min(height, i * rowsPerThread);
+        unsigned int endRow = std::min(height, firstRow + rowsPerThread);
+        workers.push_back(std::thread(KeyRows, std::ref(ctx), pass, firstRow, endRow));
+    }
+    KeyRows(ctx, pass, 0, std::min(height, rowsPerThread));
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+} // namespace
+
+bool KeyImage(const BrawImageView& source, void* destination, const BrawKeyOptions& options, BrawMatte& matte,
+              std::string& error)
+{
+    if (!CanKey(*source.format))
+    {
+        error = std::string("Cannot key pixel format ") + source.format->name;
+        return false;
+    }
+    if (!(options.hue_range > 0.0f && options.sat_range > 0.0f && options.lum_range > 0.0f))
+    {
+        error = "Key ranges must be positive";
+        return false;
+    }
+    if (!(options.matte_clip_white > options.matte_clip_black))
+    {
+        error = "Matte clip white must be above clip black";
+        return false;
+    }
+    if (source.width == 0 || source.height == 0)
+    {
+        error = "Empty image";
+        return false;
+    }
+
+    KeyContext ctx;
+    ctx.source = &source;
+    ctx.destination = options.ModifiesPixels(source.format->channels) ? static_cast<uint8_t*>(destination) : nullptr;
+    ctx.options = &options;
+    ctx.matte = &matte;
+
+    RgbToHsv(options.key_color, ctx.key_hsv);
+    ctx.inv_hue_range = 1.0f / options.hue_range;
+    ctx.inv_sat_range = 1.0f / options.sat_range;
+    ctx.inv_lum_range = 1.0f / options.lum_range;
+    ctx.edge0 = options.threshold - options.tolerance;
+    ctx.inv_width = 1.0f / std::max(2.0f * options.tolerance, 1.0e-6f);
+    ctx.offset_x = static_cast<int>(std::lround(options.edge_radius * 0.001f * source.width));
+    ctx.offset_y = static_cast<int>(std::lround(options.edge_radius * 0.001f * source.height));
+
+    matte.Reset();
+    if (options.matte != brawMatteNone)
+    {
+        size_t size = static_cast<size_t>(source.width) * source.height * (options.matte == brawMatteU16 ? 2 : 1);
+        matte.data = BrawBufferPool::Shared().Acquire(size);
+        if (!matte.data)
+        {
+            error = "Out of memory for matte";
+            return false;
+        }
+        matte.format = options.matte;
+        matte.width = source.width;
+        matte.height = source.height;
+        matte.size = size;
+    }
+
+    // Edge refinement reads its neighbours' base matte, so that is
+    // finished for the whole frame first
+    if (options.edge_refine && options.edge_feather != 0.0f)
+    {
+        ctx.base.resize(static_cast<size_t>(source.width) * source.height);
+        RunPass(ctx, kBasePass);
+    }
+    RunPass(ctx, kFinishPass);
+
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * BrawKey - chroma key matte generation for decoded frames
+ *
+ * Keys the frame on the SDK thread with the same parameters and maths as
+ * advancedChromaKeyShader in client/src/lib/webgl/advancedChromaKey.ts, so
+ * server renders and precomputed mattes match what the browser shows. Rows
+ * are split across worker threads; the HSV distance that drives the base
+ * matte runs four pixels at a time on SSE2 or NEON. The result is written
+ * into the frame's alpha channel, into a separate 8/16-bit matte, or both.
+ */
+
+#ifndef BRAW_KEY_H
+#define BRAW_KEY_H
+
+#include "BrawImageWriter.h"
+#include <stdint.h>
+#include <cstring>
+#include <string>
+
+enum BrawMatteFormat
+{
+    brawMatteNone,
+    brawMatteU8,
+    brawMatteU16,
+};
+
+// "u8" or "u16"
+bool FindMatteFormat(const char* name, BrawMatteFormat& format);
+const char* MatteFormatName(BrawMatteFormat format);
+
+// The shader's uniforms, colours in [0, 1]
+struct BrawKeyOptions
+{
+    BrawKeyOptions();
+
+    bool enabled;
+
+    float key_color[3];
+    float hue_range; // Tolerances the HSV distance is divided by
+    float sat_range;
+    float lum_range;
+
+    float threshold; // Distance at the matte's midpoint
+    float tolerance; // Softness either side of threshold
+    float edge_thin; // > 0 erodes, < 0 grows
+    float edge_feather;
+
+    float spill_suppress;
+    float despill_bias;
+    float despill_color[3];
+
+    float matte_contrast;
+    float matte_gamma;
+    float matte_clip_black;
+    float matte_clip_white;
+
+    // Soften by the matte's 3x3 neighbourhood; radius is in thousandths of
+    // the image size, as the shader's texture offsets are
+    bool edge_refine;
+    float edge_radius;
+
+    // Multiply the matte into 4-channel pixels' alpha
+    bool write_alpha;
+
+    // Also return the matte on its own
+    BrawMatteFormat matte;
+
+    // Whether keying changes the pixels, not just the separate matte
+    bool ModifiesPixels(unsigned int channels) const
+    {
+        return spill_suppress > 0.0f || (write_alpha && channels == 4);
+    }
+};
+
+// A single-channel matte in a BrawBufferPool buffer, rows packed
+class BrawMatte
+{
+public:
+    BrawMatte() : format(brawMatteNone), width(0), height(0), data(nullptr), size(0) {}
+    ~BrawMatte() { Reset(); }
+
+    void Reset();
+    void Swap(BrawMatte& other);
+
+    // Give up the buffer; the caller must release it to BrawBufferPool
+    void* Detach();
+
+    BrawMatteFormat format;
+    unsigned int width;
+    unsigned int height;
+    void* data;
+    size_t size;
+
+private:
+    BrawMatte(const BrawMatte&);
+    BrawMatte& operator=(const BrawMatte&);
+};
+
+// Keying reads interleaved 8/16-bit and 32-bit float RGB(A) layouts
+inline bool CanKey(const BrawPixelFormat& format)
+{
+    return !format.planar && format.channels >= 3 &&
+           (IsIntegerInterleaved(format) || strcmp(format.sample_type, "float32") == 0);
+}
+
+// Key source. destination, in the same layout, receives the despilled
+// pixels and keyed alpha when options.ModifiesPixels, and may be the
+// source itself; matte is filled when options.matte is set.
+bool KeyImage(const BrawImageView& source, void* destination, const BrawKeyOptions& options, BrawMatte& matte,
+              std::string& error);
+
+#endif // BRAW_KEY_H
@@ -0,0 +1,573 @@
+/*
+ * BrawMetadata - clip and per-frame metadata, and the on-disk clip index
+ */
+
+#include "BrawMetadata.h"
+#include "BrawClip.h"
+#include <sys/stat.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+// Read jobs kept queued while scanning frame metadata; reads are I/O bound
+static const unsigned int kMetadataMaxInFlight = 16;
+
+static const char kIndexMagic[8] = { 'B', 'R', 'A', 'W', 'I', 'D', 'X', '1' };
+static const uint32_t kIndexVersion = 1;
+
+namespace
+{
+
+bool SafeArrayNumbers(SafeArray* safeArray, std::vector<double>& numbers)
+{
+    BlackmagicRawVariantType type = blackmagicRawVariantTypeEmpty;
+    long lower = 0, upper = -1;
+    void* data = nullptr;
+
+    if (SafeArrayGetVartype(safeArray, &type) != S_OK ||
+        SafeArrayGetLBound(safeArray, 1, &lower) != S_OK ||
+        SafeArrayGetUBound(safeArray, 1, &upper) != S_OK)
+        return false;
+
+    if (upper < lower)
+    {
+        numbers.clear();
+        return true;
+    }
+
+    if (SafeArrayAccessData(safeArray, &data) != S_OK)
+        return false;
+
+    size_t count = static_cast<size_t>(upper - lower + 1);
+    bool supported = true;
+    numbers.resize(count);
+
+    for (size_t i = 0; i < count && supported; i++)
+    {
+        switch (type)
+        {
+        case blackmagicRawVariantTypeU8: numbers[i] = static_cast<const uint8_t*>(data)[i]; break;
+        case blackmagicRawVariantTypeS16: numbers[i] = static_cast<const int16_t*>(data)[i]; break;
+        case blackmagicRawVariantTypeU16: numbers[i] = static_cast<const uint16_t*>(data)[i]; break;
+        case blackmagicRawVariantTypeS32: numbers[i] = static_cast<const int32_t*>(data)[i]; break;
+        case blackmagicRawVariantTypeU32: numbers[i] = static_cast<const uint32_t*>(data)[i]; break;
+        case blackmagicRawVariantTypeFloat32: numbers[i] = static_cast<const float*>(data)[i]; break;
+        case blackmagicRawVariantTypeFloat64: numbers[i] = static_cast<const double*>(data)[i]; break;
+        default: supported = false; break;
+        }
+    }
+
+    SafeArrayUnaccessData(safeArray);
+    return supported;
+}
+
+bool VariantValue(const Variant& variant, BrawMetadataValue& value)
+{
+    value = BrawMetadataValue();
+
+    switch (variant.vt)
+    {
+    case blackmagicRawVariantTypeU8:
+    case blackmagicRawVariantTypeU16: value.number = variant.uiVal; return true;
+    case blackmagicRawVariantTypeS16: value.number = variant.iVal; return true;
+    case blackmagicRawVariantTypeS32: value.number = variant.intVal; return true;
+    case blackmagicRawVariantTypeU32: value.number = variant.uintVal; return true;
+    case blackmagicRawVariantTypeFloat32: value.number = variant.fltVal; return true;
+    case blackmagicRawVariantTypeFloat64: value.number = variant.dblVal; return true;
+    case blackmagicRawVariantTypeString:
+        value.kind = BrawMetadataValue::kString;
+        value.text = variant.bstrVal ? variant.bstrVal : "";
+        return true;
+    case blackmagicRawVariantTypeSafeArray:
+        value.kind = BrawMetadataValue::kNumbers;
+        return variant.parray && SafeArrayNumbers(variant.parray, value.numbers);
+    default:
+        return false;
+    }
+}
+
+// Pipelines read-only jobs over every frame, collecting each frame's metadata
+class FrameMetadataScan
+{
+public:
+    FrameMetadataScan(uint64_t frameCount) : m_frames(frameCount), m_inFlight(0), m_result(S_OK) {}
+
+    HRESULT Run(BrawClip& clip, std::string& error);
+
+    std::vector<std::vector<BrawMetadataEntry> >& Frames() { return m_frames; }
+
+private:
+    class Read;
+
+    void Complete(HRESULT result, const std::string& error);
+
+    std::vector<std::vector<BrawMetadataEntry> > m_frames;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    unsigned int m_inFlight;
+    HRESULT m_result;
+    std::string m_error;
+};
+
+class FrameMetadataScan::Read : public BrawFrameCompletion
+{
+public:
+    Read(FrameMetadataScan& scan, uint64_t frameIndex) : m_scan(scan), m_frameIndex(frameIndex) {}
+
+    virtual bool FrameRead(IBlackmagicRawFrame* frame)
+    {
+        // Each job writes only its own slot, which Run reads after all complete
+        IBlackmagicRawMetadataIterator* iterator = nullptr;
+        if (frame->GetMetadataIterator(&iterator) == S_OK)
+        {
+            ReadMetadataIterator(iterator, m_scan.m_frames[m_frameIndex]);
+            iterator->Release();
+        }
+        return true;
+    }
+
+    virtual void FrameComplete(HRESULT result, BrawFrame&, const std::string& error)
+    {
+        FrameMetadataScan& scan = m_scan;
+        delete this;
+        scan.Complete(result, error);
+    }
+
+private:
+    FrameMetadataScan& m_scan;
+    uint64_t m_frameIndex;
+};
+
+HRESULT FrameMetadataScan::Run(BrawClip& clip, std::string& error)
+{
+    BrawDecodeOptions options;
+    options.cache = false;
+    options.priority = brawPriorityBatch;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (uint64_t frameIndex = 0; frameIndex < m_frames.size() && m_result == S_OK; frameIndex++)
+    {
+        m_condition.wait(lock, [this] { return m_inFlight < kMetadataMaxInFlight; });
+        if (m_result != S_OK)
+            break;
+
+        m_inFlight++;
+        lock.unlock();
+
+        Read* read = new Read(*this, frameIndex);
+        std::string submitError;
+        HRESULT result = clip.SubmitFrame(frameIndex, options, read, submitError);
+
+        lock.lock();
+        if (result != S_OK)
+        {
+            delete read;
+            m_inFlight--;
+            m_result = result;
+            m_error = submitError;
+        }
+    }
+
+    m_condition.wait(lock, [this] { return m_inFlight == 0; });
+
+    if (m_result != S_OK)
+        error = m_error;
+    return m_result;
+}
+
+void FrameMetadataScan::Complete(HRESULT result, const std::string& error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (result != S_OK && m_result == S_OK)
+    {
+        m_result = result;
+        m_error = error.empty() ? "Failed to read frame metadata" : error;
+    }
+
+    m_inFlight--;
+    m_condition.notify_all();
+}
+
+// Little-endian encoding, independent of the host
+class IndexWriter
+{
+public:
+    void U8(uint8_t value) { m_data.push_back(static_cast<char>(value)); }
+    void U32(uint32_t value) { Bytes(value, 4); }
+    void U64(uint64_t value) { Bytes(value, 8); }
+
+    void F64(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        U64(bits);
+    }
+
+    void F32(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        U32(bits);
+    }
+
+    void String(const std::string& value)
+    {
+        U32(static_cast<uint32_t>(value.size()));
+        m_data.append(value);
+    }
+
+    void Entries(const std::vector<BrawMetadataEntry>& entries)
+    {
+        U32(static_cast<uint32_t>(entries.size()));
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            const BrawMetadataValue& value = entries[i].value;
+
+            String(entries[i].key);
+            U8(static_cast<uint8_t>(value.kind));
+            switch (value.kind)
+            {
+            case BrawMetadataValue::kNumber: F64(value.number); break;
+            case BrawMetadataValue::kString: String(value.text); break;
+            case BrawMetadataValue::kNumbers:
+                U32(static_cast<uint32_t>(value.numbers.size()));
+                for (size_t k = 0; k < value.numbers.size(); k++)
+                    F64(value.numbers[k]);
+                break;
+            }
+        }
+    }
+
+    const std::string& Data() const { return m_data; }
+
+private:
+    void Bytes(uint64_t value, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            m_data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    std::string m_data;
+};
+
+// Reads stop at the first short or malformed field; check Ok() at the end
+class IndexReader
+{
+public:
+    IndexReader(const std::string& data) : m_data(data), m_offset(0), m_ok(true) {}
+
+    bool Ok() const { return m_ok; }
+    bool AtEnd() const { return m_offset == m_data.size(); }
+
+    bool Skip(size_t count)
+    {
+        if (!m_ok || m_data.size() - m_offset < count)
+            return m_ok = false;
+        m_offset += count;
+        return true;
+    }
+
+    const char* Peek(size_t count)
+    {
+        if (!m_ok || m_data.size() - m_offset < count)
+        {
+            m_ok = false;
+            return nullptr;
+        }
+        return m_data.data() + m_offset;
+    }
+
+    uint8_t U8() { return static_cast<uint8_t>(Bytes(1)); }
+    uint32_t U32() { return static_cast<uint32_t>(Bytes(4)); }
+    uint64_t U64() { return Bytes(8); }
+
+    double F64()
+    {
+        uint64_t bits = U64();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    float F32()
+    {
+        uint32_t bits = U32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string String()
+    {
+        uint32_t length = U32();
+        const char* text = Peek(length);
+        if (!text)
+            return std::string();
+        m_offset += length;
+        return std::string(text, length);
+    }
+
+    void Entries(std::vector<BrawMetadataEntry>& entries)
+    {
+        uint32_t count = U32();
+
+        // Every entry takes at least 5 bytes, so a corrupt count fails here
+        if (!m_ok || count > (m_data.size() - m_offset) / 5)
+        {
+            m_ok = false;
+            return;
+        }
+
+        entries.resize(count);
+        for (uint32_t i = 0; i < count && m_ok; i++)
+        {
+            BrawMetadataValue& value = entries[i].value;
+
+            entries[i].key = String();
+            uint8_t kind = U8();
+            switch (kind)
+            {
+            case BrawMetadataValue::kNumber:
+                value.number = F64();
+                break;
+            case BrawMetadataValue::kString:
+                value.kind = BrawMetadataValue::kString;
+                value.text = String();
+                break;
+            case BrawMetadataValue::kNumbers:
+            {
+                value.kind = BrawMetadataValue::kNumbers;
+                uint32_t numbers = U32();
+                if (!Peek(static_cast<size_t>(numbers) * 8))
+                    return;
+                value.numbers.resize(numbers);
+                for (uint32_t k = 0; k < numbers; k++)
+                    value.numbers[k] = F64();
+                break;
+            }
+            default:
+                m_ok = false;
+                break;
+            }
+        }
+    }
+
+private:
+    uint64_t Bytes(unsigned int count)
+    {
+        const char* bytes = Peek(count);
+        if (!bytes)
+            return 0;
+
+        uint64_t value = 0;
+        for (unsigned int i = 0; i < count; i++)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        m_offset += count;
+        return value;
+    }
+
+    const std::string& m_data;
+    size_t m_offset;
+    bool m_ok;
+};
+
+bool SourceIdentity(const char* filePath, uint64_t& size, int64_t& mtime)
+{
+    struct stat fileStat;
+    if (stat(filePath, &fileStat) != 0)
+        return false;
+
+    size = static_cast<uint64_t>(fileStat.st_size);
+    mtime = static_cast<int64_t>(fileStat.st_mtime);
+    return true;
+}
+
+} // namespace
+
+void ReadMetadataIterator(IBlackmagicRawMetadataIterator* iterator, std::vector<BrawMetadataEntry>& entries)
+{
+    const char* key = nullptr;
+
+    entries.clear();
+    while (iterator->GetKey(&key) == S_OK)
+    {
+        Variant variant;
+        VariantInit(&variant);
+
+        BrawMetadataEntry entry;
+        if (key && iterator->GetData(&variant) == S_OK && VariantValue(variant, entry.value))
+        {
+            entry.key = key;
+            entries.push_back(entry);
+        }
+
+        VariantClear(&variant);
+        iterator->Next();
+    }
+}
+
+HRESULT BuildClipIndex(BrawClip& clip, const char* filePath, bool scanFrames, BrawClipIndex& index,
+                       std::string& error)
+{
+    index = BrawClipIndex();
+
+    if (!SourceIdentity(filePath, index.source_size, index.source_mtime))
+    {
+        error = "Failed to stat clip";
+        return E_FAIL;
+    }
+
+    HRESULT result = clip.ReadClipMetadata(index, error);
+    if (result != S_OK || !scanFrames)
+        return result;
+
+    FrameMetadataScan scan(index.frame_count);
+    result = scan.Run(clip, error);
+    if (result != S_OK)
+        return result;
+
+    // Keep only what changed, so steady per-frame values cost nothing per frame
+    std::map<std::string, BrawMetadataValue> current;
+    std::vector<std::vector<BrawMetadataEntry> >& frames = scan.Frames();
+    for (uint64_t frameIndex = 0; frameIndex < frames.size(); frameIndex++)
+    {
+        BrawFrameMetadata changed;
+        changed.frame_index = frameIndex;
+
+        for (size_t i = 0; i < frames[frameIndex].size(); i++)
+        {
+            const BrawMetadataEntry& entry = frames[frameIndex][i];
+            std::map<std::string, BrawMetadataValue>::iterator it = current.find(entry.key);
+            if (it != current.end() && it->second == entry.value)
+                continue;
+
+            current[entry.key] = entry.value;
+            changed.entries.push_back(entry);
+        }
+
+        if (!changed.entries.empty())
+            index.frames.push_back(changed);
+    }
+
+    return S_OK;
+}
+
+bool SaveClipIndex(const std::string& indexPath, const BrawClipIndex& index, std::string& error)
+{
+    IndexWriter writer;
+
+    for (size_t i = 0; i < sizeof(kIndexMagic); i++)
+        writer.U8(static_cast<uint8_t>(kIndexMagic[i]));
+    writer.U32(kIndexVersion);
+    writer.U64(index.source_size);
+    writer.U64(static_cast<uint64_t>(index.source_mtime));
+    writer.U64(index.frame_count);
+    writer.U32(index.width);
+    writer.U32(index.height);
+    writer.F32(index.frame_rate);
+    writer.String(index.camera_type);
+    writer.String(index.start_timecode);
+    writer.Entries(index.clip);
+
+    writer.U32(static_cast<uint32_t>(index.frames.size()));
+    for (size_t i = 0; i < index.frames.size(); i++)
+    {
+        writer.U64(index.frames[i].frame_index);
+        writer.Entries(index.frames[i].entries);
+    }
+
+    std::string temporaryPath = indexPath + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+    {
+        error = "Failed to create index file";
+        return false;
+    }
+
+    const std::string& data = writer.Data();
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temporaryPath.c_str(), indexPath.c_str()) != 0)
+    {
+        remove(temporaryPath.c_str());
+        error = "Failed to write index file";
+        return false;
+    }
+
+    return true;
+}
+
+bool LoadClipIndex(const std::string& indexPath, const std::string& filePath, bool loadFrames,
+                   BrawClipIndex& index, std::string& error)
+{
+    index = BrawClipIndex();
+
+    FILE* file = fopen(indexPath.c_str(), "rb");
+    if (!file)
+    {
+        error = "No index file";
+        return false;
+    }
+
+    std::string data;
+    char buffer[16384];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.append(buffer, count);
+    fclose(file);
+
+    IndexReader reader(data);
+    const char* magic = reader.Peek(sizeof(kIndexMagic));
+    if (!magic || memcmp(magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        !reader.Skip(sizeof(kIndexMagic)) || reader.U32() != kIndexVersion)
+    {
+        error = "Not a clip index";
+        return false;
+    }
+
+    index.source_size = reader.U64();
+    index.source_mtime = static_cast<int64_t>(reader.U64());
+
+    uint64_t sourceSize = 0;
+    int64_t sourceMtime = 0;
+    if (!reader.Ok() || !SourceIdentity(filePath.c_str(), sourceSize, sourceMtime) ||
+        sourceSize != index.source_size || sourceMtime != index.source_mtime)
+    {
+        error = "Index is stale";
+        return false;
+    }
+
+    index.frame_count = reader.U64();
+    index.width = reader.U32();
+    index.height = reader.U32();
+    index.frame_rate = reader.F32();
+    index.camera_type = reader.String();
+    index.start_timecode = reader.String();
+    reader.Entries(index.clip);
+
+    if (loadFrames)
+    {
+        uint32_t frames = reader.U32();
+        for (uint32_t i = 0; i < frames && reader.Ok(); i++)
+        {
+            BrawFrameMetadata frame;
+            frame.frame_index = reader.U64();
+            reader.Entries(frame.entries);
+            index.frames.push_back(frame);
+        }
+    }
+
+    if (!reader.Ok() || (loadFrames && !reader.AtEnd()))
+    {
+        index = BrawClipIndex();
+        error = "Corrupt clip index";
+        return false;
+    }
+
+    return true;
+}
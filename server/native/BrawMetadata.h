@@ -0,0 +1,90 @@
+/*
+ * BrawMetadata - clip and per-frame metadata, and the on-disk clip index
+ *
+ * BuildClipIndex reads the clip's metadata and every frame's metadata in
+ * one pipelined pass of read jobs (no decode). The result is saved as a
+ * compact little-endian binary next to the upload, stamped with the
+ * source's size and mtime, so listing clips later reads a few KB per clip
+ * instead of opening each one through the SDK.
+ */
+
+#ifndef BRAW_METADATA_H
+#define BRAW_METADATA_H
+
+#include "BlackmagicRawAPI.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct BrawMetadataValue
+{
+    enum Kind
+    {
+        kNumber,
+        kString,
+        kNumbers, // A SafeArray of numbers
+    };
+
+    BrawMetadataValue() : kind(kNumber), number(0.0) {}
+
+    bool operator==(const BrawMetadataValue& other) const
+    {
+        return kind == other.kind && number == other.number && text == other.text && numbers == other.numbers;
+    }
+    bool operator!=(const BrawMetadataValue& other) const { return !(*this == other); }
+
+    Kind kind;
+    double number;
+    std::string text;
+    std::vector<double> numbers;
+};
+
+struct BrawMetadataEntry
+{
+    std::string key;
+    BrawMetadataValue value;
+};
+
+// Entries of one frame that differ from the frame before; frame 0 has them all
+struct BrawFrameMetadata
+{
+    uint64_t frame_index;
+    std::vector<BrawMetadataEntry> entries;
+};
+
+struct BrawClipIndex
+{
+    BrawClipIndex() : source_size(0), source_mtime(0), frame_count(0), width(0), height(0), frame_rate(0.0f) {}
+
+    // Identity of the file the index was built from
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    uint64_t frame_count;
+    uint32_t width;
+    uint32_t height;
+    float frame_rate;
+    std::string camera_type;
+    std::string start_timecode;
+
+    std::vector<BrawMetadataEntry> clip;
+    std::vector<BrawFrameMetadata> frames; // Empty when frames were not scanned
+};
+
+// Drain an SDK metadata iterator. Values of unsupported types are skipped.
+void ReadMetadataIterator(IBlackmagicRawMetadataIterator* iterator, std::vector<BrawMetadataEntry>& entries);
+
+class BrawClip;
+
+// Fill index from an open clip; scanFrames adds the per-frame deltas
+HRESULT BuildClipIndex(BrawClip& clip, const char* filePath, bool scanFrames, BrawClipIndex& index,
+                       std::string& error);
+
+// Written to a temporary file and renamed, so readers never see a partial index
+bool SaveClipIndex(const std::string& indexPath, const BrawClipIndex& index, std::string& error);
+
+// Fails when the index is missing, corrupt, or older than the source at filePath
+bool LoadClipIndex(const std::string& indexPath, const std::string& filePath, bool loadFrames,
+                   BrawClipIndex& index, std::string& error);
+
+#endif // BRAW_METADATA_H
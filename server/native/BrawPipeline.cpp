@@ -0,0 +1,214 @@
+/*
+ * BrawPipeline - decode pipeline selection for a codec
+ */
+
+#include "BrawPipeline.h"
+#include <cstring>
+#include <utility>
+
+bool FindPipelineType(const char* name, const BrawPipelineType*& type)
+{
+    type = nullptr;
+
+    if (strcmp(name, "auto") == 0)
+        return true;
+
+    size_t count = 0;
+    const BrawPipelineType* types = BrawPipelineTypes(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(types[i].name, name) == 0)
+        {
+            type = &types[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void BrawPipelinePrepare::Complete(HRESULT result)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_result = result;
+    m_done = true;
+    m_condition.notify_one();
+}
+
+HRESULT BrawPipelinePrepare::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return m_done; });
+    return m_result;
+}
+
+BrawPipeline::BrawPipeline()
+    : m_active(nullptr), m_device(nullptr), m_resourceManager(nullptr),
+      m_context(nullptr), m_commandQueue(nullptr)
+{
+}
+
+BrawPipeline::~BrawPipeline()
+{
+    Release();
+}
+
+HRESULT BrawPipeline::Configure(IBlackmagicRawFactory* factory, IBlackmagicRaw* codec,
+                                const BrawPipelineType* requested, std::string& error)
+{
+    size_t count = 0;
+    const BrawPipelineType* types = BrawPipelineTypes(count);
+    const BrawPipelineType* cpu = &types[0];
+    bool attempted = false;
+
+    Release();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const BrawPipelineType& type = types[i];
+
+        if (&type == cpu || (requested && requested != &type))
+            continue;
+
+        attempted = true;
+        if (TryGPU(factory, codec, type) == S_OK)
+        {
+            m_active = &type;
+            return S_OK;
+        }
+
+        Release();
+    }
+
+    // The codec starts on the CPU pipeline; only reset it if a GPU attempt
+    // may have got as far as SetPipeline
+    if (attempted)
+    {
+        IBlackmagicRawConfiguration* configuration = nullptr;
+        HRESULT result = codec->QueryInterface(IID_IBlackmagicRawConfiguration, (LPVOID*)&configuration);
+
+        if (result == S_OK)
+        {
+            result = configuration->SetPipeline(blackmagicRawPipelineCPU, nullptr, nullptr);
+            configuration->Release();
+        }
+
+        if (result != S_OK)
+        {
+            error = "Failed to set pipeline";
+            return result;
+        }
+    }
+
+    m_active = cpu;
+    return S_OK;
+}
+
+HRESULT BrawPipeline::TryGPU(IBlackmagicRawFactory* factory, IBlackmagicRaw* codec, const BrawPipelineType& type)
+{
+    HRESULT result = S_OK;
+    IBlackmagicRawPipelineDeviceIterator* deviceIterator = nullptr;
+    IBlackmagicRawConfiguration* configuration = nullptr;
+    IBlackmagicRawConfigurationEx* configurationEx = nullptr;
+    BlackmagicRawPipeline pipeline = type.pipeline;
+    bool supported = false;
+
+    do
+    {
+        result = codec->QueryInterface(IID_IBlackmagicRawConfiguration, (LPVOID*)&configuration);
+        if (result != S_OK)
+            break;
+
+        result = configuration->IsPipelineSupported(type.pipeline, &supported);
+        if (result != S_OK || !supported)
+        {
+            result = E_FAIL;
+            break;
+        }
+
+        // Use the first device the SDK finds for this pipeline
+        result = factory->CreatePipelineDeviceIterator(type.pipeline, blackmagicRawInteropNone, &deviceIterator);
+        if (result != S_OK)
+            break;
+
+        result = deviceIterator->CreateDevice(&m_device);
+        if (result != S_OK)
+            break;
+
+        result = m_device->GetPipeline(&pipeline, &m_context, &m_commandQueue);
+        if (result != S_OK)
+            break;
+
+        result = configuration->SetPipeline(pipeline, m_context, m_commandQueue);
+        if (result != S_OK)
+            break;
+
+        result = codec->QueryInterface(IID_IBlackmagicRawConfigurationEx, (LPVOID*)&configurationEx);
+        if (result != S_OK)
+            break;
+
+        result = configurationEx->GetResourceManager(&m_resourceManager);
+        if (result != S_OK)
+            break;
+
+        // Build kernels now rather than on the first frame
+        BrawPipelinePrepare prepare;
+        result = codec->PreparePipeline(pipeline, m_context, m_commandQueue, &prepare);
+        if (result != S_OK)
+            break;
+
+        result = prepare.Wait();
+
+    } while(0);
+
+    if (configurationEx != nullptr)
+        configurationEx->Release();
+    if (configuration != nullptr)
+        configuration->Release();
+    if (deviceIterator != nullptr)
+        deviceIterator->Release();
+
+    return result;
+}
+
+void BrawPipeline::Release()
+{
+    if (m_resourceManager != nullptr)
+        m_resourceManager->Release();
+    if (m_device != nullptr)
+        m_device->Release();
+
+    m_active = nullptr;
+    m_device = nullptr;
+    m_resourceManager = nullptr;
+    m_context = nullptr;
+    m_commandQueue = nullptr;
+}
+
+void BrawPipeline::Swap(BrawPipeline& other)
+{
+    std::swap(m_active, other.m_active);
+    std::swap(m_device, other.m_device);
+    std::swap(m_resourceManager, other.m_resourceManager);
+    std::swap(m_context, other.m_context);
+    std::swap(m_commandQueue, other.m_commandQueue);
+}
+
+HRESULT BrawPipeline::ReadBack(IBlackmagicRawProcessedImage* processedImage, void* host, uint32_t size)
+{
+    void* resource = nullptr;
+
+    if (!m_active || !m_resourceManager)
+        return E_FAIL;
+
+    HRESULT result = processedImage->GetResource(&resource);
+    if (result != S_OK)
+        return result;
+
+    return m_resourceManager->CopyResource(m_context, m_commandQueue,
+                                           resource, m_active->resource_type,
+                                           host, blackmagicRawResourceTypeBufferCPU,
+                                           size, false);
+}
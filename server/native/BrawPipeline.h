@@ -0,0 +1,94 @@
+/*
+ * BrawPipeline - decode pipeline selection for a codec
+ *
+ * Puts a codec on the CUDA, OpenCL or CPU pipeline and copies GPU processed
+ * images back to host memory. Any GPU pipeline that cannot be set up falls
+ * back to the CPU, so callers should check Active() to see what they got.
+ */
+
+#ifndef BRAW_PIPELINE_H
+#define BRAW_PIPELINE_H
+
+#include "BlackmagicRawAPI.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+struct BrawPipelineType
+{
+    const char* name;
+    BlackmagicRawPipeline pipeline;
+    BlackmagicRawResourceType resource_type; // Where processed images live
+};
+
+// "auto" is not in the table: it tries each GPU pipeline, then the CPU
+inline const BrawPipelineType* BrawPipelineTypes(size_t& count)
+{
+    static const BrawPipelineType s_pipelines[] = {
+        { "cpu",    blackmagicRawPipelineCPU,    blackmagicRawResourceTypeBufferCPU    },
+        { "cuda",   blackmagicRawPipelineCUDA,   blackmagicRawResourceTypeBufferCUDA   },
+        { "opencl", blackmagicRawPipelineOpenCL, blackmagicRawResourceTypeBufferOpenCL },
+    };
+
+    count = sizeof(s_pipelines) / sizeof(s_pipelines[0]);
+    return s_pipelines;
+}
+
+inline const BrawPipelineType* DefaultPipelineType()
+{
+    size_t count = 0;
+    return &BrawPipelineTypes(count)[0];
+}
+
+// Returns false for unknown names; "auto" yields a null type
+bool FindPipelineType(const char* name, const BrawPipelineType*& type);
+
+// Passed as PreparePipeline user data; signalled from PreparePipelineComplete
+class BrawPipelinePrepare
+{
+public:
+    BrawPipelinePrepare() : m_result(S_OK), m_done(false) {}
+
+    void Complete(HRESULT result);
+    HRESULT Wait();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    HRESULT m_result;
+    bool m_done;
+};
+
+class BrawPipeline
+{
+public:
+    BrawPipeline();
+    ~BrawPipeline();
+
+    // Select requested (null for auto) on the codec. Must run after the
+    // codec callback is set and before any clip is opened.
+    HRESULT Configure(IBlackmagicRawFactory* factory, IBlackmagicRaw* codec,
+                      const BrawPipelineType* requested, std::string& error);
+    void Release();
+    void Swap(BrawPipeline& other);
+
+    const BrawPipelineType* Active() const { return m_active; }
+
+    // Copy a processed image's GPU buffer into host memory of size bytes
+    HRESULT ReadBack(IBlackmagicRawProcessedImage* processedImage, void* host, uint32_t size);
+
+private:
+    BrawPipeline(const BrawPipeline&);
+    BrawPipeline& operator=(const BrawPipeline&);
+
+    HRESULT TryGPU(IBlackmagicRawFactory* factory, IBlackmagicRaw* codec, const BrawPipelineType& type);
+
+    const BrawPipelineType* m_active;
+    IBlackmagicRawPipelineDevice* m_device;
+    IBlackmagicRawResourceManager* m_resourceManager;
+    void* m_context;
+    void* m_commandQueue;
+};
+
+#endif // BRAW_PIPELINE_H
@@ -0,0 +1,213 @@
+/*
+ * BrawPrefetcher - look-ahead decode into the frame cache
+ */
+
+#include "BrawPrefetcher.h"
+
+// Frames decoded with other SDK processing settings would never be hit
+static const std::string& ProcessingKey(const BrawDecodeOptions& options)
+{
+    static const std::string s_none;
+    return options.processing ? options.processing->Key() : s_none;
+}
+
+// One queued look-ahead frame. The decoded frame is cached by the clip
+// callback, so completion only has to account for the job.
+class BrawPrefetcher::Job : public BrawFrameCompletion
+{
+public:
+    Job(std::shared_ptr<BrawPrefetcher> prefetcher, uint64_t frameIndex, uint64_t jobGeneration)
+        : frame_index(frameIndex), generation(jobGeneration), m_prefetcher(prefetcher)
+    {
+    }
+
+    virtual bool Cancelled()
+    {
+        return m_prefetcher->Cancelled(*this);
+    }
+
+    virtual void FrameComplete(HRESULT result, BrawFrame&, const std::string&)
+    {
+        // Keep the prefetcher alive past our own deletion
+        std::shared_ptr<BrawPrefetcher> prefetcher = m_prefetcher;
+
+        prefetcher->JobComplete(*this, result);
+        delete this;
+    }
+
+    const uint64_t frame_index;
+    const uint64_t generation;
+
+private:
+    std::shared_ptr<BrawPrefetcher> m_prefetcher;
+};
+
+std::shared_ptr<BrawPrefetcher> BrawPrefetcher::Create(std::shared_ptr<BrawClip> clip)
+{
+    return std::shared_ptr<BrawPrefetcher>(new BrawPrefetcher(clip));
+}
+
+BrawPrefetcher::BrawPrefetcher(std::shared_ptr<BrawClip> clip)
+    : m_clip(clip), m_depth(0), m_started(false), m_position(0), m_direction(1), m_step(1),
+      m_generation(0), m_completed(0), m_cancelled(0)
+{
+}
+
+void BrawPrefetcher::SetDepth(uint32_t depth)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_depth = depth;
+    if (m_depth == 0)
+    {
+        m_started = false;
+        m_generation++;
+    }
+}
+
+void BrawPrefetcher::Detach()
+{
+    std::shared_ptr<BrawClip> clip;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_depth = 0;
+        m_started = false;
+        m_generation++;
+        clip.swap(m_clip);
+    }
+
+    // May close the clip, which waits on callbacks that take m_mutex
+    clip.reset();
+}
+
+void BrawPrefetcher::Access(uint64_t frameIndex, const BrawDecodeOptions& options)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_depth == 0 || !m_clip || !options.cache)
+        return;
+
+    // Only the decoded frame is prefetched; grades, keys, scopes and encodes of a
+    // read are worked out from the cache
+    if (!m_started || options.format != m_options.format || options.scale != m_options.scale ||
+        ProcessingKey(options) != ProcessingKey(m_options))
+    {
+        m_options = options;
+        m_options.grade.reset();
+        m_options.key = BrawKeyOptions();
+        m_options.scopes = BrawScopeOptions();
+        m_options.encode = BrawEncodeOptions();
+        m_options.priority = brawPriorityPrefetch;
+        m_generation++;
+        m_direction = 1;
+        m_step = 1;
+    }
+    else if (frameIndex != m_position)
+    {
+        int direction = frameIndex > m_position ? 1 : -1;
+        uint64_t distance = direction > 0 ? frameIndex - m_position : m_position - frameIndex;
+
+        if (distance > kMaxStep)
+        {
+            // A jump; assume forward playback from the new position
+            m_direction = 1;
+            m_step = 1;
+        }
+        else
+        {
+            m_direction = direction;
+            m_step = distance;
+        }
+    }
+
+    m_started = true;
+    m_position = frameIndex;
+
+    PumpLocked();
+}
+
+BrawPrefetchStats BrawPrefetcher::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    BrawPrefetchStats stats;
+    stats.depth = m_depth;
+    stats.direction = m_direction;
+    stats.step = m_step;
+    stats.in_flight = m_inFlight.size();
+    stats.completed = m_completed;
+    stats.cancelled = m_cancelled;
+    return stats;
+}
+
+// Queue every frame of the window that is neither cached nor in flight.
+// Stale jobs still count against depth until the SDK hands them back.
+void BrawPrefetcher::PumpLocked()
+{
+    if (!m_started || !m_clip)
+        return;
+
+    for (uint64_t ahead = 1; ahead <= m_depth && m_inFlight.size() < m_depth; ahead++)
+    {
+        uint64_t distance = ahead * m_step;
+        if (m_direction < 0 && distance > m_position)
+            break;
+
+        uint64_t frameIndex = m_direction > 0 ? m_position + distance : m_position - distance;
+
+        if (m_inFlight.count(frameIndex) || m_clip->IsFrameCached(frameIndex, m_options))
+            continue;
+
+        Job* job = new Job(shared_from_this(), frameIndex, m_generation);
+        std::string error;
+
+        // Fails past the last frame or once the clip is closed
+        if (m_clip->SubmitFrame(frameIndex, m_options, job, error) != S_OK)
+        {
+            delete job;
+            break;
+        }
+
+        m_inFlight.insert(frameIndex);
+    }
+}
+
+bool BrawPrefetcher::WantedLocked(uint64_t frameIndex, uint64_t generation) const
+{
+    if (m_depth == 0 || generation != m_generation)
+        return false;
+
+    if (m_direction > 0 ? frameIndex <= m_position : frameIndex >= m_position)
+        return false;
+
+    uint64_t distance = m_direction > 0 ? frameIndex - m_position : m_position - frameIndex;
+    return distance % m_step == 0 && distance / m_step <= m_depth;
+}
+
+// Asked from ReadComplete, before the decode is queued
+bool BrawPrefetcher::Cancelled(const Job& job)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !WantedLocked(job.frame_index, job.generation);
+}
+
+void BrawPrefetcher::JobComplete(const Job& job, HRESULT result)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_inFlight.erase(job.frame_index);
+
+    if (result == S_OK)
+        m_completed++;
+    else if (result == E_ABORT)
+        m_cancelled++;
+
+    // Refill from the SDK thread so the window stays full between reads.
+    // Not after a failed decode or a frame the cache would not keep, which
+    // would only be queued again straight away.
+    bool progressed = m_clip && (result == E_ABORT ||
+                      (result == S_OK && m_clip->IsFrameCached(job.frame_index, m_options)));
+    if (progressed)
+        PumpLocked();
+}
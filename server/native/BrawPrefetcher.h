@@ -0,0 +1,76 @@
+/*
+ * BrawPrefetcher - look-ahead decode into the frame cache
+ *
+ * Watches the frames a session reads, works out the playhead's direction
+ * and step, and keeps the next depth frames along that path queued on the
+ * codec. Decoded frames land in the shared BrawFrameCache, so the read that
+ * follows is a cache hit. When the playhead jumps or turns round, jobs that
+ * have not started decoding yet are cancelled.
+ */
+
+#ifndef BRAW_PREFETCHER_H
+#define BRAW_PREFETCHER_H
+
+#include "BrawClip.h"
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <set>
+
+struct BrawPrefetchStats
+{
+    uint32_t depth;
+    int direction; // 1 forward, -1 reverse
+    uint64_t step; // Frames between consecutive reads
+    size_t in_flight;
+    uint64_t completed;
+    uint64_t cancelled;
+};
+
+class BrawPrefetcher : public std::enable_shared_from_this<BrawPrefetcher>
+{
+public:
+    static std::shared_ptr<BrawPrefetcher> Create(std::shared_ptr<BrawClip> clip);
+
+    // 0 stops prefetching and cancels everything queued
+    void SetDepth(uint32_t depth);
+
+    // Stop for good and drop the clip reference. Call from the owner's
+    // thread before letting go, so queued jobs, which keep the prefetcher
+    // alive, never end up holding the last reference to the clip.
+    void Detach();
+
+    // Record a read of frameIndex with options and top up the look-ahead.
+    // Call after the read itself has been submitted so it is decoded first.
+    void Access(uint64_t frameIndex, const BrawDecodeOptions& options);
+
+    BrawPrefetchStats Stats();
+
+private:
+    class Job;
+
+    // Reads further apart than this are treated as a jump
+    static const uint64_t kMaxStep = 8;
+
+    explicit BrawPrefetcher(std::shared_ptr<BrawClip> clip);
+
+    void PumpLocked();
+    bool WantedLocked(uint64_t frameIndex, uint64_t generation) const;
+    bool Cancelled(const Job& job);
+    void JobComplete(const Job& job, HRESULT result);
+
+    std::shared_ptr<BrawClip> m_clip;
+    std::mutex m_mutex;
+    uint32_t m_depth;
+    BrawDecodeOptions m_options;
+    bool m_started;
+    uint64_t m_position;
+    int m_direction;
+    uint64_t m_step;
+    uint64_t m_generation; // Bumped on every jump, turn or options change
+    std::set<uint64_t> m_inFlight;
+    uint64_t m_completed;
+    uint64_t m_cancelled;
+};
+
+#endif // BRAW_PREFETCHER_H
@@ -0,0 +1,251 @@
+/*
+ * BrawPreview - poster frame and thumbnail strip for a freshly uploaded clip
+ */
+
+#include "BrawPreview.h"
+#include "BrawClip.h"
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Shared by the jobs of one BuildClipPreview; each thumbnail writes only its
+// own columns of the strip, which Wait's caller reads after all complete
+class PreviewDecode
+{
+public:
+    PreviewDecode(uint32_t thumbnails, uint32_t thumbnailWidth, uint32_t thumbnailHeight)
+        : thumbnails(thumbnails), thumbnail_width(thumbnailWidth), thumbnail_height(thumbnailHeight),
+          strip_stride(static_cast<size_t>(thumbnails) * thumbnailWidth * 4),
+          strip(strip_stride * thumbnailHeight), m_remaining(0), m_result(S_OK) {}
+
+    void Started()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_remaining++;
+    }
+
+    void Complete(HRESULT result, const std::string& error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (result != S_OK && m_result == S_OK)
+        {
+            m_result = result;
+            m_error = error;
+        }
+
+        m_remaining--;
+        if (m_remaining == 0)
+            m_condition.notify_all();
+    }
+
+    HRESULT Wait(std::string& error)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_remaining == 0; });
+
+        if (m_result != S_OK)
+            error = m_error;
+        return m_result;
+    }
+
+    const uint32_t thumbnails;
+    const uint32_t thumbnail_width;
+    const uint32_t thumbnail_height;
+    const size_t strip_stride;
+    std::vector<uint8_t> strip; // RGBA8, thumbnails side by side
+    BrawFrame poster;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    uint32_t m_remaining;
+    HRESULT m_result;
+    std::string m_error;
+};
+
+// Average each destination pixel over the source pixels it covers
+static void BoxScale(const BrawFrame& frame, uint8_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(frame.data);
+
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        uint32_t y0 = static_cast<uint32_t>(static_cast<uint64_t>(y) * frame.height / dstHeight);
+        uint32_t y1 = static_cast<uint32_t>(static_cast<uint64_t>(y + 1) * frame.height / dstHeight);
+        if (y1 <= y0)
+            y1 = y0 + 1;
+
+        uint8_t* row = dst + y * dstStride;
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+            uint32_t x0 = static_cast<uint32_t>(static_cast<uint64_t>(x) * frame.width / dstWidth);
+            uint32_t x1 = static_cast<uint32_t>(static_cast<uint64_t>(x + 1) * frame.width / dstWidth);
+            if (x1 <= x0)
+                x1 = x0 + 1;
+
+            uint32_t sums[4] = { 0, 0, 0, 0 };
+            for (uint32_t sy = y0; sy < y1; sy++)
+            {
+                const uint8_t* pixel = src + sy * frame.stride + x0 * 4;
+                for (uint32_t sx = x0; sx < x1; sx++, pixel += 4)
+                {
+                    sums[0] += pixel[0];
+                    sums[1] += pixel[1];
+                    sums[2] += pixel[2];
+                    sums[3] += pixel[3];
+                }
+            }
+
+            uint32_t count = (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < 4; c++)
+                row[x * 4 + c] = static_cast<uint8_t>((sums[c] + count / 2) / count);
+        }
+    }
+}
+
+// One decoded frame: scaled into its strip cell on the SDK thread, and kept
+// whole when it is the poster
+class PreviewJob : public BrawFrameCompletion
+{
+public:
+    PreviewJob(PreviewDecode& decode, uint32_t thumbnail, bool poster)
+        : m_decode(decode), m_thumbnail(thumbnail), m_poster(poster) {}
+
+    virtual void FrameComplete(HRESULT result, BrawFrame& frame, const std::string& error)
+    {
+        PreviewDecode& decode = m_decode;
+
+        if (result == S_OK)
+        {
+            if (m_thumbnail < decode.thumbnails)
+            {
+                uint8_t* cell = &decode.strip[static_cast<size_t>(m_thumbnail) * decode.thumbnail_width * 4];
+                BoxScale(frame, cell, decode.strip_stride, decode.thumbnail_width, decode.thumbnail_height);
+            }
+            if (m_poster)
+                decode.poster.Swap(frame);
+        }
+
+        delete this;
+        decode.Complete(result, error);
+    }
+
+private:
+    PreviewDecode& m_decode;
+    uint32_t m_thumbnail; // decode.thumbnails when the frame is not in the strip
+    bool m_poster;
+};
+
+static bool WriteImageFile(const std::string& path, const BrawImageView& image, int quality, std::string& error)
+{
+    BrawEncodeOptions options;
+    options.encoding = brawEncodingJPEG;
+    options.quality = quality;
+
+    BrawEncodedImage encoded;
+    if (!EncodeImage(image, options, encoded, error))
+        return false;
+
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+    {
+        error = "Failed to create preview file";
+        return false;
+    }
+
+    bool written = fwrite(encoded.data, 1, encoded.size, file) == encoded.size;
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        remove(temporaryPath.c_str());
+        error = "Failed to write preview file";
+        return false;
+    }
+
+    return true;
+}
+
+HRESULT BuildClipPreview(BrawClip& clip, const BrawPreviewOptions& options, BrawPreviewResult& result,
+                         std::string& error)
+{
+    const BrawClipInfo& info = clip.Info();
+    if (info.frame_count == 0 || info.width == 0 || info.height == 0)
+    {
+        error = "Clip has no frames";
+        return E_FAIL;
+    }
+
+    bool wantStrip = !options.strip_path.empty() && options.thumbnails > 0 && options.thumbnail_width > 0;
+    uint32_t thumbnails = wantStrip ? options.thumbnails : 0;
+    if (thumbnails > info.frame_count)
+        thumbnails = static_cast<uint32_t>(info.frame_count);
+
+    uint32_t thumbnailWidth = wantStrip ? options.thumbnail_width : 0;
+    uint32_t thumbnailHeight = wantStrip ? static_cast<uint32_t>(
+        (static_cast<uint64_t>(thumbnailWidth) * info.height + info.width / 2) / info.width) : 0;
+    if (wantStrip && thumbnailHeight == 0)
+        thumbnailHeight = 1;
+
+    PreviewDecode decode(thumbnails, thumbnailWidth, thumbnailHeight);
+
+    // The interactive reads this warms decode the same RGBA8 frames
+    BrawDecodeOptions decodeOptions;
+    decodeOptions.format = DefaultPixelFormat();
+    decodeOptions.scale = options.scale ? options.scale : DefaultResolutionScale();
+    decodeOptions.priority = brawPriorityBatch;
+
+    bool wantPoster = !options.poster_path.empty();
+    uint32_t jobs = thumbnails > 0 ? thumbnails : (wantPoster ? 1 : 0);
+    HRESULT submitResult = S_OK;
+
+    // Frame 0 is both the poster and the first thumbnail
+    for (uint32_t i = 0; i < jobs; i++)
+    {
+        uint64_t frameIndex = PreviewFrameIndex(i, jobs, info.frame_count);
+        PreviewJob* job = new PreviewJob(decode, i < thumbnails ? i : thumbnails, wantPoster && i == 0);
+
+        decode.Started();
+        std::string submitError;
+        submitResult = clip.SubmitFrame(frameIndex, decodeOptions, job, submitError);
+        if (submitResult != S_OK)
+        {
+            delete job;
+            decode.Complete(submitResult, submitError);
+            break;
+        }
+    }
+
+    HRESULT decodeResult = decode.Wait(error);
+    if (decodeResult != S_OK)
+        return decodeResult;
+
+    if (wantPoster)
+    {
+        BrawImageView poster = { decode.poster.data, decode.poster.format, decode.poster.width,
+                                 decode.poster.height, decode.poster.stride };
+        if (!WriteImageFile(options.poster_path, poster, options.quality, error))
+            return E_FAIL;
+
+        result.poster_width = decode.poster.width;
+        result.poster_height = decode.poster.height;
+        decode.poster.Reset();
+    }
+
+    if (thumbnails > 0)
+    {
+        BrawImageView strip = { &decode.strip[0], DefaultPixelFormat(), thumbnails * thumbnailWidth,
+                                thumbnailHeight, decode.strip_stride };
+        if (!WriteImageFile(options.strip_path, strip, options.quality, error))
+            return E_FAIL;
+
+        result.thumbnails = thumbnails;
+        result.thumbnail_width = thumbnailWidth;
+        result.thumbnail_height = thumbnailHeight;
+    }
+
+    return S_OK;
+}
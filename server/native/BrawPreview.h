@@ -0,0 +1,59 @@
+/*
+ * BrawPreview - poster frame and thumbnail strip for a freshly uploaded clip
+ *
+ * BuildClipPreview decodes frame 0 and a handful of evenly spaced frames at
+ * a reduced scale in one pipelined pass, at batch priority and through the
+ * shared frame cache, so the first interactive reads at that scale hit warm
+ * frames. The poster is saved as a JPEG of frame 0; the thumbnails are box
+ * filtered to a fixed width and saved side by side as one JPEG strip.
+ */
+
+#ifndef BRAW_PREVIEW_H
+#define BRAW_PREVIEW_H
+
+#include "BlackmagicRawAPI.h"
+#include "BrawFormat.h"
+#include <stdint.h>
+#include <string>
+
+class BrawClip;
+
+struct BrawPreviewOptions
+{
+    BrawPreviewOptions()
+        : scale(FindResolutionScale("quarter")), thumbnails(10), thumbnail_width(160), quality(85) {}
+
+    std::string poster_path; // Empty skips the poster
+    std::string strip_path; // Empty skips the strip
+
+    const BrawResolutionScale* scale;
+    uint32_t thumbnails; // Capped at the clip's frame count
+    uint32_t thumbnail_width;
+    int quality; // JPEG quality of both images
+};
+
+struct BrawPreviewResult
+{
+    BrawPreviewResult()
+        : poster_width(0), poster_height(0), thumbnails(0), thumbnail_width(0), thumbnail_height(0) {}
+
+    uint32_t poster_width;
+    uint32_t poster_height;
+    uint32_t thumbnails; // Thumbnails in the strip, left to right in frame order
+    uint32_t thumbnail_width;
+    uint32_t thumbnail_height;
+};
+
+// Frame shown by thumbnail of count, spread evenly over frameCount frames
+inline uint64_t PreviewFrameIndex(uint32_t thumbnail, uint32_t count, uint64_t frameCount)
+{
+    return count > 0 ? thumbnail * frameCount / count : 0;
+}
+
+// Decode, encode and save the preview images. Blocks; must not be called
+// from an SDK callback thread. Files are written to a temporary path and
+// renamed, so readers never see a partial image.
+HRESULT BuildClipPreview(BrawClip& clip, const BrawPreviewOptions& options, BrawPreviewResult& result,
+                         std::string& error);
+
+#endif // BRAW_PREVIEW_H
@@ -0,0 +1,280 @@
+/*
+ * BrawProcessing - SDK clip and frame processing attributes for a decode
+ */
+
+#include "BrawProcessing.h"
+#include <cstdio>
+#include <cstring>
+
+// Names follow the SDK attribute names; variant types are the ones the SDK
+// reports for each attribute
+const BrawProcessingAttribute* BrawProcessingAttributes(size_t& count)
+{
+    static const BrawProcessingAttribute s_attributes[] = {
+        { "colorScienceGen",          true,  blackmagicRawClipProcessingAttributeColorScienceGen,          blackmagicRawVariantTypeU16     },
+        { "gamma",                    true,  blackmagicRawClipProcessingAttributeGamma,                    blackmagicRawVariantTypeString  },
+        { "gamut",                    true,  blackmagicRawClipProcessingAttributeGamut,                    blackmagicRawVariantTypeString  },
+        { "toneCurveContrast",        true,  blackmagicRawClipProcessingAttributeToneCurveContrast,        blackmagicRawVariantTypeFloat32 },
+        { "toneCurveSaturation",      true,  blackmagicRawClipProcessingAttributeToneCurveSaturation,      blackmagicRawVariantTypeFloat32 },
+        { "toneCurveMidpoint",        true,  blackmagicRawClipProcessingAttributeToneCurveMidpoint,        blackmagicRawVariantTypeFloat32 },
+        { "toneCurveHighlights",      true,  blackmagicRawClipProcessingAttributeToneCurveHighlights,      blackmagicRawVariantTypeFloat32 },
+        { "toneCurveShadows",         true,  blackmagicRawClipProcessingAttributeToneCurveShadows,         blackmagicRawVariantTypeFloat32 },
+        { "toneCurveVideoBlackLevel", true,  blackmagicRawClipProcessingAttributeToneCurveVideoBlackLevel, blackmagicRawVariantTypeU16     },
+        { "toneCurveBlackLevel",      true,  blackmagicRawClipProcessingAttributeToneCurveBlackLevel,      blackmagicRawVariantTypeFloat32 },
+        { "toneCurveWhiteLevel",      true,  blackmagicRawClipProcessingAttributeToneCurveWhiteLevel,      blackmagicRawVariantTypeFloat32 },
+        { "highlightRecovery",        true,  blackmagicRawClipProcessingAttributeHighlightRecovery,        blackmagicRawVariantTypeU16     },
+        { "analogGainIsConstant",     true,  blackmagicRawClipProcessingAttributeAnalogGainIsConstant,     blackmagicRawVariantTypeU16     },
+        { "analogGain",               true,  blackmagicRawClipProcessingAttributeAnalogGain,               blackmagicRawVariantTypeFloat32 },
+        { "post3DLUTMode",            true,  blackmagicRawClipProcessingAttributePost3DLUTMode,            blackmagicRawVariantTypeString  },
+        { "whiteBalanceKelvin",       false, blackmagicRawFrameProcessingAttributeWhiteBalanceKelvin,      blackmagicRawVariantTypeU32     },
+        { "whiteBalanceTint",         false, blackmagicRawFrameProcessingAttributeWhiteBalanceTint,        blackmagicRawVariantTypeS16     },
+        { "exposure",                 false, blackmagicRawFrameProcessingAttributeExposure,                blackmagicRawVariantTypeFloat32 },
+        { "iso",                      false, blackmagicRawFrameProcessingAttributeISO,                     blackmagicRawVariantTypeU32     },
+    };
+
+    count = sizeof(s_attributes) / sizeof(s_attributes[0]);
+    return s_attributes;
+}
+
+const BrawProcessingAttribute* FindProcessingAttribute(const char* name)
+{
+    size_t count = 0;
+    const BrawProcessingAttribute* attributes = BrawProcessingAttributes(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(attributes[i].name, name) == 0)
+            return &attributes[i];
+    }
+
+    return nullptr;
+}
+
+namespace
+{
+
+// The variant borrows value's string, so it must not outlive value or be cleared
+void ToVariant(const BrawProcessingValue& value, Variant& variant)
+{
+    variant.vt = value.attribute->type;
+
+    switch (value.attribute->type)
+    {
+    case blackmagicRawVariantTypeU8:
+    case blackmagicRawVariantTypeU16: variant.uiVal = static_cast<uint16_t>(value.number); break;
+    case blackmagicRawVariantTypeS16: variant.iVal = static_cast<int16_t>(value.number); break;
+    case blackmagicRawVariantTypeS32: variant.intVal = static_cast<int32_t>(value.number); break;
+    case blackmagicRawVariantTypeU32: variant.uintVal = static_cast<uint32_t>(value.number); break;
+    case blackmagicRawVariantTypeFloat32: variant.fltVal = static_cast<float>(value.number); break;
+    case blackmagicRawVariantTypeFloat64: variant.dblVal = value.number; break;
+    case blackmagicRawVariantTypeString: variant.bstrVal = value.text.c_str(); break;
+    default: break;
+    }
+}
+
+bool FromVariant(const Variant& variant, BrawProcessingValue& value)
+{
+    switch (variant.vt)
+    {
+    case blackmagicRawVariantTypeU8:
+    case blackmagicRawVariantTypeU16: value.number = variant.uiVal; return true;
+    case blackmagicRawVariantTypeS16: value.number = variant.iVal; return true;
+    case blackmagicRawVariantTypeS32: value.number = variant.intVal; return true;
+    case blackmagicRawVariantTypeU32: value.number = variant.uintVal; return true;
+    case blackmagicRawVariantTypeFloat32: value.number = variant.fltVal; return true;
+    case blackmagicRawVariantTypeFloat64: value.number = variant.dblVal; return true;
+    case blackmagicRawVariantTypeString:
+        value.text = variant.bstrVal ? variant.bstrVal : "";
+        return true;
+    default: return false;
+    }
+}
+
+} // namespace
+
+void BrawProcessing::SetNumber(const BrawProcessingAttribute* attribute, double number)
+{
+    BrawProcessingValue value;
+    value.attribute = attribute;
+    value.number = number;
+    Set(value);
+}
+
+void BrawProcessing::SetText(const BrawProcessingAttribute* attribute, const std::string& text)
+{
+    BrawProcessingValue value;
+    value.attribute = attribute;
+    value.number = 0.0;
+    value.text = text;
+    Set(value);
+}
+
+void BrawProcessing::Set(const BrawProcessingValue& value)
+{
+    // Keep table order so equal settings give equal keys
+    std::vector<BrawProcessingValue>::iterator it = m_values.begin();
+    while (it != m_values.end() && it->attribute < value.attribute)
+        ++it;
+
+    if (it != m_values.end() && it->attribute == value.attribute)
+        *it = value;
+    else
+        m_values.insert(it, value);
+
+    UpdateKey();
+}
+
+void BrawProcessing::UpdateKey()
+{
+    m_key.clear();
+
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        const BrawProcessingValue& value = m_values[i];
+        m_key += value.attribute->name;
+        m_key += '=';
+
+        if (value.attribute->type == blackmagicRawVariantTypeString)
+        {
+            m_key += value.text;
+        }
+        else
+        {
+            char number[32];
+            snprintf(number, sizeof(number), "%.9g", value.number);
+            m_key += number;
+        }
+        m_key += ';';
+    }
+}
+
+bool BrawProcessing::HasClipAttributes() const
+{
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        if (m_values[i].attribute->clip)
+            return true;
+    }
+    return false;
+}
+
+bool BrawProcessing::HasFrameAttributes() const
+{
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        if (!m_values[i].attribute->clip)
+            return true;
+    }
+    return false;
+}
+
+HRESULT BrawProcessing::ApplyClip(IBlackmagicRawClip* clip, IBlackmagicRawClipProcessingAttributes** attributes,
+                                  std::string& error) const
+{
+    *attributes = nullptr;
+    if (!HasClipAttributes())
+        return S_OK;
+
+    IBlackmagicRawClipProcessingAttributes* clipAttributes = nullptr;
+    HRESULT result = clip->CloneClipProcessingAttributes(&clipAttributes);
+    if (result != S_OK)
+    {
+        error = "Failed to get clip processing attributes";
+        return result;
+    }
+
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        if (!m_values[i].attribute->clip)
+            continue;
+
+        Variant variant;
+        ToVariant(m_values[i], variant);
+        result = clipAttributes->SetClipAttribute(m_values[i].attribute->attribute, &variant);
+        if (result != S_OK)
+        {
+            error = std::string("Invalid value for ") + m_values[i].attribute->name;
+            clipAttributes->Release();
+            return result;
+        }
+    }
+
+    *attributes = clipAttributes;
+    return S_OK;
+}
+
+HRESULT BrawProcessing::ApplyFrame(IBlackmagicRawFrame* frame, IBlackmagicRawFrameProcessingAttributes** attributes,
+                                   std::string& error) const
+{
+    *attributes = nullptr;
+    if (!HasFrameAttributes())
+        return S_OK;
+
+    IBlackmagicRawFrameProcessingAttributes* frameAttributes = nullptr;
+    HRESULT result = frame->CloneFrameProcessingAttributes(&frameAttributes);
+    if (result != S_OK)
+    {
+        error = "Failed to get frame processing attributes";
+        return result;
+    }
+
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        if (m_values[i].attribute->clip)
+            continue;
+
+        Variant variant;
+        ToVariant(m_values[i], variant);
+        result = frameAttributes->SetFrameAttribute(m_values[i].attribute->attribute, &variant);
+        if (result != S_OK)
+        {
+            error = std::string("Invalid value for ") + m_values[i].attribute->name;
+            frameAttributes->Release();
+            return result;
+        }
+    }
+
+    *attributes = frameAttributes;
+    return S_OK;
+}
+
+HRESULT ReadClipProcessing(IBlackmagicRawClip* clip, BrawProcessing& processing, std::string& error)
+{
+    processing = BrawProcessing();
+
+    IBlackmagicRawClipProcessingAttributes* clipAttributes = nullptr;
+    HRESULT result = clip->CloneClipProcessingAttributes(&clipAttributes);
+    if (result != S_OK)
+    {
+        error = "Failed to get clip processing attributes";
+        return result;
+    }
+
+    size_t count = 0;
+    const BrawProcessingAttribute* attributes = BrawProcessingAttributes(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!attributes[i].clip)
+            continue;
+
+        Variant variant;
+        VariantInit(&variant);
+
+        BrawProcessingValue value;
+        value.attribute = &attributes[i];
+        value.number = 0.0;
+        if (clipAttributes->GetClipAttribute(attributes[i].attribute, &variant) == S_OK &&
+            FromVariant(variant, value))
+        {
+            if (attributes[i].type == blackmagicRawVariantTypeString)
+                processing.SetText(value.attribute, value.text);
+            else
+                processing.SetNumber(value.attribute, value.number);
+        }
+
+        VariantClear(&variant);
+    }
+
+    clipAttributes->Release();
+    return S_OK;
+}
@@ -0,0 +1,73 @@
+/*
+ * BrawProcessing - SDK clip and frame processing attributes for a decode
+ *
+ * Carries the RAW development settings (gamma, gamut, tone curve, white
+ * balance, exposure, ISO) a decode job hands to CreateJobDecodeAndProcessFrame,
+ * so they are applied inside the SDK's decode rather than afterwards on
+ * 8-bit pixels. Unset attributes keep the clip's own values. Each settings
+ * set has a canonical key so the frame cache keeps one entry per look.
+ */
+
+#ifndef BRAW_PROCESSING_H
+#define BRAW_PROCESSING_H
+
+#include "BlackmagicRawAPI.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct BrawProcessingAttribute
+{
+    const char* name;
+    bool clip; // Clip attribute, otherwise a frame attribute
+    uint32_t attribute; // BlackmagicRawClipProcessingAttribute or BlackmagicRawFrameProcessingAttribute
+    BlackmagicRawVariantType type;
+};
+
+const BrawProcessingAttribute* BrawProcessingAttributes(size_t& count);
+const BrawProcessingAttribute* FindProcessingAttribute(const char* name);
+
+struct BrawProcessingValue
+{
+    const BrawProcessingAttribute* attribute;
+    double number; // Numeric types; booleans are 0 or 1
+    std::string text; // blackmagicRawVariantTypeString
+};
+
+class BrawProcessing
+{
+public:
+    // Replace any earlier value of the same attribute
+    void SetNumber(const BrawProcessingAttribute* attribute, double number);
+    void SetText(const BrawProcessingAttribute* attribute, const std::string& text);
+
+    bool Empty() const { return m_values.empty(); }
+    bool HasClipAttributes() const;
+    bool HasFrameAttributes() const;
+
+    // Canonical form of the values, equal for equal settings
+    const std::string& Key() const { return m_key; }
+
+    // Clone the clip's attributes and apply the clip values to them. Leaves
+    // attributes null when there are none to apply.
+    HRESULT ApplyClip(IBlackmagicRawClip* clip, IBlackmagicRawClipProcessingAttributes** attributes,
+                      std::string& error) const;
+
+    // Clone the frame's attributes and apply the frame values to them
+    HRESULT ApplyFrame(IBlackmagicRawFrame* frame, IBlackmagicRawFrameProcessingAttributes** attributes,
+                       std::string& error) const;
+
+    const std::vector<BrawProcessingValue>& Values() const { return m_values; }
+
+private:
+    void Set(const BrawProcessingValue& value);
+    void UpdateKey();
+
+    std::vector<BrawProcessingValue> m_values; // In table order
+    std::string m_key;
+};
+
+// Read every clip attribute the clip reports; unsupported ones are skipped
+HRESULT ReadClipProcessing(IBlackmagicRawClip* clip, BrawProcessing& processing, std::string& error);
+
+#endif // BRAW_PROCESSING_H
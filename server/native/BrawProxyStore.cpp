@@ -0,0 +1,443 @@
+/*
+ * BrawProxyStore - memory-mapped pack file of reduced-scale decoded frames
+ */
+
+#include "BrawProxyStore.h"
+#include "BrawClip.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static const char kProxyMagic[8] = { 'B', 'R', 'A', 'W', 'P', 'R', 'X', '1' };
+static const uint32_t kProxyVersion = 1;
+static const uint64_t kProxyIndexOffset = 256;
+static const uint64_t kProxyPageBytes = 4096;
+
+struct ProxyHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t scale_divisor;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t frame_count;
+    uint32_t clip_width;
+    uint32_t clip_height;
+    char format[16];
+    uint64_t slot_bytes;
+    uint64_t data_offset;
+
+    // Set under the lock by the first append, before its index entry
+    uint32_t width;
+    uint32_t height;
+    uint64_t stride;
+    uint64_t frame_bytes;
+    uint64_t stored;
+};
+
+static_assert(sizeof(ProxyHeader) <= kProxyIndexOffset, "Proxy header overlaps the index");
+
+static uint64_t RoundUp(uint64_t value, uint64_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Exclusive flock for the scope; appends and (re)initialisation run under it
+class ProxyFileLock
+{
+public:
+    explicit ProxyFileLock(int fd) : m_fd(fd) { flock(m_fd, LOCK_EX); }
+    ~ProxyFileLock() { flock(m_fd, LOCK_UN); }
+
+private:
+    int m_fd;
+};
+
+bool BrawProxyStore::CanStore(const BrawPixelFormat& format, const BrawResolutionScale& scale)
+{
+    return !format.planar && format.bytes_per_sample == 1 && scale.divisor >= 4;
+}
+
+static bool SameFile(int fd, const std::string& path)
+{
+    struct stat fdStat;
+    struct stat pathStat;
+    return fstat(fd, &fdStat) == 0 && stat(path.c_str(), &pathStat) == 0 && fdStat.st_dev == pathStat.st_dev &&
+           fdStat.st_ino == pathStat.st_ino;
+}
+
+static bool HeaderMatches(int fd, const ProxyHeader& expected)
+{
+    ProxyHeader existing;
+    return pread(fd, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing)) &&
+           memcmp(existing.magic, expected.magic, sizeof(expected.magic)) == 0 &&
+           existing.version == expected.version && existing.scale_divisor == expected.scale_divisor &&
+           existing.source_size == expected.source_size && existing.source_mtime == expected.source_mtime &&
+           existing.frame_count == expected.frame_count && existing.clip_width == expected.clip_width &&
+           existing.clip_height == expected.clip_height &&
+           strncmp(existing.format, expected.format, sizeof(expected.format)) == 0 &&
+           existing.slot_bytes == expected.slot_bytes && existing.data_offset == expected.data_offset;
+}
+
+// A fresh pack stamped with header, written beside storePath and renamed
+// over it; a zeroed index past the header marks every frame missing. The
+// header and index are allocated up front, as they are written through the
+// mapping. -1 on failure.
+static int CreatePack(const std::string& storePath, const ProxyHeader& header)
+{
+    std::string tempPath = storePath + ".tmp." + std::to_string(static_cast<long>(getpid()));
+    int fd = open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    if (posix_fallocate(fd, 0, static_cast<off_t>(header.data_offset)) != 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        rename(tempPath.c_str(), storePath.c_str()) != 0)
+    {
+        close(fd);
+        unlink(tempPath.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+// The descriptor of a pack at storePath stamped with expected, or -1 with
+// error set. A pack that does not match is never truncated in place, as
+// other processes may have it mapped and hold views into it; it is
+// replaced under its own lock, and the old inode lives on until the last
+// mapping of it goes.
+static int OpenPack(const std::string& storePath, const ProxyHeader& expected, std::string& error)
+{
+    for (;;)
+    {
+        int fd = open(storePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            error = "Failed to open proxy store";
+            return -1;
+        }
+
+        int pack = -1;
+        bool replaced;
+        {
+            ProxyFileLock lock(fd);
+
+            // Another process replaced the pack while this one waited for the lock
+            replaced = !SameFile(fd, storePath);
+            if (!replaced)
+                pack = HeaderMatches(fd, expected) ? fd : CreatePack(storePath, expected);
+        }
+
+        if (pack != fd)
+            close(fd);
+        if (replaced)
+            continue;
+
+        if (pack < 0)
+            error = "Failed to initialise proxy store";
+        return pack;
+    }
+}
+
+BrawProxyStore::BrawProxyStore()
+    : m_fd(-1), m_map(nullptr), m_mapSize(0), m_frameCount(0), m_dataOffset(0), m_slotBytes(0),
+      m_format(nullptr), m_scale(nullptr), m_hits(0)
+{
+}
+
+BrawProxyStore::~BrawProxyStore()
+{
+    if (m_map)
+        munmap(m_map, m_mapSize);
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+std::shared_ptr<BrawProxyStore> BrawProxyStore::Open(const std::string& storePath, const std::string& sourcePath,
+                                                     uint64_t frameCount, uint32_t clipWidth, uint32_t clipHeight,
+                                                     const BrawPixelFormat* format, const BrawResolutionScale* scale,
+                                                     std::string& error)
+{
+    if (!format || !scale || !CanStore(*format, *scale))
+    {
+        error = "Proxies must be an 8-bit interleaved format at quarter or eighth scale";
+        return std::shared_ptr<BrawProxyStore>();
+    }
+
+    struct stat sourceStat;
+    if (stat(sourcePath.c_str(), &sourceStat) != 0)
+    {
+        error = "Failed to stat clip";
+        return std::shared_ptr<BrawProxyStore>();
+    }
+
+    uint32_t slotWidth = (clipWidth + scale->divisor - 1) / scale->divisor;
+    uint32_t slotHeight = (clipHeight + scale->divisor - 1) / scale->divisor;
+
+    ProxyHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    memcpy(expected.magic, kProxyMagic, sizeof(kProxyMagic));
+    expected.version = kProxyVersion;
+    expected.scale_divisor = scale->divisor;
+    expected.source_size = static_cast<uint64_t>(sourceStat.st_size);
+    expected.source_mtime = static_cast<int64_t>(sourceStat.st_mtime);
+    expected.frame_count = frameCount;
+    expected.clip_width = clipWidth;
+    expected.clip_height = clipHeight;
+    strncpy(expected.format, format->name, sizeof(expected.format) - 1);
+    expected.slot_bytes = RoundUp(PixelFormatStride(*format, slotWidth) * slotHeight, kProxyPageBytes);
+    expected.data_offset = RoundUp(kProxyIndexOffset + frameCount * sizeof(uint64_t), kProxyPageBytes);
+
+    std::shared_ptr<BrawProxyStore> store(new BrawProxyStore());
+    store->m_fd = OpenPack(storePath, expected, error);
+    if (store->m_fd < 0)
+        return std::shared_ptr<BrawProxyStore>();
+
+    // Mapped at full capacity up front; slots past the end of the file are
+    // never touched until an append has extended it over them
+    store->m_frameCount = frameCount;
+    store->m_dataOffset = expected.data_offset;
+    store->m_slotBytes = expected.slot_bytes;
+    store->m_format = format;
+    store->m_scale = scale;
+    store->m_mapSize = static_cast<size_t>(expected.data_offset + frameCount * expected.slot_bytes);
+
+    void* map = mmap(nullptr, store->m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, store->m_fd, 0);
+    if (map == MAP_FAILED)
+    {
+        error = "Failed to map proxy store";
+        return std::shared_ptr<BrawProxyStore>();
+    }
+    store->m_map = static_cast<uint8_t*>(map);
+
+    return store;
+}
+
+// Published last by Append, so a non-zero entry means the slot is complete
+uint64_t BrawProxyStore::IndexEntry(uint64_t frameIndex) const
+{
+    const uint64_t* index = reinterpret_cast<const uint64_t*>(m_map + kProxyIndexOffset);
+    return __atomic_load_n(&index[frameIndex], __ATOMIC_ACQUIRE);
+}
+
+bool BrawProxyStore::Contains(uint64_t frameIndex) const
+{
+    return frameIndex < m_frameCount && IndexEntry(frameIndex) != 0;
+}
+
+std::shared_ptr<BrawCachedFrame> BrawProxyStore::Lookup(uint64_t frameIndex)
+{
+    if (frameIndex >= m_frameCount)
+        return std::shared_ptr<BrawCachedFrame>();
+
+    uint64_t offset = IndexEntry(frameIndex);
+    const ProxyHeader& header = *reinterpret_cast<const ProxyHeader*>(m_map);
+    if (offset < m_dataOffset || offset + header.frame_bytes > m_mapSize)
+        return std::shared_ptr<BrawCachedFrame>();
+
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return std::make_shared<BrawCachedFrame>(std::shared_ptr<const void>(shared_from_this()), m_map + offset,
+                                             static_cast<size_t>(header.frame_bytes), m_format, header.width,
+                                             header.height, static_cast<size_t>(header.stride));
+}
+
+bool BrawProxyStore::Append(uint64_t frameIndex, const BrawFrame& frame, std::string& error)
+{
+    if (frameIndex >= m_frameCount)
+    {
+        error = "Frame index out of range";
+        return false;
+    }
+    if (frame.format != m_format || !frame.data || frame.size > m_slotBytes)
+    {
+        error = "Frame does not fit the proxy store";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    ProxyFileLock lock(m_fd);
+
+    if (IndexEntry(frameIndex) != 0)
+        return true;
+
+    ProxyHeader& header = *reinterpret_cast<ProxyHeader*>(m_map);
+    if (header.frame_bytes != 0 &&
+        (header.frame_bytes != frame.size || header.width != frame.width || header.height != frame.height))
+    {
+        error = "Frame size differs from the stored proxies";
+        return false;
+    }
+
+    // Slots are appended at the end of the file, whichever frame they hold
+    struct stat fileStat;
+    if (fstat(m_fd, &fileStat) != 0)
+    {
+        error = "Failed to stat proxy store";
+        return false;
+    }
+
+    uint64_t offset = RoundUp(static_cast<uint64_t>(fileStat.st_size), kProxyPageBytes);
+    if (offset < m_dataOffset)
+        offset = m_dataOffset;
+    if (offset + m_slotBytes > m_mapSize)
+    {
+        error = "Proxy store is full";
+        return false;
+    }
+    // Allocated, not just extended: a sparse slot the disk cannot back would
+    // fault with SIGBUS on the copy below instead of failing here
+    if (posix_fallocate(m_fd, static_cast<off_t>(offset), static_cast<off_t>(m_slotBytes)) != 0)
+    {
+        error = "Failed to extend proxy store";
+        return false;
+    }
+
+    if (header.frame_bytes == 0)
+    {
+        header.width = frame.width;
+        header.height = frame.height;
+        header.stride = frame.stride;
+        header.frame_bytes = frame.size;
+    }
+
+    memcpy(m_map + offset, frame.data, frame.size);
+    header.stored++;
+
+    uint64_t* index = reinterpret_cast<uint64_t*>(m_map + kProxyIndexOffset);
+    __atomic_store_n(&index[frameIndex], offset, __ATOMIC_RELEASE);
+    return true;
+}
+
+void BrawProxyStore::Info(BrawProxyInfo& info) const
+{
+    const ProxyHeader& header = *reinterpret_cast<const ProxyHeader*>(m_map);
+
+    info.frame_count = m_frameCount;
+    info.stored = header.stored;
+    info.width = header.width;
+    info.height = header.height;
+    info.format = m_format;
+    info.scale = m_scale;
+}
+
+// Shared by the jobs of one BuildProxies, like the metadata scan
+class ProxyBuild
+{
+public:
+    ProxyBuild(BrawProxyStore& store) : store(store), built(0), m_inFlight(0), m_result(S_OK) {}
+
+    bool Acquire(uint32_t maxInFlight)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this, maxInFlight] { return m_inFlight < maxInFlight; });
+        if (m_result != S_OK)
+            return false;
+        m_inFlight++;
+        return true;
+    }
+
+    void Complete(HRESULT result, const std::string& error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (result != S_OK && m_result == S_OK)
+        {
+            m_result = result;
+            m_error = error;
+        }
+        else if (result == S_OK)
+        {
+            built++;
+        }
+
+        m_inFlight--;
+        m_condition.notify_all();
+    }
+
+    HRESULT Wait(std::string& error)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_inFlight == 0; });
+
+        if (m_result != S_OK)
+            error = m_error;
+        return m_result;
+    }
+
+    BrawProxyStore& store;
+    uint64_t built;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    uint32_t m_inFlight;
+    HRESULT m_result;
+    std::string m_error;
+};
+
+class ProxyJob : public BrawFrameCompletion
+{
+public:
+    ProxyJob(ProxyBuild& build, uint64_t frameIndex) : m_build(build), m_frameIndex(frameIndex) {}
+
+    virtual void FrameComplete(HRESULT result, BrawFrame& frame, const std::string& error)
+    {
+        ProxyBuild& build = m_build;
+        std::string appendError = error;
+
+        if (result == S_OK && !build.store.Append(m_frameIndex, frame, appendError))
+            result = E_FAIL;
+
+        frame.Reset();
+        delete this;
+        build.Complete(result, appendError);
+    }
+
+private:
+    ProxyBuild& m_build;
+    uint64_t m_frameIndex;
+};
+
+HRESULT BuildProxies(BrawClip& clip, BrawProxyStore& store, uint32_t maxInFlight, uint64_t& built,
+                     std::string& error)
+{
+    BrawDecodeOptions options;
+    options.format = store.Format();
+    options.scale = store.Scale();
+    options.cache = false;
+    options.priority = brawPriorityBatch;
+
+    if (maxInFlight == 0)
+        maxInFlight = 1;
+
+    ProxyBuild build(store);
+    uint64_t frameCount = clip.Info().frame_count;
+
+    for (uint64_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+    {
+        if (store.Contains(frameIndex))
+            continue;
+        if (!build.Acquire(maxInFlight))
+            break;
+
+        ProxyJob* job = new ProxyJob(build, frameIndex);
+        std::string submitError;
+        HRESULT result = clip.SubmitFrame(frameIndex, options, job, submitError);
+        if (result != S_OK)
+        {
+            delete job;
+            build.Complete(result, submitError);
+            break;
+        }
+    }
+
+    HRESULT result = build.Wait(error);
+    built = build.built;
+    return result;
+}
@@ -0,0 +1,100 @@
+/*
+ * BrawProxyStore - memory-mapped pack file of reduced-scale decoded frames
+ *
+ * One file per clip: a header stamped with the source's size and mtime, a
+ * frame-offset index, then fixed-size page-aligned frame slots appended in
+ * the order frames are stored. The whole file is mapped shared once, so a
+ * stored frame is read with no syscall and no copy, and every process
+ * mapping the same clip shares its pages through the page cache. Appends
+ * take an flock, so several processes may fill one store.
+ */
+
+#ifndef BRAW_PROXY_STORE_H
+#define BRAW_PROXY_STORE_H
+
+#include "BlackmagicRawAPI.h"
+#include "BrawFormat.h"
+#include "BrawFrameCache.h"
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class BrawClip;
+class BrawFrame;
+
+struct BrawProxyInfo
+{
+    uint64_t frame_count;
+    uint64_t stored;
+    uint32_t width; // 0 until the first frame is stored
+    uint32_t height;
+    const BrawPixelFormat* format;
+    const BrawResolutionScale* scale;
+};
+
+class BrawProxyStore : public std::enable_shared_from_this<BrawProxyStore>
+{
+public:
+    // Only 8-bit interleaved formats, at a reduced scale, are stored
+    static bool CanStore(const BrawPixelFormat& format, const BrawResolutionScale& scale);
+
+    // Open or create the store at storePath for the clip at sourcePath. A
+    // store left by a different source, clip size, format or scale is
+    // replaced by a fresh file; stores already open on the old one keep it.
+    static std::shared_ptr<BrawProxyStore> Open(const std::string& storePath, const std::string& sourcePath,
+                                                uint64_t frameCount, uint32_t clipWidth, uint32_t clipHeight,
+                                                const BrawPixelFormat* format, const BrawResolutionScale* scale,
+                                                std::string& error);
+    ~BrawProxyStore();
+
+    const BrawPixelFormat* Format() const { return m_format; }
+    const BrawResolutionScale* Scale() const { return m_scale; }
+
+    // Whether frames decoded with these settings are the ones stored
+    bool Matches(const BrawPixelFormat* format, const BrawResolutionScale* scale) const
+    {
+        return format == m_format && scale == m_scale;
+    }
+
+    bool Contains(uint64_t frameIndex) const;
+
+    // A view of the stored pixels that keeps the mapping alive; null when
+    // the frame has not been stored
+    std::shared_ptr<BrawCachedFrame> Lookup(uint64_t frameIndex);
+
+    // Copy a decoded frame into the next slot. Frames already stored (by
+    // this or another process) are left alone.
+    bool Append(uint64_t frameIndex, const BrawFrame& frame, std::string& error);
+
+    void Info(BrawProxyInfo& info) const;
+
+    uint64_t Hits() const { return m_hits.load(std::memory_order_relaxed); }
+
+private:
+    BrawProxyStore();
+    BrawProxyStore(const BrawProxyStore&);
+    BrawProxyStore& operator=(const BrawProxyStore&);
+
+    uint64_t IndexEntry(uint64_t frameIndex) const;
+
+    int m_fd;
+    uint8_t* m_map;
+    size_t m_mapSize;
+    uint64_t m_frameCount;
+    uint64_t m_dataOffset;
+    uint64_t m_slotBytes;
+    const BrawPixelFormat* m_format;
+    const BrawResolutionScale* m_scale;
+    std::atomic<uint64_t> m_hits;
+    std::mutex m_mutex; // flock does not exclude threads sharing the descriptor
+};
+
+// Decode every frame not yet in store through clip, keeping maxInFlight
+// jobs queued at batch priority. Blocks; must not be called from an SDK
+// callback thread. built is the number of frames added.
+HRESULT BuildProxies(BrawClip& clip, BrawProxyStore& store, uint32_t maxInFlight, uint64_t& built,
+                     std::string& error);
+
+#endif // BRAW_PROXY_STORE_H
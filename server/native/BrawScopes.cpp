@@ -0,0 +1,270 @@
+/*
+ * BrawScopes - histogram, waveform and vectorscope of a decoded frame
+ */
+
+#include "BrawScopes.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <utility>
+
+// Fewer rows than this per thread and the spawn costs more than it saves
+static const unsigned int kMinRowsPerThread = 64;
+static const unsigned int kMaxScopeThreads = 16;
+
+void BrawScopes::Reset()
+{
+    valid = false;
+    waveform_width = 0;
+    waveform_height = 0;
+    vectorscope_size = 0;
+    std::vector<uint8_t>().swap(waveform);
+    std::vector<uint8_t>().swap(vectorscope);
+}
+
+void BrawScopes::Swap(BrawScopes& other)
+{
+    std::swap(valid, other.valid);
+    std::swap(histogram, other.histogram);
+    std::swap(waveform_width, other.waveform_width);
+    std::swap(waveform_height, other.waveform_height);
+    waveform.swap(other.waveform);
+    std::swap(vectorscope_size, other.vectorscope_size);
+    vectorscope.swap(other.vectorscope);
+}
+
+namespace
+{
+
+// Raw counts for one band of rows
+struct ScopeCounts
+{
+    explicit ScopeCounts(const BrawScopeOptions& options)
+        : waveform(static_cast<size_t>(options.waveform_width) * options.waveform_height),
+          vectorscope(static_cast<size_t>(options.vectorscope_size) * options.vectorscope_size)
+    {
+        memset(histogram, 0, sizeof(histogram));
+    }
+
+    uint32_t histogram[brawHistogramChannels][BrawScopes::kHistogramBins];
+    std::vector<uint32_t> waveform;
+    std::vector<uint32_t> vectorscope;
+};
+
+#if defined(BRAW_SSSE3)
+// The 4-channel 8-bit part of DeinterleaveRow; returns the pixels done
+BRAW_TARGET_SSSE3 unsigned int DeinterleaveRow8SSSE3(const uint8_t* src, unsigned int red, unsigned int blue,
+                                                      unsigned int width, uint8_t* r, uint8_t* g, uint8_t* b)
+{
+    // Gather each register's 4 pixels into R, G, B, A dwords, then
+    // transpose 4 registers into 16-byte planes
+    uint8_t shuffle[16];
+    const unsigned int order[4] = { red, 1, blue, 3 };
+    for (unsigned int k = 0; k < 4; k++)
+        for (unsigned int p = 0; p < 4; p++)
+            shuffle[k * 4 + p] = static_cast<uint8_t>(p * 4 + order[k]);
+
+    __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle));
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i* in = reinterpret_cast<const __m128i*>(src + x * 4);
+        __m128i t0 = _mm_shuffle_epi8(_mm_loadu_si128(in + 0), mask);
+        __m128i t1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), mask);
+        __m128i t2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), mask);
+        __m128i t3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), mask);
+        __m128i rg01 = _mm_unpacklo_epi32(t0, t1);
+        __m128i rg23 = _mm_unpacklo_epi32(t2, t3);
+        __m128i ba01 = _mm_unpackhi_epi32(t0, t1);
+        __m128i ba23 = _mm_unpackhi_epi32(t2, t3);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r + x), _mm_unpacklo_epi64(rg01, rg23));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(g + x), _mm_unpackhi_epi64(rg01, rg23));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(b + x), _mm_unpacklo_epi64(ba01, ba23));
+    }
+    return x;
+}
+#endif
+
+// Split one row into 8-bit R, G and B planes
+void DeinterleaveRow(const void* srcRow, const BrawPixelFormat& format, unsigned int width,
+                     uint8_t* r, uint8_t* g, uint8_t* b)
+{
+    unsigned int channels = format.channels;
+    unsigned int red = PixelFormatRedIndex(format);
+    unsigned int blue = 2 - red;
+    unsigned int x = 0;
+
+    if (format.bytes_per_sample == 2)
+    {
+        const uint16_t* src = static_cast<const uint16_t*>(srcRow);
+        for (; x < width; x++, src += channels)
+        {
+            r[x] = static_cast<uint8_t>(src[red] >> 8);
+            g[x] = static_cast<uint8_t>(src[1] >> 8);
+            b[x] = static_cast<uint8_t>(src[blue] >> 8);
+        }
+        return;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(srcRow);
+
+#if defined(BRAW_SSSE3)
+    if (channels == 4 && HaveSSSE3())
+        x = DeinterleaveRow8SSSE3(src, red, blue, width, r, g, b);
+#elif defined(__ARM_NEON)
+    if (channels == 4)
+    {
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t pixels = vld4q_u8(src + x * 4);
+            vst1q_u8(r + x, pixels.val[red]);
+            vst1q_u8(g + x, pixels.val[1]);
+            vst1q_u8(b + x, pixels.val[blue]);
+        }
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        const uint8_t* pixel = src + x * channels;
+        r[x] = pixel[red];
+        g[x] = pixel[1];
+        b[x] = pixel[blue];
+    }
+}
+
+void CountRows(const BrawImageView& image, const BrawScopeOptions& options, const std::vector<uint32_t>& columns,
+               unsigned int firstRow, unsigned int endRow, ScopeCounts& counts)
+{
+    const unsigned int width = image.width;
+    const int levels = static_cast<int>(options.waveform_height);
+    const int size = static_cast<int>(options.vectorscope_size);
+    const int half = size / 2;
+
+    // Rec. 601 U/V scaled to the square, in 16.16 fixed point
+    const int uScale = static_cast<int>(0.565 / 255.0 * size * 65536.0 + 0.5);
+    const int vScale = static_cast<int>(0.713 / 255.0 * size * 65536.0 + 0.5);
+
+    std::vector<uint8_t> planes(static_cast<size_t>(width) * 5);
+    uint8_t* r = &planes[0];
+    uint8_t* g = r + width;
+    uint8_t* b = g + width;
+    uint8_t* luma = b + width;
+    uint8_t* luma601 = luma + width;
+
+    const uint8_t* row = static_cast<const uint8_t*>(image.data) + image.stride * firstRow;
+    for (unsigned int y = firstRow; y < endRow; y++, row += image.stride)
+    {
+        DeinterleaveRow(row, *image.format, width, r, g, b);
+
+        // Plain loops over planes so the compiler can vectorise them
+        for (unsigned int x = 0; x < width; x++)
+        {
+            luma[x] = static_cast<uint8_t>((54 * r[x] + 183 * g[x] + 19 * b[x] + 128) >> 8);
+            luma601[x] = static_cast<uint8_t>((77 * r[x] + 150 * g[x] + 29 * b[x] + 128) >> 8);
+        }
+
+        for (unsigned int x = 0; x < width; x++)
+        {
+            counts.histogram[brawHistogramRed][r[x]]++;
+            counts.histogram[brawHistogramGreen][g[x]]++;
+            counts.histogram[brawHistogramBlue][b[x]]++;
+            counts.histogram[brawHistogramLuma][luma[x]]++;
+
+            int level = levels - 1 - ((luma[x] * levels) >> 8);
+            counts.waveform[static_cast<size_t>(level) * options.waveform_width + columns[x]]++;
+
+            int u = half + (((b[x] - luma601[x]) * uScale) >> 16);
+            int v = half - (((r[x] - luma601[x]) * vScale) >> 16);
+            u = std::min(std::max(u, 0), size - 1);
+            v = std::min(std::max(v, 0), size - 1);
+            counts.vectorscope[static_cast<size_t>(v) * size + u]++;
+        }
+    }
+}
+
+// Scale so the largest count becomes 255
+void Normalise(const std::vector<uint32_t>& counts, std::vector<uint8_t>& out)
+{
+    uint32_t maxCount = 0;
+    for (size_t i = 0; i < counts.size(); i++)
+        maxCount = std::max(maxCount, counts[i]);
+
+    out.assign(counts.size(), 0);
+    if (maxCount == 0)
+        return;
+
+    for (size_t i = 0; i < counts.size(); i++)
+        out[i] = static_cast<uint8_t>((static_cast<uint64_t>(counts[i]) * 255 + maxCount / 2) / maxCount);
+}
+
+} // namespace
+
+bool ComputeImageScopes(const BrawImageView& image, const BrawScopeOptions& options, BrawScopes& scopes,
+                        std::string& error)
+{
+    scopes.Reset();
+
+    if (!CanComputeScopes(*image.format))
+    {
+        error = std::string("Cannot compute scopes for pixel format ") + image.format->name;
+        return false;
+    }
+    if (options.waveform_width < kBrawScopeMinSize || options.waveform_width > kBrawScopeMaxSize ||
+        options.waveform_height < kBrawScopeMinSize || options.waveform_height > kBrawScopeMaxSize ||
+        options.vectorscope_size < kBrawScopeMinSize || options.vectorscope_size > kBrawScopeMaxSize)
+    {
+        error = "Scope size out of range";
+        return false;
+    }
+    if (image.width == 0 || image.height == 0)
+    {
+        error = "Empty image";
+        return false;
+    }
+
+    std::vector<uint32_t> columns(image.width);
+    for (unsigned int x = 0; x < image.width; x++)
+        columns[x] = static_cast<uint32_t>(static_cast<uint64_t>(x) * options.waveform_width / image.width);
+
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, kMaxScopeThreads);
+    threads = std::max(1u, std::min(threads, image.height / kMinRowsPerThread));
+
+    std::vector<ScopeCounts> counts(threads, ScopeCounts(options));
+    std::vector<std::thread> workers;
+    unsigned int rowsPerThread = (image.height + threads - 1) / threads;
+
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        unsigned int firstRow = std::min(image.height, i * rowsPerThread);
+        unsigned int endRow = std::min(image.height, firstRow + rowsPerThread);
+        workers.push_back(std::thread(CountRows, std::cref(image), std::cref(options), std::cref(columns),
+                                      firstRow, endRow, std::ref(counts[i])));
+    }
+    CountRows(image, options, columns, 0, std::min(image.height, rowsPerThread), counts[0]);
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    ScopeCounts& total = counts[0];
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        for (unsigned int c = 0; c < brawHistogramChannels; c++)
+            for (unsigned int bin = 0; bin < BrawScopes::kHistogramBins; bin++)
+                total.histogram[c][bin] += counts[i].histogram[c][bin];
+        for (size_t k = 0; k < total.waveform.size(); k++)
+            total.waveform[k] += counts[i].waveform[k];
+        for (size_t k = 0; k < total.vectorscope.size(); k++)
+            total.vectorscope[k] += counts[i].vectorscope[k];
+    }
+
+    memcpy(scopes.histogram, total.histogram, sizeof(scopes.histogram));
+    scopes.waveform_width = options.waveform_width;
+    scopes.waveform_height = options.waveform_height;
+    Normalise(total.waveform, scopes.waveform);
+    scopes.vectorscope_size = options.vectorscope_size;
+    Normalise(total.vectorscope, scopes.vectorscope);
+    scopes.valid = true;
+    return true;
+}
@@ -0,0 +1,76 @@
+/*
+ * BrawScopes - histogram, waveform and vectorscope of a decoded frame
+ *
+ * Computed from the decoded buffer on the SDK thread, split across worker
+ * threads by rows, so clients get a few KB of scope data with the frame
+ * instead of the full image. The 8-bit deinterleave uses NEON, or SSSE3
+ * where the CPU has it, as BrawImageWriter's swizzle does. Density maps
+ * are scaled so the busiest cell is 255, the same linear normalisation
+ * ScopeRenderer applies.
+ */
+
+#ifndef BRAW_SCOPES_H
+#define BRAW_SCOPES_H
+
+#include "BrawImageWriter.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct BrawScopeOptions
+{
+    BrawScopeOptions() : enabled(false), waveform_width(256), waveform_height(128), vectorscope_size(128) {}
+
+    bool enabled;
+    uint32_t waveform_width;   // Columns, each covering an equal slice of the image width
+    uint32_t waveform_height;  // Luma levels
+    uint32_t vectorscope_size; // Square side
+};
+
+// Smallest and largest waveform/vectorscope side accepted
+static const uint32_t kBrawScopeMinSize = 16;
+static const uint32_t kBrawScopeMaxSize = 1024;
+
+enum BrawHistogramChannel
+{
+    brawHistogramRed,
+    brawHistogramGreen,
+    brawHistogramBlue,
+    brawHistogramLuma, // Rec. 709
+    brawHistogramChannels,
+};
+
+struct BrawScopes
+{
+    static const unsigned int kHistogramBins = 256;
+
+    BrawScopes() : valid(false), waveform_width(0), waveform_height(0), vectorscope_size(0) {}
+
+    void Reset();
+    void Swap(BrawScopes& other);
+
+    bool valid;
+
+    // Pixel counts per 8-bit level; 16-bit sources are binned by their top byte
+    uint32_t histogram[brawHistogramChannels][kHistogramBins];
+
+    // Luma per column, row 0 brightest
+    uint32_t waveform_width;
+    uint32_t waveform_height;
+    std::vector<uint8_t> waveform;
+
+    // Rec. 601 U right and V up, centred; U and V of +-0.5 reach the edges
+    uint32_t vectorscope_size;
+    std::vector<uint8_t> vectorscope;
+};
+
+// Scopes read interleaved 8/16-bit RGB(A) layouts
+inline bool CanComputeScopes(const BrawPixelFormat& format)
+{
+    return IsIntegerInterleaved(format);
+}
+
+bool ComputeImageScopes(const BrawImageView& image, const BrawScopeOptions& options, BrawScopes& scopes,
+                        std::string& error);
+
+#endif // BRAW_SCOPES_H
@@ -0,0 +1,161 @@
+/*
+ * BrawStats - process-wide per-stage decode timing
+ */
+
+#include "BrawStats.h"
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdint>
+
+const char* StageName(BrawStage stage)
+{
+    static const char* const s_names[brawStageCount] = {
+        "factory", "open", "queue", "read", "decode", "copy", "grade", "key", "scopes", "encode", "total",
+    };
+
+    return stage < brawStageCount ? s_names[stage] : "unknown";
+}
+
+uint64_t StagePercentile(const BrawStageStats& stage, double q)
+{
+    if (stage.count == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(stage.count - 1)) + 1;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < kBrawStatsBuckets; i++)
+    {
+        seen += stage.buckets[i];
+        if (seen >= rank)
+            return StageBucketLimit(i) < stage.max_ns ? StageBucketLimit(i) : stage.max_ns;
+    }
+
+    return stage.max_ns;
+}
+
+uint64_t PeakMemoryBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+    // Linux reports kilobytes
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+BrawStats& BrawStats::Shared()
+{
+    static BrawStats s_stats;
+    return s_stats;
+}
+
+BrawStats::BrawStats()
+    : m_enabled(false), m_frames(0), m_bytes(0), m_encodedBytes(0), m_errors(0), m_cancelled(0)
+{
+    for (int i = 0; i < brawStageCount; i++)
+    {
+        Stage& stage = m_stages[i];
+        stage.count = 0;
+        stage.total_ns = 0;
+        stage.min_ns = UINT64_MAX;
+        stage.max_ns = 0;
+        for (int bucket = 0; bucket < kBrawStatsBuckets; bucket++)
+            stage.buckets[bucket] = 0;
+    }
+}
+
+uint64_t BrawStats::Now() const
+{
+    if (!Enabled())
+        return 0;
+
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void BrawStats::Record(BrawStage stage, uint64_t start)
+{
+    if (start == 0)
+        return;
+
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    uint64_t duration = now > start ? now - start : 0;
+
+    int bucket = 0;
+    while (bucket < kBrawStatsBuckets - 1 && duration >= StageBucketLimit(bucket))
+        bucket++;
+
+    Stage& counters = m_stages[stage];
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.total_ns.fetch_add(duration, std::memory_order_relaxed);
+    counters.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t previous = counters.min_ns.load(std::memory_order_relaxed);
+    while (duration < previous && !counters.min_ns.compare_exchange_weak(previous, duration, std::memory_order_relaxed))
+    {
+    }
+
+    previous = counters.max_ns.load(std::memory_order_relaxed);
+    while (duration > previous && !counters.max_ns.compare_exchange_weak(previous, duration, std::memory_order_relaxed))
+    {
+    }
+}
+
+void BrawStats::CountFrame(size_t bytes, size_t encodedBytes)
+{
+    if (!Enabled())
+        return;
+
+    m_frames.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    m_encodedBytes.fetch_add(encodedBytes, std::memory_order_relaxed);
+}
+
+void BrawStats::CountError()
+{
+    if (Enabled())
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BrawStats::CountCancelled()
+{
+    if (Enabled())
+        m_cancelled.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t BrawStats::Take(std::atomic<uint64_t>& counter, bool reset, uint64_t initial)
+{
+    return reset ? counter.exchange(initial, std::memory_order_relaxed) : counter.load(std::memory_order_relaxed);
+}
+
+// Counters are read one at a time, so a snapshot taken mid-decode may be off
+// by the frames in flight; fine for monitoring
+void BrawStats::Snapshot(BrawStatsSnapshot& snapshot, bool reset)
+{
+    snapshot.enabled = Enabled();
+
+    for (int i = 0; i < brawStageCount; i++)
+    {
+        Stage& counters = m_stages[i];
+        BrawStageStats& stage = snapshot.stages[i];
+
+        stage.count = Take(counters.count, reset);
+        stage.total_ns = Take(counters.total_ns, reset);
+        stage.min_ns = Take(counters.min_ns, reset, UINT64_MAX);
+        stage.max_ns = Take(counters.max_ns, reset);
+        for (int bucket = 0; bucket < kBrawStatsBuckets; bucket++)
+            stage.buckets[bucket] = Take(counters.buckets[bucket], reset);
+
+        if (stage.count == 0)
+            stage.min_ns = 0;
+    }
+
+    snapshot.frames = Take(m_frames, reset);
+    snapshot.bytes = Take(m_bytes, reset);
+    snapshot.encoded_bytes = Take(m_encodedBytes, reset);
+    snapshot.errors = Take(m_errors, reset);
+    snapshot.cancelled = Take(m_cancelled, reset);
+    snapshot.peak_rss = PeakMemoryBytes();
+}
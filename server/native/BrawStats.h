@@ -0,0 +1,116 @@
+/*
+ * BrawStats - process-wide per-stage decode timing
+ *
+ * Every decode passes through the same stages: factory and clip open, the
+ * wait in the clip's priority queue, the SDK read, the SDK decode and
+ * process, the copy to host memory, then grade, scopes and encode. When
+ * enabled, each stage records its duration into a log2 nanosecond
+ * histogram with lock-free counters, so the SDK threads pay a clock read and
+ * a few atomic adds per stage. Disabled (the default), the clock is not read.
+ */
+
+#ifndef BRAW_STATS_H
+#define BRAW_STATS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <cstddef>
+
+enum BrawStage
+{
+    brawStageFactory,
+    brawStageOpen, // CreateCodec, pipeline setup and OpenClip
+    brawStageQueue, // Waiting for a slot under BrawOpenOptions::max_jobs
+    brawStageRead, // Submit to ReadComplete
+    brawStageDecode, // ReadComplete to ProcessComplete: the SDK decode and process job
+    brawStageCopy, // Mapping or reading back the processed image
+    brawStageGrade,
+    brawStageKey,
+    brawStageScopes,
+    brawStageEncode,
+    brawStageTotal, // SubmitFrame to completion
+    brawStageCount
+};
+
+const char* StageName(BrawStage stage);
+
+// Bucket i counts durations in [2^i, 2^(i+1)) ns; the last is open-ended
+const int kBrawStatsBuckets = 40;
+
+struct BrawStageStats
+{
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t buckets[kBrawStatsBuckets];
+};
+
+struct BrawStatsSnapshot
+{
+    bool enabled;
+    BrawStageStats stages[brawStageCount];
+    uint64_t frames; // Decoded by the SDK; cache hits are counted by the frame cache
+    uint64_t bytes; // Decoded pixel bytes of those frames
+    uint64_t encoded_bytes;
+    uint64_t errors;
+    uint64_t cancelled;
+    uint64_t peak_rss; // Bytes, for the whole process
+};
+
+// Upper bound of the bucket holding the q-th quantile (0..1); 0 when empty
+uint64_t StagePercentile(const BrawStageStats& stage, double q);
+
+// Upper bound in ns of bucket
+inline uint64_t StageBucketLimit(int bucket) { return uint64_t(1) << (bucket + 1); }
+
+// Peak resident set size of the process, in bytes
+uint64_t PeakMemoryBytes();
+
+class BrawStats
+{
+public:
+    static BrawStats& Shared();
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Stage start time in ns; 0 while disabled, which Record ignores
+    uint64_t Now() const;
+
+    // Record the time from start (a Now() value) until now
+    void Record(BrawStage stage, uint64_t start);
+
+    void CountFrame(size_t bytes, size_t encodedBytes);
+    void CountError();
+    void CountCancelled();
+
+    // reset zeroes the counters once read, for interval scraping
+    void Snapshot(BrawStatsSnapshot& snapshot, bool reset);
+
+private:
+    struct Stage
+    {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> min_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint64_t> buckets[kBrawStatsBuckets];
+    };
+
+    BrawStats();
+    BrawStats(const BrawStats&);
+    BrawStats& operator=(const BrawStats&);
+
+    static uint64_t Take(std::atomic<uint64_t>& counter, bool reset, uint64_t initial = 0);
+
+    std::atomic<bool> m_enabled;
+    Stage m_stages[brawStageCount];
+    std::atomic<uint64_t> m_frames;
+    std::atomic<uint64_t> m_bytes;
+    std::atomic<uint64_t> m_encodedBytes;
+    std::atomic<uint64_t> m_errors;
+    std::atomic<uint64_t> m_cancelled;
+};
+
+#endif // BRAW_STATS_H
@@ -0,0 +1,91 @@
+/*
+ * BrawTimebase - exact frame rates and timestamp to frame index mapping
+ *
+ * The SDK reports a clip's frame rate as a float, so 23.976 fps comes back
+ * as 23.9759998. Frame times computed from that drift from the camera's
+ * 24000/1001 timebase and floor(timestamp * fps) lands one frame early on a
+ * frame's own start time. TimebaseForRate snaps the float to the rational
+ * rate it stands for; FrameAtTime maps seconds to a frame index on that
+ * timebase. Header-only so the standalone extractors can use it.
+ */
+
+#ifndef BRAW_TIMEBASE_H
+#define BRAW_TIMEBASE_H
+
+#include <stdint.h>
+#include <cmath>
+
+// Frames per second as num / den
+struct BrawTimebase
+{
+    uint32_t num;
+    uint32_t den;
+};
+
+inline uint32_t TimebaseGcd(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// NTSC rates (N * 1000/1001) and whole rates are matched to within the
+// float's precision; anything else keeps three decimals
+inline BrawTimebase TimebaseForRate(double rate)
+{
+    BrawTimebase timebase = { 0, 1 };
+    if (!(rate > 0.0) || rate > 1000000.0)
+        return timebase;
+
+    double whole = std::floor(rate + 0.5);
+    if (std::fabs(rate - whole) < 1e-4 * rate)
+    {
+        timebase.num = static_cast<uint32_t>(whole);
+        return timebase;
+    }
+
+    double ntsc = std::floor(rate * 1.001 + 0.5);
+    if (std::fabs(rate - ntsc * 1000.0 / 1001.0) < 1e-5 * rate)
+    {
+        timebase.num = static_cast<uint32_t>(ntsc) * 1000;
+        timebase.den = 1001;
+        return timebase;
+    }
+
+    uint32_t num = static_cast<uint32_t>(std::floor(rate * 1000.0 + 0.5));
+    uint32_t gcd = TimebaseGcd(num, 1000);
+    timebase.num = num / gcd;
+    timebase.den = 1000 / gcd;
+    return timebase;
+}
+
+inline double TimebaseRate(const BrawTimebase& timebase)
+{
+    return timebase.den > 0 ? static_cast<double>(timebase.num) / timebase.den : 0.0;
+}
+
+// Start time of frameIndex in seconds
+inline double FrameTime(const BrawTimebase& timebase, uint64_t frameIndex)
+{
+    return timebase.num > 0 ? static_cast<double>(frameIndex) * timebase.den / timebase.num : 0.0;
+}
+
+// The frame showing at seconds, clamped to [0, frameCount). A timestamp
+// within a thousandth of a frame before a frame's start (rounding in the
+// caller's own frame / fps) maps to that frame rather than the one before.
+inline uint64_t FrameAtTime(const BrawTimebase& timebase, double seconds, uint64_t frameCount)
+{
+    if (frameCount == 0 || timebase.num == 0 || !(seconds > 0.0))
+        return 0;
+
+    double frames = std::floor(seconds * timebase.num / timebase.den + 1e-3);
+    if (frames >= static_cast<double>(frameCount - 1))
+        return frameCount - 1;
+    return static_cast<uint64_t>(frames);
+}
+
+#endif // BRAW_TIMEBASE_H
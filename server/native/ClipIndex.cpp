@@ -0,0 +1,378 @@
+/*
+ * ClipIndex - JS entry points for the on-disk clip index
+ */
+
+#include "ClipIndex.h"
+#include "BrawClip.h"
+#include "BrawPreview.h"
+#include "ClipSession.h"
+
+// Opens, scans and saves on a worker thread; the SDK work never runs on the loop
+class IndexWorker : public Napi::AsyncWorker
+{
+public:
+    IndexWorker(Napi::Env env, const std::string& filePath, const std::string& indexPath,
+                const BrawOpenOptions& options, bool scanFrames)
+        : Napi::AsyncWorker(env, "BRAWIndexClip"),
+          m_deferred(Napi::Promise::Deferred::New(env)),
+          m_filePath(filePath), m_indexPath(indexPath), m_options(options), m_scanFrames(scanFrames),
+          m_success(false)
+    {
+    }
+
+    Napi::Promise Promise() { return m_deferred.Promise(); }
+
+protected:
+    virtual void Execute()
+    {
+        BrawClip clip;
+
+        if (clip.Open(m_filePath.c_str(), m_options, m_error) != S_OK)
+            return;
+
+        if (BuildClipIndex(clip, m_filePath.c_str(), m_scanFrames, m_index, m_error) != S_OK)
+            return;
+
+        if (!m_indexPath.empty() && !SaveClipIndex(m_indexPath, m_index, m_error))
+            return;
+
+        m_success = true;
+    }
+
+    virtual void OnOK()
+    {
+        Napi::Env env = Env();
+        Napi::Object resultObj = Napi::Object::New(env);
+
+        if (m_success)
+        {
+            SetClipIndexResult(env, resultObj, m_index);
+        }
+        else
+        {
+            resultObj.Set("success", false);
+            resultObj.Set("error", m_error);
+        }
+        m_deferred.Resolve(resultObj);
+    }
+
+private:
+    Napi::Promise::Deferred m_deferred;
+    std::string m_filePath;
+    std::string m_indexPath;
+    BrawOpenOptions m_options;
+    bool m_scanFrames;
+    bool m_success;
+    BrawClipIndex m_index;
+    std::string m_error;
+};
+
+// indexClip followed by the preview, on one clip and codec. A preview
+// failure still resolves with the index, reporting preview_error.
+class PrepareWorker : public Napi::AsyncWorker
+{
+public:
+    PrepareWorker(Napi::Env env, const std::string& filePath, const std::string& indexPath,
+                  const BrawOpenOptions& options, const BrawPreviewOptions& preview)
+        : Napi::AsyncWorker(env, "BRAWPrepareClip"),
+          m_deferred(Napi::Promise::Deferred::New(env)),
+          m_filePath(filePath), m_indexPath(indexPath), m_options(options), m_preview(preview),
+          m_success(false), m_previewSuccess(false)
+    {
+    }
+
+    Napi::Promise Promise() { return m_deferred.Promise(); }
+
+protected:
+    virtual void Execute()
+    {
+        BrawClip clip;
+
+        if (clip.Open(m_filePath.c_str(), m_options, m_error) != S_OK)
+            return;
+
+        if (BuildClipIndex(clip, m_filePath.c_str(), true, m_index, m_error) != S_OK)
+            return;
+
+        if (!m_indexPath.empty() && !SaveClipIndex(m_indexPath, m_index, m_error))
+            return;
+
+        m_success = true;
+        m_previewSuccess = BuildClipPreview(clip, m_preview, m_previewResult, m_previewError) == S_OK;
+    }
+
+    virtual void OnOK()
+    {
+        Napi::Env env = Env();
+        Napi::Object resultObj = Napi::Object::New(env);
+
+        if (!m_success)
+        {
+            resultObj.Set("success", false);
+            resultObj.Set("error", m_error);
+            m_deferred.Resolve(resultObj);
+            return;
+        }
+
+        SetClipIndexResult(env, resultObj, m_index);
+
+        if (!m_previewSuccess)
+        {
+            resultObj.Set("preview_error", m_previewError);
+        }
+        else
+        {
+            if (m_previewResult.poster_width > 0)
+            {
+                Napi::Object poster = Napi::Object::New(env);
+                poster.Set("width", Napi::Number::New(env, m_previewResult.poster_width));
+                poster.Set("height", Napi::Number::New(env, m_previewResult.poster_height));
+                resultObj.Set("poster", poster);
+            }
+            if (m_previewResult.thumbnails > 0)
+            {
+                Napi::Object strip = Napi::Object::New(env);
+                strip.Set("count", Napi::Number::New(env, m_previewResult.thumbnails));
+                strip.Set("width", Napi::Number::New(env, m_previewResult.thumbnail_width));
+                strip.Set("height", Napi::Number::New(env, m_previewResult.thumbnail_height));
+                resultObj.Set("strip", strip);
+            }
+        }
+        m_deferred.Resolve(resultObj);
+    }
+
+private:
+    Napi::Promise::Deferred m_deferred;
+    std::string m_filePath;
+    std::string m_indexPath;
+    BrawOpenOptions m_options;
+    BrawPreviewOptions m_preview;
+    bool m_success;
+    bool m_previewSuccess;
+    BrawClipIndex m_index;
+    BrawPreviewResult m_previewResult;
+    std::string m_error;
+    std::string m_previewError;
+};
+
+static Napi::Value MetadataValue(Napi::Env env, const BrawMetadataValue& value)
+{
+    switch (value.kind)
+    {
+    case BrawMetadataValue::kString:
+        return Napi::String::New(env, value.text);
+    case BrawMetadataValue::kNumbers:
+    {
+        Napi::Array numbers = Napi::Array::New(env, value.numbers.size());
+        for (size_t i = 0; i < value.numbers.size(); i++)
+            numbers.Set(static_cast<uint32_t>(i), Napi::Number::New(env, value.numbers[i]));
+        return numbers;
+    }
+    default:
+        return Napi::Number::New(env, value.number);
+    }
+}
+
+static Napi::Object MetadataObject(Napi::Env env, const std::vector<BrawMetadataEntry>& entries)
+{
+    Napi::Object obj = Napi::Object::New(env);
+
+    for (size_t i = 0; i < entries.size(); i++)
+        obj.Set(entries[i].key, MetadataValue(env, entries[i].value));
+    return obj;
+}
+
+void SetClipIndexResult(Napi::Env env, Napi::Object& obj, const BrawClipIndex& index)
+{
+    obj.Set("success", true);
+    obj.Set("frame_count", Napi::Number::New(env, static_cast<double>(index.frame_count)));
+    obj.Set("width", Napi::Number::New(env, index.width));
+    obj.Set("height", Napi::Number::New(env, index.height));
+    BrawTimebase timebase = TimebaseForRate(index.frame_rate);
+    obj.Set("frame_rate", Napi::Number::New(env, index.frame_rate));
+    obj.Set("frame_rate_num", Napi::Number::New(env, timebase.num));
+    obj.Set("frame_rate_den", Napi::Number::New(env, timebase.den));
+    obj.Set("duration", Napi::Number::New(env, FrameTime(timebase, index.frame_count)));
+    obj.Set("camera_type", index.camera_type);
+    obj.Set("start_timecode", index.start_timecode);
+    obj.Set("clip", MetadataObject(env, index.clip));
+
+    Napi::Array frames = Napi::Array::New(env, index.frames.size());
+    for (size_t i = 0; i < index.frames.size(); i++)
+    {
+        Napi::Object frame = Napi::Object::New(env);
+        frame.Set("frame_index", Napi::Number::New(env, static_cast<double>(index.frames[i].frame_index)));
+        frame.Set("metadata", MetadataObject(env, index.frames[i].entries));
+        frames.Set(static_cast<uint32_t>(i), frame);
+    }
+    obj.Set("frames", frames);
+}
+
+static bool ParseFramesOption(Napi::Value value)
+{
+    if (!value.IsObject())
+        return true;
+
+    Napi::Value frames = value.As<Napi::Object>().Get("frames");
+    return !frames.IsBoolean() || frames.As<Napi::Boolean>().Value();
+}
+
+/**
+ * Read clip and per-frame metadata in one pass of read jobs and save it as an index
+ *
+ * @param {string} filePath - Path to BRAW file
+ * @param {string} indexPath - Where to write the index; empty to skip saving
+ * @param {object} [opts] - { pipeline } as for openClip, plus { frames } (default true)
+ *                          to scan per-frame metadata
+ * @returns {Promise<object>} Resolves with the readClipIndex result shape
+ */
+Napi::Value IndexClip(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected (string filePath, string indexPath)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    BrawOpenOptions options;
+    if (!ParseOpenOptions(env, info[2], options))
+        return env.Null();
+
+    IndexWorker* worker = new IndexWorker(env, info[0].As<Napi::String>().Utf8Value(),
+                                          info[1].As<Napi::String>().Utf8Value(), options,
+                                          ParseFramesOption(info[2]));
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * Load a saved index without opening the clip
+ *
+ * @param {string} indexPath - Index written by indexClip
+ * @param {string} filePath - The BRAW file it describes; a changed file makes the index stale
+ * @param {object} [opts] - { frames } (default true); false skips the per-frame metadata
+ * @returns {object} { success, frame_count, width, height, frame_rate, frame_rate_num,
+ *                   frame_rate_den, duration, camera_type,
+ *                   start_timecode, clip, frames: [{ frame_index, metadata }] }, where each
+ *                   frames entry holds only the keys that changed at that frame
+ */
+Napi::Value ReadClipIndex(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected (string indexPath, string filePath)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object resultObj = Napi::Object::New(env);
+    BrawClipIndex index;
+    std::string error;
+
+    if (!LoadClipIndex(info[0].As<Napi::String>().Utf8Value(), info[1].As<Napi::String>().Utf8Value(),
+                       ParseFramesOption(info[2]), index, error))
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", error);
+        return resultObj;
+    }
+
+    SetClipIndexResult(env, resultObj, index);
+    return resultObj;
+}
+
+static bool ParsePreviewOptions(Napi::Env env, Napi::Value value, BrawPreviewOptions& options)
+{
+    if (!value.IsObject())
+        return true;
+
+    Napi::Object opts = value.As<Napi::Object>();
+
+    Napi::Value posterPath = opts.Get("posterPath");
+    if (posterPath.IsString())
+        options.poster_path = posterPath.As<Napi::String>().Utf8Value();
+
+    Napi::Value stripPath = opts.Get("stripPath");
+    if (stripPath.IsString())
+        options.strip_path = stripPath.As<Napi::String>().Utf8Value();
+
+    Napi::Value thumbnails = opts.Get("thumbnails");
+    if (thumbnails.IsNumber())
+        options.thumbnails = thumbnails.As<Napi::Number>().Uint32Value();
+
+    Napi::Value thumbnailWidth = opts.Get("thumbnailWidth");
+    if (thumbnailWidth.IsNumber())
+    {
+        options.thumbnail_width = thumbnailWidth.As<Napi::Number>().Uint32Value();
+        if (options.thumbnail_width == 0 || options.thumbnail_width > 1024) {
+            Napi::TypeError::New(env, "thumbnailWidth must be between 1 and 1024").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value quality = opts.Get("quality");
+    if (quality.IsNumber())
+    {
+        options.quality = quality.As<Napi::Number>().Int32Value();
+        if (options.quality < 1 || options.quality > 100) {
+            Napi::TypeError::New(env, "quality must be between 1 and 100").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value scale = opts.Get("scale");
+    if (scale.IsString())
+    {
+        std::string name = scale.As<Napi::String>().Utf8Value();
+        options.scale = FindResolutionScale(name.c_str());
+        if (!options.scale) {
+            Napi::TypeError::New(env, "Unknown resolution scale: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Everything a freshly uploaded clip needs before its first open, as one
+ * background job: the index with per-frame metadata, then a poster of frame 0
+ * and a strip of evenly spaced thumbnails, decoded through the shared frame
+ * cache so the first reads at that scale are warm
+ *
+ * @param {string} filePath - Path to BRAW file
+ * @param {string} indexPath - Where to write the index; empty to skip saving
+ * @param {object} [opts] - { pipeline } as for openClip, plus { posterPath, stripPath }
+ *                          (JPEG files; empty or missing skips that image), thumbnails
+ *                          (default 10), thumbnailWidth (default 160), quality (default 85)
+ *                          and scale (default "quarter")
+ * @returns {Promise<object>} Resolves with the readClipIndex result shape plus
+ *                            poster: { width, height } and strip: { count, width, height }
+ *                            (width and height of one thumbnail), or preview_error when only
+ *                            the preview failed
+ */
+Napi::Value PrepareClip(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected (string filePath, string indexPath)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    BrawOpenOptions options;
+    if (!ParseOpenOptions(env, info[2], options))
+        return env.Null();
+
+    BrawPreviewOptions preview;
+    if (!ParsePreviewOptions(env, info[2], preview))
+        return env.Null();
+
+    PrepareWorker* worker = new PrepareWorker(env, info[0].As<Napi::String>().Utf8Value(),
+                                              info[1].As<Napi::String>().Utf8Value(), options, preview);
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
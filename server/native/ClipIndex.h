@@ -0,0 +1,24 @@
+/*
+ * ClipIndex - JS entry points for the on-disk clip index
+ *
+ * indexClip builds a BrawClipIndex on a libuv worker (opening its own clip
+ * and codec) and saves it; readClipIndex loads a saved one without touching
+ * the SDK, so projects can be listed from their index files alone.
+ * prepareClip adds the poster and thumbnail strip of an upload to the index.
+ */
+
+#ifndef CLIP_INDEX_H
+#define CLIP_INDEX_H
+
+#include <napi.h>
+#include "BrawMetadata.h"
+
+// Fill a result object from an index: the extractMetadata fields plus
+// camera_type, start_timecode, clip and, when scanned, frames
+void SetClipIndexResult(Napi::Env env, Napi::Object& obj, const BrawClipIndex& index);
+
+Napi::Value IndexClip(const Napi::CallbackInfo& info);
+Napi::Value ReadClipIndex(const Napi::CallbackInfo& info);
+Napi::Value PrepareClip(const Napi::CallbackInfo& info);
+
+#endif // CLIP_INDEX_H
@@ -0,0 +1,1300 @@
+/*
+ * ClipSession - JS handle for a long-lived BrawClip
+ */
+
+#include "ClipSession.h"
+#include "BrawAddon.h"
+#include "BrawBufferPool.h"
+#include "BrawClipRegistry.h"
+#include "FrameBatch.h"
+#include "FrameRequest.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static void SetProxyResult(Napi::Env env, Napi::Object& obj, const BrawProxyStore& store)
+{
+    BrawProxyInfo info;
+    store.Info(info);
+
+    obj.Set("success", true);
+    obj.Set("frame_count", Napi::Number::New(env, static_cast<double>(info.frame_count)));
+    obj.Set("stored", Napi::Number::New(env, static_cast<double>(info.stored)));
+    obj.Set("hits", Napi::Number::New(env, static_cast<double>(store.Hits())));
+    obj.Set("width", Napi::Number::New(env, info.width));
+    obj.Set("height", Napi::Number::New(env, info.height));
+    obj.Set("format", info.format->name);
+    obj.Set("scale", info.scale->name);
+}
+
+// Fills the attached proxy store from the session's own clip, at batch priority
+class ProxyWorker : public Napi::AsyncWorker
+{
+public:
+    ProxyWorker(Napi::Env env, std::shared_ptr<BrawClip> clip, std::shared_ptr<BrawProxyStore> store,
+                uint32_t maxInFlight)
+        : Napi::AsyncWorker(env, "BRAWBuildProxies"),
+          m_deferred(Napi::Promise::Deferred::New(env)),
+          m_clip(clip), m_store(store), m_maxInFlight(maxInFlight), m_built(0), m_success(false)
+    {
+    }
+
+    Napi::Promise Promise() { return m_deferred.Promise(); }
+
+protected:
+    virtual void Execute()
+    {
+        m_success = ::BuildProxies(*m_clip, *m_store, m_maxInFlight, m_built, m_error) == S_OK;
+    }
+
+    virtual void OnOK()
+    {
+        Napi::Env env = Env();
+        Napi::Object resultObj = Napi::Object::New(env);
+
+        SetProxyResult(env, resultObj, *m_store);
+        resultObj.Set("built", Napi::Number::New(env, static_cast<double>(m_built)));
+        if (!m_success)
+        {
+            resultObj.Set("success", false);
+            resultObj.Set("error", m_error);
+        }
+        m_deferred.Resolve(resultObj);
+    }
+
+private:
+    Napi::Promise::Deferred m_deferred;
+    std::shared_ptr<BrawClip> m_clip;
+    std::shared_ptr<BrawProxyStore> m_store;
+    uint32_t m_maxInFlight;
+    uint64_t m_built;
+    bool m_success;
+    std::string m_error;
+};
+
+FrameCancel::FrameCancel(uint32_t timeoutMs)
+    : m_cancelled(false), m_hasDeadline(timeoutMs > 0),
+      m_deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs))
+{
+}
+
+bool FrameCancel::Expired() const
+{
+    return m_cancelled || (m_hasDeadline && std::chrono::steady_clock::now() >= m_deadline);
+}
+
+void SetMetadataResult(Napi::Env env, Napi::Object& obj, const BrawClipInfo& info)
+{
+    obj.Set("success", true);
+    obj.Set("frame_count", Napi::Number::New(env, static_cast<double>(info.frame_count)));
+    obj.Set("width", Napi::Number::New(env, info.width));
+    obj.Set("height", Napi::Number::New(env, info.height));
+    obj.Set("frame_rate", Napi::Number::New(env, info.frame_rate));
+    obj.Set("frame_rate_num", Napi::Number::New(env, info.timebase.num));
+    obj.Set("frame_rate_den", Napi::Number::New(env, info.timebase.den));
+    obj.Set("duration", Napi::Number::New(env, FrameTime(info.timebase, info.frame_count)));
+    obj.Set("pipeline", info.pipeline);
+}
+
+bool ParseOpenOptions(Napi::Env env, Napi::Value value, BrawOpenOptions& options)
+{
+    options = BrawOpenOptions();
+
+    if (value.IsUndefined() || value.IsNull())
+        return true;
+
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Object expected for open options").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Value pipeline = value.As<Napi::Object>().Get("pipeline");
+    if (pipeline.IsString())
+    {
+        std::string name = pipeline.As<Napi::String>().Utf8Value();
+        if (!FindPipelineType(name.c_str(), options.pipeline)) {
+            Napi::TypeError::New(env, "Unknown pipeline: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value maxJobs = value.As<Napi::Object>().Get("maxJobs");
+    if (maxJobs.IsNumber())
+    {
+        options.max_jobs = maxJobs.As<Napi::Number>().Uint32Value();
+        if (options.max_jobs == 0) {
+            Napi::TypeError::New(env, "maxJobs must be at least 1").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// true for the default sizes, or { waveformWidth, waveformHeight, vectorscopeSize }
+static bool ParseScopeOptions(Napi::Env env, Napi::Value value, BrawScopeOptions& options)
+{
+    if (value.IsBoolean())
+    {
+        options.enabled = value.As<Napi::Boolean>().Value();
+        return true;
+    }
+    if (!value.IsObject())
+        return true;
+
+    static const struct { const char* name; uint32_t BrawScopeOptions::* size; } s_sizes[] = {
+        { "waveformWidth",   &BrawScopeOptions::waveform_width   },
+        { "waveformHeight",  &BrawScopeOptions::waveform_height  },
+        { "vectorscopeSize", &BrawScopeOptions::vectorscope_size },
+    };
+
+    Napi::Object opts = value.As<Napi::Object>();
+    for (size_t i = 0; i < sizeof(s_sizes) / sizeof(s_sizes[0]); i++)
+    {
+        Napi::Value size = opts.Get(s_sizes[i].name);
+        if (!size.IsNumber())
+            continue;
+
+        double requested = size.As<Napi::Number>().DoubleValue();
+        if (!(requested >= kBrawScopeMinSize && requested <= kBrawScopeMaxSize)) {
+            Napi::TypeError::New(env, std::string(s_sizes[i].name) + " must be between " +
+                                  std::to_string(kBrawScopeMinSize) + " and " +
+                                  std::to_string(kBrawScopeMaxSize)).ThrowAsJavaScriptException();
+            return false;
+        }
+        options.*s_sizes[i].size = static_cast<uint32_t>(requested);
+    }
+
+    options.enabled = true;
+    return true;
+}
+
+// [r, g, b] or { r, g, b } in 0-255, as CHROMA_KEY_PRESETS give them
+static bool KeyColorParam(Napi::Env env, const Napi::Object& opts, const char* name, float* color)
+{
+    static const char* const s_channels[3] = { "r", "g", "b" };
+
+    Napi::Value value = opts.Get(name);
+    if (value.IsUndefined())
+        return true;
+
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        Napi::Value channel = value.IsArray() ? value.As<Napi::Array>().Get(c)
+                            : value.IsObject() ? value.As<Napi::Object>().Get(s_channels[c])
+                            : Napi::Value();
+        double level = channel.IsNumber() ? channel.As<Napi::Number>().DoubleValue() : -1.0;
+        if (!(level >= 0.0 && level <= 255.0)) {
+            Napi::TypeError::New(env, std::string(name) + " must be three levels between 0 and 255").ThrowAsJavaScriptException();
+            return false;
+        }
+        color[c] = static_cast<float>(level / 255.0);
+    }
+    return true;
+}
+
+// { keyColor, threshold, tolerance, spillSuppress, ..., matte }, named after
+// advancedChromaKeyShader's uniforms
+static bool ParseKeyOptions(Napi::Env env, Napi::Value value, BrawKeyOptions& options)
+{
+    if (value.IsUndefined() || value.IsNull())
+        return true;
+
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Object expected for key").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    static const struct { const char* name; float BrawKeyOptions::* param; } s_params[] = {
+        { "hueRange",       &BrawKeyOptions::hue_range        },
+        { "satRange",       &BrawKeyOptions::sat_range        },
+        { "lumRange",       &BrawKeyOptions::lum_range        },
+        { "threshold",      &BrawKeyOptions::threshold        },
+        { "tolerance",      &BrawKeyOptions::tolerance        },
+        { "edgeThin",       &BrawKeyOptions::edge_thin        },
+        { "edgeFeather",    &BrawKeyOptions::edge_feather     },
+        { "edgeRadius",     &BrawKeyOptions::edge_radius      },
+        { "spillSuppress",  &BrawKeyOptions::spill_suppress   },
+        { "despillBias",    &BrawKeyOptions::despill_bias     },
+        { "matteContrast",  &BrawKeyOptions::matte_contrast   },
+        { "matteGamma",     &BrawKeyOptions::matte_gamma      },
+        { "matteClipBlack", &BrawKeyOptions::matte_clip_black },
+        { "matteClipWhite", &BrawKeyOptions::matte_clip_white },
+    };
+
+    Napi::Object opts = value.As<Napi::Object>();
+    for (size_t i = 0; i < sizeof(s_params) / sizeof(s_params[0]); i++)
+    {
+        Napi::Value param = opts.Get(s_params[i].name);
+        if (param.IsUndefined())
+            continue;
+
+        double number = param.IsNumber() ? param.As<Napi::Number>().DoubleValue() : NAN;
+        if (!std::isfinite(number)) {
+            Napi::TypeError::New(env, std::string(s_params[i].name) + " must be a number").ThrowAsJavaScriptException();
+            return false;
+        }
+        options.*s_params[i].param = static_cast<float>(number);
+    }
+
+    if (!KeyColorParam(env, opts, "keyColor", options.key_color) ||
+        !KeyColorParam(env, opts, "despillColor", options.despill_color))
+        return false;
+
+    Napi::Value edgeRefine = opts.Get("edgeRefine");
+    if (edgeRefine.IsBoolean())
+        options.edge_refine = edgeRefine.As<Napi::Boolean>().Value();
+
+    Napi::Value writeAlpha = opts.Get("writeAlpha");
+    if (writeAlpha.IsBoolean())
+        options.write_alpha = writeAlpha.As<Napi::Boolean>().Value();
+
+    Napi::Value matte = opts.Get("matte");
+    if (matte.IsString())
+    {
+        std::string name = matte.As<Napi::String>().Utf8Value();
+        if (!FindMatteFormat(name.c_str(), options.matte)) {
+            Napi::TypeError::New(env, "Unknown matte format: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (!(options.hue_range > 0.0f && options.sat_range > 0.0f && options.lum_range > 0.0f)) {
+        Napi::TypeError::New(env, "Key ranges must be positive").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (!(options.matte_clip_white > options.matte_clip_black)) {
+        Napi::TypeError::New(env, "matteClipWhite must be above matteClipBlack").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    options.enabled = true;
+    return true;
+}
+
+// { gamma, gamut, iso, whiteBalanceKelvin, ... } handed to the SDK decode;
+// names not in BrawProcessingAttributes are ignored
+static bool ParseProcessing(Napi::Env env, Napi::Value value, std::shared_ptr<const BrawProcessing>& processing)
+{
+    processing.reset();
+
+    if (value.IsUndefined() || value.IsNull())
+        return true;
+
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Object expected for processing").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Object opts = value.As<Napi::Object>();
+    std::shared_ptr<BrawProcessing> parsed = std::make_shared<BrawProcessing>();
+
+    size_t count = 0;
+    const BrawProcessingAttribute* attributes = BrawProcessingAttributes(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const BrawProcessingAttribute* attribute = &attributes[i];
+        Napi::Value setting = opts.Get(attribute->name);
+        if (setting.IsUndefined())
+            continue;
+
+        if (attribute->type == blackmagicRawVariantTypeString)
+        {
+            if (!setting.IsString()) {
+                Napi::TypeError::New(env, std::string("String expected for ") + attribute->name).ThrowAsJavaScriptException();
+                return false;
+            }
+            parsed->SetText(attribute, setting.As<Napi::String>().Utf8Value());
+            continue;
+        }
+
+        double number = 0.0;
+        if (setting.IsBoolean())
+            number = setting.As<Napi::Boolean>().Value() ? 1.0 : 0.0;
+        else if (setting.IsNumber())
+            number = setting.As<Napi::Number>().DoubleValue();
+        else {
+            Napi::TypeError::New(env, std::string("Number expected for ") + attribute->name).ThrowAsJavaScriptException();
+            return false;
+        }
+
+        // The SDK checks its own ranges; this only keeps the integer conversion defined
+        double low = -3.4e38, high = 3.4e38;
+        switch (attribute->type)
+        {
+        case blackmagicRawVariantTypeU16: low = 0; high = 65535; break;
+        case blackmagicRawVariantTypeS16: low = -32768; high = 32767; break;
+        case blackmagicRawVariantTypeU32: low = 0; high = 4294967295.0; break;
+        default: break;
+        }
+        if (!(number >= low && number <= high)) {
+            Napi::TypeError::New(env, std::string(attribute->name) + " out of range").ThrowAsJavaScriptException();
+            return false;
+        }
+        parsed->SetNumber(attribute, number);
+    }
+
+    if (!parsed->Empty())
+        processing = parsed;
+    return true;
+}
+
+static float NumberParam(const Napi::Object& params, const char* name, float fallback)
+{
+    Napi::Value value = params.Get(name);
+    return value.IsNumber() ? value.As<Napi::Number>().FloatValue() : fallback;
+}
+
+// { r, g, b } scaled by its master amount, as the primary shader applies it
+static void WheelParam(const Napi::Object& params, const char* name, const char* master, float* wheel)
+{
+    static const char* const s_channels[3] = { "r", "g", "b" };
+
+    float amount = NumberParam(params, master, 0.0f);
+    Napi::Value value = params.Get(name);
+    for (unsigned int c = 0; c < 3; c++)
+    {
+        float channel = value.IsObject() ? NumberParam(value.As<Napi::Object>(), s_channels[c], 0.0f) : 0.0f;
+        wheel[c] = channel * amount;
+    }
+}
+
+static bool ParseGradeNode(Napi::Env env, const Napi::Object& node, BrawGradeNode& gradeNode)
+{
+    std::string type = node.Get("type").IsString() ? node.Get("type").As<Napi::String>().Utf8Value() : "";
+    Napi::Object params = node.Get("params").IsObject() ? node.Get("params").As<Napi::Object>()
+                                                        : Napi::Object::New(env);
+
+    if (type == "primary_wheels")
+    {
+        gradeNode.type = BrawGradeNode::kPrimary;
+        WheelParam(params, "lift", "liftMaster", gradeNode.lift);
+        WheelParam(params, "gamma", "gammaMaster", gradeNode.gamma);
+        WheelParam(params, "gain", "gainMaster", gradeNode.gain);
+        WheelParam(params, "offset", "offsetMaster", gradeNode.offset);
+        gradeNode.contrast = NumberParam(params, "contrast", 0.0f);
+        gradeNode.saturation = NumberParam(params, "saturation", 0.0f);
+        gradeNode.hue = NumberParam(params, "hue", 0.0f);
+        gradeNode.temperature = NumberParam(params, "temperature", 0.0f);
+        gradeNode.tint = NumberParam(params, "tint", 0.0f);
+        gradeNode.exposure = NumberParam(params, "exposure", 0.0f);
+        gradeNode.highlights = NumberParam(params, "highlights", 0.0f);
+        gradeNode.shadows = NumberParam(params, "shadows", 0.0f);
+        gradeNode.whites = NumberParam(params, "whites", 0.0f);
+        gradeNode.blacks = NumberParam(params, "blacks", 0.0f);
+        return true;
+    }
+
+    if (type == "lut")
+    {
+        Napi::Value path = params.Get("path");
+        if (!path.IsString()) {
+            Napi::TypeError::New(env, "LUT node requires a path").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        gradeNode.type = BrawGradeNode::kLut;
+        gradeNode.intensity = NumberParam(params, "intensity", 1.0f);
+        if (!(gradeNode.intensity >= 0.0f && gradeNode.intensity <= 1.0f)) {
+            Napi::TypeError::New(env, "LUT intensity must be between 0 and 1").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        std::string error;
+        gradeNode.lut = LoadCubeLut(path.As<Napi::String>().Utf8Value(), error);
+        if (!gradeNode.lut) {
+            Napi::Error::New(env, error).ThrowAsJavaScriptException();
+            return false;
+        }
+        return true;
+    }
+
+    Napi::TypeError::New(env, "Unsupported grade node type: " + type).ThrowAsJavaScriptException();
+    return false;
+}
+
+// NodeSystem.export() output, or just its nodes. Enabled nodes apply in
+// array order, as the browser engine renders them; connections are ignored.
+static bool ParseGrade(Napi::Env env, Napi::Value value, std::shared_ptr<const BrawGrade>& grade)
+{
+    grade.reset();
+
+    if (value.IsUndefined() || value.IsNull())
+        return true;
+
+    if (value.IsObject() && !value.IsArray())
+        value = value.As<Napi::Object>().Get("nodes");
+
+    if (!value.IsArray()) {
+        Napi::TypeError::New(env, "Array of nodes expected for grade").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Array nodes = value.As<Napi::Array>();
+    std::shared_ptr<BrawGrade> parsed = std::make_shared<BrawGrade>();
+    for (uint32_t i = 0; i < nodes.Length(); i++)
+    {
+        Napi::Value node = nodes.Get(i);
+        if (!node.IsObject()) {
+            Napi::TypeError::New(env, "Object expected for grade node").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        Napi::Value enabled = node.As<Napi::Object>().Get("enabled");
+        if (enabled.IsBoolean() && !enabled.As<Napi::Boolean>().Value())
+            continue;
+
+        BrawGradeNode gradeNode;
+        if (!ParseGradeNode(env, node.As<Napi::Object>(), gradeNode))
+            return false;
+        parsed->nodes.push_back(gradeNode);
+    }
+
+    if (!parsed->Empty())
+        grade = parsed;
+    return true;
+}
+
+bool ParseFrameOptions(Napi::Env env, Napi::Value value, FrameOptions& options)
+{
+    options = FrameOptions();
+
+    if (value.IsUndefined() || value.IsNull())
+        return true;
+
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Object expected for frame options").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (!ParseOpenOptions(env, value, options.open))
+        return false;
+
+    Napi::Object opts = value.As<Napi::Object>();
+
+    Napi::Value format = opts.Get("format");
+    if (format.IsString())
+    {
+        std::string name = format.As<Napi::String>().Utf8Value();
+        options.decode.format = FindPixelFormat(name.c_str());
+        if (!options.decode.format) {
+            Napi::TypeError::New(env, "Unknown pixel format: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value scale = opts.Get("scale");
+    if (scale.IsString())
+    {
+        std::string name = scale.As<Napi::String>().Utf8Value();
+        options.decode.scale = FindResolutionScale(name.c_str());
+        if (!options.decode.scale) {
+            Napi::TypeError::New(env, "Unknown resolution scale: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value encoding = opts.Get("encoding");
+    if (encoding.IsString())
+    {
+        std::string name = encoding.As<Napi::String>().Utf8Value();
+        if (!FindEncoding(name.c_str(), options.decode.encode.encoding)) {
+            Napi::TypeError::New(env, "Unknown encoding: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value quality = opts.Get("quality");
+    if (quality.IsNumber())
+    {
+        options.decode.encode.quality = quality.As<Napi::Number>().Int32Value();
+        if (options.decode.encode.quality < 1 || options.decode.encode.quality > 100) {
+            Napi::TypeError::New(env, "Quality must be between 1 and 100").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value subsampling = opts.Get("subsampling");
+    if (subsampling.IsString())
+    {
+        std::string name = subsampling.As<Napi::String>().Utf8Value();
+        if (!FindChromaSubsampling(name.c_str(), options.decode.encode.subsampling)) {
+            Napi::TypeError::New(env, "Unknown chroma subsampling: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    const BrawPixelFormat* pixelFormat = options.decode.format;
+    if (options.decode.encode.encoding != brawEncodingNone &&
+        (pixelFormat->planar || pixelFormat->bytes_per_sample != 1)) {
+        Napi::TypeError::New(env, std::string("Cannot encode pixel format ") + pixelFormat->name).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Value zeroCopy = opts.Get("zeroCopy");
+    if (zeroCopy.IsBoolean())
+        options.zero_copy = zeroCopy.As<Napi::Boolean>().Value();
+
+    Napi::Value cache = opts.Get("cache");
+    if (cache.IsBoolean())
+        options.decode.cache = cache.As<Napi::Boolean>().Value();
+
+    Napi::Value priority = opts.Get("priority");
+    if (priority.IsString())
+    {
+        std::string name = priority.As<Napi::String>().Utf8Value();
+        if (!FindPriority(name.c_str(), options.decode.priority)) {
+            Napi::TypeError::New(env, "Unknown priority: " + name).ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    Napi::Value requestId = opts.Get("requestId");
+    if (requestId.IsString() || requestId.IsNumber())
+        options.request_id = requestId.ToString().Utf8Value();
+
+    uint32_t timeoutMs = 0;
+    Napi::Value timeout = opts.Get("timeoutMs");
+    if (timeout.IsNumber())
+        timeoutMs = timeout.As<Napi::Number>().Uint32Value();
+
+    // The deadline runs from here, as the request arrives
+    if (!options.request_id.empty() || timeoutMs > 0)
+        options.cancel = std::make_shared<FrameCancel>(timeoutMs);
+
+    if (!ParseProcessing(env, opts.Get("processing"), options.decode.processing))
+        return false;
+
+    if (!ParseGrade(env, opts.Get("grade"), options.decode.grade))
+        return false;
+
+    if (options.decode.grade && !CanGrade(*pixelFormat)) {
+        Napi::TypeError::New(env, std::string("Cannot grade pixel format ") + pixelFormat->name).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (!ParseKeyOptions(env, opts.Get("key"), options.decode.key))
+        return false;
+
+    if (options.decode.key.enabled && !CanKey(*pixelFormat)) {
+        Napi::TypeError::New(env, std::string("Cannot key pixel format ") + pixelFormat->name).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (!ParseScopeOptions(env, opts.Get("scopes"), options.decode.scopes))
+        return false;
+
+    if (options.decode.scopes.enabled && !CanComputeScopes(*pixelFormat)) {
+        Napi::TypeError::New(env, std::string("Cannot compute scopes for pixel format ") + pixelFormat->name).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    return true;
+}
+
+static void ReleaseProcessedImage(Napi::Env, uint8_t*, IBlackmagicRawProcessedImage* image)
+{
+    image->Release();
+}
+
+// Pooled buffers are outside the V8 heap, so they are reported to it to
+// keep GC, and with it buffer reuse, in step with the frame rate
+static void ReleasePooledBuffer(Napi::Env env, uint8_t* data)
+{
+    Napi::MemoryManagement::AdjustExternalMemory(env, -static_cast<int64_t>(BrawBufferPool::Capacity(data)));
+    BrawBufferPool::Shared().Release(data);
+}
+
+static Napi::Buffer<uint8_t> PooledBuffer(Napi::Env env, uint8_t* data, size_t size)
+{
+    Napi::MemoryManagement::AdjustExternalMemory(env, static_cast<int64_t>(BrawBufferPool::Capacity(data)));
+    return Napi::Buffer<uint8_t>::New(env, data, size, ReleasePooledBuffer);
+}
+
+static void DeleteEncodedImage(Napi::Env, uint8_t*, BrawEncodedImage* encoded)
+{
+    delete encoded;
+}
+
+static void ReleaseCachedFrame(Napi::Env, uint8_t*, std::shared_ptr<BrawCachedFrame>* cached)
+{
+    delete cached;
+}
+
+static Napi::Object ScopesObject(Napi::Env env, const BrawScopes& scopes)
+{
+    Napi::Object obj = Napi::Object::New(env);
+
+    // R, G, B then luma, 256 bins each
+    Napi::Uint32Array histogram = Napi::Uint32Array::New(env, brawHistogramChannels * BrawScopes::kHistogramBins);
+    memcpy(histogram.Data(), scopes.histogram, sizeof(scopes.histogram));
+    obj.Set("histogram", histogram);
+
+    Napi::Object waveform = Napi::Object::New(env);
+    waveform.Set("width", Napi::Number::New(env, scopes.waveform_width));
+    waveform.Set("height", Napi::Number::New(env, scopes.waveform_height));
+    waveform.Set("data", Napi::Buffer<uint8_t>::Copy(env, scopes.waveform.data(), scopes.waveform.size()));
+    obj.Set("waveform", waveform);
+
+    Napi::Object vectorscope = Napi::Object::New(env);
+    vectorscope.Set("size", Napi::Number::New(env, scopes.vectorscope_size));
+    vectorscope.Set("data", Napi::Buffer<uint8_t>::Copy(env, scopes.vectorscope.data(), scopes.vectorscope.size()));
+    obj.Set("vectorscope", vectorscope);
+
+    return obj;
+}
+
+// Rows packed, one 8- or 16-bit sample per pixel
+static Napi::Object MatteObject(Napi::Env env, BrawMatte& matte)
+{
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("width", Napi::Number::New(env, matte.width));
+    obj.Set("height", Napi::Number::New(env, matte.height));
+    obj.Set("format", MatteFormatName(matte.format));
+
+#ifndef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+    size_t size = matte.size;
+    obj.Set("data", PooledBuffer(env, static_cast<uint8_t*>(matte.Detach()), size));
+#else
+    obj.Set("data", Napi::Buffer<uint8_t>::Copy(env, static_cast<uint8_t*>(matte.data), matte.size));
+    matte.Reset();
+#endif
+
+    return obj;
+}
+
+void SetFrameResult(Napi::Env env, Napi::Object& obj, BrawFrame& frame, const FrameOptions& options)
+{
+    // Taken before the zero-copy hand-offs below reset the frame
+    Napi::Value matte = frame.matte.data ? Napi::Value(MatteObject(env, frame.matte)) : env.Undefined();
+
+    unsigned int width = frame.width;
+    unsigned int height = frame.height;
+    size_t stride = frame.stride;
+    const BrawPixelFormat* format = frame.format;
+    Napi::Buffer<uint8_t> buffer;
+
+#ifndef NODE_API_NO_EXTERNAL_BUFFERS_ALLOWED
+    if (frame.encoded.data)
+    {
+        // Encoded output is ours already, so it is always handed over
+        BrawEncodedImage* encoded = new BrawEncodedImage();
+        encoded->Swap(frame.encoded);
+        buffer = Napi::Buffer<uint8_t>::New(env, encoded->data, encoded->size, DeleteEncodedImage, encoded);
+    }
+    else if (options.zero_copy && frame.IsCached())
+    {
+        // Shared with the cache and any other hit on the same frame
+        uint8_t* data = static_cast<uint8_t*>(frame.data);
+        size_t size = frame.size;
+        std::shared_ptr<BrawCachedFrame>* cached = frame.DetachCached();
+        buffer = Napi::Buffer<uint8_t>::New(env, data, size, ReleaseCachedFrame, cached);
+    }
+    else if (options.zero_copy && frame.HasHostCopy())
+    {
+        // GPU frames were already copied to host memory; hand that over
+        size_t size = frame.size;
+        uint8_t* data = static_cast<uint8_t*>(frame.DetachHostCopy());
+        buffer = PooledBuffer(env, data, size);
+    }
+    else if (options.zero_copy)
+    {
+        // Wrap the SDK's memory; the finalizer drops our image reference
+        uint8_t* data = static_cast<uint8_t*>(frame.data);
+        size_t size = frame.size;
+        IBlackmagicRawProcessedImage* image = frame.Detach();
+        buffer = Napi::Buffer<uint8_t>::New(env, data, size, ReleaseProcessedImage, image);
+    }
+    else if (uint8_t* copy = static_cast<uint8_t*>(BrawBufferPool::Shared().Acquire(frame.size)))
+    {
+        // A private copy, in a buffer the next frame of this size reuses
+        memcpy(copy, frame.data, frame.size);
+        buffer = PooledBuffer(env, copy, frame.size);
+    }
+    else
+#endif
+    if (frame.encoded.data)
+    {
+        buffer = Napi::Buffer<uint8_t>::Copy(env, frame.encoded.data, frame.encoded.size);
+    }
+    else
+    {
+        // Create Node.js Buffer from image data
+        buffer = Napi::Buffer<uint8_t>::Copy(env, static_cast<uint8_t*>(frame.data), frame.size);
+    }
+
+    obj.Set("success", true);
+    obj.Set("width", Napi::Number::New(env, width));
+    obj.Set("height", Napi::Number::New(env, height));
+    obj.Set("stride", Napi::Number::New(env, static_cast<double>(stride)));
+    obj.Set("format", format->name);
+    obj.Set("channels", Napi::Number::New(env, format->channels));
+    obj.Set("channel_order", format->channel_order);
+    obj.Set("sample_type", format->sample_type);
+    obj.Set("planar", format->planar);
+    obj.Set("encoding", EncodingName(options.decode.encode.encoding));
+    if (frame.scopes.valid)
+        obj.Set("scopes", ScopesObject(env, frame.scopes));
+    if (!matte.IsUndefined())
+        obj.Set("matte", matte);
+    obj.Set("buffer", buffer);
+}
+
+Napi::Function ClipSession::Init(Napi::Env env)
+{
+    Napi::Function func = DefineClass(env, "ClipSession", {
+        InstanceMethod("readFrame", &ClipSession::ReadFrame),
+        InstanceMethod("readFrameAsync", &ClipSession::ReadFrameAsync),
+        InstanceMethod("readFrames", &ClipSession::ReadFrames),
+        InstanceMethod("setPrefetch", &ClipSession::SetPrefetch),
+        InstanceMethod("prefetchStats", &ClipSession::PrefetchStats),
+        InstanceMethod("metadata", &ClipSession::Metadata),
+        InstanceMethod("frameAt", &ClipSession::FrameAt),
+        InstanceMethod("clipProcessing", &ClipSession::ClipProcessing),
+        InstanceMethod("attachProxies", &ClipSession::AttachProxies),
+        InstanceMethod("buildProxies", &ClipSession::BuildProxies),
+        InstanceMethod("cancel", &ClipSession::Cancel),
+        InstanceMethod("close", &ClipSession::Close),
+    });
+
+    return func;
+}
+
+/**
+ * Open a BRAW file and keep it open for repeated reads
+ *
+ * @param {string} filePath - Path to BRAW file
+ * @param {object} [opts] - { pipeline, maxJobs }: pipeline "cpu" (default), "cuda", "opencl"
+ *                          or "auto", unavailable GPU pipelines falling back to the CPU;
+ *                          maxJobs frames handed to the decoder at once (default 8), past
+ *                          which frames wait by priority
+ * @returns {ClipSession} Session with readFrame(i), setPrefetch(opts), attachProxies(path),
+ *                        metadata() and close()
+ */
+Napi::Value ClipSession::Open(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "String expected for file path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return BrawAddon::Get(env).clip_session.New({ info[0], info[1] });
+}
+
+ClipSession::ClipSession(const Napi::CallbackInfo& info)
+    : Napi::ObjectWrap<ClipSession>(info), m_clip(std::make_shared<BrawClip>()),
+      m_prefetcher(BrawPrefetcher::Create(m_clip)), m_poolSize(0)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "String expected for file path").ThrowAsJavaScriptException();
+        return;
+    }
+
+    BrawOpenOptions options;
+    if (!ParseOpenOptions(env, info[1], options))
+        return;
+
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    std::string error;
+
+    m_filePath = filePath;
+    m_openOptions = options;
+
+    // Sessions on any thread opening the same file share its codec
+    std::shared_ptr<BrawClip> clip = BrawClipRegistry::Shared().Open(filePath, options, error);
+    if (!clip) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return;
+    }
+
+    m_prefetcher->Detach();
+    m_clip = clip;
+    m_prefetcher = BrawPrefetcher::Create(m_clip);
+}
+
+ClipSession::~ClipSession()
+{
+    m_prefetcher->Detach();
+}
+
+/**
+ * Decode one frame from the open clip
+ *
+ * @param {number} frameIndex - Frame index to extract
+ * @param {object} [opts] - { format, scale, zeroCopy, encoding, quality, subsampling }:
+ *                          SDK pixel format name (default "rgba8"); decode scale "full",
+ *                          "half", "quarter" or "eighth"; zeroCopy wraps the SDK buffer
+ *                          instead of copying it; encoding "jpeg" or "webp" compresses on
+ *                          the decode thread, with quality 1-100 (default 90) and JPEG
+ *                          subsampling "444", "422", "420" (default) or "gray"; cache
+ *                          false bypasses the decoded-frame cache. Zero-copy buffers of
+ *                          cached frames are shared and must be treated as read-only.
+ * @returns {object} Object with success, width, height, stride, format, channels,
+ *                   channel_order, sample_type, planar, encoding and buffer (Uint8Array)
+ */
+Napi::Value ClipSession::ReadFrame(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected (number frameIndex)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    long frameIndex = info[0].As<Napi::Number>().Int64Value();
+
+    FrameOptions options;
+    if (!ParseFrameOptions(env, info[1], options))
+        return env.Null();
+
+    Napi::Object resultObj = Napi::Object::New(env);
+
+    if (frameIndex < 0)
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", "Frame index out of range");
+        return resultObj;
+    }
+
+    BrawFrame frame;
+    std::string error;
+
+    options.decode.proxies = m_proxies;
+    if (m_clip->ReadFrame(static_cast<uint64_t>(frameIndex), options.decode, frame, error) != S_OK)
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", error);
+        return resultObj;
+    }
+
+    m_prefetcher->Access(static_cast<uint64_t>(frameIndex), options.decode);
+
+    SetFrameResult(env, resultObj, frame, options);
+    return resultObj;
+}
+
+/**
+ * Decode one frame without blocking the event loop
+ *
+ * @param {number} frameIndex - Frame index to extract
+ * @param {object} [opts] - readFrame options plus { priority, requestId, timeoutMs }:
+ *                          priority "interactive" (default), "prefetch" or "batch" orders
+ *                          frames waiting for the decoder; requestId names the request for
+ *                          cancel(); frames not decoding timeoutMs after the call are skipped
+ * @returns {Promise<object>} Resolves with the readFrame result shape
+ */
+Napi::Value ClipSession::ReadFrameAsync(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected (number frameIndex)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    long frameIndex = info[0].As<Napi::Number>().Int64Value();
+
+    FrameOptions options;
+    if (!ParseFrameOptions(env, info[1], options))
+        return env.Null();
+
+    if (frameIndex < 0)
+        return FrameRequest::Failed(env, "Frame index out of range");
+
+    options.decode.proxies = m_proxies;
+    TrackRequest(options);
+    return FrameRequest::Queue(env, m_clip, std::string(), static_cast<uint64_t>(frameIndex), options, m_prefetcher);
+}
+
+/**
+ * Decode many frames with the SDK pipeline kept full
+ *
+ * @param {number[]} frameIndices - Frame indices to extract
+ * @param {object} [opts] - readFrameAsync options plus { maxInFlight, codecs }: maxInFlight caps
+ *                          jobs queued per codec; codecs > 1 spreads the frames over that many
+ *                          codecs, opened once and kept for the session (0 sizes to the machine).
+ *                          priority defaults to "batch".
+ * @returns {Promise<object[]>} readFrame-shaped results plus frame_index, in request order
+ */
+Napi::Value ClipSession::ReadFrames(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    std::vector<int64_t> frameIndices;
+    uint32_t maxInFlight = 0;
+    uint32_t codecs = 1;
+    FrameOptions options;
+
+    if (!FrameBatch::ParseArguments(info, 0, frameIndices, maxInFlight, codecs, options))
+        return env.Null();
+
+    options.decode.proxies = m_proxies;
+    TrackRequest(options);
+
+    if (codecs <= 1 || !m_clip->IsOpen())
+        return FrameBatch::Queue(env, std::make_shared<BrawDecodePool>(m_clip), std::string(),
+                                 frameIndices, maxInFlight, 1, options);
+
+    // Batches already running keep any pool replaced here alive
+    if (!m_pool || m_poolSize != codecs)
+    {
+        m_pool = std::make_shared<BrawDecodePool>();
+        m_poolSize = codecs;
+    }
+
+    options.open = m_openOptions;
+    return FrameBatch::Queue(env, m_pool, m_filePath, frameIndices, maxInFlight, codecs, options);
+}
+
+/**
+ * Decode ahead of readFrame/readFrameAsync into the frame cache
+ *
+ * Follows the direction and step of successive reads and keeps the next
+ * depth frames queued, using the format and scale of the latest read.
+ * Queued frames the playhead has moved away from are cancelled before decode.
+ *
+ * @param {object} opts - { depth }: frames to keep ahead; 0 (the default) turns prefetch off
+ */
+Napi::Value ClipSession::SetPrefetch(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Object expected for prefetch options").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Value depth = info[0].As<Napi::Object>().Get("depth");
+    if (!depth.IsNumber()) {
+        Napi::TypeError::New(env, "Number expected for prefetch depth").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    m_prefetcher->SetDepth(depth.As<Napi::Number>().Uint32Value());
+    return env.Undefined();
+}
+
+/**
+ * Prefetch state and counters
+ *
+ * @returns {object} Object with depth, direction, step, in_flight, completed, cancelled
+ */
+Napi::Value ClipSession::PrefetchStats(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    BrawPrefetchStats stats = m_prefetcher->Stats();
+    Napi::Object obj = Napi::Object::New(env);
+
+    obj.Set("depth", Napi::Number::New(env, stats.depth));
+    obj.Set("direction", Napi::Number::New(env, stats.direction));
+    obj.Set("step", Napi::Number::New(env, static_cast<double>(stats.step)));
+    obj.Set("in_flight", Napi::Number::New(env, static_cast<double>(stats.in_flight)));
+    obj.Set("completed", Napi::Number::New(env, static_cast<double>(stats.completed)));
+    obj.Set("cancelled", Napi::Number::New(env, static_cast<double>(stats.cancelled)));
+    return obj;
+}
+
+/**
+ * Metadata of the open clip, without touching the SDK again
+ *
+ * @returns {object} Metadata object with frame_count, width, height, frame_rate, frame_rate_num,
+ *                   frame_rate_den (the exact rational rate), duration, pipeline
+ */
+Napi::Value ClipSession::Metadata(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    Napi::Object metadata = Napi::Object::New(env);
+
+    if (!m_clip->IsOpen())
+    {
+        metadata.Set("success", false);
+        metadata.Set("error", "Session is closed");
+        return metadata;
+    }
+
+    SetMetadataResult(env, metadata, m_clip->Info());
+    return metadata;
+}
+
+/**
+ * Frame index showing at a timestamp, on the clip's exact timebase
+ *
+ * NTSC rates map on their 1000/1001 timebase, and a frame's own start time
+ * (however the caller rounded frame / fps) maps to that frame. Indices are
+ * clamped to the clip. Needs no SDK call, so it is cheap enough per request.
+ *
+ * @param {number|number[]} timestamp - Seconds from the start of the clip, or many
+ * @returns {number|number[]} Frame index, or one per timestamp in order
+ */
+Napi::Value ClipSession::FrameAt(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !(info[0].IsNumber() || info[0].IsArray())) {
+        Napi::TypeError::New(env, "Number or array of numbers expected for timestamp").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!m_clip->IsOpen()) {
+        Napi::Error::New(env, "Session is closed").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    const BrawClipInfo& clipInfo = m_clip->Info();
+
+    if (info[0].IsNumber())
+    {
+        double seconds = info[0].As<Napi::Number>().DoubleValue();
+        return Napi::Number::New(env, static_cast<double>(
+            FrameAtTime(clipInfo.timebase, seconds, clipInfo.frame_count)));
+    }
+
+    Napi::Array timestamps = info[0].As<Napi::Array>();
+    Napi::Array frames = Napi::Array::New(env, timestamps.Length());
+
+    for (uint32_t i = 0; i < timestamps.Length(); i++)
+    {
+        Napi::Value timestamp = timestamps.Get(i);
+        if (!timestamp.IsNumber()) {
+            Napi::TypeError::New(env, "Timestamps must be numbers").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+
+        double seconds = timestamp.As<Napi::Number>().DoubleValue();
+        frames.Set(i, Napi::Number::New(env, static_cast<double>(
+            FrameAtTime(clipInfo.timebase, seconds, clipInfo.frame_count))));
+    }
+
+    return frames;
+}
+
+/**
+ * Serve reads from a memory-mapped proxy store
+ *
+ * Frames this session reads with the store's format and scale and the clip's
+ * own processing come from the store once it holds them, as shared read-only pages, without
+ * touching the decoder. The store is created, or reset when it belongs to an
+ * older version of the clip; buildProxies() fills it.
+ *
+ * @param {string} storePath - Proxy pack file, one per clip
+ * @param {object} [opts] - { scale, format }: "quarter" (default) or "eighth"; "rgba8"
+ *                          (default) or "bgra8"
+ * @returns {object} { success, frame_count, stored, hits, width, height, format, scale }
+ */
+Napi::Value ClipSession::AttachProxies(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected (string storePath)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    const BrawResolutionScale* scale = FindResolutionScale("quarter");
+    const BrawPixelFormat* format = DefaultPixelFormat();
+
+    if (info[1].IsObject())
+    {
+        Napi::Object opts = info[1].As<Napi::Object>();
+
+        Napi::Value scaleName = opts.Get("scale");
+        if (scaleName.IsString())
+        {
+            std::string name = scaleName.As<Napi::String>().Utf8Value();
+            scale = FindResolutionScale(name.c_str());
+            if (!scale) {
+                Napi::TypeError::New(env, "Unknown resolution scale: " + name).ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+
+        Napi::Value formatName = opts.Get("format");
+        if (formatName.IsString())
+        {
+            std::string name = formatName.As<Napi::String>().Utf8Value();
+            format = FindPixelFormat(name.c_str());
+            if (!format) {
+                Napi::TypeError::New(env, "Unknown pixel format: " + name).ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+    }
+
+    if (!BrawProxyStore::CanStore(*format, *scale)) {
+        Napi::TypeError::New(env, "Proxies must be rgba8 or bgra8 at quarter or eighth scale").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object resultObj = Napi::Object::New(env);
+
+    if (!m_clip->IsOpen())
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", "Session is closed");
+        return resultObj;
+    }
+
+    const BrawClipInfo& clipInfo = m_clip->Info();
+    std::string error;
+    std::shared_ptr<BrawProxyStore> store = BrawProxyStore::Open(info[0].As<Napi::String>().Utf8Value(), m_filePath,
+                                                                 clipInfo.frame_count, clipInfo.width,
+                                                                 clipInfo.height, format, scale, error);
+    if (!store)
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", error);
+        return resultObj;
+    }
+
+    m_proxies = store;
+    SetProxyResult(env, resultObj, *store);
+    return resultObj;
+}
+
+/**
+ * Decode every frame missing from the attached proxy store into it
+ *
+ * Runs at batch priority, so interactive reads keep their decoder slots.
+ * Frames already stored by any process are skipped.
+ *
+ * @param {object} [opts] - { maxInFlight } jobs kept queued (default 4)
+ * @returns {Promise<object>} attachProxies result plus built, the frames added
+ */
+Napi::Value ClipSession::BuildProxies(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    uint32_t maxInFlight = 4;
+    if (info[0].IsObject())
+    {
+        Napi::Value value = info[0].As<Napi::Object>().Get("maxInFlight");
+        if (value.IsNumber())
+            maxInFlight = value.As<Napi::Number>().Uint32Value();
+    }
+
+    if (!m_proxies)
+        return FrameRequest::Failed(env, "No proxy store attached");
+
+    ProxyWorker* worker = new ProxyWorker(env, m_clip, m_proxies, maxInFlight);
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * The clip processing attributes frames decode with when processing is not given
+ *
+ * @returns {object} { success, attributes } keyed by the processing option names
+ */
+Napi::Value ClipSession::ClipProcessing(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    Napi::Object obj = Napi::Object::New(env);
+    BrawProcessing processing;
+    std::string error;
+
+    if (m_clip->GetClipProcessing(processing, error) != S_OK)
+    {
+        obj.Set("success", false);
+        obj.Set("error", error);
+        return obj;
+    }
+
+    Napi::Object attributes = Napi::Object::New(env);
+    const std::vector<BrawProcessingValue>& values = processing.Values();
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (values[i].attribute->type == blackmagicRawVariantTypeString)
+            attributes.Set(values[i].attribute->name, values[i].text);
+        else
+            attributes.Set(values[i].attribute->name, Napi::Number::New(env, values[i].number));
+    }
+
+    obj.Set("success", true);
+    obj.Set("attributes", attributes);
+    return obj;
+}
+
+/**
+ * Cancel requests made with a requestId
+ *
+ * Frames not yet handed to the decoder are skipped, and frames already
+ * decoding are dropped once done. Cancelled frames resolve with
+ * { success: false, error: "Cancelled", cancelled: true }.
+ *
+ * @param {string} [requestId] - Request to cancel; every tracked request when omitted
+ * @returns {number} Number of requests cancelled
+ */
+Napi::Value ClipSession::Cancel(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+    uint32_t cancelled = 0;
+
+    if (info.Length() > 0 && (info[0].IsString() || info[0].IsNumber()))
+    {
+        std::map<std::string, std::weak_ptr<FrameCancel> >::iterator it =
+            m_requests.find(info[0].ToString().Utf8Value());
+
+        if (it != m_requests.end())
+        {
+            std::shared_ptr<FrameCancel> cancel = it->second.lock();
+            if (cancel && !cancel->IsCancelled())
+            {
+                cancel->Cancel();
+                cancelled++;
+            }
+            m_requests.erase(it);
+        }
+    }
+    else
+    {
+        std::map<std::string, std::weak_ptr<FrameCancel> >::iterator it;
+        for (it = m_requests.begin(); it != m_requests.end(); ++it)
+        {
+            std::shared_ptr<FrameCancel> cancel = it->second.lock();
+            if (cancel && !cancel->IsCancelled())
+            {
+                cancel->Cancel();
+                cancelled++;
+            }
+        }
+        m_requests.clear();
+    }
+
+    return Napi::Number::New(env, cancelled);
+}
+
+void ClipSession::TrackRequest(const FrameOptions& options)
+{
+    if (options.request_id.empty() || !options.cancel)
+        return;
+
+    // Drop requests that have settled since the last one
+    std::map<std::string, std::weak_ptr<FrameCancel> >::iterator it = m_requests.begin();
+    while (it != m_requests.end())
+    {
+        if (it->second.expired())
+            m_requests.erase(it++);
+        else
+            ++it;
+    }
+
+    m_requests[options.request_id] = options.cancel;
+}
+
+/**
+ * Release this session's hold on the clip. The codec closes once no other
+ * session or in-flight request uses it. Further reads fail.
+ */
+Napi::Value ClipSession::Close(const Napi::CallbackInfo& info)
+{
+    m_prefetcher->Detach();
+    m_pool.reset();
+    m_proxies.reset();
+    m_clip = std::make_shared<BrawClip>();
+    return info.Env().Undefined();
+}
@@ -0,0 +1,123 @@
+/*
+ * ClipSession - JS handle for a long-lived BrawClip
+ *
+ * Returned by openClip(path). Keeps the factory, codec and clip alive between
+ * calls so repeated reads of the same file skip codec construction.
+ */
+
+#ifndef CLIP_SESSION_H
+#define CLIP_SESSION_H
+
+#include <napi.h>
+#include "BrawClip.h"
+#include "BrawDecodePool.h"
+#include "BrawPrefetcher.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+// Cancellation state of one JS request, shared with the SDK threads doing its work
+class FrameCancel
+{
+public:
+    // timeoutMs of 0 never expires
+    explicit FrameCancel(uint32_t timeoutMs);
+
+    void Cancel() { m_cancelled = true; }
+
+    // True once cancel() has been called for the request
+    bool IsCancelled() const { return m_cancelled; }
+
+    // Cancelled, or past the deadline; work not yet decoding is then skipped
+    bool Expired() const;
+
+private:
+    std::atomic<bool> m_cancelled;
+    bool m_hasDeadline;
+    std::chrono::steady_clock::time_point m_deadline;
+};
+
+// Options accepted by every frame-returning export
+struct FrameOptions
+{
+    FrameOptions() : zero_copy(false) {}
+
+    // Whether work for the request should still be started / delivered
+    bool Expired() const { return cancel && cancel->Expired(); }
+    bool IsCancelled() const { return cancel && cancel->IsCancelled(); }
+
+    // Only used by exports that open the clip themselves
+    BrawOpenOptions open;
+    BrawDecodeOptions decode;
+
+    // Hand out the SDK's buffer directly; it is released when the Buffer is collected
+    bool zero_copy;
+
+    // Name cancel() knows the request by; empty when it was not given one
+    std::string request_id;
+
+    // Set when the request has an id or a timeout
+    std::shared_ptr<FrameCancel> cancel;
+};
+
+// Read an optional options object. Throws a TypeError and returns false on bad input.
+bool ParseOpenOptions(Napi::Env env, Napi::Value value, BrawOpenOptions& options);
+bool ParseFrameOptions(Napi::Env env, Napi::Value value, FrameOptions& options);
+
+// Fill a result object with the shape returned by extractMetadata
+void SetMetadataResult(Napi::Env env, Napi::Object& obj, const BrawClipInfo& info);
+
+// Fill a result object with the shape returned by extractFrame. In zero-copy
+// mode the frame's image reference moves into the returned Buffer.
+void SetFrameResult(Napi::Env env, Napi::Object& obj, BrawFrame& frame, const FrameOptions& options);
+
+class ClipSession : public Napi::ObjectWrap<ClipSession>
+{
+public:
+    static Napi::Function Init(Napi::Env env);
+    static Napi::Value Open(const Napi::CallbackInfo& info);
+
+    ClipSession(const Napi::CallbackInfo& info);
+    ~ClipSession();
+
+private:
+    Napi::Value ReadFrame(const Napi::CallbackInfo& info);
+    Napi::Value ReadFrameAsync(const Napi::CallbackInfo& info);
+    Napi::Value ReadFrames(const Napi::CallbackInfo& info);
+    Napi::Value SetPrefetch(const Napi::CallbackInfo& info);
+    Napi::Value PrefetchStats(const Napi::CallbackInfo& info);
+    Napi::Value Metadata(const Napi::CallbackInfo& info);
+    Napi::Value FrameAt(const Napi::CallbackInfo& info);
+    Napi::Value ClipProcessing(const Napi::CallbackInfo& info);
+    Napi::Value AttachProxies(const Napi::CallbackInfo& info);
+    Napi::Value BuildProxies(const Napi::CallbackInfo& info);
+    Napi::Value Cancel(const Napi::CallbackInfo& info);
+    Napi::Value Close(const Napi::CallbackInfo& info);
+
+    // Make options.request_id cancellable through cancel()
+    void TrackRequest(const FrameOptions& options);
+
+    // Shared with in-flight async requests so a collected session cannot
+    // free the codec underneath them
+    std::shared_ptr<BrawClip> m_clip;
+
+    // Fed by readFrame/readFrameAsync; idle until setPrefetch sets a depth
+    std::shared_ptr<BrawPrefetcher> m_prefetcher;
+
+    // Extra codecs for readFrames with codecs > 1, opened on first use
+    std::string m_filePath;
+    BrawOpenOptions m_openOptions;
+    std::shared_ptr<BrawDecodePool> m_pool;
+    uint32_t m_poolSize;
+
+    // Set by attachProxies and handed to this session's reads only; other
+    // sessions sharing the clip keep their own
+    std::shared_ptr<BrawProxyStore> m_proxies;
+
+    // Requests still running, by request id; only touched on the JS thread
+    std::map<std::string, std::weak_ptr<FrameCancel> > m_requests;
+};
+
+#endif // CLIP_SESSION_H
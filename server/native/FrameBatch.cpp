@@ -0,0 +1,326 @@
+/*
+ * FrameBatch - pipelined multi-frame decode
+ */
+
+#include "FrameBatch.h"
+
+// One requested frame; passed to the SDK as job user data
+class FrameBatch::Slot : public BrawFrameCompletion
+{
+public:
+    Slot(FrameBatch* batch, int64_t frameIndex)
+        : frame_index(frameIndex), result(E_FAIL), codec(0), m_batch(batch)
+    {
+    }
+
+    virtual void FrameComplete(HRESULT frameResult, BrawFrame& decodedFrame, const std::string& frameError)
+    {
+        result = frameResult;
+        error = frameError;
+        frame.Swap(decodedFrame);
+
+        m_batch->SlotComplete(codec);
+    }
+
+    virtual bool Cancelled() { return m_batch->m_options.Expired(); }
+
+    int64_t frame_index;
+    HRESULT result;
+    size_t codec; // Pool index of the codec the job went to
+    BrawFrame frame;
+    std::string error;
+
+private:
+    FrameBatch* m_batch;
+};
+
+// Opens (if needed) and primes the pipeline on a worker thread
+class FrameBatch::SubmitWorker : public Napi::AsyncWorker
+{
+public:
+    SubmitWorker(Napi::Env env, FrameBatch* batch, const std::string& filePath)
+        : Napi::AsyncWorker(env, "BRAWFrameBatchSubmit"), m_batch(batch), m_filePath(filePath)
+    {
+    }
+
+protected:
+    virtual void Execute()
+    {
+        std::string error;
+
+        if (!m_filePath.empty())
+            m_batch->m_pool->Open(m_filePath.c_str(), m_batch->m_options.open, m_batch->m_codecs, error);
+
+        // The batch owns itself from here and may be freed at any moment
+        m_batch->Start(error);
+    }
+
+private:
+    FrameBatch* m_batch;
+    std::string m_filePath;
+};
+
+bool FrameBatch::ParseArguments(const Napi::CallbackInfo& info, size_t first,
+                                std::vector<int64_t>& frameIndices, uint32_t& maxInFlight,
+                                uint32_t& codecs, FrameOptions& options)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() <= first || !info[first].IsArray()) {
+        Napi::TypeError::New(env, "Array of frame indices expected").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Array indices = info[first].As<Napi::Array>();
+    frameIndices.clear();
+    frameIndices.reserve(indices.Length());
+
+    for (uint32_t i = 0; i < indices.Length(); i++)
+    {
+        Napi::Value value = indices.Get(i);
+        if (!value.IsNumber()) {
+            Napi::TypeError::New(env, "Frame indices must be numbers").ThrowAsJavaScriptException();
+            return false;
+        }
+        frameIndices.push_back(value.As<Napi::Number>().Int64Value());
+    }
+
+    maxInFlight = kDefaultMaxInFlight;
+    codecs = 1;
+
+    if (!ParseFrameOptions(env, info[first + 1], options))
+        return false;
+
+    // Exports yield to interactive reads unless told otherwise
+    options.decode.priority = brawPriorityBatch;
+
+    if (info[first + 1].IsObject())
+    {
+        Napi::Object opts = info[first + 1].As<Napi::Object>();
+        Napi::Value value = opts.Get("priority");
+        if (value.IsString())
+            FindPriority(value.As<Napi::String>().Utf8Value().c_str(), options.decode.priority);
+
+        value = opts.Get("maxInFlight");
+        if (value.IsNumber() && value.As<Napi::Number>().Uint32Value() > 0)
+            maxInFlight = value.As<Napi::Number>().Uint32Value();
+
+        value = opts.Get("codecs");
+        if (value.IsNumber())
+        {
+            codecs = value.As<Napi::Number>().Uint32Value();
+            if (codecs == 0)
+                codecs = BrawDecodePool::DefaultSize();
+        }
+    }
+
+    return true;
+}
+
+FrameBatch::FrameBatch(Napi::Env env, std::shared_ptr<BrawDecodePool> pool,
+                       const std::vector<int64_t>& frameIndices, uint32_t maxInFlight, uint32_t codecs,
+                       const FrameOptions& options)
+    : m_deferred(Napi::Promise::Deferred::New(env)),
+      m_completion(CompletionFunction::New(env, "BRAWFrameBatchComplete", 0, 1)),
+      m_pool(pool),
+      m_maxInFlight(maxInFlight),
+      m_codecs(codecs),
+      m_options(options),
+      m_remaining(frameIndices.size())
+{
+    m_slots.reserve(frameIndices.size());
+    for (size_t i = 0; i < frameIndices.size(); i++)
+        m_slots.push_back(new Slot(this, frameIndices[i]));
+}
+
+FrameBatch::~FrameBatch()
+{
+    for (size_t i = 0; i < m_slots.size(); i++)
+        delete m_slots[i];
+}
+
+Napi::Value FrameBatch::Queue(Napi::Env env, std::shared_ptr<BrawDecodePool> pool, const std::string& filePath,
+                              const std::vector<int64_t>& frameIndices, uint32_t maxInFlight, uint32_t codecs,
+                              const FrameOptions& options)
+{
+    FrameBatch* batch = new FrameBatch(env, pool, frameIndices, maxInFlight, codecs, options);
+    Napi::Promise promise = batch->m_deferred.Promise();
+
+    SubmitWorker* worker = new SubmitWorker(env, batch, filePath);
+    worker->Queue();
+
+    return promise;
+}
+
+void FrameBatch::Start(const std::string& openError)
+{
+    bool finished = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!openError.empty())
+        {
+            for (size_t i = 0; i < m_slots.size(); i++)
+                m_slots[i]->error = openError;
+
+            m_remaining = 0;
+        }
+        else
+        {
+            // Contiguous runs, so each codec reads through its part of the file
+            size_t codecs = m_pool->Size();
+
+            m_queues.resize(codecs);
+            m_inFlight.assign(codecs, 0);
+            for (size_t i = 0; i < m_slots.size(); i++)
+                m_queues[i * codecs / m_slots.size()].push_back(i);
+
+            for (size_t codec = 0; codec < codecs; codec++)
+                PumpLocked(codec);
+        }
+
+        finished = (m_remaining == 0);
+    }
+
+    if (finished)
+        Finish();
+}
+
+void FrameBatch::SlotComplete(size_t codec)
+{
+    bool finished = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_inFlight[codec]--;
+        m_remaining--;
+        PumpLocked(codec);
+        finished = (m_remaining == 0);
+    }
+
+    if (finished)
+        Finish();
+}
+
+// Top codec's pipeline back up to maxInFlight jobs
+void FrameBatch::PumpLocked(size_t codec)
+{
+    BrawClip& clip = *m_pool->Clip(codec);
+    size_t slotIndex = 0;
+
+    while (m_inFlight[codec] < m_maxInFlight && NextSlotLocked(codec, slotIndex))
+    {
+        Slot* slot = m_slots[slotIndex];
+        slot->codec = codec;
+
+        if (slot->frame_index < 0)
+        {
+            slot->error = "Frame index out of range";
+            m_remaining--;
+            continue;
+        }
+
+        if (m_options.Expired())
+        {
+            slot->result = E_ABORT;
+            slot->error = "Cancelled";
+            m_remaining--;
+            continue;
+        }
+
+        if (clip.LookupFrame(static_cast<uint64_t>(slot->frame_index), m_options.decode, slot->frame))
+        {
+            slot->result = S_OK;
+            m_remaining--;
+            continue;
+        }
+
+        if (clip.SubmitFrame(static_cast<uint64_t>(slot->frame_index), m_options.decode, slot, slot->error) == S_OK)
+            m_inFlight[codec]++;
+        else
+            m_remaining--;
+    }
+}
+
+// Take from the front of codec's own run, else steal from the back of the longest one
+bool FrameBatch::NextSlotLocked(size_t codec, size_t& slotIndex)
+{
+    if (!m_queues[codec].empty())
+    {
+        slotIndex = m_queues[codec].front();
+        m_queues[codec].pop_front();
+        return true;
+    }
+
+    size_t victim = codec;
+    for (size_t i = 0; i < m_queues.size(); i++)
+    {
+        if (m_queues[i].size() > m_queues[victim].size())
+            victim = i;
+    }
+
+    if (m_queues[victim].empty())
+        return false;
+
+    slotIndex = m_queues[victim].back();
+    m_queues[victim].pop_back();
+    return true;
+}
+
+void FrameBatch::Finish()
+{
+    // Copy the handle: once queued, the main thread may free this batch.
+    // Refused while the environment closes, when nothing would free it.
+    CompletionFunction completion = m_completion;
+    if (completion.NonBlockingCall(this) != napi_ok)
+        delete this;
+    completion.Release();
+}
+
+void FrameBatch::CallJs(Napi::Env env, Napi::Function, std::nullptr_t*, FrameBatch* batch)
+{
+    if (env != nullptr)
+        batch->Settle(env);
+
+    delete batch;
+}
+
+void FrameBatch::Settle(Napi::Env env)
+{
+    Napi::Array frames = Napi::Array::New(env, m_slots.size());
+
+    for (size_t i = 0; i < m_slots.size(); i++)
+    {
+        Slot* slot = m_slots[i];
+        Napi::Object resultObj = Napi::Object::New(env);
+
+        if (slot->result == S_OK && m_options.IsCancelled())
+        {
+            slot->result = E_ABORT;
+            slot->error = "Cancelled";
+        }
+
+        if (slot->result == S_OK)
+        {
+            SetFrameResult(env, resultObj, slot->frame, m_options);
+        }
+        else
+        {
+            resultObj.Set("success", false);
+            resultObj.Set("error", slot->error);
+            if (slot->result == E_ABORT)
+                resultObj.Set("cancelled", true);
+        }
+
+        resultObj.Set("frame_index", Napi::Number::New(env, static_cast<double>(slot->frame_index)));
+        frames.Set(static_cast<uint32_t>(i), resultObj);
+
+        // Hand the SDK buffer back as soon as it has been copied out
+        // (a no-op in zero-copy mode, where the Buffer now owns it)
+        slot->frame.Reset();
+    }
+
+    m_deferred.Resolve(frames);
+}
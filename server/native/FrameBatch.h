@@ -0,0 +1,78 @@
+/*
+ * FrameBatch - pipelined multi-frame decode
+ *
+ * Keeps up to maxInFlight read/decode jobs queued on each codec of a
+ * BrawDecodePool so the SDK's internal pipelines stay full. Frames are
+ * sharded into contiguous runs per codec, and a codec that runs dry steals
+ * from the tail of the longest remaining run. Each job carries its slot as
+ * user data and results are collected in ProcessComplete; the promise
+ * settles once every slot is filled.
+ */
+
+#ifndef FRAME_BATCH_H
+#define FRAME_BATCH_H
+
+#include <napi.h>
+#include "BrawClip.h"
+#include "BrawDecodePool.h"
+#include "ClipSession.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FrameBatch
+{
+public:
+    static const uint32_t kDefaultMaxInFlight = 8;
+
+    // Decode every index in frameIndices. When filePath is non-empty the
+    // pool is opened with codecs codecs on the worker first (if it is not
+    // open already). Resolves with an array of extractFrame-shaped
+    // results, in request order.
+    static Napi::Value Queue(Napi::Env env, std::shared_ptr<BrawDecodePool> pool, const std::string& filePath,
+                             const std::vector<int64_t>& frameIndices, uint32_t maxInFlight, uint32_t codecs,
+                             const FrameOptions& options);
+
+    // Read (indices[], opts?) starting at info[first]. Throws a TypeError
+    // and returns false on bad input. codecs is 1 unless opts asks for more;
+    // 0 from opts becomes BrawDecodePool::DefaultSize().
+    static bool ParseArguments(const Napi::CallbackInfo& info, size_t first,
+                               std::vector<int64_t>& frameIndices, uint32_t& maxInFlight,
+                               uint32_t& codecs, FrameOptions& options);
+
+private:
+    class Slot;
+    class SubmitWorker;
+
+    static void CallJs(Napi::Env env, Napi::Function, std::nullptr_t*, FrameBatch* batch);
+    typedef Napi::TypedThreadSafeFunction<std::nullptr_t, FrameBatch, &FrameBatch::CallJs> CompletionFunction;
+
+    FrameBatch(Napi::Env env, std::shared_ptr<BrawDecodePool> pool,
+               const std::vector<int64_t>& frameIndices, uint32_t maxInFlight, uint32_t codecs,
+               const FrameOptions& options);
+    ~FrameBatch();
+
+    void Start(const std::string& openError);
+    void SlotComplete(size_t codec);
+    void PumpLocked(size_t codec);
+    bool NextSlotLocked(size_t codec, size_t& slotIndex);
+    void Finish();
+    void Settle(Napi::Env env);
+
+    Napi::Promise::Deferred m_deferred;
+    CompletionFunction m_completion;
+    std::shared_ptr<BrawDecodePool> m_pool;
+    std::vector<Slot*> m_slots;
+    uint32_t m_maxInFlight; // Per codec
+    uint32_t m_codecs;
+    FrameOptions m_options;
+
+    std::mutex m_mutex;
+    std::vector<std::deque<size_t> > m_queues; // Slot indices still to submit, per codec
+    std::vector<uint32_t> m_inFlight; // Per codec
+    size_t m_remaining;
+};
+
+#endif // FRAME_BATCH_H
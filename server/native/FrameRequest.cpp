@@ -0,0 +1,164 @@
+/*
+ * FrameRequest - Promise-based frame decode
+ */
+
+#include "FrameRequest.h"
+
+// Opens (if needed) and submits on a worker thread. Completion is reported
+// by the SDK callback, not by this worker, unless submission itself failed
+// or the frame was already cached.
+class FrameRequest::SubmitWorker : public Napi::AsyncWorker
+{
+public:
+    SubmitWorker(Napi::Env env, FrameRequest* request, const std::string& filePath, uint64_t frameIndex,
+                 std::shared_ptr<BrawPrefetcher> prefetcher)
+        : Napi::AsyncWorker(env, "BRAWFrameSubmit"),
+          m_request(request), m_filePath(filePath), m_frameIndex(frameIndex),
+          m_decode(request->m_options.decode), m_prefetcher(prefetcher), m_submitted(false), m_result(E_FAIL)
+    {
+    }
+
+protected:
+    virtual void Execute()
+    {
+        std::shared_ptr<BrawClip> clip = m_request->m_clip;
+
+        if (!m_filePath.empty() && clip->Open(m_filePath.c_str(), m_request->m_options.open, m_error) != S_OK)
+            return;
+
+        // Superseded while waiting for a worker
+        if (m_request->Cancelled())
+        {
+            m_result = E_ABORT;
+            m_error = "Cancelled";
+            return;
+        }
+
+        // After a successful submit the request may complete and be freed at
+        // any moment, so it must not be touched again from here on.
+        BrawFrame frame;
+        if (clip->LookupFrame(m_frameIndex, m_decode, frame))
+        {
+            m_submitted = true;
+            m_request->FrameComplete(S_OK, frame, std::string());
+        }
+        else
+        {
+            m_submitted = clip->SubmitFrame(m_frameIndex, m_decode, m_request, m_error) == S_OK;
+        }
+
+        // Queued behind the read itself, so look-ahead never delays it
+        if (m_submitted && m_prefetcher)
+            m_prefetcher->Access(m_frameIndex, m_decode);
+    }
+
+    virtual void OnOK()
+    {
+        if (!m_submitted)
+            m_request->Fail(Env(), m_result, m_error);
+    }
+
+private:
+    FrameRequest* m_request;
+    std::string m_filePath;
+    uint64_t m_frameIndex;
+    BrawDecodeOptions m_decode;
+    std::shared_ptr<BrawPrefetcher> m_prefetcher;
+    bool m_submitted;
+    HRESULT m_result;
+    std::string m_error;
+};
+
+FrameRequest::FrameRequest(Napi::Env env, std::shared_ptr<BrawClip> clip, const FrameOptions& options)
+    : m_deferred(Napi::Promise::Deferred::New(env)),
+      m_completion(CompletionFunction::New(env, "BRAWFrameComplete", 0, 1)),
+      m_clip(clip),
+      m_options(options),
+      m_result(E_FAIL)
+{
+}
+
+Napi::Value FrameRequest::Queue(Napi::Env env, std::shared_ptr<BrawClip> clip,
+                                const std::string& filePath, uint64_t frameIndex,
+                                const FrameOptions& options,
+                                std::shared_ptr<BrawPrefetcher> prefetcher)
+{
+    FrameRequest* request = new FrameRequest(env, clip, options);
+    Napi::Promise promise = request->m_deferred.Promise();
+
+    SubmitWorker* worker = new SubmitWorker(env, request, filePath, frameIndex, prefetcher);
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value FrameRequest::Failed(Napi::Env env, const std::string& error)
+{
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+    Napi::Object resultObj = Napi::Object::New(env);
+
+    resultObj.Set("success", false);
+    resultObj.Set("error", error);
+    deferred.Resolve(resultObj);
+
+    return deferred.Promise();
+}
+
+void FrameRequest::FrameComplete(HRESULT result, BrawFrame& frame, const std::string& error)
+{
+    m_result = result;
+    m_error = error;
+    m_frame.Swap(frame);
+
+    // Copy the handle: once queued, the main thread may free this request.
+    // Refused while the environment closes, when nothing would free it.
+    CompletionFunction completion = m_completion;
+    if (completion.NonBlockingCall(this) != napi_ok)
+        delete this;
+    completion.Release();
+}
+
+void FrameRequest::CallJs(Napi::Env env, Napi::Function, std::nullptr_t*, FrameRequest* request)
+{
+    if (env != nullptr)
+        request->Settle(env);
+
+    delete request;
+}
+
+void FrameRequest::Settle(Napi::Env env)
+{
+    Napi::Object resultObj = Napi::Object::New(env);
+
+    // Decoded before cancel() caught up with it; nobody wants the frame now
+    if (m_result == S_OK && m_options.IsCancelled())
+    {
+        m_result = E_ABORT;
+        m_error = "Cancelled";
+        m_frame.Reset();
+    }
+
+    if (m_result == S_OK)
+    {
+        SetFrameResult(env, resultObj, m_frame, m_options);
+    }
+    else
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", m_error);
+        if (m_result == E_ABORT)
+            resultObj.Set("cancelled", true);
+    }
+
+    m_deferred.Resolve(resultObj);
+}
+
+void FrameRequest::Fail(Napi::Env env, HRESULT result, const std::string& error)
+{
+    m_result = result;
+    m_error = error;
+
+    m_completion.Release();
+    Settle(env);
+    delete this;
+}
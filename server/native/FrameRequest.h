@@ -0,0 +1,55 @@
+/*
+ * FrameRequest - Promise-based frame decode
+ *
+ * The read job is submitted from a libuv worker and the SDK's ProcessComplete
+ * resolves the promise through a thread-safe function, so the event loop is
+ * never blocked by FlushJobs.
+ */
+
+#ifndef FRAME_REQUEST_H
+#define FRAME_REQUEST_H
+
+#include <napi.h>
+#include "BrawClip.h"
+#include "ClipSession.h"
+#include <memory>
+#include <string>
+
+class FrameRequest : public BrawFrameCompletion
+{
+public:
+    // Decode frameIndex from clip. When filePath is non-empty the clip is
+    // opened on the worker first. Resolves with the extractFrame result shape.
+    // A prefetcher, if given, is told about the read once it is submitted.
+    static Napi::Value Queue(Napi::Env env, std::shared_ptr<BrawClip> clip,
+                             const std::string& filePath, uint64_t frameIndex,
+                             const FrameOptions& options,
+                             std::shared_ptr<BrawPrefetcher> prefetcher = std::shared_ptr<BrawPrefetcher>());
+
+    // Already-settled promise carrying { success: false, error }
+    static Napi::Value Failed(Napi::Env env, const std::string& error);
+
+    virtual void FrameComplete(HRESULT result, BrawFrame& frame, const std::string& error);
+    virtual bool Cancelled() { return m_options.Expired(); }
+
+private:
+    class SubmitWorker;
+
+    static void CallJs(Napi::Env env, Napi::Function, std::nullptr_t*, FrameRequest* request);
+    typedef Napi::TypedThreadSafeFunction<std::nullptr_t, FrameRequest, &FrameRequest::CallJs> CompletionFunction;
+
+    FrameRequest(Napi::Env env, std::shared_ptr<BrawClip> clip, const FrameOptions& options);
+
+    void Settle(Napi::Env env);
+    void Fail(Napi::Env env, HRESULT result, const std::string& error);
+
+    Napi::Promise::Deferred m_deferred;
+    CompletionFunction m_completion;
+    std::shared_ptr<BrawClip> m_clip;
+    FrameOptions m_options;
+    HRESULT m_result;
+    BrawFrame m_frame;
+    std::string m_error;
+};
+
+#endif // FRAME_REQUEST_H
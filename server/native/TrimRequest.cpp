@@ -0,0 +1,241 @@
+/*
+ * TrimRequest - Promise-based sub-clip export without decode
+ */
+
+#include "TrimRequest.h"
+#include "BrawAddon.h"
+#include <sys/stat.h>
+#include <stdio.h>
+
+bool ParseTrimOptions(Napi::Env env, Napi::Value value, TrimOptions& options)
+{
+    if (!ParseOpenOptions(env, value, options.open))
+        return false;
+
+    if (value.IsUndefined() || value.IsNull())
+        return true;
+
+    Napi::Object opts = value.As<Napi::Object>();
+
+    Napi::Value onProgress = opts.Get("onProgress");
+    if (onProgress.IsFunction())
+        options.on_progress = onProgress.As<Napi::Function>();
+    else if (!onProgress.IsUndefined() && !onProgress.IsNull()) {
+        Napi::TypeError::New(env, "onProgress must be a function").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Value requestId = opts.Get("requestId");
+    if (requestId.IsString() || requestId.IsNumber())
+        options.request_id = requestId.ToString().Utf8Value();
+
+    uint32_t timeoutMs = 0;
+    Napi::Value timeout = opts.Get("timeoutMs");
+    if (timeout.IsNumber())
+        timeoutMs = timeout.As<Napi::Number>().Uint32Value();
+
+    if (!options.request_id.empty() || timeoutMs > 0)
+        options.cancel = std::make_shared<FrameCancel>(timeoutMs);
+
+    return true;
+}
+
+// Opens the clip and submits the trim on a worker thread. Completion is
+// reported by the SDK callback, unless submission itself failed.
+class TrimRequest::SubmitWorker : public Napi::AsyncWorker
+{
+public:
+    SubmitWorker(Napi::Env env, TrimRequest* request, const std::string& sourcePath, uint64_t firstFrame,
+                 uint64_t lastFrame, const BrawOpenOptions& open)
+        : Napi::AsyncWorker(env, "BRAWTrimSubmit"),
+          m_request(request), m_sourcePath(sourcePath), m_outputPath(request->m_outputPath),
+          m_firstFrame(firstFrame), m_lastFrame(lastFrame), m_open(open), m_submitted(false), m_result(E_FAIL)
+    {
+    }
+
+protected:
+    virtual void Execute()
+    {
+        // The SDK would truncate the source while reading it
+        struct stat source;
+        struct stat output;
+        if (stat(m_sourcePath.c_str(), &source) == 0 && stat(m_outputPath.c_str(), &output) == 0 &&
+            source.st_dev == output.st_dev && source.st_ino == output.st_ino)
+        {
+            m_error = "Output path is the source clip";
+            return;
+        }
+
+        // A codec of its own rather than the registry's: the SDK runs a
+        // codec's jobs in order, so a long trim would hold up scrubbing in
+        // the sessions sharing it
+        std::shared_ptr<BrawClip> clip = std::make_shared<BrawClip>();
+        if (clip->Open(m_sourcePath.c_str(), m_open, m_error) != S_OK)
+            return;
+
+        if (m_request->Cancelled())
+        {
+            m_result = E_ABORT;
+            m_error = "Cancelled";
+            return;
+        }
+
+        // Set before submitting: the request may complete and be freed at
+        // any moment after a successful submit, and must not be touched
+        m_request->m_clip = clip;
+        m_submitted = clip->SubmitTrim(m_request->m_partPath.c_str(), m_firstFrame, m_lastFrame - m_firstFrame + 1,
+                                       m_request, m_error) == S_OK;
+    }
+
+    virtual void OnOK()
+    {
+        if (!m_submitted)
+            m_request->Fail(Env(), m_result, m_error);
+    }
+
+private:
+    TrimRequest* m_request;
+    std::string m_sourcePath;
+    std::string m_outputPath;
+    uint64_t m_firstFrame;
+    uint64_t m_lastFrame;
+    BrawOpenOptions m_open;
+    bool m_submitted;
+    HRESULT m_result;
+    std::string m_error;
+};
+
+TrimRequest::TrimRequest(Napi::Env env, const std::string& outputPath, uint64_t frameCount,
+                         const TrimOptions& options)
+    : m_deferred(Napi::Promise::Deferred::New(env)),
+      m_completion(CompletionFunction::New(env, "BRAWTrimComplete", 0, 1, this)),
+      m_requestId(options.request_id),
+      m_cancel(options.cancel),
+      m_outputPath(outputPath),
+      m_partPath(outputPath + ".part"),
+      m_frameCount(frameCount),
+      m_progressQueued(false),
+      m_result(E_FAIL),
+      m_bytes(0)
+{
+    if (!options.on_progress.IsEmpty())
+        m_onProgress = Napi::Persistent(options.on_progress);
+}
+
+Napi::Value TrimRequest::Queue(Napi::Env env, const std::string& sourcePath, uint64_t firstFrame,
+                               uint64_t lastFrame, const std::string& outputPath, const TrimOptions& options)
+{
+    TrimRequest* request = new TrimRequest(env, outputPath, lastFrame - firstFrame + 1, options);
+    Napi::Promise promise = request->m_deferred.Promise();
+
+    if (!options.request_id.empty())
+        BrawAddon::Get(env).trims[options.request_id] = options.cancel;
+
+    SubmitWorker* worker = new SubmitWorker(env, request, sourcePath, firstFrame, lastFrame, options.open);
+    worker->Queue();
+
+    return promise;
+}
+
+void TrimRequest::TrimProgress(float progress)
+{
+    if (m_onProgress.IsEmpty() || m_progressQueued.exchange(true))
+        return;
+
+    // Not queued once the environment is going away; the report is dropped
+    // and the next one may try again
+    float* report = new float(progress);
+    if (m_completion.NonBlockingCall(report) != napi_ok)
+    {
+        delete report;
+        m_progressQueued = false;
+    }
+}
+
+void TrimRequest::TrimComplete(HRESULT result, const std::string& error)
+{
+    m_result = result;
+    m_error = error;
+
+    // Only a finished clip replaces outputPath; a file already there is
+    // left alone otherwise
+    if (result == S_OK && rename(m_partPath.c_str(), m_outputPath.c_str()) != 0)
+    {
+        m_result = E_FAIL;
+        m_error = "Failed to move the trimmed clip into place";
+    }
+
+    struct stat output;
+    if (m_result == S_OK && stat(m_outputPath.c_str(), &output) == 0)
+        m_bytes = static_cast<uint64_t>(output.st_size);
+    else if (m_result != S_OK)
+        remove(m_partPath.c_str());
+
+    // Copy the handle: once queued, the main thread may free this request.
+    // Refused while the environment closes, when nothing would free it;
+    // the progress callback's reference goes with the environment.
+    CompletionFunction completion = m_completion;
+    if (completion.NonBlockingCall(nullptr) != napi_ok)
+    {
+        m_onProgress.SuppressDestruct();
+        delete this;
+    }
+    completion.Release();
+}
+
+void TrimRequest::CallJs(Napi::Env env, Napi::Function, TrimRequest* request, float* progress)
+{
+    // Reports still queued at teardown may outlive the request
+    if (progress)
+    {
+        if (env != nullptr)
+        {
+            request->m_progressQueued = false;
+            request->m_onProgress.Call({ Napi::Number::New(env, *progress) });
+        }
+        delete progress;
+        return;
+    }
+
+    if (env != nullptr)
+        request->Settle(env);
+
+    delete request;
+}
+
+void TrimRequest::Settle(Napi::Env env)
+{
+    std::map<std::string, std::shared_ptr<FrameCancel> >& trims = BrawAddon::Get(env).trims;
+    std::map<std::string, std::shared_ptr<FrameCancel> >::iterator tracked = trims.find(m_requestId);
+    if (tracked != trims.end() && tracked->second == m_cancel)
+        trims.erase(tracked);
+
+    Napi::Object resultObj = Napi::Object::New(env);
+
+    if (m_result == S_OK)
+    {
+        resultObj.Set("success", true);
+        resultObj.Set("frame_count", Napi::Number::New(env, static_cast<double>(m_frameCount)));
+        resultObj.Set("bytes", Napi::Number::New(env, static_cast<double>(m_bytes)));
+    }
+    else
+    {
+        resultObj.Set("success", false);
+        resultObj.Set("error", m_error);
+        if (m_result == E_ABORT)
+            resultObj.Set("cancelled", true);
+    }
+
+    m_deferred.Resolve(resultObj);
+}
+
+void TrimRequest::Fail(Napi::Env env, HRESULT result, const std::string& error)
+{
+    m_result = result;
+    m_error = error;
+    remove(m_partPath.c_str());
+
+    m_completion.Release();
+    Settle(env);
+    delete this;
+}
@@ -0,0 +1,74 @@
+/*
+ * TrimRequest - Promise-based sub-clip export without decode
+ *
+ * The SDK's trim job copies the compressed frames of a range, with the
+ * clip's metadata, into a new .braw file, so delivering a select costs file
+ * I/O only. The clip is opened, on a codec of the trim's own, and the trim
+ * submitted from a libuv worker; progress and completion come back through
+ * a thread-safe function.
+ */
+
+#ifndef TRIM_REQUEST_H
+#define TRIM_REQUEST_H
+
+#include <napi.h>
+#include "BrawClip.h"
+#include "ClipSession.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+struct TrimOptions
+{
+    BrawOpenOptions open;
+    std::string request_id; // Cancellable through cancelTrim when set
+    std::shared_ptr<FrameCancel> cancel; // Set when the trim has an id or a timeout
+    Napi::Function on_progress; // Called with 0-1 as the trim is written, when set
+};
+
+// Read trimClip's options object. Throws a TypeError and returns false on bad input.
+bool ParseTrimOptions(Napi::Env env, Napi::Value value, TrimOptions& options);
+
+class TrimRequest : public BrawTrimCompletion
+{
+public:
+    // Write frames firstFrame to lastFrame, inclusive, of sourcePath to
+    // outputPath. Resolves with { success, frame_count, bytes }, or
+    // { success: false, error, cancelled }. The clip is written to
+    // outputPath + ".part" and renamed over outputPath once complete, so a
+    // failed or cancelled trim leaves outputPath as it was.
+    static Napi::Value Queue(Napi::Env env, const std::string& sourcePath, uint64_t firstFrame,
+                             uint64_t lastFrame, const std::string& outputPath, const TrimOptions& options);
+
+    virtual void TrimComplete(HRESULT result, const std::string& error);
+    virtual void TrimProgress(float progress);
+    virtual bool Cancelled() { return m_cancel && m_cancel->Expired(); }
+
+private:
+    class SubmitWorker;
+
+    // progress is null for the completion, which frees the request
+    static void CallJs(Napi::Env env, Napi::Function, TrimRequest* request, float* progress);
+    typedef Napi::TypedThreadSafeFunction<TrimRequest, float, &TrimRequest::CallJs> CompletionFunction;
+
+    TrimRequest(Napi::Env env, const std::string& outputPath, uint64_t frameCount, const TrimOptions& options);
+
+    void Settle(Napi::Env env);
+    void Fail(Napi::Env env, HRESULT result, const std::string& error);
+
+    Napi::Promise::Deferred m_deferred;
+    CompletionFunction m_completion;
+    Napi::FunctionReference m_onProgress;
+    std::shared_ptr<BrawClip> m_clip; // Kept open until the trim completes
+    std::string m_requestId;
+    std::shared_ptr<FrameCancel> m_cancel;
+    std::string m_outputPath;
+    std::string m_partPath; // Written by the SDK, renamed to m_outputPath on success
+    uint64_t m_frameCount;
+    std::atomic<bool> m_progressQueued; // At most one progress report waits for the main thread
+    HRESULT m_result;
+    uint64_t m_bytes;
+    std::string m_error;
+};
+
+#endif // TRIM_REQUEST_H
@@ -4,6 +4,27 @@
       "target_name": "braw",
       "sources": [
         "braw_addon.cpp",
+        "BrawClip.cpp",
+        "BrawPipeline.cpp",
+        "BrawEncoder.cpp",
+        "BrawFrameCache.cpp",
+        "BrawBufferPool.cpp",
+        "BrawScopes.cpp",
+        "BrawGrade.cpp",
+        "BrawKey.cpp",
+        "BrawProcessing.cpp",
+        "BrawMetadata.cpp",
+        "BrawStats.cpp",
+        "BrawPreview.cpp",
+        "BrawProxyStore.cpp",
+        "BrawPrefetcher.cpp",
+        "BrawDecodePool.cpp",
+        "BrawClipRegistry.cpp",
+        "ClipIndex.cpp",
+        "ClipSession.cpp",
+        "FrameBatch.cpp",
+        "FrameRequest.cpp",
+        "TrimRequest.cpp",
         "BlackmagicRawAPIDispatch.cpp"
       ],
       "include_dirs": [
@@ -17,6 +38,94 @@
       "cflags_cc!": [ "-fno-exceptions" ],
       "cflags_cc": [ "-std=c++11" ],
       "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS" ],
+      "libraries": [
+        "-lpthread",
+        "-ldl",
+        "-lturbojpeg",
+        "-lwebp"
+      ]
+    },
+    {
+      "target_name": "braw-bench",
+      "type": "executable",
+      "sources": [
+        "../braw-bench.cpp",
+        "BrawClip.cpp",
+        "BrawPipeline.cpp",
+        "BrawEncoder.cpp",
+        "BrawFrameCache.cpp",
+        "BrawBufferPool.cpp",
+        "BrawScopes.cpp",
+        "BrawGrade.cpp",
+        "BrawKey.cpp",
+        "BrawProcessing.cpp",
+        "BrawMetadata.cpp",
+        "BrawStats.cpp",
+        "BrawProxyStore.cpp",
+        "BrawDecodePool.cpp",
+        "BlackmagicRawAPIDispatch.cpp"
+      ],
+      "include_dirs": [
+        "..",
+        "/usr/local/include/BlackmagicRAW"
+      ],
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "cflags_cc": [ "-std=c++11" ],
+      "libraries": [
+        "-lpthread",
+        "-ldl",
+        "-lturbojpeg",
+        "-lwebp"
+      ]
+    },
+    {
+      "target_name": "braw-extractor",
+      "type": "executable",
+      "sources": [
+        "../braw-extractor.cpp",
+        "BrawClip.cpp",
+        "BrawPipeline.cpp",
+        "BrawEncoder.cpp",
+        "BrawFrameCache.cpp",
+        "BrawBufferPool.cpp",
+        "BrawScopes.cpp",
+        "BrawGrade.cpp",
+        "BrawKey.cpp",
+        "BrawProcessing.cpp",
+        "BrawMetadata.cpp",
+        "BrawStats.cpp",
+        "BrawProxyStore.cpp",
+        "BlackmagicRawAPIDispatch.cpp"
+      ],
+      "include_dirs": [
+        "..",
+        "/usr/local/include/BlackmagicRAW"
+      ],
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "cflags_cc": [ "-std=c++11" ],
+      "libraries": [
+        "-lpthread",
+        "-ldl",
+        "-lturbojpeg",
+        "-lwebp"
+      ]
+    },
+    {
+      "target_name": "braw-extract",
+      "type": "executable",
+      "sources": [
+        "../braw-extract.cpp",
+        "BlackmagicRawAPIDispatch.cpp"
+      ],
+      "include_dirs": [
+        "..",
+        "/usr/local/include/BlackmagicRAW"
+      ],
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "cflags_cc": [ "-std=c++11" ],
       "libraries": [
         "-lpthread",
         "-ldl"
@@ -1,353 +1,543 @@
 /*
  * Blackmagic RAW Node.js Native Addon
- * 
+ *
  * High-performance N-API addon for BRAW processing
  * Based on official Blackmagic RAW SDK
  */
 
 #include <napi.h>
-#include "BlackmagicRawAPI.h"
+#include "BrawAddon.h"
+#include "BrawBufferPool.h"
+#include "BrawClip.h"
+#include "BrawFrameCache.h"
+#include "BrawStats.h"
+#include "ClipIndex.h"
+#include "ClipSession.h"
+#include "FrameBatch.h"
+#include "FrameRequest.h"
+#include "TrimRequest.h"
+#include <memory>
 #include <string>
-#include <cstring>
-
-// Resource format for frame extraction
-static const BlackmagicRawResourceFormat s_resourceFormat = blackmagicRawResourceFormatRGBAU8;
-
-// Callback implementation for frame extraction
-class BRAWCallback : public IBlackmagicRawCallback
-{
-public:
-    BRAWCallback() : processed_image(nullptr), error_occurred(false) {}
-    virtual ~BRAWCallback() {
-        if (processed_image) {
-            processed_image->Release();
-        }
-    }
-
-    IBlackmagicRawProcessedImage* processed_image;
-    bool error_occurred;
-
-    virtual void ReadComplete(IBlackmagicRawJob* readJob, HRESULT result, IBlackmagicRawFrame* frame)
-    {
-        IBlackmagicRawJob* decodeAndProcessJob = nullptr;
-
-        if (result == S_OK)
-            result = frame->SetResourceFormat(s_resourceFormat);
-
-        if (result == S_OK)
-            result = frame->CreateJobDecodeAndProcessFrame(nullptr, nullptr, &decodeAndProcessJob);
 
-        if (result == S_OK)
-            result = decodeAndProcessJob->Submit();
-
-        if (result != S_OK)
-        {
-            error_occurred = true;
-            if (decodeAndProcessJob)
-                decodeAndProcessJob->Release();
-        }
+/**
+ * Extract metadata from BRAW file
+ *
+ * @param {string} filePath - Path to BRAW file
+ * @param {object} [opts] - { pipeline }, as for openClip
+ * @returns {object} Metadata object with frame_count, width, height, frame_rate, frame_rate_num,
+ *                   frame_rate_den (the exact rational rate), duration, pipeline
+ */
+Napi::Object ExtractMetadata(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
 
-        readJob->Release();
+    // Validate arguments
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "String expected for file path").ThrowAsJavaScriptException();
+        return Napi::Object::New(env);
     }
 
-    virtual void ProcessComplete(IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawProcessedImage* processedImage)
-    {
-        if (result != S_OK) {
-            error_occurred = true;
-            job->Release();
-            return;
-        }
-
-        // Store the processed image
-        if (processed_image) {
-            processed_image->Release();
-        }
-        processed_image = processedImage;
-        processed_image->AddRef();
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
 
-        job->Release();
-    }
+    BrawOpenOptions options;
+    if (!ParseOpenOptions(env, info[1], options))
+        return Napi::Object::New(env);
 
-    virtual void DecodeComplete(IBlackmagicRawJob*, HRESULT) {}
-    virtual void TrimProgress(IBlackmagicRawJob*, float) {}
-    virtual void TrimComplete(IBlackmagicRawJob*, HRESULT) {}
-    virtual void SidecarMetadataParseWarning(IBlackmagicRawClip*, const char*, uint32_t, const char*) {}
-    virtual void SidecarMetadataParseError(IBlackmagicRawClip*, const char*, uint32_t, const char*) {}
-    virtual void PreparePipelineComplete(void*, HRESULT) {}
+    Napi::Object metadata = Napi::Object::New(env);
 
-    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, LPVOID*)
-    {
-        return E_NOTIMPL;
-    }
+    BrawClip clip;
+    std::string error;
 
-    virtual ULONG STDMETHODCALLTYPE AddRef(void)
+    if (clip.Open(filePath.c_str(), options, error) != S_OK)
     {
-        return 0;
+        metadata.Set("success", false);
+        metadata.Set("error", error);
+        return metadata;
     }
 
-    virtual ULONG STDMETHODCALLTYPE Release(void)
-    {
-        return 0;
-    }
-};
+    SetMetadataResult(env, metadata, clip.Info());
+    return metadata;
+}
 
 /**
- * Extract metadata from BRAW file
- * 
+ * Extract a single frame from BRAW file as a pixel buffer
+ *
  * @param {string} filePath - Path to BRAW file
- * @returns {object} Metadata object with frame_count, width, height, frame_rate, duration
+ * @param {number} frameIndex - Frame index to extract
+ * @param {object} [opts] - ClipSession.readFrame options plus { pipeline } as for openClip
+ * @returns {object} Object with success, width, height, stride, format, channels,
+ *                   channel_order, sample_type, planar, encoding and buffer (Uint8Array)
  */
-Napi::Object ExtractMetadata(const Napi::CallbackInfo& info) {
+Napi::Object ExtractFrame(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     // Validate arguments
-    if (info.Length() < 1 || !info[0].IsString()) {
-        Napi::TypeError::New(env, "String expected for file path").ThrowAsJavaScriptException();
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected (string filePath, number frameIndex)").ThrowAsJavaScriptException();
         return Napi::Object::New(env);
     }
 
     std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    long frameIndex = info[1].As<Napi::Number>().Int64Value();
 
-    HRESULT result = S_OK;
-    IBlackmagicRawFactory* factory = nullptr;
-    IBlackmagicRaw* codec = nullptr;
-    IBlackmagicRawClip* clip = nullptr;
+    FrameOptions options;
+    if (!ParseFrameOptions(env, info[2], options))
+        return Napi::Object::New(env);
 
-    Napi::Object metadata = Napi::Object::New(env);
+    Napi::Object resultObj = Napi::Object::New(env);
+
+    BrawClip clip;
+    BrawFrame frame;
+    std::string error;
 
     do
     {
-        factory = CreateBlackmagicRawFactoryInstanceFromPath("/usr/local/lib");
-        if (!factory)
-        {
-            metadata.Set("success", false);
-            metadata.Set("error", "Failed to create factory");
+        if (clip.Open(filePath.c_str(), options.open, error) != S_OK)
             break;
-        }
 
-        result = factory->CreateCodec(&codec);
-        if (result != S_OK)
+        if (frameIndex < 0)
         {
-            metadata.Set("success", false);
-            metadata.Set("error", "Failed to create codec");
+            error = "Frame index out of range";
             break;
         }
 
-        result = codec->OpenClip(filePath.c_str(), &clip);
-        if (result != S_OK)
-        {
-            metadata.Set("success", false);
-            metadata.Set("error", "Failed to open clip");
+        if (clip.ReadFrame(static_cast<uint64_t>(frameIndex), options.decode, frame, error) != S_OK)
             break;
-        }
 
-        // Get metadata
-        uint64_t frame_count = 0;
-        unsigned int width = 0;
-        unsigned int height = 0;
-        float frame_rate = 0.0f;
-
-        clip->GetFrameCount(&frame_count);
-        clip->GetWidth(&width);
-        clip->GetHeight(&height);
-        clip->GetFrameRate(&frame_rate);
-
-        // Build result object
-        metadata.Set("success", true);
-        metadata.Set("frame_count", Napi::Number::New(env, static_cast<double>(frame_count)));
-        metadata.Set("width", Napi::Number::New(env, width));
-        metadata.Set("height", Napi::Number::New(env, height));
-        metadata.Set("frame_rate", Napi::Number::New(env, frame_rate));
-        metadata.Set("duration", Napi::Number::New(env, frame_count / frame_rate));
+        SetFrameResult(env, resultObj, frame, options);
+        return resultObj;
 
     } while(0);
 
-    if (clip != nullptr)
-        clip->Release();
-    if (codec != nullptr)
-        codec->Release();
-    if (factory != nullptr)
-        factory->Release();
-
-    return metadata;
+    resultObj.Set("success", false);
+    resultObj.Set("error", error);
+    return resultObj;
 }
 
 /**
- * Extract a single frame from BRAW file as RGBA buffer
- * 
+ * Extract a single frame without blocking the event loop
+ *
+ * The clip is opened and the read job submitted on a worker thread; the
+ * promise settles from the SDK's ProcessComplete callback.
+ *
  * @param {string} filePath - Path to BRAW file
  * @param {number} frameIndex - Frame index to extract
- * @returns {object} Object with success, width, height, and buffer (Uint8Array)
+ * @param {object} [opts] - Same as extractFrame
+ * @returns {Promise<object>} Resolves with the extractFrame result shape
  */
-Napi::Object ExtractFrame(const Napi::CallbackInfo& info) {
+Napi::Value ExtractFrameAsync(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     // Validate arguments
     if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber()) {
         Napi::TypeError::New(env, "Expected (string filePath, number frameIndex)").ThrowAsJavaScriptException();
-        return Napi::Object::New(env);
+        return env.Null();
     }
 
     std::string filePath = info[0].As<Napi::String>().Utf8Value();
     long frameIndex = info[1].As<Napi::Number>().Int64Value();
 
-    HRESULT result = S_OK;
-    IBlackmagicRawFactory* factory = nullptr;
-    IBlackmagicRaw* codec = nullptr;
-    IBlackmagicRawClip* clip = nullptr;
-    IBlackmagicRawJob* readJob = nullptr;
-    BRAWCallback callback;
+    FrameOptions options;
+    if (!ParseFrameOptions(env, info[2], options))
+        return env.Null();
 
-    Napi::Object resultObj = Napi::Object::New(env);
+    if (frameIndex < 0)
+        return FrameRequest::Failed(env, "Frame index out of range");
 
-    do
+    return FrameRequest::Queue(env, std::make_shared<BrawClip>(), filePath, static_cast<uint64_t>(frameIndex), options);
+}
+
+/**
+ * Copy a range of frames into a new clip without decoding them
+ *
+ * The SDK's trim job writes the compressed frames and the clip metadata to
+ * outputPath, so the cost is the I/O of the range alone. The clip is opened
+ * on a worker with a codec of its own, so open sessions keep reading.
+ *
+ * @param {string} filePath - Path to BRAW file
+ * @param {number} inFrame - First frame to keep
+ * @param {number} outFrame - Last frame to keep, inclusive
+ * @param {string} outputPath - The new .braw file; replaced if it exists once the trim completes
+ * @param {object} [opts] - { onProgress, requestId, timeoutMs } plus the openClip options:
+ *                          onProgress(fraction) as the trim is written; requestId makes the
+ *                          trim cancellable through cancelTrim(requestId); trims still
+ *                          running timeoutMs after the call are aborted
+ * @returns {Promise<object>} { success, frame_count, bytes }, or { success: false, error,
+ *                            cancelled }; a failed trim leaves outputPath untouched
+ */
+Napi::Value TrimClip(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4 || !info[0].IsString() || !info[1].IsNumber() || !info[2].IsNumber() ||
+        !info[3].IsString()) {
+        Napi::TypeError::New(env, "Expected (string filePath, number inFrame, number outFrame, string outputPath)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    int64_t inFrame = info[1].As<Napi::Number>().Int64Value();
+    int64_t outFrame = info[2].As<Napi::Number>().Int64Value();
+    std::string outputPath = info[3].As<Napi::String>().Utf8Value();
+
+    TrimOptions options;
+    if (!ParseTrimOptions(env, info[4], options))
+        return env.Null();
+
+    if (inFrame < 0 || outFrame < inFrame)
+        return FrameRequest::Failed(env, "Invalid trim range");
+
+    return TrimRequest::Queue(env, filePath, static_cast<uint64_t>(inFrame), static_cast<uint64_t>(outFrame),
+                              outputPath, options);
+}
+
+/**
+ * Abort trims started by this thread
+ *
+ * @param {string} [requestId] - The trim to abort; omitted aborts every trim with an id
+ * @returns {number} How many trims were told to stop. They resolve with cancelled: true
+ *                   at their next progress report.
+ */
+Napi::Value CancelTrim(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::map<std::string, std::shared_ptr<FrameCancel> >& trims = BrawAddon::Get(env).trims;
+    uint32_t cancelled = 0;
+
+    if (info.Length() > 0 && (info[0].IsString() || info[0].IsNumber()))
     {
-        factory = CreateBlackmagicRawFactoryInstanceFromPath("/usr/local/lib");
-        if (!factory)
+        std::map<std::string, std::shared_ptr<FrameCancel> >::iterator trim =
+            trims.find(info[0].ToString().Utf8Value());
+        if (trim != trims.end())
         {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to create factory");
-            break;
+            trim->second->Cancel();
+            cancelled++;
         }
+        return Napi::Number::New(env, cancelled);
+    }
 
-        result = factory->CreateCodec(&codec);
-        if (result != S_OK)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to create codec");
-            break;
-        }
+    for (std::map<std::string, std::shared_ptr<FrameCancel> >::iterator trim = trims.begin(); trim != trims.end(); ++trim)
+    {
+        trim->second->Cancel();
+        cancelled++;
+    }
+    return Napi::Number::New(env, cancelled);
+}
 
-        result = codec->OpenClip(filePath.c_str(), &clip);
-        if (result != S_OK)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to open clip");
-            break;
-        }
+/**
+ * Extract many frames from a BRAW file in one pipelined pass
+ *
+ * All read jobs go to a single codec, with at most maxInFlight queued at a
+ * time, instead of one open/decode/flush round trip per frame.
+ *
+ * @param {string} filePath - Path to BRAW file
+ * @param {number[]} frameIndices - Frame indices to extract
+ * @param {object} [opts] - extractFrame options plus { maxInFlight, codecs }: maxInFlight caps
+ *                          jobs queued per codec; codecs opens that many codecs on the clip
+ *                          and spreads the frames over them (default 1, 0 sizes to the machine)
+ * @returns {Promise<object[]>} extractFrame-shaped results plus frame_index, in request order
+ */
+Napi::Value ExtractFrames(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
 
-        // Verify frame index
-        uint64_t frame_count = 0;
-        clip->GetFrameCount(&frame_count);
-        if (frameIndex < 0 || frameIndex >= (long)frame_count)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Frame index out of range");
-            result = E_FAIL;
-            break;
-        }
+    // Validate arguments
+    if (info.Length() < 2 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected (string filePath, number[] frameIndices, object? opts)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-        result = codec->SetCallback(&callback);
-        if (result != S_OK)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to set callback");
-            break;
-        }
+    std::string filePath = info[0].As<Napi::String>().Utf8Value();
+    std::vector<int64_t> frameIndices;
+    uint32_t maxInFlight = 0;
+    uint32_t codecs = 1;
+    FrameOptions options;
 
-        result = clip->CreateJobReadFrame(frameIndex, &readJob);
-        if (result != S_OK)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to create read job");
-            break;
-        }
+    if (!FrameBatch::ParseArguments(info, 1, frameIndices, maxInFlight, codecs, options))
+        return env.Null();
 
-        result = readJob->Submit();
-        if (result != S_OK)
-        {
-            readJob->Release();
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to submit job");
-            break;
-        }
+    return FrameBatch::Queue(env, std::make_shared<BrawDecodePool>(), filePath, frameIndices,
+                             maxInFlight, codecs, options);
+}
 
-        codec->FlushJobs();
+/**
+ * Decoded-frame cache occupancy and hit counters
+ *
+ * @returns {object} Object with entries, bytes, max_bytes, hits, misses, evictions
+ */
+Napi::Value FrameCacheStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    BrawFrameCacheStats stats = BrawFrameCache::Shared().Stats();
+    Napi::Object obj = Napi::Object::New(env);
+
+    obj.Set("entries", Napi::Number::New(env, static_cast<double>(stats.entries)));
+    obj.Set("bytes", Napi::Number::New(env, static_cast<double>(stats.bytes)));
+    obj.Set("max_bytes", Napi::Number::New(env, static_cast<double>(stats.max_bytes)));
+    obj.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    obj.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    obj.Set("evictions", Napi::Number::New(env, static_cast<double>(stats.evictions)));
+    return obj;
+}
 
-        // Check for errors
-        if (callback.error_occurred)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Processing error occurred");
-            result = E_FAIL;
-            break;
-        }
+/**
+ * Set the decoded-frame cache budget, shared by every clip and session
+ *
+ * @param {object} opts - { maxBytes }: byte budget; 0 disables the cache
+ * @returns {object} Cache stats after the change, as for frameCacheStats
+ */
+Napi::Value ConfigureFrameCache(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
 
-        // Check if we got the image
-        if (!callback.processed_image)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "No processed image received");
-            result = E_FAIL;
-            break;
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Object expected for cache options").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Value maxBytes = info[0].As<Napi::Object>().Get("maxBytes");
+    if (maxBytes.IsNumber())
+    {
+        double bytes = maxBytes.As<Napi::Number>().DoubleValue();
+        if (bytes < 0) {
+            Napi::TypeError::New(env, "maxBytes must not be negative").ThrowAsJavaScriptException();
+            return env.Null();
         }
+        BrawFrameCache::Shared().SetMaxBytes(static_cast<size_t>(bytes));
+    }
 
-        // Get image dimensions
-        unsigned int width = 0;
-        unsigned int height = 0;
-        callback.processed_image->GetWidth(&width);
-        callback.processed_image->GetHeight(&height);
-
-        // Get resource type
-        BlackmagicRawResourceType resourceType;
-        callback.processed_image->GetResourceType(&resourceType);
-        
-        if (resourceType != blackmagicRawResourceTypeBufferCPU)
-        {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Unexpected resource type");
-            result = E_FAIL;
-            break;
+    return FrameCacheStats(info);
+}
+
+/**
+ * Frame-buffer pool occupancy and reuse counters
+ *
+ * @returns {object} Object with idle_buffers, idle_bytes, max_idle_bytes, used_buffers,
+ *                   used_bytes, hits, misses
+ */
+Napi::Value BufferPoolStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    BrawBufferPoolStats stats = BrawBufferPool::Shared().Stats();
+    Napi::Object obj = Napi::Object::New(env);
+
+    obj.Set("idle_buffers", Napi::Number::New(env, static_cast<double>(stats.idle_buffers)));
+    obj.Set("idle_bytes", Napi::Number::New(env, static_cast<double>(stats.idle_bytes)));
+    obj.Set("max_idle_bytes", Napi::Number::New(env, static_cast<double>(stats.max_idle_bytes)));
+    obj.Set("used_buffers", Napi::Number::New(env, static_cast<double>(stats.used_buffers)));
+    obj.Set("used_bytes", Napi::Number::New(env, static_cast<double>(stats.used_bytes)));
+    obj.Set("hits", Napi::Number::New(env, static_cast<double>(stats.hits)));
+    obj.Set("misses", Napi::Number::New(env, static_cast<double>(stats.misses)));
+    return obj;
+}
+
+/**
+ * Set how many bytes of released frame buffers are kept for reuse
+ *
+ * @param {object} opts - { maxIdleBytes }: idle byte budget; 0 frees buffers as they are released
+ * @returns {object} Pool stats after the change, as for bufferPoolStats
+ */
+Napi::Value ConfigureBufferPool(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Object expected for buffer pool options").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Value maxIdleBytes = info[0].As<Napi::Object>().Get("maxIdleBytes");
+    if (maxIdleBytes.IsNumber())
+    {
+        double bytes = maxIdleBytes.As<Napi::Number>().DoubleValue();
+        if (bytes < 0) {
+            Napi::TypeError::New(env, "maxIdleBytes must not be negative").ThrowAsJavaScriptException();
+            return env.Null();
         }
+        BrawBufferPool::Shared().SetMaxIdleBytes(static_cast<size_t>(bytes));
+    }
+
+    return BufferPoolStats(info);
+}
 
-        // Get image data
-        void* imageData = nullptr;
-        result = callback.processed_image->GetResource(&imageData);
-        if (result != S_OK || !imageData)
+/**
+ * Per-stage decode timings and throughput counters, process-wide
+ *
+ * @param {object} [opts] - { reset }: zero the counters once read
+ * @returns {object} Object with enabled, frames, bytes, encoded_bytes, errors, cancelled,
+ *                   peak_rss and stages, keyed by stage name, each with count, total_ns,
+ *                   mean_ns, min_ns, max_ns, p50_ns, p90_ns, p99_ns and histogram, a list of
+ *                   [upper_bound_ns, count] for the non-empty log2 buckets
+ */
+Napi::Value GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    bool reset = false;
+    if (info.Length() > 0 && info[0].IsObject())
+    {
+        Napi::Value value = info[0].As<Napi::Object>().Get("reset");
+        reset = value.IsBoolean() && value.As<Napi::Boolean>().Value();
+    }
+
+    BrawStatsSnapshot snapshot;
+    BrawStats::Shared().Snapshot(snapshot, reset);
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("enabled", snapshot.enabled);
+    obj.Set("frames", Napi::Number::New(env, static_cast<double>(snapshot.frames)));
+    obj.Set("bytes", Napi::Number::New(env, static_cast<double>(snapshot.bytes)));
+    obj.Set("encoded_bytes", Napi::Number::New(env, static_cast<double>(snapshot.encoded_bytes)));
+    obj.Set("errors", Napi::Number::New(env, static_cast<double>(snapshot.errors)));
+    obj.Set("cancelled", Napi::Number::New(env, static_cast<double>(snapshot.cancelled)));
+    obj.Set("peak_rss", Napi::Number::New(env, static_cast<double>(snapshot.peak_rss)));
+
+    Napi::Object stages = Napi::Object::New(env);
+    for (int i = 0; i < brawStageCount; i++)
+    {
+        const BrawStageStats& stage = snapshot.stages[i];
+        Napi::Object stageObj = Napi::Object::New(env);
+
+        stageObj.Set("count", Napi::Number::New(env, static_cast<double>(stage.count)));
+        stageObj.Set("total_ns", Napi::Number::New(env, static_cast<double>(stage.total_ns)));
+        stageObj.Set("mean_ns", Napi::Number::New(env, stage.count ? static_cast<double>(stage.total_ns) / stage.count : 0.0));
+        stageObj.Set("min_ns", Napi::Number::New(env, static_cast<double>(stage.min_ns)));
+        stageObj.Set("max_ns", Napi::Number::New(env, static_cast<double>(stage.max_ns)));
+        stageObj.Set("p50_ns", Napi::Number::New(env, static_cast<double>(StagePercentile(stage, 0.5))));
+        stageObj.Set("p90_ns", Napi::Number::New(env, static_cast<double>(StagePercentile(stage, 0.9))));
+        stageObj.Set("p99_ns", Napi::Number::New(env, static_cast<double>(StagePercentile(stage, 0.99))));
+
+        Napi::Array histogram = Napi::Array::New(env);
+        for (int bucket = 0; bucket < kBrawStatsBuckets; bucket++)
         {
-            resultObj.Set("success", false);
-            resultObj.Set("error", "Failed to get image data");
-            break;
+            if (stage.buckets[bucket] == 0)
+                continue;
+
+            Napi::Array entry = Napi::Array::New(env, 2);
+            entry.Set(0u, Napi::Number::New(env, static_cast<double>(StageBucketLimit(bucket))));
+            entry.Set(1u, Napi::Number::New(env, static_cast<double>(stage.buckets[bucket])));
+            histogram.Set(histogram.Length(), entry);
         }
+        stageObj.Set("histogram", histogram);
 
-        // Create Node.js Buffer from image data
-        size_t bufferSize = width * height * 4; // RGBA
-        Napi::Buffer<uint8_t> buffer = Napi::Buffer<uint8_t>::Copy(env, static_cast<uint8_t*>(imageData), bufferSize);
+        stages.Set(StageName(static_cast<BrawStage>(i)), stageObj);
+    }
+    obj.Set("stages", stages);
 
-        // Build result object
-        resultObj.Set("success", true);
-        resultObj.Set("width", Napi::Number::New(env, width));
-        resultObj.Set("height", Napi::Number::New(env, height));
-        resultObj.Set("buffer", buffer);
+    return obj;
+}
 
-    } while(0);
+/**
+ * Turn the per-stage timers on or off. Off by default; counters are kept
+ * while off, so a later getStats still reports what was measured.
+ *
+ * @param {object} opts - { enabled }
+ * @returns {object} Stats after the change, as for getStats
+ */
+Napi::Value ConfigureStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
 
-    if (clip != nullptr)
-        clip->Release();
-    if (codec != nullptr)
-        codec->Release();
-    if (factory != nullptr)
-        factory->Release();
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Object expected for stats options").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-    return resultObj;
+    Napi::Value enabled = info[0].As<Napi::Object>().Get("enabled");
+    if (enabled.IsBoolean())
+        BrawStats::Shared().SetEnabled(enabled.As<Napi::Boolean>().Value());
+
+    return GetStats(info);
 }
 
 /**
- * Initialize the addon
+ * Drop every cached frame. Buffers already handed out stay valid.
  */
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
+Napi::Value ClearFrameCache(const Napi::CallbackInfo& info) {
+    BrawFrameCache::Shared().Clear();
+    return info.Env().Undefined();
+}
+
+/**
+ * Initialize the addon for one environment: the main thread or a worker
+ */
+BrawAddon::BrawAddon(Napi::Env env, Napi::Object exports) {
     exports.Set(
         Napi::String::New(env, "extractMetadata"),
         Napi::Function::New(env, ExtractMetadata)
     );
-    
+
+    exports.Set(
+        Napi::String::New(env, "indexClip"),
+        Napi::Function::New(env, IndexClip)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "readClipIndex"),
+        Napi::Function::New(env, ReadClipIndex)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "prepareClip"),
+        Napi::Function::New(env, PrepareClip)
+    );
+
     exports.Set(
         Napi::String::New(env, "extractFrame"),
         Napi::Function::New(env, ExtractFrame)
     );
 
-    return exports;
-}
+    exports.Set(
+        Napi::String::New(env, "extractFrameAsync"),
+        Napi::Function::New(env, ExtractFrameAsync)
+    );
 
-NODE_API_MODULE(braw, Init)
+    exports.Set(
+        Napi::String::New(env, "extractFrames"),
+        Napi::Function::New(env, ExtractFrames)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "trimClip"),
+        Napi::Function::New(env, TrimClip)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "cancelTrim"),
+        Napi::Function::New(env, CancelTrim)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "configureFrameCache"),
+        Napi::Function::New(env, ConfigureFrameCache)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "frameCacheStats"),
+        Napi::Function::New(env, FrameCacheStats)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "clearFrameCache"),
+        Napi::Function::New(env, ClearFrameCache)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "configureBufferPool"),
+        Napi::Function::New(env, ConfigureBufferPool)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "bufferPoolStats"),
+        Napi::Function::New(env, BufferPoolStats)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "configureStats"),
+        Napi::Function::New(env, ConfigureStats)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "getStats"),
+        Napi::Function::New(env, GetStats)
+    );
+
+    clip_session = Napi::Persistent(ClipSession::Init(env));
+
+    exports.Set(
+        Napi::String::New(env, "openClip"),
+        Napi::Function::New(env, ClipSession::Open)
+    );
+}
 
+NODE_API_ADDON(BrawAddon)
@@ -1,8 +1,86 @@
 import { publicProcedure, router } from "../_core/trpc";
 import { z } from "zod";
 import { getBRAWProcessor } from "../brawProcessor";
+import { getRenderQueue, RenderError } from "../brawRender";
+import { BRAWCancelledError } from "../braw";
 import { TRPCError } from "@trpc/server";
 
+// SDK decode settings; names and ranges follow the Blackmagic RAW SDK
+const processing = z.object({
+  colorScienceGen: z.number().int().optional(),
+  gamma: z.string().optional(),
+  gamut: z.string().optional(),
+  toneCurveContrast: z.number().optional(),
+  toneCurveSaturation: z.number().optional(),
+  toneCurveMidpoint: z.number().optional(),
+  toneCurveHighlights: z.number().optional(),
+  toneCurveShadows: z.number().optional(),
+  toneCurveVideoBlackLevel: z.boolean().optional(),
+  toneCurveBlackLevel: z.number().optional(),
+  toneCurveWhiteLevel: z.number().optional(),
+  highlightRecovery: z.boolean().optional(),
+  analogGainIsConstant: z.boolean().optional(),
+  analogGain: z.number().optional(),
+  post3DLUTMode: z.string().optional(),
+  whiteBalanceKelvin: z.number().int().min(0).optional(),
+  whiteBalanceTint: z.number().int().optional(),
+  exposure: z.number().optional(),
+  iso: z.number().int().min(0).optional(),
+});
+
+// NodeSystem nodes; the server grades primary_wheels and lut nodes natively
+const gradeNode = z.object({
+  type: z.string(),
+  enabled: z.boolean().optional(),
+  params: z.record(z.string(), z.any()),
+});
+const grade = z.union([z.object({ nodes: z.array(gradeNode) }), z.array(gradeNode)]);
+
+const priority = z.enum(["interactive", "prefetch", "batch"]);
+
+// advancedChromaKeyShader's uniforms, colours as 0-255 levels
+const keyColor = z.union([
+  z.tuple([z.number().min(0).max(255), z.number().min(0).max(255), z.number().min(0).max(255)]),
+  z.object({ r: z.number().min(0).max(255), g: z.number().min(0).max(255), b: z.number().min(0).max(255) }),
+]);
+const key = z.object({
+  keyColor: keyColor.optional(),
+  hueRange: z.number().positive().optional(),
+  satRange: z.number().positive().optional(),
+  lumRange: z.number().positive().optional(),
+  threshold: z.number().optional(),
+  tolerance: z.number().min(0).optional(),
+  edgeThin: z.number().optional(),
+  edgeFeather: z.number().optional(),
+  edgeRefine: z.boolean().optional(),
+  edgeRadius: z.number().min(0).optional(),
+  spillSuppress: z.number().min(0).max(1).optional(),
+  despillBias: z.number().min(0).max(1).optional(),
+  despillColor: keyColor.optional(),
+  matteContrast: z.number().optional(),
+  matteGamma: z.number().positive().optional(),
+  matteClipBlack: z.number().optional(),
+  matteClipWhite: z.number().optional(),
+  writeAlpha: z.boolean().optional(),
+  matte: z.enum(["u8", "u16"]).optional(),
+});
+
+// Where a render goes: an image sequence directory or an H.264 mp4
+const renderOutput = z.object({
+  container: z.enum(["frames", "mp4"]),
+  encoding: z.enum(["jpeg", "webp"]).optional(),
+  quality: z.number().int().min(1).max(100).optional(),
+  resolution: z.enum(["low", "medium", "high"]).optional(),
+});
+
+// A superseded request is not a server failure; report it as the client's doing
+function cancelledError(error: unknown): TRPCError | undefined {
+  if (error instanceof BRAWCancelledError) {
+    return new TRPCError({ code: "CLIENT_CLOSED_REQUEST", message: "Frame request cancelled" });
+  }
+  return undefined;
+}
+
 export const brawRouter = router({
 
 
@@ -30,6 +108,10 @@ export const brawRouter = router({
         fileId: z.string(),
         timestamp: z.number(),
         quality: z.enum(["low", "medium", "high"]).optional(),
+        processing: processing.optional(),
+        grade: grade.optional(),
+        requestId: z.string().max(128).optional(),
+        priority: priority.optional(),
       })
     )
     .query(async ({ input }) => {
@@ -41,7 +123,7 @@ export const brawRouter = router({
           timestamp: input.timestamp,
         };
       } catch (error) {
-        throw new TRPCError({
+        throw cancelledError(error) ?? new TRPCError({
           code: "INTERNAL_SERVER_ERROR",
           message: "Failed to extract frame",
         });
@@ -54,28 +136,156 @@ export const brawRouter = router({
         fileId: z.string(),
         timestamps: z.array(z.number()),
         quality: z.enum(["low", "medium", "high"]).optional(),
+        processing: processing.optional(),
+        grade: grade.optional(),
+        requestId: z.string().max(128).optional(),
+        priority: priority.optional(),
       })
     )
     .query(async ({ input }) => {
       try {
         const processor = await getBRAWProcessor();
-        const frames = await Promise.all(
-          input.timestamps.map((timestamp) =>
-            processor.extractFrame({ ...input, timestamp })
-          )
-        );
+        const frames = await processor.extractFrames(input);
         return frames.map((buffer, i) => ({
           timestamp: input.timestamps[i],
           data: buffer.toString("base64"),
         }));
       } catch (error) {
-        throw new TRPCError({
+        throw cancelledError(error) ?? new TRPCError({
           code: "INTERNAL_SERVER_ERROR",
           message: "Failed to extract frames",
         });
       }
     }),
 
+  getMetadata: publicProcedure
+    .input(z.object({ fileId: z.string() }))
+    .query(async ({ input }) => {
+      try {
+        const processor = await getBRAWProcessor();
+        return await processor.getMetadata(input.fileId);
+      } catch (error) {
+        throw new TRPCError({
+          code: "NOT_FOUND",
+          message: "BRAW file not found",
+        });
+      }
+    }),
+
+  getClipProcessing: publicProcedure
+    .input(z.object({ fileId: z.string() }))
+    .query(async ({ input }) => {
+      try {
+        const processor = await getBRAWProcessor();
+        return await processor.getClipProcessing(input.fileId);
+      } catch (error) {
+        throw new TRPCError({
+          code: "INTERNAL_SERVER_ERROR",
+          message: "Failed to read clip processing attributes",
+        });
+      }
+    }),
+
+  getScopes: publicProcedure
+    .input(
+      z.object({
+        fileId: z.string(),
+        timestamp: z.number(),
+        quality: z.enum(["low", "medium", "high"]).optional(),
+        waveformWidth: z.number().int().min(16).max(1024).optional(),
+        waveformHeight: z.number().int().min(16).max(1024).optional(),
+        vectorscopeSize: z.number().int().min(16).max(1024).optional(),
+      })
+    )
+    .query(async ({ input }) => {
+      try {
+        const processor = await getBRAWProcessor();
+        const scopes = await processor.getScopes(input);
+        return {
+          timestamp: input.timestamp,
+          histogram: Array.from(scopes.histogram),
+          waveform: {
+            width: scopes.waveform.width,
+            height: scopes.waveform.height,
+            data: scopes.waveform.data.toString("base64"),
+          },
+          vectorscope: {
+            size: scopes.vectorscope.size,
+            data: scopes.vectorscope.data.toString("base64"),
+          },
+        };
+      } catch (error) {
+        throw new TRPCError({
+          code: "INTERNAL_SERVER_ERROR",
+          message: "Failed to compute scopes",
+        });
+      }
+    }),
+
+  // Without requestIds every named request on the clip is cancelled
+  cancelFrames: publicProcedure
+    .input(
+      z.object({
+        fileId: z.string(),
+        requestIds: z.array(z.string().max(128)).optional(),
+      })
+    )
+    .mutation(async ({ input }) => {
+      const processor = await getBRAWProcessor();
+      return { cancelled: processor.cancelFrames(input.fileId, input.requestIds) };
+    }),
+
+  // Queue a headless render; progress is polled with getRender
+  submitRender: publicProcedure
+    .input(
+      z.object({
+        fileId: z.string(),
+        inFrame: z.number().int().min(0).optional(),
+        outFrame: z.number().int().min(0).optional(),
+        processing: processing.optional(),
+        grade: grade.optional(),
+        key: key.optional(),
+        output: renderOutput,
+      })
+    )
+    .mutation(async ({ input }) => {
+      try {
+        const queue = await getRenderQueue();
+        return await queue.submit(input);
+      } catch (error) {
+        if (error instanceof RenderError) {
+          throw new TRPCError({ code: "BAD_REQUEST", message: error.message });
+        }
+        throw new TRPCError({
+          code: "NOT_FOUND",
+          message: "BRAW file not found",
+        });
+      }
+    }),
+
+  getRender: publicProcedure
+    .input(z.object({ jobId: z.string() }))
+    .query(async ({ input }) => {
+      const queue = await getRenderQueue();
+      const job = await queue.get(input.jobId);
+      if (!job) {
+        throw new TRPCError({ code: "NOT_FOUND", message: "Render job not found" });
+      }
+      return job;
+    }),
+
+  listRenders: publicProcedure.query(async () => {
+    const queue = await getRenderQueue();
+    return queue.list();
+  }),
+
+  cancelRender: publicProcedure
+    .input(z.object({ jobId: z.string() }))
+    .mutation(async ({ input }) => {
+      const queue = await getRenderQueue();
+      return { cancelled: await queue.cancel(input.jobId) };
+    }),
+
   cleanup: publicProcedure
     .input(z.object({ fileId: z.string() }))
     .mutation(async ({ input }) => {
@@ -88,5 +298,13 @@ export const brawRouter = router({
     const processor = await getBRAWProcessor();
     return processor.getCacheStats();
   }),
+
+  // Enabled with BRAW_STATS=1; reset makes each scrape report one interval
+  getStats: publicProcedure
+    .input(z.object({ reset: z.boolean().optional() }).optional())
+    .query(async ({ input }) => {
+      const processor = await getBRAWProcessor();
+      return processor.getStats(input?.reset ?? false);
+    }),
 });
 